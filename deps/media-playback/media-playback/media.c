@@ -284,6 +284,36 @@ static void mp_media_next_audio(mp_media_t *m)
 	m->a_cb(m->opaque, &audio);
 }
 
+static void release_video_frame(void *param)
+{
+	AVFrame *f = param;
+	av_frame_free(&f);
+}
+
+/* passes a new reference to the decoded frame instead of having it copied,
+ * the decoder allocates a new buffer for the next frame while it's held */
+static bool mp_media_output_video_ref(mp_media_t *m, AVFrame *f,
+		struct obs_source_frame *frame)
+{
+	AVFrame *ref = av_frame_clone(f);
+	struct obs_source_frame ref_frame = *frame;
+	ptrdiff_t offset;
+
+	if (!ref)
+		return false;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		if (!frame->data[i])
+			continue;
+
+		offset = frame->data[i] - f->data[i];
+		ref_frame.data[i] = ref->data[i] + offset;
+	}
+
+	m->v_ref_cb(m->opaque, &ref_frame, release_video_frame, ref);
+	return true;
+}
+
 static void mp_media_next_video(mp_media_t *m, bool preload)
 {
 	struct mp_decode *d = &m->v;
@@ -381,7 +411,8 @@ static void mp_media_next_video(mp_media_t *m, bool preload)
 
 	if (preload)
 		m->v_preload_cb(m->opaque, frame);
-	else
+	else if (m->swscale || !m->v_ref_cb ||
+	         !mp_media_output_video_ref(m, f, frame))
 		m->v_cb(m->opaque, frame);
 }
 
@@ -682,6 +713,7 @@ bool mp_media_init(mp_media_t *media, const struct mp_media_info *info)
 	pthread_mutex_init_value(&media->mutex);
 	media->opaque = info->opaque;
 	media->v_cb = info->v_cb;
+	media->v_ref_cb = info->v_ref_cb;
 	media->a_cb = info->a_cb;
 	media->stop_cb = info->stop_cb;
 	media->v_preload_cb = info->v_preload_cb;
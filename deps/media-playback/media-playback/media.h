@@ -39,6 +39,8 @@ extern "C" {
 #endif
 
 typedef void (*mp_video_cb)(void *opaque, struct obs_source_frame *frame);
+typedef void (*mp_video_ref_cb)(void *opaque, struct obs_source_frame *frame,
+		void (*release)(void *param), void *param);
 typedef void (*mp_audio_cb)(void *opaque, struct obs_source_audio *audio);
 typedef void (*mp_stop_cb)(void *opaque);
 
@@ -48,6 +50,7 @@ struct mp_media {
 	mp_video_cb v_preload_cb;
 	mp_stop_cb stop_cb;
 	mp_video_cb v_cb;
+	mp_video_ref_cb v_ref_cb;
 	mp_audio_cb a_cb;
 	void *opaque;
 
@@ -101,6 +104,7 @@ struct mp_media_info {
 	void *opaque;
 
 	mp_video_cb v_cb;
+	mp_video_ref_cb v_ref_cb;
 	mp_video_cb v_preload_cb;
 	mp_audio_cb a_cb;
 	mp_stop_cb stop_cb;
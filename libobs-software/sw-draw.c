@@ -0,0 +1,639 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include <graphics/vec2.h>
+#include <graphics/vec3.h>
+#include "sw-subsystem.h"
+
+/* transformed vertex, ready for rasterization */
+struct sw_vertex {
+	float        x, y, z;
+	float        inv_w;
+	struct vec2  uv;
+	struct vec4  color;
+};
+
+/* pixel stage state, resolved once per draw */
+struct sw_pixel_state {
+	const gs_texture_t     *texture;
+	struct gs_sampler_info sampler;
+	bool                   textured;
+	bool                   vertex_color;
+
+	bool                   has_color;
+	struct vec4            color;
+
+	bool                   has_matrix;
+	struct matrix4         color_matrix;
+	struct vec3            range_min;
+	struct vec3            range_max;
+};
+
+struct sw_target {
+	struct sw_surface         *surf;
+	enum gs_color_format      format;
+	uint32_t                  bytes_per_pixel;
+	struct gs_zstencil_buffer *zs;
+
+	int                       min_x, min_y;
+	int                       max_x, max_y;
+};
+
+/* ------------------------------------------------------------------------- */
+/* setup                                                                     */
+
+static inline bool can_render(const gs_device_t *device)
+{
+	if (!device->cur_vertex_shader) {
+		blog(LOG_ERROR, "No vertex shader specified");
+		return false;
+	}
+
+	if (!device->cur_pixel_shader) {
+		blog(LOG_ERROR, "No pixel shader specified");
+		return false;
+	}
+
+	if (!device->cur_vertex_buffer) {
+		blog(LOG_ERROR, "No vertex buffer specified");
+		return false;
+	}
+
+	if (!sw_get_target_surface((gs_device_t*)device)) {
+		blog(LOG_ERROR, "No active swap chain or render target");
+		return false;
+	}
+
+	return true;
+}
+
+static void update_viewproj_matrix(struct gs_device *device)
+{
+	struct gs_shader *vs = device->cur_vertex_shader;
+
+	gs_matrix_get(&device->cur_view);
+	matrix4_mul(&device->cur_viewproj, &device->cur_view,
+			&device->cur_proj);
+
+	if (vs->viewproj)
+		gs_shader_set_matrix4(vs->viewproj, &device->cur_viewproj);
+}
+
+static inline bool get_param_data(const struct gs_shader_param *param,
+		void *dst, size_t size)
+{
+	if (!param || param->cur_value.num < size)
+		return false;
+
+	memcpy(dst, param->cur_value.array, size);
+	return true;
+}
+
+static const struct gs_sampler_info *get_param_sampler(
+		struct gs_device *device, struct gs_shader_param *param)
+{
+	gs_samplerstate_t *ss = NULL;
+
+	if (param->next_sampler) {
+		ss = param->next_sampler;
+		param->next_sampler = NULL;
+		if (param->texture_id < GS_MAX_TEXTURES)
+			device->cur_samplers[param->texture_id] = ss;
+	}
+
+	if (!ss && param->texture_id < GS_MAX_TEXTURES)
+		ss = device->cur_samplers[param->texture_id];
+	if (!ss && param->shader->samplers.num)
+		ss = param->shader->samplers.array[0];
+	if (!ss)
+		ss = device->default_sampler;
+
+	return &ss->info;
+}
+
+static void init_pixel_state(struct gs_device *device,
+		struct sw_pixel_state *ps)
+{
+	struct gs_shader *shader = device->cur_pixel_shader;
+	struct gs_vertex_buffer *vb = device->cur_vertex_buffer;
+	struct gs_shader_param *tex_param = shader->first_texture;
+
+	memset(ps, 0, sizeof(*ps));
+
+	if (tex_param) {
+		ps->textured = true;
+		ps->texture  = tex_param->texture;
+		ps->sampler  = *get_param_sampler(device, tex_param);
+
+		if (ps->texture && ps->texture->type != GS_TEXTURE_2D) {
+			blog(LOG_DEBUG, "device_draw (software): only 2D "
+			                "textures can be sampled");
+			ps->texture = NULL;
+		}
+
+		device->cur_textures[tex_param->texture_id] =
+			tex_param->texture;
+	}
+
+	ps->vertex_color = !ps->textured && vb->data->colors != NULL;
+	ps->has_color = get_param_data(shader->color, ps->color.ptr,
+			sizeof(float) * 4);
+	ps->has_matrix = get_param_data(shader->color_matrix,
+			&ps->color_matrix, sizeof(struct matrix4));
+
+	if (!get_param_data(shader->color_range_min, ps->range_min.ptr,
+				sizeof(float) * 3))
+		vec3_set(&ps->range_min, 0.0f, 0.0f, 0.0f);
+	if (!get_param_data(shader->color_range_max, ps->range_max.ptr,
+				sizeof(float) * 3))
+		vec3_set(&ps->range_max, 1.0f, 1.0f, 1.0f);
+}
+
+static void init_target(struct gs_device *device, struct sw_target *target)
+{
+	struct gs_rect *vp = &device->cur_viewport;
+
+	target->surf = sw_get_target_surface(device);
+	target->format = device->cur_render_target
+		? device->cur_render_target->format
+		: device->cur_swap->target->format;
+	target->bytes_per_pixel = gs_get_format_bpp(target->format) / 8;
+	target->zs = device->depth_test ? device->cur_zstencil_buffer : NULL;
+
+	target->min_x = vp->x > 0 ? vp->x : 0;
+	target->min_y = vp->y > 0 ? vp->y : 0;
+	target->max_x = vp->x + vp->cx;
+	target->max_y = vp->y + vp->cy;
+
+	if (target->max_x > (int)target->surf->width)
+		target->max_x = (int)target->surf->width;
+	if (target->max_y > (int)target->surf->height)
+		target->max_y = (int)target->surf->height;
+
+	if (device->scissor_enabled) {
+		struct gs_rect *sc = &device->cur_scissor;
+		if (target->min_x < sc->x)
+			target->min_x = sc->x;
+		if (target->min_y < sc->y)
+			target->min_y = sc->y;
+		if (target->max_x > sc->x + sc->cx)
+			target->max_x = sc->x + sc->cx;
+		if (target->max_y > sc->y + sc->cy)
+			target->max_y = sc->y + sc->cy;
+	}
+
+	if (target->zs) {
+		if (target->max_x > (int)target->zs->width)
+			target->max_x = (int)target->zs->width;
+		if (target->max_y > (int)target->zs->height)
+			target->max_y = (int)target->zs->height;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* vertex stage                                                              */
+
+static void transform_vertex(struct gs_device *device, size_t idx,
+		struct sw_vertex *out)
+{
+	struct gs_vb_data *data = device->cur_vertex_buffer->data;
+	struct gs_rect *vp = &device->cur_viewport;
+	struct vec4 pos;
+
+	vec4_set(&pos, data->points[idx].x, data->points[idx].y,
+			data->points[idx].z, 1.0f);
+	vec4_transform(&pos, &pos, &device->cur_viewproj);
+
+	out->inv_w = pos.w != 0.0f ? 1.0f / pos.w : 0.0f;
+	out->x = (float)vp->x + ( pos.x * out->inv_w + 1.0f) * 0.5f *
+		(float)vp->cx;
+	out->y = (float)vp->y + (-pos.y * out->inv_w + 1.0f) * 0.5f *
+		(float)vp->cy;
+	out->z = pos.z * out->inv_w;
+
+	if (data->num_tex && data->tvarray[0].width >= 2) {
+		const float *uv = (const float*)data->tvarray[0].array +
+			idx * data->tvarray[0].width;
+		vec2_set(&out->uv, uv[0], uv[1]);
+	} else {
+		vec2_zero(&out->uv);
+	}
+
+	if (data->colors)
+		vec4_from_rgba(&out->color, data->colors[idx]);
+	else
+		vec4_set(&out->color, 1.0f, 1.0f, 1.0f, 1.0f);
+}
+
+/* ------------------------------------------------------------------------- */
+/* pixel stage                                                               */
+
+static inline float saturate(float val)
+{
+	return val < 0.0f ? 0.0f : (val > 1.0f ? 1.0f : val);
+}
+
+static inline float clampf(float val, float min_val, float max_val)
+{
+	return val < min_val ? min_val : (val > max_val ? max_val : val);
+}
+
+static void shade_pixel(const struct sw_pixel_state *ps,
+		const struct vec2 *uv, const struct vec4 *vcolor,
+		struct vec4 *out)
+{
+	if (ps->textured) {
+		if (ps->texture)
+			sw_sample_texture(ps->texture, &ps->sampler,
+					uv->x, uv->y, out);
+		else
+			vec4_zero(out);
+	} else if (ps->vertex_color) {
+		vec4_copy(out, vcolor);
+	} else {
+		vec4_set(out, 1.0f, 1.0f, 1.0f, 1.0f);
+	}
+
+	if (ps->has_color)
+		vec4_mul(out, out, &ps->color);
+
+	if (ps->has_matrix) {
+		struct vec4 yuv;
+		vec4_set(&yuv,
+			clampf(out->x, ps->range_min.x, ps->range_max.x),
+			clampf(out->y, ps->range_min.y, ps->range_max.y),
+			clampf(out->z, ps->range_min.z, ps->range_max.z),
+			1.0f);
+		vec4_transform(out, &yuv, &ps->color_matrix);
+
+		for (size_t i = 0; i < 4; i++)
+			out->ptr[i] = saturate(out->ptr[i]);
+	}
+}
+
+static inline float blend_factor(enum gs_blend_type type,
+		const struct vec4 *src, const struct vec4 *dst, size_t channel)
+{
+	switch (type) {
+	case GS_BLEND_ZERO:        return 0.0f;
+	case GS_BLEND_ONE:         return 1.0f;
+	case GS_BLEND_SRCCOLOR:    return src->ptr[channel];
+	case GS_BLEND_INVSRCCOLOR: return 1.0f - src->ptr[channel];
+	case GS_BLEND_SRCALPHA:    return src->w;
+	case GS_BLEND_INVSRCALPHA: return 1.0f - src->w;
+	case GS_BLEND_DSTCOLOR:    return dst->ptr[channel];
+	case GS_BLEND_INVDSTCOLOR: return 1.0f - dst->ptr[channel];
+	case GS_BLEND_DSTALPHA:    return dst->w;
+	case GS_BLEND_INVDSTALPHA: return 1.0f - dst->w;
+	case GS_BLEND_SRCALPHASAT:
+		if (channel == 3)
+			return 1.0f;
+		return src->w < 1.0f - dst->w ? src->w : 1.0f - dst->w;
+	}
+
+	return 1.0f;
+}
+
+static inline bool depth_passes(enum gs_depth_test test, float z, float cur)
+{
+	switch (test) {
+	case GS_NEVER:    return false;
+	case GS_LESS:     return z <  cur;
+	case GS_LEQUAL:   return z <= cur;
+	case GS_EQUAL:    return z == cur;
+	case GS_GEQUAL:   return z >= cur;
+	case GS_GREATER:  return z >  cur;
+	case GS_NOTEQUAL: return z != cur;
+	case GS_ALWAYS:   return true;
+	}
+
+	return true;
+}
+
+static void write_pixel(const struct gs_device *device,
+		const struct sw_target *target, int x, int y, float z,
+		const struct vec4 *src)
+{
+	uint8_t *ptr = target->surf->data + (size_t)y * target->surf->linesize +
+		(size_t)x * target->bytes_per_pixel;
+	const struct sw_blend_state *blend = &device->blend;
+	struct vec4 dst, out;
+
+	if (target->zs) {
+		float *depth = target->zs->depth + (size_t)y * target->zs->width
+			+ x;
+		if (!depth_passes(device->depth_function, z, *depth))
+			return;
+		*depth = z;
+	}
+
+	sw_load_texel(target->format, ptr, &dst);
+
+	for (size_t i = 0; i < 4; i++) {
+		float val = src->ptr[i];
+
+		if (blend->enabled) {
+			enum gs_blend_type sf = i < 3 ? blend->src_c :
+				blend->src_a;
+			enum gs_blend_type df = i < 3 ? blend->dest_c :
+				blend->dest_a;
+
+			val = val * blend_factor(sf, src, &dst, i) +
+				dst.ptr[i] * blend_factor(df, src, &dst, i);
+		}
+
+		out.ptr[i] = device->color_mask[i] ? val : dst.ptr[i];
+	}
+
+	sw_store_texel(target->format, ptr, &out);
+}
+
+/* ------------------------------------------------------------------------- */
+/* rasterization                                                             */
+
+static inline float edge_func(const struct sw_vertex *a,
+		const struct sw_vertex *b, float x, float y)
+{
+	return (b->x - a->x) * (y - a->y) - (b->y - a->y) * (x - a->x);
+}
+
+/* top-left fill convention so shared edges are only drawn once */
+static inline bool is_top_left(const struct sw_vertex *a,
+		const struct sw_vertex *b, bool clockwise)
+{
+	float dx = b->x - a->x;
+	float dy = b->y - a->y;
+
+	if (!clockwise) {
+		dx = -dx;
+		dy = -dy;
+	}
+
+	return (dy == 0.0f && dx > 0.0f) || dy < 0.0f;
+}
+
+static inline bool culled(enum gs_cull_mode mode, bool clockwise)
+{
+	if (mode == GS_BACK)
+		return !clockwise;
+	if (mode == GS_FRONT)
+		return clockwise;
+	return false;
+}
+
+static inline int floor_clamp(float val, int min_val, int max_val)
+{
+	int ival = (int)floorf(val);
+	return ival < min_val ? min_val : (ival > max_val ? max_val : ival);
+}
+
+static void raster_triangle(struct gs_device *device,
+		const struct sw_target *target,
+		const struct sw_pixel_state *ps,
+		const struct sw_vertex *v0, const struct sw_vertex *v1,
+		const struct sw_vertex *v2)
+{
+	float area = edge_func(v0, v1, v2->x, v2->y);
+	bool clockwise = area > 0.0f;
+	bool tl0, tl1, tl2;
+	int min_x, min_y, max_x, max_y;
+	float inv_area;
+
+	if (area == 0.0f || culled(device->cur_cull_mode, clockwise))
+		return;
+	if (v0->inv_w <= 0.0f || v1->inv_w <= 0.0f || v2->inv_w <= 0.0f)
+		return;
+
+	inv_area = 1.0f / area;
+
+	min_x = floor_clamp(fminf(v0->x, fminf(v1->x, v2->x)),
+			target->min_x, target->max_x);
+	max_x = floor_clamp(fmaxf(v0->x, fmaxf(v1->x, v2->x)) + 1.0f,
+			target->min_x, target->max_x);
+	min_y = floor_clamp(fminf(v0->y, fminf(v1->y, v2->y)),
+			target->min_y, target->max_y);
+	max_y = floor_clamp(fmaxf(v0->y, fmaxf(v1->y, v2->y)) + 1.0f,
+			target->min_y, target->max_y);
+
+	tl0 = is_top_left(v1, v2, clockwise);
+	tl1 = is_top_left(v2, v0, clockwise);
+	tl2 = is_top_left(v0, v1, clockwise);
+
+	for (int y = min_y; y < max_y; y++) {
+		float py = (float)y + 0.5f;
+
+		for (int x = min_x; x < max_x; x++) {
+			float px = (float)x + 0.5f;
+			float w0 = edge_func(v1, v2, px, py) * inv_area;
+			float w1 = edge_func(v2, v0, px, py) * inv_area;
+			float w2 = edge_func(v0, v1, px, py) * inv_area;
+			float persp;
+			struct vec2 uv;
+			struct vec4 vcolor, color;
+			float z;
+
+			if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+				continue;
+			if ((w0 == 0.0f && !tl0) ||
+			    (w1 == 0.0f && !tl1) ||
+			    (w2 == 0.0f && !tl2))
+				continue;
+
+			z = w0 * v0->z + w1 * v1->z + w2 * v2->z;
+
+			w0 *= v0->inv_w;
+			w1 *= v1->inv_w;
+			w2 *= v2->inv_w;
+			persp = 1.0f / (w0 + w1 + w2);
+			w0 *= persp;
+			w1 *= persp;
+			w2 *= persp;
+
+			uv.x = w0 * v0->uv.x + w1 * v1->uv.x + w2 * v2->uv.x;
+			uv.y = w0 * v0->uv.y + w1 * v1->uv.y + w2 * v2->uv.y;
+
+			if (ps->vertex_color) {
+				for (size_t i = 0; i < 4; i++)
+					vcolor.ptr[i] =
+						w0 * v0->color.ptr[i] +
+						w1 * v1->color.ptr[i] +
+						w2 * v2->color.ptr[i];
+			}
+
+			shade_pixel(ps, &uv, &vcolor, &color);
+			write_pixel(device, target, x, y, z, &color);
+		}
+	}
+}
+
+static void raster_point(struct gs_device *device,
+		const struct sw_target *target,
+		const struct sw_pixel_state *ps, const struct sw_vertex *v)
+{
+	int x = (int)floorf(v->x);
+	int y = (int)floorf(v->y);
+	struct vec4 color;
+
+	if (x < target->min_x || x >= target->max_x ||
+	    y < target->min_y || y >= target->max_y)
+		return;
+
+	shade_pixel(ps, &v->uv, &v->color, &color);
+	write_pixel(device, target, x, y, v->z, &color);
+}
+
+static void raster_line(struct gs_device *device,
+		const struct sw_target *target,
+		const struct sw_pixel_state *ps,
+		const struct sw_vertex *v0, const struct sw_vertex *v1)
+{
+	float dx = v1->x - v0->x;
+	float dy = v1->y - v0->y;
+	float len = fmaxf(fabsf(dx), fabsf(dy));
+	int steps = (int)ceilf(len);
+
+	for (int i = 0; i <= steps; i++) {
+		float t = steps ? (float)i / (float)steps : 0.0f;
+		struct sw_vertex v;
+
+		v.x     = v0->x + dx * t;
+		v.y     = v0->y + dy * t;
+		v.z     = v0->z + (v1->z - v0->z) * t;
+		v.inv_w = 1.0f;
+		vec2_set(&v.uv, v0->uv.x + (v1->uv.x - v0->uv.x) * t,
+				v0->uv.y + (v1->uv.y - v0->uv.y) * t);
+		for (size_t c = 0; c < 4; c++)
+			v.color.ptr[c] = v0->color.ptr[c] +
+				(v1->color.ptr[c] - v0->color.ptr[c]) * t;
+
+		raster_point(device, target, ps, &v);
+	}
+}
+
+static inline size_t get_index(const struct gs_index_buffer *ib, size_t i)
+{
+	if (ib->type == GS_UNSIGNED_LONG)
+		return (size_t)((const unsigned long*)ib->data)[i];
+	return (size_t)((const unsigned short*)ib->data)[i];
+}
+
+void device_draw(gs_device_t *device, enum gs_draw_mode draw_mode,
+		uint32_t start_vert, uint32_t num_verts)
+{
+	struct gs_index_buffer *ib = device->cur_index_buffer;
+	struct gs_vertex_buffer *vb;
+	gs_effect_t *effect = gs_get_effect();
+	struct sw_pixel_state ps;
+	struct sw_target target;
+	struct sw_vertex *verts;
+	size_t total;
+
+	if (!can_render(device))
+		goto fail;
+
+	/* already warned about when the shader was created */
+	if (device->cur_vertex_shader->unsupported ||
+	    device->cur_pixel_shader->unsupported)
+		return;
+
+	vb = device->cur_vertex_buffer;
+	if (!vb->data || !vb->data->points) {
+		blog(LOG_ERROR, "Vertex buffer has no position data");
+		goto fail;
+	}
+
+	if (effect)
+		gs_effect_update_params(effect);
+
+	update_viewproj_matrix(device);
+	init_pixel_state(device, &ps);
+	init_target(device, &target);
+
+	if (!num_verts)
+		num_verts = (uint32_t)(ib ? ib->num : vb->num);
+
+	total = ib ? ib->num : vb->num;
+	if ((size_t)start_vert + num_verts > total) {
+		blog(LOG_ERROR, "Draw range exceeds buffer size");
+		goto fail;
+	}
+
+	if (target.min_x >= target.max_x || target.min_y >= target.max_y)
+		return;
+
+	verts = bmalloc(sizeof(struct sw_vertex) * num_verts);
+
+	for (uint32_t i = 0; i < num_verts; i++) {
+		size_t idx = ib ? get_index(ib, start_vert + i) :
+			start_vert + i;
+
+		if (idx >= vb->num) {
+			blog(LOG_ERROR, "Vertex index out of range");
+			bfree(verts);
+			goto fail;
+		}
+
+		transform_vertex(device, idx, &verts[i]);
+	}
+
+	switch (draw_mode) {
+	case GS_POINTS:
+		for (uint32_t i = 0; i < num_verts; i++)
+			raster_point(device, &target, &ps, &verts[i]);
+		break;
+
+	case GS_LINES:
+		for (uint32_t i = 0; i + 1 < num_verts; i += 2)
+			raster_line(device, &target, &ps,
+					&verts[i], &verts[i+1]);
+		break;
+
+	case GS_LINESTRIP:
+		for (uint32_t i = 0; i + 1 < num_verts; i++)
+			raster_line(device, &target, &ps,
+					&verts[i], &verts[i+1]);
+		break;
+
+	case GS_TRIS:
+		for (uint32_t i = 0; i + 2 < num_verts; i += 3)
+			raster_triangle(device, &target, &ps,
+					&verts[i], &verts[i+1], &verts[i+2]);
+		break;
+
+	case GS_TRISTRIP:
+		/* odd triangles swap their first two vertices so every
+		 * triangle in the strip keeps the same winding */
+		for (uint32_t i = 0; i + 2 < num_verts; i++) {
+			if (i & 1)
+				raster_triangle(device, &target, &ps,
+						&verts[i+1], &verts[i],
+						&verts[i+2]);
+			else
+				raster_triangle(device, &target, &ps,
+						&verts[i], &verts[i+1],
+						&verts[i+2]);
+		}
+		break;
+	}
+
+	bfree(verts);
+	return;
+
+fail:
+	blog(LOG_ERROR, "device_draw (software) failed");
+}
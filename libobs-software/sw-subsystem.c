@@ -0,0 +1,875 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <graphics/vec3.h>
+#include "sw-subsystem.h"
+
+const char *device_get_name(void)
+{
+	return "Software";
+}
+
+int device_get_type(void)
+{
+	return GS_DEVICE_SOFTWARE;
+}
+
+bool device_enum_adapters(
+		bool (*callback)(void *param, const char *name, uint32_t id),
+		void *param)
+{
+	callback(param, "CPU rasterizer", 0);
+	return true;
+}
+
+const char *device_preprocessor_name(void)
+{
+	return "_SOFTWARE";
+}
+
+int device_create(gs_device_t **p_device, uint32_t adapter)
+{
+	struct gs_device *device = bzalloc(sizeof(struct gs_device));
+	struct gs_sampler_info info = {0};
+
+	blog(LOG_INFO, "---------------------------------");
+	blog(LOG_INFO, "Initializing software renderer...");
+
+	if (pthread_mutex_init(&device->context_mutex, NULL) != 0) {
+		blog(LOG_ERROR, "device_create (software) failed");
+		bfree(device);
+		*p_device = NULL;
+		return GS_ERROR_FAIL;
+	}
+
+	info.filter    = GS_FILTER_LINEAR;
+	info.address_u = GS_ADDRESS_CLAMP;
+	info.address_v = GS_ADDRESS_CLAMP;
+	info.address_w = GS_ADDRESS_CLAMP;
+	device->default_sampler = device_samplerstate_create(device, &info);
+
+	device->cur_cull_mode  = GS_NEITHER;
+	device->depth_function = GS_LESS;
+	device->blend.enabled  = true;
+	device->blend.src_c    = GS_BLEND_SRCALPHA;
+	device->blend.dest_c   = GS_BLEND_INVSRCALPHA;
+	device->blend.src_a    = GS_BLEND_SRCALPHA;
+	device->blend.dest_a   = GS_BLEND_INVSRCALPHA;
+
+	for (size_t i = 0; i < 4; i++)
+		device->color_mask[i] = true;
+
+	matrix4_identity(&device->cur_proj);
+	matrix4_identity(&device->cur_view);
+	matrix4_identity(&device->cur_viewproj);
+
+	blog(LOG_INFO, "Software renderer loaded successfully, all "
+	               "rendering will be done on the CPU");
+
+	UNUSED_PARAMETER(adapter);
+
+	*p_device = device;
+	return GS_SUCCESS;
+}
+
+void device_destroy(gs_device_t *device)
+{
+	if (device) {
+		gs_samplerstate_destroy(device->default_sampler);
+		pthread_mutex_destroy(&device->context_mutex);
+		da_free(device->proj_stack);
+		bfree(device);
+	}
+}
+
+void device_enter_context(gs_device_t *device)
+{
+	pthread_mutex_lock(&device->context_mutex);
+}
+
+void device_leave_context(gs_device_t *device)
+{
+	pthread_mutex_unlock(&device->context_mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/* swap chains                                                               */
+
+/* There is no window system in a headless device, so swap chains render
+ * into a system memory back buffer that is never presented. */
+static bool init_swap_target(struct gs_swap_chain *swap)
+{
+	gs_texture_destroy(swap->target);
+	swap->target = NULL;
+
+	if (!swap->info.cx || !swap->info.cy)
+		return true;
+
+	swap->target = device_texture_create(swap->device, swap->info.cx,
+			swap->info.cy, GS_BGRA, 1, NULL, GS_RENDER_TARGET);
+	return swap->target != NULL;
+}
+
+gs_swapchain_t *device_swapchain_create(gs_device_t *device,
+		const struct gs_init_data *info)
+{
+	struct gs_swap_chain *swap = bzalloc(sizeof(struct gs_swap_chain));
+
+	swap->device = device;
+	swap->info   = *info;
+
+	if (!init_swap_target(swap)) {
+		blog(LOG_ERROR, "device_swapchain_create (software) failed");
+		gs_swapchain_destroy(swap);
+		return NULL;
+	}
+
+	return swap;
+}
+
+void gs_swapchain_destroy(gs_swapchain_t *swapchain)
+{
+	if (!swapchain)
+		return;
+
+	if (swapchain->device->cur_swap == swapchain)
+		device_load_swapchain(swapchain->device, NULL);
+
+	gs_texture_destroy(swapchain->target);
+	bfree(swapchain);
+}
+
+void device_load_swapchain(gs_device_t *device, gs_swapchain_t *swapchain)
+{
+	device->cur_swap = swapchain;
+}
+
+void device_resize(gs_device_t *device, uint32_t cx, uint32_t cy)
+{
+	if (device->cur_swap) {
+		device->cur_swap->info.cx = cx;
+		device->cur_swap->info.cy = cy;
+
+		if (!init_swap_target(device->cur_swap))
+			blog(LOG_ERROR, "device_resize (software) failed");
+	} else {
+		blog(LOG_WARNING, "device_resize (software): No active swap");
+	}
+}
+
+void device_get_size(const gs_device_t *device, uint32_t *cx, uint32_t *cy)
+{
+	if (device->cur_swap) {
+		*cx = device->cur_swap->info.cx;
+		*cy = device->cur_swap->info.cy;
+	} else {
+		blog(LOG_WARNING, "device_get_size (software): No active swap");
+		*cx = 0;
+		*cy = 0;
+	}
+}
+
+uint32_t device_get_width(const gs_device_t *device)
+{
+	if (device->cur_swap) {
+		return device->cur_swap->info.cx;
+	} else {
+		blog(LOG_WARNING, "device_get_width (software): "
+		                  "No active swap");
+		return 0;
+	}
+}
+
+uint32_t device_get_height(const gs_device_t *device)
+{
+	if (device->cur_swap) {
+		return device->cur_swap->info.cy;
+	} else {
+		blog(LOG_WARNING, "device_get_height (software): "
+		                  "No active swap");
+		return 0;
+	}
+}
+
+void device_present(gs_device_t *device)
+{
+	/* nothing to present to */
+	UNUSED_PARAMETER(device);
+}
+
+/* ------------------------------------------------------------------------- */
+/* volume textures                                                           */
+
+gs_texture_t *device_voltexture_create(gs_device_t *device, uint32_t width,
+		uint32_t height, uint32_t depth,
+		enum gs_color_format color_format, uint32_t levels,
+		const uint8_t **data, uint32_t flags)
+{
+	/* TODO */
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(width);
+	UNUSED_PARAMETER(height);
+	UNUSED_PARAMETER(depth);
+	UNUSED_PARAMETER(color_format);
+	UNUSED_PARAMETER(levels);
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(flags);
+	return NULL;
+}
+
+void gs_voltexture_destroy(gs_texture_t *voltex)
+{
+	/* TODO */
+	UNUSED_PARAMETER(voltex);
+}
+
+uint32_t gs_voltexture_get_width(const gs_texture_t *voltex)
+{
+	/* TODO */
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+uint32_t gs_voltexture_get_height(const gs_texture_t *voltex)
+{
+	/* TODO */
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+uint32_t gs_voltexture_get_depth(const gs_texture_t *voltex)
+{
+	/* TODO */
+	UNUSED_PARAMETER(voltex);
+	return 0;
+}
+
+enum gs_color_format gs_voltexture_get_color_format(const gs_texture_t *voltex)
+{
+	/* TODO */
+	UNUSED_PARAMETER(voltex);
+	return GS_UNKNOWN;
+}
+
+enum gs_texture_type device_get_texture_type(const gs_texture_t *texture)
+{
+	return texture->type;
+}
+
+/* ------------------------------------------------------------------------- */
+/* depth/stencil buffers                                                     */
+
+gs_zstencil_t *device_zstencil_create(gs_device_t *device, uint32_t width,
+		uint32_t height, enum gs_zstencil_format format)
+{
+	struct gs_zstencil_buffer *zs;
+
+	zs = bzalloc(sizeof(struct gs_zstencil_buffer));
+	zs->device = device;
+	zs->format = format;
+	zs->width  = width;
+	zs->height = height;
+	zs->depth  = bmalloc(sizeof(float) * width * height);
+
+	if (format == GS_Z24_S8 || format == GS_Z32F_S8X24)
+		zs->stencil = bzalloc(width * height);
+
+	for (size_t i = 0; i < (size_t)width * height; i++)
+		zs->depth[i] = 1.0f;
+
+	return zs;
+}
+
+void gs_zstencil_destroy(gs_zstencil_t *zs)
+{
+	if (zs) {
+		if (zs->device->cur_zstencil_buffer == zs)
+			zs->device->cur_zstencil_buffer = NULL;
+
+		bfree(zs->depth);
+		bfree(zs->stencil);
+		bfree(zs);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* sampler states                                                            */
+
+gs_samplerstate_t *device_samplerstate_create(gs_device_t *device,
+		const struct gs_sampler_info *info)
+{
+	struct gs_sampler_state *sampler;
+
+	sampler = bzalloc(sizeof(struct gs_sampler_state));
+	sampler->device = device;
+	sampler->ref    = 1;
+	sampler->info   = *info;
+
+	return sampler;
+}
+
+void gs_samplerstate_destroy(gs_samplerstate_t *samplerstate)
+{
+	if (!samplerstate)
+		return;
+
+	if (samplerstate->device)
+		for (int i = 0; i < GS_MAX_TEXTURES; i++)
+			if (samplerstate->device->cur_samplers[i] ==
+					samplerstate)
+				samplerstate->device->cur_samplers[i] = NULL;
+
+	samplerstate_release(samplerstate);
+}
+
+/* ------------------------------------------------------------------------- */
+/* vertex/index buffers                                                      */
+
+gs_vertbuffer_t *device_vertexbuffer_create(gs_device_t *device,
+		struct gs_vb_data *data, uint32_t flags)
+{
+	struct gs_vertex_buffer *vb = bzalloc(sizeof(struct gs_vertex_buffer));
+	vb->device  = device;
+	vb->data    = data;
+	vb->num     = data->num;
+	vb->dynamic = (flags & GS_DYNAMIC) != 0;
+
+	return vb;
+}
+
+void gs_vertexbuffer_destroy(gs_vertbuffer_t *vb)
+{
+	if (vb) {
+		if (vb->device->cur_vertex_buffer == vb)
+			vb->device->cur_vertex_buffer = NULL;
+
+		gs_vbdata_destroy(vb->data);
+		bfree(vb);
+	}
+}
+
+static inline void copy_vb_array(void *dst, const void *src, size_t size)
+{
+	if (dst && src && dst != src)
+		memcpy(dst, src, size);
+}
+
+static inline void gs_vertexbuffer_flush_internal(gs_vertbuffer_t *vb,
+		const struct gs_vb_data *data)
+{
+	size_t num = data->num < vb->num ? data->num : vb->num;
+	size_t num_tex = data->num_tex < vb->data->num_tex
+		? data->num_tex
+		: vb->data->num_tex;
+
+	if (!vb->dynamic) {
+		blog(LOG_ERROR, "vertex buffer is not dynamic");
+		blog(LOG_ERROR, "gs_vertexbuffer_flush (software) failed");
+		return;
+	}
+
+	/* draws read directly from the vertex data, so a flush only has
+	 * something to do when the data was passed in from elsewhere */
+	copy_vb_array(vb->data->points, data->points,
+			num * sizeof(struct vec3));
+	copy_vb_array(vb->data->normals, data->normals,
+			num * sizeof(struct vec3));
+	copy_vb_array(vb->data->tangents, data->tangents,
+			num * sizeof(struct vec3));
+	copy_vb_array(vb->data->colors, data->colors,
+			num * sizeof(uint32_t));
+
+	for (size_t i = 0; i < num_tex; i++) {
+		struct gs_tvertarray *tv = data->tvarray+i;
+		copy_vb_array(vb->data->tvarray[i].array, tv->array,
+				num * tv->width * sizeof(float));
+	}
+}
+
+void gs_vertexbuffer_flush(gs_vertbuffer_t *vb)
+{
+	gs_vertexbuffer_flush_internal(vb, vb->data);
+}
+
+void gs_vertexbuffer_flush_direct(gs_vertbuffer_t *vb,
+		const struct gs_vb_data *data)
+{
+	gs_vertexbuffer_flush_internal(vb, data);
+}
+
+struct gs_vb_data *gs_vertexbuffer_get_data(const gs_vertbuffer_t *vb)
+{
+	return vb->data;
+}
+
+void device_load_vertexbuffer(gs_device_t *device, gs_vertbuffer_t *vb)
+{
+	device->cur_vertex_buffer = vb;
+}
+
+gs_indexbuffer_t *device_indexbuffer_create(gs_device_t *device,
+		enum gs_index_type type, void *indices, size_t num,
+		uint32_t flags)
+{
+	struct gs_index_buffer *ib = bzalloc(sizeof(struct gs_index_buffer));
+	size_t width = type == GS_UNSIGNED_LONG
+		? sizeof(unsigned long)
+		: sizeof(unsigned short);
+
+	ib->device  = device;
+	ib->data    = indices;
+	ib->dynamic = (flags & GS_DYNAMIC) != 0;
+	ib->num     = num;
+	ib->width   = width;
+	ib->size    = width * num;
+	ib->type    = type;
+
+	return ib;
+}
+
+void gs_indexbuffer_destroy(gs_indexbuffer_t *ib)
+{
+	if (ib) {
+		if (ib->device->cur_index_buffer == ib)
+			ib->device->cur_index_buffer = NULL;
+
+		bfree(ib->data);
+		bfree(ib);
+	}
+}
+
+void gs_indexbuffer_flush(gs_indexbuffer_t *ib)
+{
+	if (!ib->dynamic)
+		blog(LOG_ERROR, "gs_indexbuffer_flush (software) failed: "
+		                "Index buffer is not dynamic");
+}
+
+void gs_indexbuffer_flush_direct(gs_indexbuffer_t *ib, const void *data)
+{
+	if (!ib->dynamic) {
+		blog(LOG_ERROR, "gs_indexbuffer_flush (software) failed: "
+		                "Index buffer is not dynamic");
+		return;
+	}
+
+	if (data != ib->data)
+		memcpy(ib->data, data, ib->size);
+}
+
+void *gs_indexbuffer_get_data(const gs_indexbuffer_t *ib)
+{
+	return ib->data;
+}
+
+size_t gs_indexbuffer_get_num_indices(const gs_indexbuffer_t *ib)
+{
+	return ib->num;
+}
+
+enum gs_index_type gs_indexbuffer_get_type(const gs_indexbuffer_t *ib)
+{
+	return ib->type;
+}
+
+void device_load_indexbuffer(gs_device_t *device, gs_indexbuffer_t *ib)
+{
+	device->cur_index_buffer = ib;
+}
+
+/* ------------------------------------------------------------------------- */
+/* pipeline state                                                            */
+
+void device_load_texture(gs_device_t *device, gs_texture_t *tex, int unit)
+{
+	device->cur_textures[unit] = tex;
+}
+
+void device_load_samplerstate(gs_device_t *device,
+		gs_samplerstate_t *samplerstate, int unit)
+{
+	device->cur_samplers[unit] = samplerstate;
+}
+
+void device_load_vertexshader(gs_device_t *device, gs_shader_t *vertshader)
+{
+	if (vertshader && vertshader->type != GS_SHADER_VERTEX) {
+		blog(LOG_ERROR, "Specified shader is not a vertex shader");
+		blog(LOG_ERROR, "device_load_vertexshader (software) failed");
+		return;
+	}
+
+	device->cur_vertex_shader = vertshader;
+}
+
+void device_load_pixelshader(gs_device_t *device, gs_shader_t *pixelshader)
+{
+	if (pixelshader && pixelshader->type != GS_SHADER_PIXEL) {
+		blog(LOG_ERROR, "Specified shader is not a pixel shader");
+		blog(LOG_ERROR, "device_load_pixelshader (software) failed");
+		return;
+	}
+
+	device->cur_pixel_shader = pixelshader;
+
+	for (size_t i = 0; i < GS_MAX_TEXTURES; i++) {
+		device->cur_textures[i] = NULL;
+		device->cur_samplers[i] = NULL;
+	}
+
+	if (!pixelshader)
+		return;
+
+	for (size_t i = 0; i < pixelshader->samplers.num; i++) {
+		if (i >= GS_MAX_TEXTURES)
+			break;
+		device->cur_samplers[i] = pixelshader->samplers.array[i];
+	}
+}
+
+void device_load_default_samplerstate(gs_device_t *device, bool b_3d, int unit)
+{
+	/* TODO */
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(b_3d);
+	UNUSED_PARAMETER(unit);
+}
+
+gs_shader_t *device_get_vertex_shader(const gs_device_t *device)
+{
+	return device->cur_vertex_shader;
+}
+
+gs_shader_t *device_get_pixel_shader(const gs_device_t *device)
+{
+	return device->cur_pixel_shader;
+}
+
+gs_texture_t *device_get_render_target(const gs_device_t *device)
+{
+	return device->cur_render_target;
+}
+
+gs_zstencil_t *device_get_zstencil_target(const gs_device_t *device)
+{
+	return device->cur_zstencil_buffer;
+}
+
+void device_set_render_target(gs_device_t *device, gs_texture_t *tex,
+		gs_zstencil_t *zstencil)
+{
+	if (tex) {
+		if (tex->type != GS_TEXTURE_2D) {
+			blog(LOG_ERROR, "Texture is not a 2D texture");
+			goto fail;
+		}
+
+		if (!tex->is_render_target) {
+			blog(LOG_ERROR, "Texture is not a render target");
+			goto fail;
+		}
+	}
+
+	device->cur_render_target   = tex;
+	device->cur_render_side     = 0;
+	device->cur_zstencil_buffer = zstencil;
+	return;
+
+fail:
+	blog(LOG_ERROR, "device_set_render_target (software) failed");
+}
+
+void device_set_cube_render_target(gs_device_t *device, gs_texture_t *cubetex,
+		int side, gs_zstencil_t *zstencil)
+{
+	if (cubetex) {
+		if (cubetex->type != GS_TEXTURE_CUBE) {
+			blog(LOG_ERROR, "Texture is not a cube texture");
+			goto fail;
+		}
+
+		if (!cubetex->is_render_target) {
+			blog(LOG_ERROR, "Texture is not a render target");
+			goto fail;
+		}
+	}
+
+	device->cur_render_target   = cubetex;
+	device->cur_render_side     = side;
+	device->cur_zstencil_buffer = zstencil;
+	return;
+
+fail:
+	blog(LOG_ERROR, "device_set_cube_render_target (software) failed");
+}
+
+void device_begin_scene(gs_device_t *device)
+{
+	for (size_t i = 0; i < GS_MAX_TEXTURES; i++)
+		device->cur_textures[i] = NULL;
+}
+
+void device_end_scene(gs_device_t *device)
+{
+	/* does nothing */
+	UNUSED_PARAMETER(device);
+}
+
+void device_flush(gs_device_t *device)
+{
+	/* all rendering is complete by the time a draw call returns */
+	UNUSED_PARAMETER(device);
+}
+
+static void clear_surface(const struct sw_surface *surf,
+		enum gs_color_format format, const struct vec4 *color)
+{
+	uint32_t bytes_per_pixel = gs_get_format_bpp(format) / 8;
+	uint8_t  texel[16];
+	uint8_t  *row;
+
+	sw_store_texel(format, texel, color);
+
+	row = surf->data;
+	for (uint32_t x = 0; x < surf->width; x++)
+		memcpy(row + x * bytes_per_pixel, texel, bytes_per_pixel);
+
+	for (uint32_t y = 1; y < surf->height; y++)
+		memcpy(surf->data + y * surf->linesize, row,
+				surf->width * bytes_per_pixel);
+}
+
+static inline enum gs_color_format get_target_format(gs_device_t *device)
+{
+	if (device->cur_render_target)
+		return device->cur_render_target->format;
+	if (device->cur_swap && device->cur_swap->target)
+		return device->cur_swap->target->format;
+
+	return GS_UNKNOWN;
+}
+
+void device_clear(gs_device_t *device, uint32_t clear_flags,
+		const struct vec4 *color, float depth, uint8_t stencil)
+{
+	struct gs_zstencil_buffer *zs = device->cur_zstencil_buffer;
+	struct sw_surface *surf = sw_get_target_surface(device);
+
+	if ((clear_flags & GS_CLEAR_COLOR) != 0 && surf)
+		clear_surface(surf, get_target_format(device), color);
+
+	if ((clear_flags & GS_CLEAR_DEPTH) != 0 && zs) {
+		for (size_t i = 0; i < (size_t)zs->width * zs->height; i++)
+			zs->depth[i] = depth;
+	}
+
+	if ((clear_flags & GS_CLEAR_STENCIL) != 0 && zs && zs->stencil)
+		memset(zs->stencil, stencil, (size_t)zs->width * zs->height);
+}
+
+void device_set_cull_mode(gs_device_t *device, enum gs_cull_mode mode)
+{
+	device->cur_cull_mode = mode;
+}
+
+enum gs_cull_mode device_get_cull_mode(const gs_device_t *device)
+{
+	return device->cur_cull_mode;
+}
+
+void device_enable_blending(gs_device_t *device, bool enable)
+{
+	device->blend.enabled = enable;
+}
+
+void device_enable_depth_test(gs_device_t *device, bool enable)
+{
+	device->depth_test = enable;
+}
+
+void device_enable_stencil_test(gs_device_t *device, bool enable)
+{
+	/* stencil operations are not emulated */
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stencil_write(gs_device_t *device, bool enable)
+{
+	/* stencil operations are not emulated */
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_color(gs_device_t *device, bool red, bool green,
+		bool blue, bool alpha)
+{
+	device->color_mask[0] = red;
+	device->color_mask[1] = green;
+	device->color_mask[2] = blue;
+	device->color_mask[3] = alpha;
+}
+
+void device_blend_function(gs_device_t *device, enum gs_blend_type src,
+		enum gs_blend_type dest)
+{
+	device->blend.src_c  = src;
+	device->blend.src_a  = src;
+	device->blend.dest_c = dest;
+	device->blend.dest_a = dest;
+}
+
+void device_blend_function_separate(gs_device_t *device,
+		enum gs_blend_type src_c, enum gs_blend_type dest_c,
+		enum gs_blend_type src_a, enum gs_blend_type dest_a)
+{
+	device->blend.src_c  = src_c;
+	device->blend.src_a  = src_a;
+	device->blend.dest_c = dest_c;
+	device->blend.dest_a = dest_a;
+}
+
+void device_depth_function(gs_device_t *device, enum gs_depth_test test)
+{
+	device->depth_function = test;
+}
+
+void device_stencil_function(gs_device_t *device, enum gs_stencil_side side,
+		enum gs_depth_test test)
+{
+	/* stencil operations are not emulated */
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencil_op(gs_device_t *device, enum gs_stencil_side side,
+		enum gs_stencil_op_type fail, enum gs_stencil_op_type zfail,
+		enum gs_stencil_op_type zpass)
+{
+	/* stencil operations are not emulated */
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(fail);
+	UNUSED_PARAMETER(zfail);
+	UNUSED_PARAMETER(zpass);
+}
+
+void device_set_viewport(gs_device_t *device, int x, int y, int width,
+		int height)
+{
+	device->cur_viewport.x  = x;
+	device->cur_viewport.y  = y;
+	device->cur_viewport.cx = width;
+	device->cur_viewport.cy = height;
+}
+
+void device_get_viewport(const gs_device_t *device, struct gs_rect *rect)
+{
+	*rect = device->cur_viewport;
+}
+
+void device_set_scissor_rect(gs_device_t *device, const struct gs_rect *rect)
+{
+	if (rect) {
+		device->cur_scissor     = *rect;
+		device->scissor_enabled = true;
+	} else {
+		device->scissor_enabled = false;
+	}
+}
+
+void device_ortho(gs_device_t *device, float left, float right,
+		float top, float bottom, float zn, float zf)
+{
+	struct matrix4 *dst = &device->cur_proj;
+
+	float rml = right-left;
+	float bmt = bottom-top;
+	float fmn = zf-zn;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x =         2.0f /  rml;
+	dst->t.x = (left+right) / -rml;
+
+	dst->y.y =         2.0f / -bmt;
+	dst->t.y = (bottom+top) /  bmt;
+
+	dst->z.z =         1.0f /  fmn;
+	dst->t.z =           zn / -fmn;
+
+	dst->t.w = 1.0f;
+}
+
+void device_frustum(gs_device_t *device, float left, float right,
+		float top, float bottom, float zn, float zf)
+{
+	struct matrix4 *dst = &device->cur_proj;
+
+	float rml    = right-left;
+	float bmt    = bottom-top;
+	float fmn    = zf-zn;
+	float nearx2 = 2.0f*zn;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x =       nearx2 /  rml;
+	dst->z.x = (left+right) / -rml;
+
+	dst->y.y =       nearx2 / -bmt;
+	dst->z.y = (bottom+top) /  bmt;
+
+	dst->z.z =           zf /  fmn;
+	dst->t.z =    (zn * zf) / -fmn;
+
+	dst->z.w = 1.0f;
+}
+
+void device_projection_push(gs_device_t *device)
+{
+	da_push_back(device->proj_stack, &device->cur_proj);
+}
+
+void device_projection_pop(gs_device_t *device)
+{
+	struct matrix4 *end;
+	if (!device->proj_stack.num)
+		return;
+
+	end = da_end(device->proj_stack);
+	device->cur_proj = *end;
+	da_pop_back(device->proj_stack);
+}
+
+#ifdef _WIN32
+EXPORT bool device_gdi_texture_available(void)
+{
+	return false;
+}
+
+EXPORT bool device_shared_texture_available(void)
+{
+	return false;
+}
+#endif
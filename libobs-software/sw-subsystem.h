@@ -0,0 +1,219 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+/*
+ *   CPU-only implementation of the graphics device exports.  Resources are
+ * plain system memory buffers, and draws are rasterized on the calling
+ * thread.  Shaders are parsed for their parameters and samplers only; pixel
+ * output is evaluated with a fixed function model that covers the libobs
+ * core effects (textured draws, solid colors and color matrix conversion).
+ */
+
+#include <util/darray.h>
+#include <util/threading.h>
+#include <graphics/graphics.h>
+#include <graphics/device-exports.h>
+#include <graphics/matrix4.h>
+#include <graphics/vec4.h>
+
+extern bool sw_format_supported(enum gs_color_format format);
+
+/* loads/stores a single texel as normalized RGBA */
+extern void sw_load_texel(enum gs_color_format format, const uint8_t *src,
+		struct vec4 *out);
+extern void sw_store_texel(enum gs_color_format format, uint8_t *dst,
+		const struct vec4 *color);
+
+struct gs_sampler_state {
+	gs_device_t          *device;
+	volatile long        ref;
+
+	struct gs_sampler_info info;
+};
+
+static inline void samplerstate_addref(gs_samplerstate_t *ss)
+{
+	os_atomic_inc_long(&ss->ref);
+}
+
+static inline void samplerstate_release(gs_samplerstate_t *ss)
+{
+	if (os_atomic_dec_long(&ss->ref) == 0)
+		bfree(ss);
+}
+
+struct gs_shader_param {
+	enum gs_shader_param_type type;
+
+	char                 *name;
+	gs_shader_t          *shader;
+	gs_samplerstate_t    *next_sampler;
+	int                  texture_id;
+	int                  array_count;
+
+	struct gs_texture    *texture;
+
+	DARRAY(uint8_t)      cur_value;
+	DARRAY(uint8_t)      def_value;
+};
+
+struct gs_shader {
+	gs_device_t          *device;
+	enum gs_shader_type  type;
+
+	struct gs_shader_param  *viewproj;
+	struct gs_shader_param  *world;
+
+	/* pixel stage inputs recognized by the fixed function model */
+	struct gs_shader_param  *color;
+	struct gs_shader_param  *color_matrix;
+	struct gs_shader_param  *color_range_min;
+	struct gs_shader_param  *color_range_max;
+	struct gs_shader_param  *first_texture;
+
+	/* uses inputs that the fixed function model can't emulate */
+	bool                    unsupported;
+
+	DARRAY(struct gs_shader_param) params;
+	DARRAY(gs_samplerstate_t*)      samplers;
+};
+
+struct gs_vertex_buffer {
+	gs_device_t          *device;
+	size_t               num;
+	bool                 dynamic;
+	struct gs_vb_data    *data;
+};
+
+struct gs_index_buffer {
+	gs_device_t          *device;
+	enum gs_index_type   type;
+	void                 *data;
+	size_t               num;
+	size_t               width;
+	size_t               size;
+	bool                 dynamic;
+};
+
+struct sw_surface {
+	uint8_t              *data;
+	uint32_t             width;
+	uint32_t             height;
+	uint32_t             linesize;
+};
+
+struct gs_texture {
+	gs_device_t          *device;
+	enum gs_texture_type type;
+	enum gs_color_format format;
+	uint32_t             bytes_per_pixel;
+	uint32_t             levels;
+	bool                 is_dynamic;
+	bool                 is_render_target;
+};
+
+struct gs_texture_2d {
+	struct gs_texture    base;
+
+	uint32_t             width;
+	uint32_t             height;
+	struct sw_surface    surface;
+};
+
+struct gs_texture_cube {
+	struct gs_texture    base;
+
+	uint32_t             size;
+	struct sw_surface    faces[6];
+};
+
+struct gs_stage_surface {
+	gs_device_t          *device;
+
+	enum gs_color_format format;
+	uint32_t             width;
+	uint32_t             height;
+	uint32_t             bytes_per_pixel;
+	struct sw_surface    surface;
+};
+
+struct gs_zstencil_buffer {
+	gs_device_t          *device;
+	enum gs_zstencil_format format;
+	uint32_t             width;
+	uint32_t             height;
+	float                *depth;
+	uint8_t              *stencil;
+};
+
+struct gs_swap_chain {
+	gs_device_t          *device;
+	struct gs_init_data  info;
+	gs_texture_t         *target;
+};
+
+struct sw_blend_state {
+	bool                 enabled;
+	enum gs_blend_type   src_c;
+	enum gs_blend_type   dest_c;
+	enum gs_blend_type   src_a;
+	enum gs_blend_type   dest_a;
+};
+
+struct gs_device {
+	pthread_mutex_t      context_mutex;
+
+	gs_texture_t         *cur_render_target;
+	gs_zstencil_t        *cur_zstencil_buffer;
+	int                  cur_render_side;
+	gs_texture_t         *cur_textures[GS_MAX_TEXTURES];
+	gs_samplerstate_t    *cur_samplers[GS_MAX_TEXTURES];
+	gs_vertbuffer_t      *cur_vertex_buffer;
+	gs_indexbuffer_t     *cur_index_buffer;
+	gs_shader_t          *cur_vertex_shader;
+	gs_shader_t          *cur_pixel_shader;
+	gs_swapchain_t       *cur_swap;
+
+	gs_samplerstate_t    *default_sampler;
+
+	enum gs_cull_mode    cur_cull_mode;
+	struct gs_rect       cur_viewport;
+	struct gs_rect       cur_scissor;
+	bool                 scissor_enabled;
+
+	struct sw_blend_state blend;
+	bool                 depth_test;
+	enum gs_depth_test   depth_function;
+	bool                 color_mask[4];
+
+	struct matrix4       cur_proj;
+	struct matrix4       cur_view;
+	struct matrix4       cur_viewproj;
+
+	DARRAY(struct matrix4) proj_stack;
+};
+
+extern bool sw_surface_init(struct sw_surface *surf, uint32_t width,
+		uint32_t height, enum gs_color_format format);
+extern void sw_surface_free(struct sw_surface *surf);
+extern struct sw_surface *sw_get_target_surface(gs_device_t *device);
+
+extern void sw_sample_texture(const gs_texture_t *tex,
+		const struct gs_sampler_info *info, float u, float v,
+		struct vec4 *out);
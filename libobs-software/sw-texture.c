@@ -0,0 +1,812 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include "sw-subsystem.h"
+
+/* ------------------------------------------------------------------------- */
+/* texel conversion                                                          */
+
+static inline float unorm8(uint8_t val)
+{
+	return (float)val * (1.0f / 255.0f);
+}
+
+static inline float unorm16(uint16_t val)
+{
+	return (float)val * (1.0f / 65535.0f);
+}
+
+static inline uint8_t to_unorm8(float val)
+{
+	if (val <= 0.0f) return 0;
+	if (val >= 1.0f) return 255;
+	return (uint8_t)(val * 255.0f + 0.5f);
+}
+
+static inline uint16_t to_unorm16(float val)
+{
+	if (val <= 0.0f) return 0;
+	if (val >= 1.0f) return 65535;
+	return (uint16_t)(val * 65535.0f + 0.5f);
+}
+
+static float half_to_float(uint16_t h)
+{
+	uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	uint32_t exp  = (h >> 10) & 0x1F;
+	uint32_t mant = h & 0x3FF;
+	union {uint32_t u; float f;} out;
+
+	if (exp == 0) {
+		float val = (float)mant * (1.0f / 16777216.0f);
+		return sign ? -val : val;
+	} else if (exp == 31) {
+		out.u = sign | 0x7F800000 | (mant << 13);
+	} else {
+		out.u = sign | ((exp + 112) << 23) | (mant << 13);
+	}
+
+	return out.f;
+}
+
+static uint16_t float_to_half(float f)
+{
+	union {uint32_t u; float f;} in;
+	uint32_t sign, mant;
+	int32_t exp;
+
+	in.f = f;
+	sign = (in.u >> 16) & 0x8000;
+	exp  = (int32_t)((in.u >> 23) & 0xFF) - 112;
+	mant = in.u & 0x7FFFFF;
+
+	if (exp <= 0)
+		return (uint16_t)sign;
+	if (exp >= 31)
+		return (uint16_t)(sign | 0x7C00);
+
+	return (uint16_t)(sign | ((uint32_t)exp << 10) | (mant >> 13));
+}
+
+bool sw_format_supported(enum gs_color_format format)
+{
+	return format != GS_UNKNOWN && !gs_is_compressed_format(format);
+}
+
+void sw_load_texel(enum gs_color_format format, const uint8_t *src,
+		struct vec4 *out)
+{
+	const uint16_t *src16 = (const uint16_t*)src;
+	const float    *src32 = (const float*)src;
+	uint32_t       packed;
+
+	switch (format) {
+	case GS_A8:
+		vec4_set(out, 1.0f, 1.0f, 1.0f, unorm8(src[0]));
+		break;
+	case GS_R8:
+		vec4_set(out, unorm8(src[0]), 0.0f, 0.0f, 1.0f);
+		break;
+	case GS_RGBA:
+		vec4_set(out, unorm8(src[0]), unorm8(src[1]),
+				unorm8(src[2]), unorm8(src[3]));
+		break;
+	case GS_BGRX:
+		vec4_set(out, unorm8(src[2]), unorm8(src[1]),
+				unorm8(src[0]), 1.0f);
+		break;
+	case GS_BGRA:
+		vec4_set(out, unorm8(src[2]), unorm8(src[1]),
+				unorm8(src[0]), unorm8(src[3]));
+		break;
+	case GS_R10G10B10A2:
+		packed = *(const uint32_t*)src;
+		vec4_set(out,
+				(float)( packed        & 0x3FF) / 1023.0f,
+				(float)((packed >> 10) & 0x3FF) / 1023.0f,
+				(float)((packed >> 20) & 0x3FF) / 1023.0f,
+				(float)((packed >> 30) & 0x3)   / 3.0f);
+		break;
+	case GS_RGBA16:
+		vec4_set(out, unorm16(src16[0]), unorm16(src16[1]),
+				unorm16(src16[2]), unorm16(src16[3]));
+		break;
+	case GS_R16:
+		vec4_set(out, unorm16(src16[0]), 0.0f, 0.0f, 1.0f);
+		break;
+	case GS_RGBA16F:
+		vec4_set(out, half_to_float(src16[0]),
+				half_to_float(src16[1]),
+				half_to_float(src16[2]),
+				half_to_float(src16[3]));
+		break;
+	case GS_RGBA32F:
+		vec4_set(out, src32[0], src32[1], src32[2], src32[3]);
+		break;
+	case GS_RG16F:
+		vec4_set(out, half_to_float(src16[0]),
+				half_to_float(src16[1]), 0.0f, 1.0f);
+		break;
+	case GS_RG32F:
+		vec4_set(out, src32[0], src32[1], 0.0f, 1.0f);
+		break;
+	case GS_R16F:
+		vec4_set(out, half_to_float(src16[0]), 0.0f, 0.0f, 1.0f);
+		break;
+	case GS_R32F:
+		vec4_set(out, src32[0], 0.0f, 0.0f, 1.0f);
+		break;
+	case GS_DXT1:
+	case GS_DXT3:
+	case GS_DXT5:
+	case GS_UNKNOWN:
+		vec4_zero(out);
+	}
+}
+
+void sw_store_texel(enum gs_color_format format, uint8_t *dst,
+		const struct vec4 *color)
+{
+	uint16_t *dst16 = (uint16_t*)dst;
+	float    *dst32 = (float*)dst;
+
+	switch (format) {
+	case GS_A8:
+		dst[0] = to_unorm8(color->w);
+		break;
+	case GS_R8:
+		dst[0] = to_unorm8(color->x);
+		break;
+	case GS_RGBA:
+		dst[0] = to_unorm8(color->x);
+		dst[1] = to_unorm8(color->y);
+		dst[2] = to_unorm8(color->z);
+		dst[3] = to_unorm8(color->w);
+		break;
+	case GS_BGRX:
+		dst[0] = to_unorm8(color->z);
+		dst[1] = to_unorm8(color->y);
+		dst[2] = to_unorm8(color->x);
+		dst[3] = 255;
+		break;
+	case GS_BGRA:
+		dst[0] = to_unorm8(color->z);
+		dst[1] = to_unorm8(color->y);
+		dst[2] = to_unorm8(color->x);
+		dst[3] = to_unorm8(color->w);
+		break;
+	case GS_R10G10B10A2:
+		*(uint32_t*)dst =
+			 (uint32_t)(to_unorm16(color->x) >> 6) |
+			((uint32_t)(to_unorm16(color->y) >> 6) << 10) |
+			((uint32_t)(to_unorm16(color->z) >> 6) << 20) |
+			((uint32_t)(to_unorm16(color->w) >> 14) << 30);
+		break;
+	case GS_RGBA16:
+		dst16[0] = to_unorm16(color->x);
+		dst16[1] = to_unorm16(color->y);
+		dst16[2] = to_unorm16(color->z);
+		dst16[3] = to_unorm16(color->w);
+		break;
+	case GS_R16:
+		dst16[0] = to_unorm16(color->x);
+		break;
+	case GS_RGBA16F:
+		dst16[0] = float_to_half(color->x);
+		dst16[1] = float_to_half(color->y);
+		dst16[2] = float_to_half(color->z);
+		dst16[3] = float_to_half(color->w);
+		break;
+	case GS_RGBA32F:
+		memcpy(dst32, color->ptr, sizeof(float) * 4);
+		break;
+	case GS_RG16F:
+		dst16[0] = float_to_half(color->x);
+		dst16[1] = float_to_half(color->y);
+		break;
+	case GS_RG32F:
+		dst32[0] = color->x;
+		dst32[1] = color->y;
+		break;
+	case GS_R16F:
+		dst16[0] = float_to_half(color->x);
+		break;
+	case GS_R32F:
+		dst32[0] = color->x;
+		break;
+	case GS_DXT1:
+	case GS_DXT3:
+	case GS_DXT5:
+	case GS_UNKNOWN:
+		break;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* surfaces                                                                  */
+
+bool sw_surface_init(struct sw_surface *surf, uint32_t width,
+		uint32_t height, enum gs_color_format format)
+{
+	uint32_t bpp = gs_get_format_bpp(format);
+
+	if (!width || !height || !bpp)
+		return false;
+
+	surf->width    = width;
+	surf->height   = height;
+	surf->linesize = (width * bpp / 8 + 31) & ~31;
+	surf->data     = bzalloc((size_t)surf->linesize * height);
+	return true;
+}
+
+void sw_surface_free(struct sw_surface *surf)
+{
+	bfree(surf->data);
+	memset(surf, 0, sizeof(*surf));
+}
+
+static void sw_surface_upload(struct sw_surface *surf,
+		enum gs_color_format format, const uint8_t *data)
+{
+	uint32_t row_size = surf->width * gs_get_format_bpp(format) / 8;
+
+	for (uint32_t y = 0; y < surf->height; y++)
+		memcpy(surf->data + y * surf->linesize,
+				data + y * row_size, row_size);
+}
+
+static inline struct sw_surface *get_tex_surface(const gs_texture_t *tex,
+		int side)
+{
+	if (tex->type == GS_TEXTURE_2D)
+		return &((struct gs_texture_2d*)tex)->surface;
+	else if (tex->type == GS_TEXTURE_CUBE)
+		return &((struct gs_texture_cube*)tex)->faces[side];
+
+	return NULL;
+}
+
+struct sw_surface *sw_get_target_surface(gs_device_t *device)
+{
+	if (device->cur_render_target)
+		return get_tex_surface(device->cur_render_target,
+				device->cur_render_side);
+	if (device->cur_swap && device->cur_swap->target)
+		return get_tex_surface(device->cur_swap->target, 0);
+
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* sampling                                                                  */
+
+static inline int wrap_coord(int coord, int size, enum gs_address_mode mode)
+{
+	int period;
+
+	switch (mode) {
+	case GS_ADDRESS_WRAP:
+		coord %= size;
+		return coord < 0 ? coord + size : coord;
+
+	case GS_ADDRESS_MIRROR:
+		period = size * 2;
+		coord %= period;
+		if (coord < 0)
+			coord += period;
+		return coord < size ? coord : period - coord - 1;
+
+	case GS_ADDRESS_MIRRORONCE:
+		if (coord < 0)
+			coord = -coord - 1;
+		/* fall through */
+	case GS_ADDRESS_CLAMP:
+	case GS_ADDRESS_BORDER:
+		break;
+	}
+
+	if (coord < 0)
+		return 0;
+	return coord >= size ? size - 1 : coord;
+}
+
+static inline bool is_border_texel(int x, int y, int cx, int cy,
+		const struct gs_sampler_info *info)
+{
+	return (info->address_u == GS_ADDRESS_BORDER && (x < 0 || x >= cx)) ||
+	       (info->address_v == GS_ADDRESS_BORDER && (y < 0 || y >= cy));
+}
+
+static inline void fetch_texel(const struct sw_surface *surf,
+		enum gs_color_format format, uint32_t bytes_per_pixel,
+		const struct gs_sampler_info *info, int x, int y,
+		struct vec4 *out)
+{
+	const uint8_t *ptr;
+
+	if (is_border_texel(x, y, (int)surf->width, (int)surf->height, info)) {
+		vec4_from_rgba(out, info->border_color);
+		return;
+	}
+
+	x = wrap_coord(x, (int)surf->width,  info->address_u);
+	y = wrap_coord(y, (int)surf->height, info->address_v);
+
+	ptr = surf->data + (size_t)y * surf->linesize +
+		(size_t)x * bytes_per_pixel;
+	sw_load_texel(format, ptr, out);
+}
+
+static inline float sw_lerp(float a, float b, float t)
+{
+	return a + (b - a) * t;
+}
+
+static inline bool is_point_filter(enum gs_sample_filter filter)
+{
+	return filter == GS_FILTER_POINT ||
+	       filter == GS_FILTER_MIN_MAG_POINT_MIP_LINEAR ||
+	       filter == GS_FILTER_MIN_LINEAR_MAG_POINT_MIP_LINEAR;
+}
+
+void sw_sample_texture(const gs_texture_t *tex,
+		const struct gs_sampler_info *info, float u, float v,
+		struct vec4 *out)
+{
+	const struct sw_surface *surf = get_tex_surface(tex, 0);
+	uint32_t bpp = tex->bytes_per_pixel;
+	struct vec4 t00, t10, t01, t11;
+	float fx, fy, wx, wy;
+	int x0, y0;
+
+	if (!surf || !surf->data || !sw_format_supported(tex->format)) {
+		vec4_zero(out);
+		return;
+	}
+
+	fx = u * (float)surf->width;
+	fy = v * (float)surf->height;
+
+	if (is_point_filter(info->filter)) {
+		fetch_texel(surf, tex->format, bpp, info,
+				(int)floorf(fx), (int)floorf(fy), out);
+		return;
+	}
+
+	fx -= 0.5f;
+	fy -= 0.5f;
+	x0 = (int)floorf(fx);
+	y0 = (int)floorf(fy);
+	wx = fx - (float)x0;
+	wy = fy - (float)y0;
+
+	fetch_texel(surf, tex->format, bpp, info, x0,     y0,     &t00);
+	fetch_texel(surf, tex->format, bpp, info, x0 + 1, y0,     &t10);
+	fetch_texel(surf, tex->format, bpp, info, x0,     y0 + 1, &t01);
+	fetch_texel(surf, tex->format, bpp, info, x0 + 1, y0 + 1, &t11);
+
+	for (size_t i = 0; i < 4; i++) {
+		float top    = sw_lerp(t00.ptr[i], t10.ptr[i], wx);
+		float bottom = sw_lerp(t01.ptr[i], t11.ptr[i], wx);
+		out->ptr[i] = sw_lerp(top, bottom, wy);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* 2D textures                                                               */
+
+static inline void texture_base_init(struct gs_texture *base,
+		gs_device_t *device, enum gs_texture_type type,
+		enum gs_color_format format, uint32_t levels, uint32_t flags)
+{
+	base->device           = device;
+	base->type             = type;
+	base->format           = format;
+	base->bytes_per_pixel  = gs_get_format_bpp(format) / 8;
+	base->levels           = levels;
+	base->is_dynamic       = (flags & GS_DYNAMIC)       != 0;
+	base->is_render_target = (flags & GS_RENDER_TARGET) != 0;
+}
+
+gs_texture_t *device_texture_create(gs_device_t *device, uint32_t width,
+		uint32_t height, enum gs_color_format color_format,
+		uint32_t levels, const uint8_t **data, uint32_t flags)
+{
+	struct gs_texture_2d *tex = bzalloc(sizeof(struct gs_texture_2d));
+	texture_base_init(&tex->base, device, GS_TEXTURE_2D, color_format,
+			levels, flags);
+	tex->width  = width;
+	tex->height = height;
+
+	if (!sw_format_supported(color_format)) {
+		blog(LOG_ERROR, "device_texture_create (software): "
+		                "unsupported color format %d",
+		                (int)color_format);
+		goto fail;
+	}
+
+	if (!sw_surface_init(&tex->surface, width, height, color_format))
+		goto fail;
+
+	/* only the base level is kept, mipmapped sampling is not emulated */
+	if (data && *data)
+		sw_surface_upload(&tex->surface, color_format, *data);
+
+	return (gs_texture_t*)tex;
+
+fail:
+	gs_texture_destroy((gs_texture_t*)tex);
+	blog(LOG_ERROR, "device_texture_create (software) failed");
+	return NULL;
+}
+
+static inline bool is_texture_2d(const gs_texture_t *tex, const char *func)
+{
+	bool is_tex2d = tex->type == GS_TEXTURE_2D;
+	if (!is_tex2d)
+		blog(LOG_ERROR, "%s (software) failed:  Not a 2D texture",
+				func);
+	return is_tex2d;
+}
+
+static void unbind_texture(gs_texture_t *tex)
+{
+	gs_device_t *device = tex->device;
+
+	for (size_t i = 0; i < GS_MAX_TEXTURES; i++)
+		if (device->cur_textures[i] == tex)
+			device->cur_textures[i] = NULL;
+	if (device->cur_render_target == tex)
+		device->cur_render_target = NULL;
+}
+
+void gs_texture_destroy(gs_texture_t *tex)
+{
+	struct gs_texture_2d *tex2d = (struct gs_texture_2d*)tex;
+
+	if (!tex)
+		return;
+	if (!is_texture_2d(tex, "gs_texture_destroy"))
+		return;
+
+	unbind_texture(tex);
+	sw_surface_free(&tex2d->surface);
+	bfree(tex);
+}
+
+uint32_t gs_texture_get_width(const gs_texture_t *tex)
+{
+	const struct gs_texture_2d *tex2d = (const struct gs_texture_2d*)tex;
+	if (!is_texture_2d(tex, "gs_texture_get_width"))
+		return 0;
+
+	return tex2d->width;
+}
+
+uint32_t gs_texture_get_height(const gs_texture_t *tex)
+{
+	const struct gs_texture_2d *tex2d = (const struct gs_texture_2d*)tex;
+	if (!is_texture_2d(tex, "gs_texture_get_height"))
+		return 0;
+
+	return tex2d->height;
+}
+
+enum gs_color_format gs_texture_get_color_format(const gs_texture_t *tex)
+{
+	return tex->format;
+}
+
+bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr, uint32_t *linesize)
+{
+	struct gs_texture_2d *tex2d = (struct gs_texture_2d*)tex;
+
+	if (!is_texture_2d(tex, "gs_texture_map"))
+		goto fail;
+
+	if (!tex->is_dynamic) {
+		blog(LOG_ERROR, "Texture is not dynamic");
+		goto fail;
+	}
+
+	*ptr      = tex2d->surface.data;
+	*linesize = tex2d->surface.linesize;
+	return true;
+
+fail:
+	blog(LOG_ERROR, "gs_texture_map (software) failed");
+	return false;
+}
+
+void gs_texture_unmap(gs_texture_t *tex)
+{
+	/* system memory textures are always up to date */
+	UNUSED_PARAMETER(tex);
+}
+
+bool gs_texture_is_rect(const gs_texture_t *tex)
+{
+	UNUSED_PARAMETER(tex);
+	return false;
+}
+
+void *gs_texture_get_obj(gs_texture_t *tex)
+{
+	struct gs_texture_2d *tex2d = (struct gs_texture_2d*)tex;
+	if (!is_texture_2d(tex, "gs_texture_get_obj"))
+		return NULL;
+
+	return tex2d->surface.data;
+}
+
+/* ------------------------------------------------------------------------- */
+/* cube textures                                                             */
+
+gs_texture_t *device_cubetexture_create(gs_device_t *device, uint32_t size,
+		enum gs_color_format color_format, uint32_t levels,
+		const uint8_t **data, uint32_t flags)
+{
+	struct gs_texture_cube *tex = bzalloc(sizeof(struct gs_texture_cube));
+	texture_base_init(&tex->base, device, GS_TEXTURE_CUBE, color_format,
+			levels, flags);
+	tex->size = size;
+
+	if (!sw_format_supported(color_format))
+		goto fail;
+
+	for (size_t i = 0; i < 6; i++) {
+		if (!sw_surface_init(&tex->faces[i], size, size, color_format))
+			goto fail;
+
+		if (data && data[i * (levels ? levels : 1)])
+			sw_surface_upload(&tex->faces[i], color_format,
+					data[i * (levels ? levels : 1)]);
+	}
+
+	return (gs_texture_t*)tex;
+
+fail:
+	gs_cubetexture_destroy((gs_texture_t*)tex);
+	blog(LOG_ERROR, "device_cubetexture_create (software) failed");
+	return NULL;
+}
+
+void gs_cubetexture_destroy(gs_texture_t *tex)
+{
+	struct gs_texture_cube *cube = (struct gs_texture_cube*)tex;
+
+	if (!tex)
+		return;
+
+	unbind_texture(tex);
+	for (size_t i = 0; i < 6; i++)
+		sw_surface_free(&cube->faces[i]);
+	bfree(tex);
+}
+
+static inline bool is_texture_cube(const gs_texture_t *tex, const char *func)
+{
+	bool is_texcube = tex->type == GS_TEXTURE_CUBE;
+	if (!is_texcube)
+		blog(LOG_ERROR, "%s (software) failed:  Not a cubemap", func);
+	return is_texcube;
+}
+
+uint32_t gs_cubetexture_get_size(const gs_texture_t *cubetex)
+{
+	const struct gs_texture_cube *cube =
+		(const struct gs_texture_cube*)cubetex;
+	if (!is_texture_cube(cubetex, "gs_cubetexture_get_size"))
+		return 0;
+
+	return cube->size;
+}
+
+enum gs_color_format gs_cubetexture_get_color_format(
+		const gs_texture_t *cubetex)
+{
+	return cubetex->format;
+}
+
+/* ------------------------------------------------------------------------- */
+/* copies                                                                    */
+
+static void copy_surface_region(const struct sw_surface *dst,
+		uint32_t dst_x, uint32_t dst_y,
+		const struct sw_surface *src,
+		uint32_t src_x, uint32_t src_y,
+		uint32_t src_w, uint32_t src_h, uint32_t bytes_per_pixel)
+{
+	size_t row_size = (size_t)src_w * bytes_per_pixel;
+
+	for (uint32_t y = 0; y < src_h; y++) {
+		const uint8_t *in  = src->data +
+			(size_t)(src_y + y) * src->linesize +
+			(size_t)src_x * bytes_per_pixel;
+		uint8_t       *out = dst->data +
+			(size_t)(dst_y + y) * dst->linesize +
+			(size_t)dst_x * bytes_per_pixel;
+
+		memcpy(out, in, row_size);
+	}
+}
+
+void device_copy_texture_region(gs_device_t *device,
+		gs_texture_t *dst, uint32_t dst_x, uint32_t dst_y,
+		gs_texture_t *src, uint32_t src_x, uint32_t src_y,
+		uint32_t src_w, uint32_t src_h)
+{
+	struct gs_texture_2d *src2d = (struct gs_texture_2d*)src;
+	struct gs_texture_2d *dst2d = (struct gs_texture_2d*)dst;
+	uint32_t copy_w, copy_h;
+
+	if (!src) {
+		blog(LOG_ERROR, "Source texture is NULL");
+		goto fail;
+	}
+
+	if (!dst) {
+		blog(LOG_ERROR, "Destination texture is NULL");
+		goto fail;
+	}
+
+	if (dst->type != GS_TEXTURE_2D || src->type != GS_TEXTURE_2D) {
+		blog(LOG_ERROR, "Source and destination textures must be 2D "
+		                "textures");
+		goto fail;
+	}
+
+	if (dst->format != src->format) {
+		blog(LOG_ERROR, "Source and destination formats do not match");
+		goto fail;
+	}
+
+	copy_w = src_w ? src_w : (src2d->width  - src_x);
+	copy_h = src_h ? src_h : (src2d->height - src_y);
+
+	if (dst2d->width  - dst_x < copy_w ||
+	    dst2d->height - dst_y < copy_h) {
+		blog(LOG_ERROR, "Destination texture region is not big "
+		                "enough to hold the source region");
+		goto fail;
+	}
+
+	copy_surface_region(&dst2d->surface, dst_x, dst_y,
+			&src2d->surface, src_x, src_y, copy_w, copy_h,
+			src->bytes_per_pixel);
+
+	UNUSED_PARAMETER(device);
+	return;
+
+fail:
+	blog(LOG_ERROR, "device_copy_texture (software) failed");
+}
+
+void device_copy_texture(gs_device_t *device, gs_texture_t *dst,
+		gs_texture_t *src)
+{
+	device_copy_texture_region(device, dst, 0, 0, src, 0, 0, 0, 0);
+}
+
+/* ------------------------------------------------------------------------- */
+/* stage surfaces                                                            */
+
+gs_stagesurf_t *device_stagesurface_create(gs_device_t *device, uint32_t width,
+		uint32_t height, enum gs_color_format color_format)
+{
+	struct gs_stage_surface *surf;
+	surf = bzalloc(sizeof(struct gs_stage_surface));
+	surf->device          = device;
+	surf->format          = color_format;
+	surf->width           = width;
+	surf->height          = height;
+	surf->bytes_per_pixel = gs_get_format_bpp(color_format) / 8;
+
+	if (!sw_surface_init(&surf->surface, width, height, color_format)) {
+		blog(LOG_ERROR, "device_stagesurface_create (software) failed");
+		gs_stagesurface_destroy(surf);
+		return NULL;
+	}
+
+	return surf;
+}
+
+void gs_stagesurface_destroy(gs_stagesurf_t *stagesurf)
+{
+	if (stagesurf) {
+		sw_surface_free(&stagesurf->surface);
+		bfree(stagesurf);
+	}
+}
+
+static bool can_stage(struct gs_stage_surface *dst, struct gs_texture_2d *src)
+{
+	if (!src) {
+		blog(LOG_ERROR, "Source texture is NULL");
+		return false;
+	}
+
+	if (src->base.type != GS_TEXTURE_2D) {
+		blog(LOG_ERROR, "Source texture must be a 2D texture");
+		return false;
+	}
+
+	if (!dst) {
+		blog(LOG_ERROR, "Destination surface is NULL");
+		return false;
+	}
+
+	if (src->base.format != dst->format) {
+		blog(LOG_ERROR, "Source and destination formats do not match");
+		return false;
+	}
+
+	if (src->width != dst->width || src->height != dst->height) {
+		blog(LOG_ERROR, "Source and destination must have the same "
+		                "dimensions");
+		return false;
+	}
+
+	return true;
+}
+
+void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
+		gs_texture_t *src)
+{
+	struct gs_texture_2d *tex2d = (struct gs_texture_2d*)src;
+
+	if (!can_stage(dst, tex2d)) {
+		blog(LOG_ERROR, "device_stage_texture (software) failed");
+		return;
+	}
+
+	copy_surface_region(&dst->surface, 0, 0, &tex2d->surface, 0, 0,
+			dst->width, dst->height, dst->bytes_per_pixel);
+
+	UNUSED_PARAMETER(device);
+}
+
+uint32_t gs_stagesurface_get_width(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->width;
+}
+
+uint32_t gs_stagesurface_get_height(const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->height;
+}
+
+enum gs_color_format gs_stagesurface_get_color_format(
+		const gs_stagesurf_t *stagesurf)
+{
+	return stagesurf->format;
+}
+
+bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
+		uint32_t *linesize)
+{
+	*data     = stagesurf->surface.data;
+	*linesize = stagesurf->surface.linesize;
+	return true;
+}
+
+void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf)
+{
+	UNUSED_PARAMETER(stagesurf);
+}
@@ -33,21 +33,29 @@ extern profiler_name_store_t *obs_get_profiler_name_store(void);
 
 #define nop() do {int invalid = 0;} while(0)
 
+/* inputs of the same mix that need the same format share a resampler, so
+ * the mix is only converted once per tick for all of them */
+struct audio_conversion {
+	struct audio_convert_info info;
+	audio_resampler_t         *resampler;
+	long                      refs;
+
+	/* resampled data of the current tick */
+	struct audio_data         data;
+	bool                      success;
+};
+
 struct audio_input {
 	struct audio_convert_info conversion;
-	audio_resampler_t         *resampler;
+	struct audio_conversion   *shared;
 
 	audio_output_callback_t callback;
 	void *param;
 };
 
-static inline void audio_input_free(struct audio_input *input)
-{
-	audio_resampler_destroy(input->resampler);
-}
-
 struct audio_mix {
 	DARRAY(struct audio_input) inputs;
+	DARRAY(struct audio_conversion*) conversions;
 	float buffer[MAX_AUDIO_CHANNELS][AUDIO_OUTPUT_FRAMES];
 };
 
@@ -115,56 +123,63 @@ static inline size_t min_size(size_t a, size_t b)
 	((val > maxval) ? maxval : ((val < minval) ? minval : val))
 #endif
 
-static bool resample_audio_output(struct audio_input *input,
+static void resample_audio_output(struct audio_conversion *conv,
 		struct audio_data *data)
 {
-	bool success = true;
-
-	if (input->resampler) {
-		uint8_t  *output[MAX_AV_PLANES];
-		uint32_t frames;
-		uint64_t offset;
+	uint8_t  *output[MAX_AV_PLANES];
+	uint32_t frames;
+	uint64_t offset;
 
-		memset(output, 0, sizeof(output));
+	memset(output, 0, sizeof(output));
 
-		success = audio_resampler_resample(input->resampler,
-				output, &frames, &offset,
-				(const uint8_t *const *)data->data,
-				data->frames);
+	conv->success = audio_resampler_resample(conv->resampler,
+			output, &frames, &offset,
+			(const uint8_t *const *)data->data,
+			data->frames);
 
-		for (size_t i = 0; i < MAX_AV_PLANES; i++)
-			data->data[i] = output[i];
-		data->frames     = frames;
-		data->timestamp -= offset;
-	}
-
-	return success;
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
+		conv->data.data[i] = output[i];
+	conv->data.frames    = frames;
+	conv->data.timestamp = data->timestamp - offset;
 }
 
 static inline void do_audio_output(struct audio_output *audio,
 		size_t mix_idx, uint64_t timestamp, uint32_t frames)
 {
 	struct audio_mix *mix = &audio->mixes[mix_idx];
+	struct audio_data mix_data;
 	struct audio_data data;
 
+	memset(&mix_data, 0, sizeof(mix_data));
+	for (size_t i = 0; i < audio->planes; i++)
+		mix_data.data[i] = (uint8_t*)mix->buffer[i];
+	mix_data.frames = frames;
+	mix_data.timestamp = timestamp;
+
 	pthread_mutex_lock(&audio->input_mutex);
 
+	for (size_t i = 0; i < mix->conversions.num; i++)
+		resample_audio_output(mix->conversions.array[i], &mix_data);
+
 	for (size_t i = mix->inputs.num; i > 0; i--) {
 		struct audio_input *input = mix->inputs.array+(i-1);
 
-		for (size_t i = 0; i < audio->planes; i++)
-			data.data[i] = (uint8_t*)mix->buffer[i];
-		data.frames = frames;
-		data.timestamp = timestamp;
+		if (input->shared) {
+			if (!input->shared->success)
+				continue;
+			data = input->shared->data;
+		} else {
+			data = mix_data;
+		}
 
-		if (resample_audio_output(input, &data))
-			input->callback(input->param, mix_idx, &data);
+		input->callback(input->param, mix_idx, &data);
 	}
 
 	pthread_mutex_unlock(&audio->input_mutex);
 }
 
-static inline void clamp_audio_output(struct audio_output *audio, size_t bytes)
+static inline void clamp_audio_output(struct audio_output *audio, size_t bytes,
+		uint32_t active_mixes)
 {
 	size_t float_size = bytes / sizeof(float);
 
@@ -172,7 +187,7 @@ static inline void clamp_audio_output(struct audio_output *audio, size_t bytes)
 		struct audio_mix *mix = &audio->mixes[mix_idx];
 
 		/* do not process mixing if a specific mix is inactive */
-		if (!mix->inputs.num)
+		if ((active_mixes & (1 << mix_idx)) == 0)
 			continue;
 
 		for (size_t plane = 0; plane < audio->planes; plane++) {
@@ -192,7 +207,7 @@ static inline void clamp_audio_output(struct audio_output *audio, size_t bytes)
 static void input_and_output(struct audio_output *audio,
 		uint64_t audio_time, uint64_t prev_time)
 {
-	size_t bytes = AUDIO_OUTPUT_FRAMES * audio->block_size;
+	size_t bytes = audio->info.frames * audio->block_size;
 	struct audio_output_data data[MAX_AUDIO_MIXES];
 	uint32_t active_mixes = 0;
 	uint64_t new_ts = 0;
@@ -217,8 +232,9 @@ static void input_and_output(struct audio_output *audio,
 	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
 		struct audio_mix *mix = &audio->mixes[mix_idx];
 
-		memset(mix->buffer[0], 0, AUDIO_OUTPUT_FRAMES *
-				MAX_AUDIO_CHANNELS * sizeof(float));
+		if ((active_mixes & (1 << mix_idx)) != 0)
+			memset(mix->buffer[0], 0, AUDIO_OUTPUT_FRAMES *
+					MAX_AUDIO_CHANNELS * sizeof(float));
 
 		for (size_t i = 0; i < audio->planes; i++)
 			data[mix_idx].data[i] = mix->buffer[i];
@@ -231,11 +247,14 @@ static void input_and_output(struct audio_output *audio,
 		return;
 
 	/* clamps audio data to -1.0..1.0 */
-	clamp_audio_output(audio, bytes);
+	clamp_audio_output(audio, bytes, active_mixes);
 
-	/* output */
-	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
-		do_audio_output(audio, i, new_ts, AUDIO_OUTPUT_FRAMES);
+	/* output, inputs connected since the mixers were checked will get
+	 * data starting with the next tick */
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		if ((active_mixes & (1 << i)) != 0)
+			do_audio_output(audio, i, new_ts, audio->info.frames);
+	}
 }
 
 static void *audio_thread(void *param)
@@ -247,9 +266,13 @@ static void *audio_thread(void *param)
 	uint64_t prev_time = start_time;
 	uint64_t audio_time = prev_time;
 	uint32_t audio_wait_time =
-		(uint32_t)(audio_frames_to_ns(rate, AUDIO_OUTPUT_FRAMES) /
+		(uint32_t)(audio_frames_to_ns(rate, audio->info.frames) /
 				1000000);
 
+	/* small ticks are shorter than a millisecond at high sample rates */
+	if (!audio_wait_time)
+		audio_wait_time = 1;
+
 	os_set_thread_name("audio-io: audio thread");
 
 	const char *audio_thread_name =
@@ -265,7 +288,7 @@ static void *audio_thread(void *param)
 
 		cur_time = os_gettime_ns();
 		while (audio_time <= cur_time) {
-			samples += AUDIO_OUTPUT_FRAMES;
+			samples += audio->info.frames;
 			audio_time = start_time +
 				audio_frames_to_ns(rate, samples);
 
@@ -298,32 +321,84 @@ static size_t audio_get_input_idx(const audio_t *audio, size_t mix_idx,
 	return DARRAY_INVALID;
 }
 
+static inline bool same_conversion(const struct audio_convert_info *a,
+		const struct audio_convert_info *b)
+{
+	return a->format          == b->format          &&
+	       a->samples_per_sec == b->samples_per_sec &&
+	       a->speakers        == b->speakers;
+}
+
+static struct audio_conversion *get_conversion(struct audio_output *audio,
+		struct audio_mix *mix, const struct audio_convert_info *info)
+{
+	struct audio_conversion *conv;
+
+	for (size_t i = 0; i < mix->conversions.num; i++) {
+		conv = mix->conversions.array[i];
+
+		if (same_conversion(&conv->info, info)) {
+			conv->refs++;
+			return conv;
+		}
+	}
+
+	struct resample_info from = {
+		.format          = audio->info.format,
+		.samples_per_sec = audio->info.samples_per_sec,
+		.speakers        = audio->info.speakers
+	};
+
+	struct resample_info to = {
+		.format          = info->format,
+		.samples_per_sec = info->samples_per_sec,
+		.speakers        = info->speakers
+	};
+
+	conv = bzalloc(sizeof(struct audio_conversion));
+	conv->info = *info;
+	conv->refs = 1;
+	conv->resampler = audio_resampler_create(&to, &from);
+	if (!conv->resampler) {
+		blog(LOG_ERROR, "audio_input_init: Failed to "
+		                "create resampler");
+		bfree(conv);
+		return NULL;
+	}
+
+	da_push_back(mix->conversions, &conv);
+	return conv;
+}
+
+static void release_conversion(struct audio_mix *mix,
+		struct audio_conversion *conv)
+{
+	if (--conv->refs)
+		return;
+
+	da_erase_item(mix->conversions, &conv);
+	audio_resampler_destroy(conv->resampler);
+	bfree(conv);
+}
+
+static inline void audio_input_free(struct audio_mix *mix,
+		struct audio_input *input)
+{
+	if (input->shared)
+		release_conversion(mix, input->shared);
+}
+
 static inline bool audio_input_init(struct audio_input *input,
-		struct audio_output *audio)
+		struct audio_output *audio, struct audio_mix *mix)
 {
 	if (input->conversion.format          != audio->info.format          ||
 	    input->conversion.samples_per_sec != audio->info.samples_per_sec ||
 	    input->conversion.speakers        != audio->info.speakers) {
-		struct resample_info from = {
-			.format          = audio->info.format,
-			.samples_per_sec = audio->info.samples_per_sec,
-			.speakers        = audio->info.speakers
-		};
-
-		struct resample_info to = {
-			.format          = input->conversion.format,
-			.samples_per_sec = input->conversion.samples_per_sec,
-			.speakers        = input->conversion.speakers
-		};
-
-		input->resampler = audio_resampler_create(&to, &from);
-		if (!input->resampler) {
-			blog(LOG_ERROR, "audio_input_init: Failed to "
-			                "create resampler");
+		input->shared = get_conversion(audio, mix, &input->conversion);
+		if (!input->shared)
 			return false;
-		}
 	} else {
-		input->resampler = NULL;
+		input->shared = NULL;
 	}
 
 	return true;
@@ -362,7 +437,7 @@ bool audio_output_connect(audio_t *audio, size_t mi,
 			input.conversion.samples_per_sec =
 				audio->info.samples_per_sec;
 
-		success = audio_input_init(&input, audio);
+		success = audio_input_init(&input, audio, mix);
 		if (success)
 			da_push_back(mix->inputs, &input);
 	}
@@ -382,7 +457,7 @@ void audio_output_disconnect(audio_t *audio, size_t mix_idx,
 	size_t idx = audio_get_input_idx(audio, mix_idx, callback, param);
 	if (idx != DARRAY_INVALID) {
 		struct audio_mix *mix = &audio->mixes[mix_idx];
-		audio_input_free(mix->inputs.array+idx);
+		audio_input_free(mix, mix->inputs.array+idx);
 		da_erase(mix->inputs, idx);
 	}
 
@@ -391,6 +466,10 @@ void audio_output_disconnect(audio_t *audio, size_t mix_idx,
 
 static inline bool valid_audio_params(const struct audio_output_info *info)
 {
+	if (info->frames && (info->frames < MIN_AUDIO_OUTPUT_FRAMES ||
+	                     info->frames > AUDIO_OUTPUT_FRAMES))
+		return false;
+
 	return info->format && info->name && info->samples_per_sec > 0 &&
 	       info->speakers > 0;
 }
@@ -409,6 +488,8 @@ int audio_output_open(audio_t **audio, struct audio_output_info *info)
 		goto fail;
 
 	memcpy(&out->info, info, sizeof(struct audio_output_info));
+	if (!out->info.frames)
+		out->info.frames = AUDIO_OUTPUT_FRAMES;
 	out->channels   = get_audio_channels(info->speakers);
 	out->planes     = planar ? out->channels : 1;
 	out->input_cb   = info->input_callback;
@@ -452,9 +533,10 @@ void audio_output_close(audio_t *audio)
 		struct audio_mix *mix = &audio->mixes[mix_idx];
 
 		for (size_t i = 0; i < mix->inputs.num; i++)
-			audio_input_free(mix->inputs.array+i);
+			audio_input_free(mix, mix->inputs.array+i);
 
 		da_free(mix->inputs);
+		da_free(mix->conversions);
 	}
 
 	os_event_destroy(audio->stop_event);
@@ -499,3 +581,8 @@ uint32_t audio_output_get_sample_rate(const audio_t *audio)
 {
 	return audio ? audio->info.samples_per_sec : 0;
 }
+
+uint32_t audio_output_get_frames(const audio_t *audio)
+{
+	return audio ? audio->info.frames : 0;
+}
@@ -27,7 +27,11 @@ extern "C" {
 
 #define MAX_AUDIO_MIXES     6
 #define MAX_AUDIO_CHANNELS  8
+
+/* maximum (and default) number of frames per audio tick, the actual number
+ * is set with audio_output_info.frames, see audio_output_get_frames */
 #define AUDIO_OUTPUT_FRAMES 1024
+#define MIN_AUDIO_OUTPUT_FRAMES 64
 
 #define TOTAL_AUDIO_SIZE \
 	(MAX_AUDIO_MIXES * MAX_AUDIO_CHANNELS * \
@@ -98,6 +102,10 @@ struct audio_output_info {
 
 	audio_input_callback_t input_callback;
 	void                   *input_param;
+
+	/* frames per audio tick, between MIN_AUDIO_OUTPUT_FRAMES and
+	 * AUDIO_OUTPUT_FRAMES.  0 uses AUDIO_OUTPUT_FRAMES. */
+	uint32_t               frames;
 };
 
 struct audio_convert_info {
@@ -224,6 +232,7 @@ EXPORT size_t audio_output_get_block_size(const audio_t *audio);
 EXPORT size_t audio_output_get_planes(const audio_t *audio);
 EXPORT size_t audio_output_get_channels(const audio_t *audio);
 EXPORT uint32_t audio_output_get_sample_rate(const audio_t *audio);
+EXPORT uint32_t audio_output_get_frames(const audio_t *audio);
 EXPORT const struct audio_output_info *audio_output_get_info(
 		const audio_t *audio);
 
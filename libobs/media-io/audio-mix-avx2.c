@@ -0,0 +1,49 @@
+/******************************************************************************
+    Copyright (C) 2018 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/*
+ * AVX2 version of audio_mix_float.  This file is built with AVX2 code
+ * generation enabled, so nothing in here may be called unless
+ * os_cpu_has_avx2() returns true.
+ */
+
+#include "audio-mix.h"
+#include "../util/platform.h"
+
+#ifdef OS_HAS_AVX2_PATHS
+
+#include <immintrin.h>
+
+void audio_mix_float_avx2(float *dst, const float *src, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m256 a0 = _mm256_loadu_ps(dst + i);
+		__m256 a1 = _mm256_loadu_ps(dst + i + 8);
+		__m256 b0 = _mm256_loadu_ps(src + i);
+		__m256 b1 = _mm256_loadu_ps(src + i + 8);
+
+		_mm256_storeu_ps(dst + i,     _mm256_add_ps(a0, b0));
+		_mm256_storeu_ps(dst + i + 8, _mm256_add_ps(a1, b1));
+	}
+
+	for (; i < count; i++)
+		dst[i] += src[i];
+}
+
+#endif
@@ -0,0 +1,56 @@
+/******************************************************************************
+    Copyright (C) 2018 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <xmmintrin.h>
+
+#include "audio-mix.h"
+#include "../util/platform.h"
+
+#ifdef OS_HAS_AVX2_PATHS
+/* in audio-mix-avx2.c */
+extern void audio_mix_float_avx2(float *dst, const float *src, size_t count);
+#endif
+
+static void audio_mix_float_sse(float *dst, const float *src, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128 a0 = _mm_loadu_ps(dst + i);
+		__m128 a1 = _mm_loadu_ps(dst + i + 4);
+		__m128 b0 = _mm_loadu_ps(src + i);
+		__m128 b1 = _mm_loadu_ps(src + i + 4);
+
+		_mm_storeu_ps(dst + i,     _mm_add_ps(a0, b0));
+		_mm_storeu_ps(dst + i + 4, _mm_add_ps(a1, b1));
+	}
+
+	for (; i < count; i++)
+		dst[i] += src[i];
+}
+
+void audio_mix_float(float *dst, const float *src, size_t count)
+{
+#ifdef OS_HAS_AVX2_PATHS
+	if (os_cpu_has_avx2()) {
+		audio_mix_float_avx2(dst, src, count);
+		return;
+	}
+#endif
+
+	audio_mix_float_sse(dst, src, count);
+}
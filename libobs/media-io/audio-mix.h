@@ -0,0 +1,35 @@
+/******************************************************************************
+    Copyright (C) 2018 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Adds count floats of src on to dst (dst[i] += src[i]).  Uses AVX2 when the
+ * CPU supports it, otherwise SSE.  Neither pointer needs to be aligned.
+ */
+
+EXPORT void audio_mix_float(float *dst, const float *src, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
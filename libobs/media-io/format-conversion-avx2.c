@@ -0,0 +1,427 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/*
+ * AVX2 versions of the format conversion functions.  This file is built with
+ * AVX2 code generation enabled, so nothing in here may be called unless
+ * os_cpu_has_avx2() returns true.  Output is bit-exact with the SSE2/scalar
+ * versions in format-conversion.c.
+ */
+
+#include "format-conversion.h"
+#include "../util/platform.h"
+
+#ifdef OS_HAS_AVX2_PATHS
+
+#include <immintrin.h>
+
+static FORCE_INLINE uint32_t min_uint32(uint32_t a, uint32_t b)
+{
+	return a < b ? a : b;
+}
+
+/* ------------------------------------------------------------------------- */
+/* packed 444 -> planar                                                      */
+
+/* gathers the Y bytes of each lane into its low dword */
+#define LUM_SHUFFLE \
+	_mm256_setr_epi8( \
+		1, 5, 9, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, \
+		1, 5, 9, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)
+
+/* gathers the averaged U/V words of each lane as interleaved UV bytes */
+#define UV_SHUFFLE \
+	_mm256_setr_epi8( \
+		0, 2, 8, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, \
+		0, 2, 8, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)
+
+static FORCE_INLINE __m128i pack_lum(__m256i line, __m256i shuffle,
+		__m256i lanes)
+{
+	__m256i val = _mm256_shuffle_epi8(line, shuffle);
+	return _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(val, lanes));
+}
+
+/* averages each 2x2 block of chroma, returning U0 V0 U1 V1 U2 V2 U3 V3 */
+static FORCE_INLINE __m128i pack_uv(__m256i line1, __m256i line2,
+		__m256i uv_mask, __m256i shuffle, __m256i lanes)
+{
+	__m256i add_val = _mm256_add_epi16(
+			_mm256_and_si256(line1, uv_mask),
+			_mm256_and_si256(line2, uv_mask));
+	__m256i avg_val = _mm256_add_epi16(add_val,
+			_mm256_shuffle_epi32(add_val,
+				_MM_SHUFFLE(2, 3, 0, 1)));
+
+	avg_val = _mm256_srli_epi16(avg_val, 2);
+	avg_val = _mm256_shuffle_epi8(avg_val, shuffle);
+	return _mm256_castsi256_si128(
+			_mm256_permutevar8x32_epi32(avg_val, lanes));
+}
+
+/* scalar fallback for the last few pixels of a line, matches the 4 pixel
+ * steps of the SSE2 version */
+static inline void compress_tail(const uint8_t *img, uint32_t in_linesize,
+		uint8_t *lum0, uint8_t *lum1, uint8_t *u, uint8_t *v,
+		size_t uv_stride)
+{
+	const uint8_t *line1 = img;
+	const uint8_t *line2 = img + in_linesize;
+
+	for (size_t i = 0; i < 4; i++) {
+		lum0[i] = line1[i*4 + 1];
+		lum1[i] = line2[i*4 + 1];
+	}
+
+	for (size_t i = 0; i < 2; i++) {
+		const uint8_t *p1 = line1 + i*8;
+		const uint8_t *p2 = line2 + i*8;
+
+		u[i * uv_stride] = (uint8_t)((p1[0] + p1[4] +
+					p2[0] + p2[4]) >> 2);
+		v[i * uv_stride] = (uint8_t)((p1[2] + p1[6] +
+					p2[2] + p2[6]) >> 2);
+	}
+}
+
+void compress_uyvx_to_i420_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t  *lum_plane   = output[0];
+	uint8_t  *u_plane     = output[1];
+	uint8_t  *v_plane     = output[2];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	__m256i uv_mask     = _mm256_set1_epi16(0x00FF);
+	__m256i lum_shuffle = LUM_SHUFFLE;
+	__m256i uv_shuffle  = UV_SHUFFLE;
+	__m256i lanes       = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	__m128i planar      = _mm_setr_epi8(0, 2, 4, 6, 1, 3, 5, 7,
+			-1, -1, -1, -1, -1, -1, -1, -1);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x + 8 <= width; x += 8) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+			uint32_t chroma_pos = chroma_y_pos + (x>>1);
+
+			__m256i line1 = _mm256_loadu_si256((const __m256i*)img);
+			__m256i line2 = _mm256_loadu_si256(
+					(const __m256i*)(img + in_linesize));
+			__m128i uv;
+
+			_mm_storel_epi64((__m128i*)(lum_plane + lum_pos0),
+					pack_lum(line1, lum_shuffle, lanes));
+			_mm_storel_epi64((__m128i*)(lum_plane + lum_pos1),
+					pack_lum(line2, lum_shuffle, lanes));
+
+			uv = pack_uv(line1, line2, uv_mask, uv_shuffle, lanes);
+			uv = _mm_shuffle_epi8(uv, planar);
+
+			*(uint32_t*)(u_plane + chroma_pos) =
+				(uint32_t)_mm_cvtsi128_si32(uv);
+			*(uint32_t*)(v_plane + chroma_pos) =
+				(uint32_t)_mm_cvtsi128_si32(
+						_mm_srli_si128(uv, 4));
+		}
+
+		for (; x < width; x += 4) {
+			uint32_t lum_pos0 = lum_y_pos + x;
+
+			compress_tail(input + y_pos + x*4, in_linesize,
+					lum_plane + lum_pos0,
+					lum_plane + lum_pos0 + out_linesize[0],
+					u_plane + chroma_y_pos + (x>>1),
+					v_plane + chroma_y_pos + (x>>1), 1);
+		}
+	}
+}
+
+void compress_uyvx_to_nv12_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t *lum_plane    = output[0];
+	uint8_t *chroma_plane = output[1];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	__m256i uv_mask     = _mm256_set1_epi16(0x00FF);
+	__m256i lum_shuffle = LUM_SHUFFLE;
+	__m256i uv_shuffle  = UV_SHUFFLE;
+	__m256i lanes       = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x + 8 <= width; x += 8) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			__m256i line1 = _mm256_loadu_si256((const __m256i*)img);
+			__m256i line2 = _mm256_loadu_si256(
+					(const __m256i*)(img + in_linesize));
+
+			_mm_storel_epi64((__m128i*)(lum_plane + lum_pos0),
+					pack_lum(line1, lum_shuffle, lanes));
+			_mm_storel_epi64((__m128i*)(lum_plane + lum_pos1),
+					pack_lum(line2, lum_shuffle, lanes));
+			_mm_storel_epi64(
+					(__m128i*)(chroma_plane + chroma_y_pos + x),
+					pack_uv(line1, line2, uv_mask,
+						uv_shuffle, lanes));
+		}
+
+		for (; x < width; x += 4) {
+			uint32_t lum_pos0 = lum_y_pos + x;
+			uint8_t *uv       = chroma_plane + chroma_y_pos + x;
+
+			compress_tail(input + y_pos + x*4, in_linesize,
+					lum_plane + lum_pos0,
+					lum_plane + lum_pos0 + out_linesize[0],
+					uv, uv + 1, 2);
+		}
+	}
+}
+
+void convert_uyvx_to_i444_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[])
+{
+	uint8_t  *lum_plane   = output[0];
+	uint8_t  *u_plane     = output[1];
+	uint8_t  *v_plane     = output[2];
+	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t y;
+
+	__m256i shuffle = _mm256_setr_epi8(
+			1, 5, 9, 13, 0, 4, 8, 12, 2, 6, 10, 14, -1, -1, -1, -1,
+			1, 5, 9, 13, 0, 4, 8, 12, 2, 6, 10, 14, -1, -1, -1, -1);
+	__m256i lanes   = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+	for (y = start_y; y < end_y; y++) {
+		const uint8_t *line   = input + y * in_linesize;
+		uint32_t      lum_y_pos = y * out_linesize[0];
+		uint32_t      x;
+
+		for (x = 0; x + 8 <= width; x += 8) {
+			uint32_t pos = lum_y_pos + x;
+			__m256i  val = _mm256_loadu_si256(
+					(const __m256i*)(line + x*4));
+
+			val = _mm256_shuffle_epi8(val, shuffle);
+			val = _mm256_permutevar8x32_epi32(val, lanes);
+
+			_mm_storel_epi64((__m128i*)(lum_plane + pos),
+					_mm256_castsi256_si128(val));
+			_mm_storel_epi64((__m128i*)(u_plane + pos),
+					_mm_srli_si128(
+						_mm256_castsi256_si128(val), 8));
+			_mm_storel_epi64((__m128i*)(v_plane + pos),
+					_mm256_extracti128_si256(val, 1));
+		}
+
+		for (; x < width; x++) {
+			const uint8_t *pixel = line + x*4;
+			uint32_t      pos    = lum_y_pos + x;
+
+			lum_plane[pos] = pixel[1];
+			u_plane[pos]   = pixel[0];
+			v_plane[pos]   = pixel[2];
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* planar/packed -> packed 444                                               */
+
+void decompress_420_avx2(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	uint32_t start_y_d2 = start_y/2;
+	uint32_t width_d2   = in_linesize[0]/2;
+	uint32_t height_d2  = end_y/2;
+	uint32_t y;
+
+	for (y = start_y_d2; y < height_d2; y++) {
+		const uint8_t *chroma0 = input[1] + y * in_linesize[1];
+		const uint8_t *chroma1 = input[2] + y * in_linesize[2];
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
+		uint32_t x;
+
+		lum0 = input[0] + y * 2 * in_linesize[0];
+		lum1 = lum0 + in_linesize[0];
+		output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
+
+		for (x = 0; x + 4 <= width_d2; x += 4) {
+			__m128i u = _mm_cvtsi32_si128(*(const int*)(chroma0+x));
+			__m128i v = _mm_cvtsi32_si128(*(const int*)(chroma1+x));
+			__m256i out;
+
+			u = _mm_unpacklo_epi8(u, u);
+			v = _mm_unpacklo_epi8(v, v);
+
+			out = _mm256_or_si256(
+				_mm256_slli_epi32(_mm256_cvtepu8_epi32(u), 8),
+				_mm256_cvtepu8_epi32(v));
+
+			_mm256_storeu_si256((__m256i*)(output0 + x*2),
+				_mm256_or_si256(out, _mm256_slli_epi32(
+					_mm256_cvtepu8_epi32(_mm_loadl_epi64(
+						(const __m128i*)(lum0 + x*2))),
+					16)));
+			_mm256_storeu_si256((__m256i*)(output1 + x*2),
+				_mm256_or_si256(out, _mm256_slli_epi32(
+					_mm256_cvtepu8_epi32(_mm_loadl_epi64(
+						(const __m128i*)(lum1 + x*2))),
+					16)));
+		}
+
+		for (; x < width_d2; x++) {
+			uint32_t out = (chroma0[x] << 8) | chroma1[x];
+
+			output0[x*2]   = (lum0[x*2]   << 16) | out;
+			output0[x*2+1] = (lum0[x*2+1] << 16) | out;
+
+			output1[x*2]   = (lum1[x*2]   << 16) | out;
+			output1[x*2+1] = (lum1[x*2+1] << 16) | out;
+		}
+	}
+}
+
+void decompress_nv12_avx2(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize)
+{
+	uint32_t start_y_d2 = start_y/2;
+	uint32_t width_d2   = min_uint32(in_linesize[0], out_linesize)/2;
+	uint32_t height_d2  = end_y/2;
+	uint32_t y;
+
+	for (y = start_y_d2; y < height_d2; y++) {
+		const uint16_t *chroma;
+		const uint8_t *lum0, *lum1;
+		uint32_t *output0, *output1;
+		uint32_t x;
+
+		chroma = (const uint16_t*)(input[1] + y * in_linesize[1]);
+		lum0 = input[0] + y * 2 * in_linesize[0];
+		lum1 = lum0 + in_linesize[0];
+		output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
+
+		for (x = 0; x + 4 <= width_d2; x += 4) {
+			__m128i uv = _mm_loadl_epi64(
+					(const __m128i*)(chroma + x));
+			__m256i out;
+
+			uv  = _mm_unpacklo_epi16(uv, uv);
+			out = _mm256_slli_epi32(_mm256_cvtepu16_epi32(uv), 8);
+
+			_mm256_storeu_si256((__m256i*)(output0 + x*2),
+				_mm256_or_si256(out,
+					_mm256_cvtepu8_epi32(_mm_loadl_epi64(
+						(const __m128i*)(lum0 + x*2)))));
+			_mm256_storeu_si256((__m256i*)(output1 + x*2),
+				_mm256_or_si256(out,
+					_mm256_cvtepu8_epi32(_mm_loadl_epi64(
+						(const __m128i*)(lum1 + x*2)))));
+		}
+
+		for (; x < width_d2; x++) {
+			uint32_t out = chroma[x] << 8;
+
+			output0[x*2]   = lum0[x*2]   | out;
+			output0[x*2+1] = lum0[x*2+1] | out;
+
+			output1[x*2]   = lum1[x*2]   | out;
+			output1[x*2+1] = lum1[x*2+1] | out;
+		}
+	}
+}
+
+void decompress_422_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize,
+		bool leading_lum)
+{
+	uint32_t width_d2 = min_uint32(in_linesize, out_linesize)/2;
+	uint32_t y;
+
+	/* every input dword becomes two output pixels, the second one takes
+	 * the second luma value of the pair for both of its luma bytes */
+	__m256i dup     = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+	__m256i shuffle = leading_lum ?
+		_mm256_setr_epi8(
+			0, 1, 2, 3, 6, 5, 6, 7, 8, 9, 10, 11, 14, 13, 14, 15,
+			0, 1, 2, 3, 6, 5, 6, 7, 8, 9, 10, 11, 14, 13, 14, 15) :
+		_mm256_setr_epi8(
+			0, 1, 2, 3, 4, 7, 6, 7, 8, 9, 10, 11, 12, 15, 14, 15,
+			0, 1, 2, 3, 4, 7, 6, 7, 8, 9, 10, 11, 12, 15, 14, 15);
+
+	for (y = start_y; y < end_y; y++) {
+		const uint32_t *input32  = (const uint32_t*)(input + y*in_linesize);
+		uint32_t       *output32 = (uint32_t*)(output + y*out_linesize);
+		uint32_t       x;
+
+		for (x = 0; x + 4 <= width_d2; x += 4) {
+			__m256i val = _mm256_castsi128_si256(_mm_loadu_si128(
+					(const __m128i*)(input32 + x)));
+
+			val = _mm256_permutevar8x32_epi32(val, dup);
+			val = _mm256_shuffle_epi8(val, shuffle);
+			_mm256_storeu_si256((__m256i*)(output32 + x*2), val);
+		}
+
+		for (; x < width_d2; x++) {
+			uint32_t dw = input32[x];
+
+			output32[x*2] = dw;
+			if (leading_lum) {
+				dw &= 0xFFFFFF00;
+				dw |= (uint8_t)(dw>>16);
+			} else {
+				dw &= 0xFFFF00FF;
+				dw |= (dw>>16) & 0xFF00;
+			}
+			output32[x*2+1] = dw;
+		}
+	}
+}
+
+#endif
@@ -16,9 +16,39 @@
 ******************************************************************************/
 
 #include "format-conversion.h"
+#include "../util/platform.h"
 #include <xmmintrin.h>
 #include <emmintrin.h>
 
+#ifdef OS_HAS_AVX2_PATHS
+/* implemented in format-conversion-avx2.c */
+extern void compress_uyvx_to_i420_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[]);
+extern void compress_uyvx_to_nv12_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[]);
+extern void convert_uyvx_to_i444_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[]);
+extern void decompress_nv12_avx2(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize);
+extern void decompress_420_avx2(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize);
+extern void decompress_422_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize,
+		bool leading_lum);
+#endif
+
 /* ...surprisingly, if I don't use a macro to force inlining, it causes the
  * CPU usage to boost by a tremendous amount in debug builds. */
 
@@ -94,6 +124,14 @@ void compress_uyvx_to_i420(
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output[], const uint32_t out_linesize[])
 {
+#ifdef OS_HAS_AVX2_PATHS
+	if (os_cpu_has_avx2()) {
+		compress_uyvx_to_i420_avx2(input, in_linesize, start_y, end_y,
+				output, out_linesize);
+		return;
+	}
+#endif
+
 	uint8_t  *lum_plane   = output[0];
 	uint8_t  *u_plane     = output[1];
 	uint8_t  *v_plane     = output[2];
@@ -132,6 +170,14 @@ void compress_uyvx_to_nv12(
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output[], const uint32_t out_linesize[])
 {
+#ifdef OS_HAS_AVX2_PATHS
+	if (os_cpu_has_avx2()) {
+		compress_uyvx_to_nv12_avx2(input, in_linesize, start_y, end_y,
+				output, out_linesize);
+		return;
+	}
+#endif
+
 	uint8_t *lum_plane    = output[0];
 	uint8_t *chroma_plane = output[1];
 	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
@@ -168,6 +214,14 @@ void convert_uyvx_to_i444(
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output[], const uint32_t out_linesize[])
 {
+#ifdef OS_HAS_AVX2_PATHS
+	if (os_cpu_has_avx2()) {
+		convert_uyvx_to_i444_avx2(input, in_linesize, start_y, end_y,
+				output, out_linesize);
+		return;
+	}
+#endif
+
 	uint8_t  *lum_plane   = output[0];
 	uint8_t  *u_plane     = output[1];
 	uint8_t  *v_plane     = output[2];
@@ -207,6 +261,14 @@ void decompress_420(
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output, uint32_t out_linesize)
 {
+#ifdef OS_HAS_AVX2_PATHS
+	if (os_cpu_has_avx2()) {
+		decompress_420_avx2(input, in_linesize, start_y, end_y,
+				output, out_linesize);
+		return;
+	}
+#endif
+
 	uint32_t start_y_d2 = start_y/2;
 	uint32_t width_d2   = in_linesize[0]/2;
 	uint32_t height_d2  = end_y/2;
@@ -242,6 +304,14 @@ void decompress_nv12(
 		uint32_t start_y, uint32_t end_y,
 		uint8_t *output, uint32_t out_linesize)
 {
+#ifdef OS_HAS_AVX2_PATHS
+	if (os_cpu_has_avx2()) {
+		decompress_nv12_avx2(input, in_linesize, start_y, end_y,
+				output, out_linesize);
+		return;
+	}
+#endif
+
 	uint32_t start_y_d2 = start_y/2;
 	uint32_t width_d2   = min_uint32(in_linesize[0], out_linesize)/2;
 	uint32_t height_d2  = end_y/2;
@@ -284,6 +354,14 @@ void decompress_422(
 	register const uint32_t *input32_end;
 	register uint32_t       *output32;
 
+#ifdef OS_HAS_AVX2_PATHS
+	if (os_cpu_has_avx2()) {
+		decompress_422_avx2(input, in_linesize, start_y, end_y,
+				output, out_linesize, leading_lum);
+		return;
+	}
+#endif
+
 	if (leading_lum) {
 		for (y = start_y; y < end_y; y++) {
 			input32     = (const uint32_t*)(input + y*in_linesize);
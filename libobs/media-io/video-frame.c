@@ -20,57 +20,50 @@
 #define ALIGN_SIZE(size, align) \
 	size = (((size)+(align-1)) & (~(align-1)))
 
-/* messy code alarm */
-void video_frame_init(struct video_frame *frame, enum video_format format,
-		uint32_t width, uint32_t height)
+/* calculates the plane offsets/line sizes of a frame and returns the size of
+ * the buffer that holds all of its planes */
+static size_t get_frame_layout(enum video_format format, uint32_t width,
+		uint32_t height, size_t offsets[MAX_AV_PLANES],
+		uint32_t linesize[MAX_AV_PLANES])
 {
-	size_t size;
-	size_t offsets[MAX_AV_PLANES];
+	size_t size = 0;
 	int    alignment = base_get_alignment();
 
-	if (!frame) return;
-
-	memset(frame, 0, sizeof(struct video_frame));
-	memset(offsets, 0, sizeof(offsets));
+	memset(offsets, 0, sizeof(size_t) * MAX_AV_PLANES);
+	memset(linesize, 0, sizeof(uint32_t) * MAX_AV_PLANES);
 
 	switch (format) {
 	case VIDEO_FORMAT_NONE:
-		return;
+		return 0;
 
 	case VIDEO_FORMAT_I420:
 		size = width * height;
 		ALIGN_SIZE(size, alignment);
-		offsets[0] = size;
+		offsets[1] = size;
 		size += (width/2) * (height/2);
 		ALIGN_SIZE(size, alignment);
-		offsets[1] = size;
+		offsets[2] = size;
 		size += (width/2) * (height/2);
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
-		frame->data[1] = (uint8_t*)frame->data[0] + offsets[0];
-		frame->data[2] = (uint8_t*)frame->data[0] + offsets[1];
-		frame->linesize[0] = width;
-		frame->linesize[1] = width/2;
-		frame->linesize[2] = width/2;
+		linesize[0] = width;
+		linesize[1] = width/2;
+		linesize[2] = width/2;
 		break;
 
 	case VIDEO_FORMAT_NV12:
 		size = width * height;
 		ALIGN_SIZE(size, alignment);
-		offsets[0] = size;
+		offsets[1] = size;
 		size += (width/2) * (height/2) * 2;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
-		frame->data[1] = (uint8_t*)frame->data[0] + offsets[0];
-		frame->linesize[0] = width;
-		frame->linesize[1] = width;
+		linesize[0] = width;
+		linesize[1] = width;
 		break;
 
 	case VIDEO_FORMAT_Y800:
 		size = width * height;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
-		frame->linesize[0] = width;
+		linesize[0] = width;
 		break;
 
 	case VIDEO_FORMAT_YVYU:
@@ -78,8 +71,7 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 	case VIDEO_FORMAT_UYVY:
 		size = width * height * 2;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
-		frame->linesize[0] = width*2;
+		linesize[0] = width*2;
 		break;
 
 	case VIDEO_FORMAT_RGBA:
@@ -87,21 +79,66 @@ void video_frame_init(struct video_frame *frame, enum video_format format,
 	case VIDEO_FORMAT_BGRX:
 		size = width * height * 4;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size);
-		frame->linesize[0] = width*4;
+		linesize[0] = width*4;
 		break;
 
 	case VIDEO_FORMAT_I444:
 		size = width * height;
 		ALIGN_SIZE(size, alignment);
-		frame->data[0] = bmalloc(size * 3);
-		frame->data[1] = (uint8_t*)frame->data[0] + size;
-		frame->data[2] = (uint8_t*)frame->data[1] + size;
-		frame->linesize[0] = width;
-		frame->linesize[1] = width;
-		frame->linesize[2] = width;
+		offsets[1] = size;
+		offsets[2] = size * 2;
+		size *= 3;
+		linesize[0] = width;
+		linesize[1] = width;
+		linesize[2] = width;
 		break;
 	}
+
+	return size;
+}
+
+size_t video_frame_get_size(enum video_format format, uint32_t width,
+		uint32_t height)
+{
+	size_t offsets[MAX_AV_PLANES];
+	uint32_t linesize[MAX_AV_PLANES];
+
+	return get_frame_layout(format, width, height, offsets, linesize);
+}
+
+void video_frame_init_buffer(struct video_frame *frame,
+		enum video_format format, uint32_t width, uint32_t height,
+		uint8_t *buffer)
+{
+	size_t offsets[MAX_AV_PLANES];
+	size_t size;
+
+	if (!frame) return;
+
+	memset(frame, 0, sizeof(struct video_frame));
+
+	size = get_frame_layout(format, width, height, offsets,
+			frame->linesize);
+	if (!size || !buffer)
+		return;
+
+	frame->data[0] = buffer;
+	for (size_t i = 1; i < MAX_AV_PLANES; i++) {
+		if (offsets[i])
+			frame->data[i] = buffer + offsets[i];
+	}
+}
+
+void video_frame_init(struct video_frame *frame, enum video_format format,
+		uint32_t width, uint32_t height)
+{
+	size_t size;
+
+	if (!frame) return;
+
+	size = video_frame_get_size(format, width, height);
+	video_frame_init_buffer(frame, format, width, height,
+			size ? bmalloc(size) : NULL);
 }
 
 void video_frame_copy(struct video_frame *dst, const struct video_frame *src,
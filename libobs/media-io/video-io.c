@@ -22,6 +22,7 @@
 #include "../util/profiler.h"
 #include "../util/threading.h"
 #include "../util/darray.h"
+#include "../util/circlebuf.h"
 
 #include "format-conversion.h"
 #include "video-io.h"
@@ -30,31 +31,80 @@
 
 extern profiler_name_store_t *obs_get_profiler_name_store(void);
 
-#define MAX_CONVERT_BUFFERS 3
-#define MAX_CACHE_SIZE 16
+#define MAX_CACHE_SIZE 32
+#define MAX_QUEUED_FRAMES 3
+
+/* longest the video thread waits for blocking inputs before dropping the
+ * frame anyway, so an input that disconnects itself can't deadlock it.  the
+ * wait happens outside of input_mutex and is shared by all blocked inputs */
+#define MAX_BLOCK_TIME_MS 100
 
 struct cached_frame_info {
 	struct video_data frame;
 	int skipped;
 	int count;
+	uint64_t generation;
+
+	/* held by the video thread until the frame has been sent to every
+	 * input, and by each input until it has processed the frame */
+	long refs;
 };
 
-struct video_input {
+struct queued_frame {
+	struct cached_frame_info *cfi;
+	uint64_t                 timestamp;
+};
+
+struct scaled_frame {
+	struct video_frame        frame;
+	uint64_t                  generation;
+	long                      users;
+};
+
+/* Inputs that request the same conversion share a single scaler.  Each
+ * cached frame is scaled once, by whichever input gets to it first, and kept
+ * for the other inputs until the buffer is needed for a newer frame.  Inputs
+ * are at most their queue depth apart, so the scaler keeps up to the deepest
+ * queue plus one frame per input before reusing buffers. */
+struct shared_scaler {
 	struct video_scale_info   conversion;
 	video_scaler_t            *scaler;
-	struct video_frame        frame[MAX_CONVERT_BUFFERS];
-	int                       cur_frame;
+	long                      refs;
+
+	pthread_mutex_t           mutex;
+	DARRAY(struct scaled_frame) frames;
+	size_t                    max_frames;
+};
+
+struct video_input {
+	struct video_output       *video;
+	struct video_scale_info   conversion;
+	struct shared_scaler      *scaler;
 
 	void (*callback)(void *param, struct video_data *frame);
 	void *param;
-};
 
-static inline void video_input_free(struct video_input *input)
-{
-	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-		video_frame_free(&input->frame[i]);
-	video_scaler_destroy(input->scaler);
-}
+	/* each input scales and processes its frames on its own thread so a
+	 * slow input does not hold up the other inputs of the same output */
+	pthread_t                 thread;
+	bool                      thread_created;
+	pthread_mutex_t           callback_mutex;
+	volatile bool             stop;
+
+	/* held by the output while connected and by the video thread while
+	 * it waits for space in the queue */
+	volatile long             refs;
+
+	pthread_mutex_t           queue_mutex;
+	os_sem_t                  *queue_semaphore;
+	os_event_t                *queue_space_event;
+	struct circlebuf          queue;
+	size_t                    max_queued;
+	enum video_input_overflow overflow;
+
+	uint32_t                  dropped_frames;
+	uint32_t                  total_frames;
+};
 
 struct video_output {
 	struct video_output_info   info;
@@ -71,47 +121,292 @@ struct video_output {
 	bool                       initialized;
 
 	pthread_mutex_t            input_mutex;
-	DARRAY(struct video_input) inputs;
-
+	DARRAY(struct video_input*) inputs;
+	DARRAY(struct video_input*) stopped_inputs;
+	DARRAY(struct video_input*) blocked_inputs;
+	DARRAY(struct shared_scaler*) scalers;
+
+	/* frames queued to inputs are not available to the video thread, so
+	 * the cache grows by the queue depth of each input on top of the
+	 * frames requested in info.cache_size */
+	size_t                     cache_frames;
 	size_t                     available_frames;
-	size_t                     first_added;
 	size_t                     last_added;
+	uint64_t                   last_generation;
 	struct cached_frame_info   cache[MAX_CACHE_SIZE];
+
+	/* locked frames waiting to be sent to the inputs, in order */
+	size_t                     pending[MAX_CACHE_SIZE];
+	size_t                     first_pending;
+	size_t                     num_pending;
 };
 
 /* ------------------------------------------------------------------------- */
 
+static void release_cached_frame(struct video_output *video,
+		struct cached_frame_info *cfi)
+{
+	pthread_mutex_lock(&video->data_mutex);
+
+	if (--cfi->refs == 0)
+		video->available_frames++;
+
+	pthread_mutex_unlock(&video->data_mutex);
+}
+
+/* returns the scaled frame that holds the given generation, or the buffer
+ * to scale it in to.  called with the scaler mutex held. */
+static size_t get_scaled_frame(struct shared_scaler *ss, uint64_t generation)
+{
+	size_t oldest = DARRAY_INVALID;
+	struct scaled_frame *sf;
+
+	for (size_t i = 0; i < ss->frames.num; i++) {
+		sf = ss->frames.array + i;
+
+		if (sf->generation == generation)
+			return i;
+		if (sf->users)
+			continue;
+		if (oldest == DARRAY_INVALID ||
+		    sf->generation < ss->frames.array[oldest].generation)
+			oldest = i;
+	}
+
+	if (oldest != DARRAY_INVALID && ss->frames.num >= ss->max_frames) {
+		ss->frames.array[oldest].generation = 0;
+		return oldest;
+	}
+
+	sf = da_push_back_new(ss->frames);
+	video_frame_init(&sf->frame, ss->conversion.format,
+			ss->conversion.width, ss->conversion.height);
+	return ss->frames.num - 1;
+}
+
 static inline bool scale_video_output(struct video_input *input,
-		struct video_data *data)
+		const struct cached_frame_info *cfi, struct video_data *data,
+		size_t *scaled_idx)
 {
+	struct shared_scaler *ss = input->scaler;
+	struct scaled_frame *sf;
 	bool success = true;
+	size_t idx;
 
-	if (input->scaler) {
-		struct video_frame *frame;
+	if (!ss)
+		return true;
 
-		if (++input->cur_frame == MAX_CONVERT_BUFFERS)
-			input->cur_frame = 0;
+	pthread_mutex_lock(&ss->mutex);
 
-		frame = &input->frame[input->cur_frame];
+	idx = get_scaled_frame(ss, cfi->generation);
+	sf = ss->frames.array + idx;
 
-		success = video_scaler_scale(input->scaler,
-				frame->data, frame->linesize,
+	if (sf->generation != cfi->generation) {
+		success = video_scaler_scale(ss->scaler,
+				sf->frame.data, sf->frame.linesize,
 				(const uint8_t * const*)data->data,
 				data->linesize);
 
-		if (success) {
-			for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-				data->data[i]     = frame->data[i];
-				data->linesize[i] = frame->linesize[i];
-			}
-		} else {
-			blog(LOG_WARNING, "video-io: Could not scale frame!");
+		sf->generation = success ? cfi->generation : 0;
+	}
+
+	if (success) {
+		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+			data->data[i]     = sf->frame.data[i];
+			data->linesize[i] = sf->frame.linesize[i];
 		}
+
+		sf->users++;
+		*scaled_idx = idx;
 	}
 
+	pthread_mutex_unlock(&ss->mutex);
+
+	if (!success)
+		blog(LOG_WARNING, "video-io: Could not scale frame!");
+
 	return success;
 }
 
+static inline void release_scaled_frame(struct video_input *input,
+		size_t scaled_idx)
+{
+	struct shared_scaler *ss = input->scaler;
+
+	if (!ss)
+		return;
+
+	pthread_mutex_lock(&ss->mutex);
+	ss->frames.array[scaled_idx].users--;
+	pthread_mutex_unlock(&ss->mutex);
+}
+
+static void *video_input_thread(void *param)
+{
+	struct video_input *input = param;
+	struct video_output *video = input->video;
+
+	os_set_thread_name("video-io: video input thread");
+
+	while (os_sem_wait(input->queue_semaphore) == 0) {
+		struct queued_frame queued = {0};
+		size_t scaled_idx = 0;
+		bool stop;
+
+		pthread_mutex_lock(&input->callback_mutex);
+
+		stop = os_atomic_load_bool(&input->stop);
+		if (!stop) {
+			pthread_mutex_lock(&input->queue_mutex);
+			if (input->queue.size)
+				circlebuf_pop_front(&input->queue, &queued,
+						sizeof(queued));
+			pthread_mutex_unlock(&input->queue_mutex);
+
+			os_event_signal(input->queue_space_event);
+		}
+
+		if (queued.cfi) {
+			struct video_data frame;
+
+			/* the timestamp of a repeated frame is advanced by the
+			 * video thread, so only the planes are shared */
+			memcpy(frame.data, queued.cfi->frame.data,
+					sizeof(frame.data));
+			memcpy(frame.linesize, queued.cfi->frame.linesize,
+					sizeof(frame.linesize));
+			frame.timestamp = queued.timestamp;
+
+			if (scale_video_output(input, queued.cfi, &frame,
+						&scaled_idx)) {
+				input->callback(input->param, &frame);
+				release_scaled_frame(input, scaled_idx);
+			}
+		}
+
+		pthread_mutex_unlock(&input->callback_mutex);
+
+		if (queued.cfi)
+			release_cached_frame(video, queued.cfi);
+		if (stop)
+			break;
+	}
+
+	return NULL;
+}
+
+static void video_input_free(struct video_output *video,
+		struct video_input *input);
+
+static inline void video_input_addref(struct video_input *input)
+{
+	os_atomic_inc_long(&input->refs);
+}
+
+static inline void video_input_release(struct video_output *video,
+		struct video_input *input)
+{
+	if (os_atomic_dec_long(&input->refs) == 0)
+		video_input_free(video, input);
+}
+
+static inline bool video_input_queue_full(struct video_input *input)
+{
+	return input->queue.size >=
+		input->max_queued * sizeof(struct queued_frame);
+}
+
+/* Queues a frame for the input.  If the queue is full and the input blocks,
+ * nothing is queued and false is returned so the video thread can wait for
+ * space without holding input_mutex, then push again with 'waited' set. */
+static bool video_input_push(struct video_output *video,
+		struct video_input *input, struct cached_frame_info *cfi,
+		uint64_t timestamp, bool waited)
+{
+	struct queued_frame queued = {cfi, timestamp};
+
+	pthread_mutex_lock(&input->queue_mutex);
+
+	if (os_atomic_load_bool(&input->stop)) {
+		pthread_mutex_unlock(&input->queue_mutex);
+		return true;
+	}
+
+	if (!waited)
+		input->total_frames++;
+
+	while (video_input_queue_full(input)) {
+		struct queued_frame oldest;
+
+		if (input->overflow == VIDEO_INPUT_BLOCK && !waited) {
+			pthread_mutex_unlock(&input->queue_mutex);
+			return false;
+
+		} else if (input->overflow == VIDEO_INPUT_DROP_OLDEST) {
+			circlebuf_pop_front(&input->queue, &oldest,
+					sizeof(oldest));
+			input->dropped_frames++;
+			release_cached_frame(video, oldest.cfi);
+			continue;
+		}
+
+		input->dropped_frames++;
+		pthread_mutex_unlock(&input->queue_mutex);
+		return true;
+	}
+
+	pthread_mutex_lock(&video->data_mutex);
+	cfi->refs++;
+	pthread_mutex_unlock(&video->data_mutex);
+
+	circlebuf_push_back(&input->queue, &queued, sizeof(queued));
+
+	pthread_mutex_unlock(&input->queue_mutex);
+
+	os_sem_post(input->queue_semaphore);
+	return true;
+}
+
+static void video_input_wait_for_space(struct video_input *input,
+		uint64_t block_end)
+{
+	for (;;) {
+		uint64_t cur_time;
+		bool full;
+
+		pthread_mutex_lock(&input->queue_mutex);
+		full = video_input_queue_full(input);
+		pthread_mutex_unlock(&input->queue_mutex);
+
+		cur_time = os_gettime_ns();
+		if (!full || cur_time >= block_end ||
+		    os_atomic_load_bool(&input->stop))
+			break;
+
+		os_event_timedwait(input->queue_space_event,
+				(unsigned long)((block_end - cur_time) /
+				1000000ULL) + 1);
+	}
+}
+
+/* called from the video thread without input_mutex held */
+static void push_blocked_inputs(struct video_output *video,
+		struct cached_frame_info *cfi, uint64_t timestamp)
+{
+	uint64_t block_end = os_gettime_ns() +
+		MAX_BLOCK_TIME_MS * 1000000ULL;
+
+	for (size_t i = 0; i < video->blocked_inputs.num; i++) {
+		struct video_input *input = video->blocked_inputs.array[i];
+
+		video_input_wait_for_space(input, block_end);
+		video_input_push(video, input, cfi, timestamp, true);
+		video_input_release(video, input);
+	}
+
+	da_resize(video->blocked_inputs, 0);
+}
+
 static inline bool video_output_cur_frame(struct video_output *video)
 {
 	struct cached_frame_info *frame_info;
@@ -122,7 +417,12 @@ static inline bool video_output_cur_frame(struct video_output *video)
 
 	pthread_mutex_lock(&video->data_mutex);
 
-	frame_info = &video->cache[video->first_added];
+	if (!video->num_pending) {
+		pthread_mutex_unlock(&video->data_mutex);
+		return true;
+	}
+
+	frame_info = &video->cache[video->pending[video->first_pending]];
 
 	pthread_mutex_unlock(&video->data_mutex);
 
@@ -131,15 +431,21 @@ static inline bool video_output_cur_frame(struct video_output *video)
 	pthread_mutex_lock(&video->input_mutex);
 
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array+i;
-		struct video_data frame = frame_info->frame;
+		struct video_input *input = video->inputs.array[i];
 
-		if (scale_video_output(input, &frame))
-			input->callback(input->param, &frame);
+		if (!video_input_push(video, input, frame_info,
+					frame_info->frame.timestamp, false)) {
+			video_input_addref(input);
+			da_push_back(video->blocked_inputs, &input);
+		}
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
 
+	if (video->blocked_inputs.num)
+		push_blocked_inputs(video, frame_info,
+				frame_info->frame.timestamp);
+
 	/* -------------------------------- */
 
 	pthread_mutex_lock(&video->data_mutex);
@@ -149,11 +455,12 @@ static inline bool video_output_cur_frame(struct video_output *video)
 	skipped = frame_info->skipped > 0;
 
 	if (complete) {
-		if (++video->first_added == video->info.cache_size)
-			video->first_added = 0;
+		if (++video->first_pending == MAX_CACHE_SIZE)
+			video->first_pending = 0;
+		video->num_pending--;
 
-		if (++video->available_frames == video->info.cache_size)
-			video->last_added = video->first_added;
+		if (--frame_info->refs == 0)
+			video->available_frames++;
 	} else if (skipped) {
 		--frame_info->skipped;
 		++video->skipped_frames;
@@ -215,9 +522,55 @@ static inline void init_cache(struct video_output *video)
 				video->info.width, video->info.height);
 	}
 
+	video->cache_frames = video->info.cache_size;
 	video->available_frames = video->info.cache_size;
 }
 
+static void update_input_buffers(struct video_output *video)
+{
+	size_t needed = video->info.cache_size;
+
+	for (size_t i = 0; i < video->inputs.num; i++)
+		needed += video->inputs.array[i]->max_queued + 1;
+
+	if (needed > MAX_CACHE_SIZE) {
+		blog(LOG_DEBUG, "video-io: %"PRIu64" cached frames needed "
+				"for the connected inputs, limited to %d",
+				(uint64_t)needed, MAX_CACHE_SIZE);
+		needed = MAX_CACHE_SIZE;
+	}
+
+	for (size_t i = 0; i < video->scalers.num; i++) {
+		struct shared_scaler *ss = video->scalers.array[i];
+		size_t max_queued = 0;
+
+		for (size_t j = 0; j < video->inputs.num; j++) {
+			struct video_input *input = video->inputs.array[j];
+			if (input->scaler == ss &&
+			    input->max_queued > max_queued)
+				max_queued = input->max_queued;
+		}
+
+		pthread_mutex_lock(&ss->mutex);
+		ss->max_frames = max_queued + (size_t)ss->refs;
+		pthread_mutex_unlock(&ss->mutex);
+	}
+
+	pthread_mutex_lock(&video->data_mutex);
+
+	while (video->cache_frames < needed) {
+		struct video_frame *frame;
+		frame = (struct video_frame*)&video->cache[video->cache_frames];
+
+		video_frame_init(frame, video->info.format,
+				video->info.width, video->info.height);
+		video->cache_frames++;
+		video->available_frames++;
+	}
+
+	pthread_mutex_unlock(&video->data_mutex);
+}
+
 int video_output_open(video_t **video, struct video_output_info *info)
 {
 	struct video_output *out;
@@ -259,6 +612,138 @@ fail:
 	return VIDEO_OUTPUT_FAIL;
 }
 
+static inline bool same_conversion(const struct video_scale_info *a,
+		const struct video_scale_info *b)
+{
+	return a->format     == b->format &&
+	       a->width      == b->width &&
+	       a->height     == b->height &&
+	       a->range      == b->range &&
+	       a->colorspace == b->colorspace;
+}
+
+static void shared_scaler_destroy(struct shared_scaler *ss)
+{
+	for (size_t i = 0; i < ss->frames.num; i++)
+		video_frame_free(&ss->frames.array[i].frame);
+	da_free(ss->frames);
+	video_scaler_destroy(ss->scaler);
+	pthread_mutex_destroy(&ss->mutex);
+	bfree(ss);
+}
+
+static struct shared_scaler *shared_scaler_get(struct video_output *video,
+		const struct video_scale_info *conversion)
+{
+	struct video_scale_info from = {
+		.format = video->info.format,
+		.width  = video->info.width,
+		.height = video->info.height,
+		.range = video->info.range,
+		.colorspace = video->info.colorspace
+	};
+	struct shared_scaler *ss;
+	int ret;
+
+	for (size_t i = 0; i < video->scalers.num; i++) {
+		ss = video->scalers.array[i];
+		if (same_conversion(&ss->conversion, conversion)) {
+			ss->refs++;
+			return ss;
+		}
+	}
+
+	ss = bzalloc(sizeof(*ss));
+	ss->conversion = *conversion;
+	ss->refs = 1;
+
+	if (pthread_mutex_init(&ss->mutex, NULL) != 0) {
+		bfree(ss);
+		return NULL;
+	}
+
+	ret = video_scaler_create(&ss->scaler, conversion, &from,
+			VIDEO_SCALE_FAST_BILINEAR);
+	if (ret != VIDEO_SCALER_SUCCESS) {
+		if (ret == VIDEO_SCALER_BAD_CONVERSION)
+			blog(LOG_ERROR, "video_input_init: Bad "
+			                "scale conversion type");
+		else
+			blog(LOG_ERROR, "video_input_init: Failed to "
+			                "create scaler");
+
+		shared_scaler_destroy(ss);
+		return NULL;
+	}
+
+	da_push_back(video->scalers, &ss);
+	return ss;
+}
+
+static void shared_scaler_release(struct video_output *video,
+		struct shared_scaler *ss)
+{
+	pthread_mutex_lock(&video->input_mutex);
+
+	if (--ss->refs == 0) {
+		da_erase_item(video->scalers, &ss);
+		shared_scaler_destroy(ss);
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+}
+
+static void video_input_free(struct video_output *video,
+		struct video_input *input)
+{
+	while (input->queue.size) {
+		struct queued_frame queued;
+		circlebuf_pop_front(&input->queue, &queued, sizeof(queued));
+		release_cached_frame(video, queued.cfi);
+	}
+
+	if (input->scaler)
+		shared_scaler_release(video, input->scaler);
+
+	circlebuf_free(&input->queue);
+	os_sem_destroy(input->queue_semaphore);
+	os_event_destroy(input->queue_space_event);
+	pthread_mutex_destroy(&input->queue_mutex);
+	pthread_mutex_destroy(&input->callback_mutex);
+	bfree(input);
+}
+
+static inline void video_input_join(struct video_output *video,
+		struct video_input *input)
+{
+	if (input->thread_created)
+		pthread_join(input->thread, NULL);
+	video_input_release(video, input);
+}
+
+/* Stops the input thread.  Once this returns, the input's callback will not
+ * be called again.  If this is called from the input's own callback, the
+ * thread is joined when the output is closed instead. */
+static void video_input_stop(struct video_output *video,
+		struct video_input *input)
+{
+	pthread_mutex_lock(&input->callback_mutex);
+	os_atomic_set_bool(&input->stop, true);
+	pthread_mutex_unlock(&input->callback_mutex);
+
+	os_sem_post(input->queue_semaphore);
+	os_event_signal(input->queue_space_event);
+
+	if (input->thread_created &&
+	    pthread_equal(pthread_self(), input->thread)) {
+		pthread_mutex_lock(&video->input_mutex);
+		da_push_back(video->stopped_inputs, &input);
+		pthread_mutex_unlock(&video->input_mutex);
+	} else {
+		video_input_join(video, input);
+	}
+}
+
 void video_output_close(video_t *video)
 {
 	if (!video)
@@ -267,10 +752,16 @@ void video_output_close(video_t *video)
 	video_output_stop(video);
 
 	for (size_t i = 0; i < video->inputs.num; i++)
-		video_input_free(&video->inputs.array[i]);
+		video_input_stop(video, video->inputs.array[i]);
 	da_free(video->inputs);
 
-	for (size_t i = 0; i < video->info.cache_size; i++)
+	for (size_t i = 0; i < video->stopped_inputs.num; i++)
+		video_input_join(video, video->stopped_inputs.array[i]);
+	da_free(video->stopped_inputs);
+	da_free(video->blocked_inputs);
+	da_free(video->scalers);
+
+	for (size_t i = 0; i < video->cache_frames; i++)
 		video_frame_free((struct video_frame*)&video->cache[i]);
 
 	os_sem_destroy(video->update_semaphore);
@@ -284,7 +775,7 @@ static size_t video_get_input_idx(const video_t *video,
 		void *param)
 {
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array+i;
+		struct video_input *input = video->inputs.array[i];
 		if (input->callback == callback && input->param == param)
 			return i;
 	}
@@ -295,38 +786,39 @@ static size_t video_get_input_idx(const video_t *video,
 static inline bool video_input_init(struct video_input *input,
 		struct video_output *video)
 {
+	pthread_mutexattr_t attr;
+
+	input->video = video;
+
 	if (input->conversion.width  != video->info.width ||
 	    input->conversion.height != video->info.height ||
 	    input->conversion.format != video->info.format) {
-		struct video_scale_info from = {
-			.format = video->info.format,
-			.width  = video->info.width,
-			.height = video->info.height,
-			.range = video->info.range,
-			.colorspace = video->info.colorspace
-		};
-
-		int ret = video_scaler_create(&input->scaler,
-				&input->conversion, &from,
-				VIDEO_SCALE_FAST_BILINEAR);
-		if (ret != VIDEO_SCALER_SUCCESS) {
-			if (ret == VIDEO_SCALER_BAD_CONVERSION)
-				blog(LOG_ERROR, "video_input_init: Bad "
-				                "scale conversion type");
-			else
-				blog(LOG_ERROR, "video_input_init: Failed to "
-				                "create scaler");
-
+		input->scaler = shared_scaler_get(video, &input->conversion);
+		if (!input->scaler)
 			return false;
-		}
+	}
 
-		for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-			video_frame_init(&input->frame[i],
-					input->conversion.format,
-					input->conversion.width,
-					input->conversion.height);
+	/* recursive so an input can disconnect itself from its callback */
+	if (pthread_mutexattr_init(&attr) != 0)
+		return false;
+	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
+		return false;
+	if (pthread_mutex_init(&input->callback_mutex, &attr) != 0)
+		return false;
+	if (pthread_mutex_init(&input->queue_mutex, NULL) != 0)
+		return false;
+	if (os_sem_init(&input->queue_semaphore, 0) != 0)
+		return false;
+	if (os_event_init(&input->queue_space_event, OS_EVENT_TYPE_AUTO) != 0)
+		return false;
+	if (pthread_create(&input->thread, NULL, video_input_thread,
+				input) != 0) {
+		blog(LOG_ERROR, "video_input_init: Failed to create input "
+		                "thread");
+		return false;
 	}
 
+	input->thread_created = true;
 	return true;
 }
 
@@ -348,28 +840,37 @@ bool video_output_connect(video_t *video,
 	}
 
 	if (video_get_input_idx(video, callback, param) == DARRAY_INVALID) {
-		struct video_input input;
-		memset(&input, 0, sizeof(input));
+		struct video_input *input = bzalloc(sizeof(*input));
 
-		input.callback = callback;
-		input.param    = param;
+		pthread_mutex_init_value(&input->callback_mutex);
+		pthread_mutex_init_value(&input->queue_mutex);
+
+		input->callback   = callback;
+		input->param      = param;
+		input->refs       = 1;
+		input->max_queued = MAX_QUEUED_FRAMES;
+		input->overflow   = VIDEO_INPUT_DROP_NEWEST;
 
 		if (conversion) {
-			input.conversion = *conversion;
+			input->conversion = *conversion;
 		} else {
-			input.conversion.format    = video->info.format;
-			input.conversion.width     = video->info.width;
-			input.conversion.height    = video->info.height;
+			input->conversion.format    = video->info.format;
+			input->conversion.width     = video->info.width;
+			input->conversion.height    = video->info.height;
 		}
 
-		if (input.conversion.width == 0)
-			input.conversion.width = video->info.width;
-		if (input.conversion.height == 0)
-			input.conversion.height = video->info.height;
+		if (input->conversion.width == 0)
+			input->conversion.width = video->info.width;
+		if (input->conversion.height == 0)
+			input->conversion.height = video->info.height;
 
-		success = video_input_init(&input, video);
-		if (success)
+		success = video_input_init(input, video);
+		if (success) {
 			da_push_back(video->inputs, &input);
+			update_input_buffers(video);
+		} else {
+			video_input_free(video, input);
+		}
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
@@ -381,6 +882,8 @@ void video_output_disconnect(video_t *video,
 		void (*callback)(void *param, struct video_data *frame),
 		void *param)
 {
+	struct video_input *input = NULL;
+
 	if (!video || !callback)
 		return;
 
@@ -388,8 +891,9 @@ void video_output_disconnect(video_t *video,
 
 	size_t idx = video_get_input_idx(video, callback, param);
 	if (idx != DARRAY_INVALID) {
-		video_input_free(video->inputs.array+idx);
+		input = video->inputs.array[idx];
 		da_erase(video->inputs, idx);
+		update_input_buffers(video);
 	}
 
 	if (video->inputs.num == 0) {
@@ -407,6 +911,20 @@ void video_output_disconnect(video_t *video,
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
+
+	if (input) {
+		if (input->dropped_frames)
+			blog(LOG_INFO, "Video input stopped, number of "
+					"frames dropped because the input "
+					"could not keep up: "
+					"%"PRIu32"/%"PRIu32" (%0.1f%%)",
+					input->dropped_frames,
+					input->total_frames,
+					(double)input->dropped_frames /
+					(double)input->total_frames * 100.0);
+
+		video_input_stop(video, input);
+	}
 }
 
 bool video_output_active(const video_t *video)
@@ -420,6 +938,20 @@ const struct video_output_info *video_output_get_info(const video_t *video)
 	return video ? &video->info : NULL;
 }
 
+static inline size_t find_free_frame(const struct video_output *video)
+{
+	size_t idx = video->last_added;
+
+	for (size_t i = 0; i < video->cache_frames; i++) {
+		if (++idx == video->cache_frames)
+			idx = 0;
+		if (video->cache[idx].refs == 0)
+			break;
+	}
+
+	return idx;
+}
+
 bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 		int count, uint64_t timestamp)
 {
@@ -431,20 +963,29 @@ bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 	pthread_mutex_lock(&video->data_mutex);
 
 	if (video->available_frames == 0) {
-		video->cache[video->last_added].count += count;
-		video->cache[video->last_added].skipped += count;
+		cfi = &video->cache[video->last_added];
+
+		/* if the last frame has already been sent out and is only
+		 * being held by inputs, it can no longer be repeated */
+		if (cfi->count) {
+			cfi->count += count;
+			cfi->skipped += count;
+		} else {
+			video->skipped_frames += count;
+			video->total_frames += count;
+		}
 		locked = false;
 
 	} else {
-		if (video->available_frames != video->info.cache_size) {
-			if (++video->last_added == video->info.cache_size)
-				video->last_added = 0;
-		}
+		video->last_added = find_free_frame(video);
+		video->available_frames--;
 
 		cfi = &video->cache[video->last_added];
 		cfi->frame.timestamp = timestamp;
 		cfi->count = count;
 		cfi->skipped = 0;
+		cfi->refs = 1;
+		cfi->generation = ++video->last_generation;
 
 		memcpy(frame, &cfi->frame, sizeof(*frame));
 
@@ -458,11 +999,15 @@ bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 
 void video_output_unlock_frame(video_t *video)
 {
+	size_t idx;
+
 	if (!video) return;
 
 	pthread_mutex_lock(&video->data_mutex);
 
-	video->available_frames--;
+	idx = (video->first_pending + video->num_pending) % MAX_CACHE_SIZE;
+	video->pending[idx] = video->last_added;
+	video->num_pending++;
 	os_sem_post(video->update_semaphore);
 
 	pthread_mutex_unlock(&video->data_mutex);
@@ -528,3 +1073,88 @@ uint32_t video_output_get_total_frames(const video_t *video)
 {
 	return video->total_frames;
 }
+
+static struct video_input *video_get_input(const video_t *video,
+		void (*callback)(void *param, struct video_data *frame),
+		void *param)
+{
+	size_t idx = video_get_input_idx(video, callback, param);
+	return idx != DARRAY_INVALID ? video->inputs.array[idx] : NULL;
+}
+
+size_t video_output_get_input_queued_frames(video_t *video,
+		void (*callback)(void *param, struct video_data *frame),
+		void *param)
+{
+	struct video_input *input;
+	size_t queued = 0;
+
+	if (!video)
+		return 0;
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	input = video_get_input(video, callback, param);
+	if (input) {
+		pthread_mutex_lock(&input->queue_mutex);
+		queued = input->queue.size / sizeof(struct queued_frame);
+		pthread_mutex_unlock(&input->queue_mutex);
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+	return queued;
+}
+
+uint32_t video_output_get_input_dropped_frames(video_t *video,
+		void (*callback)(void *param, struct video_data *frame),
+		void *param)
+{
+	struct video_input *input;
+	uint32_t dropped = 0;
+
+	if (!video)
+		return 0;
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	input = video_get_input(video, callback, param);
+	if (input) {
+		pthread_mutex_lock(&input->queue_mutex);
+		dropped = input->dropped_frames;
+		pthread_mutex_unlock(&input->queue_mutex);
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+	return dropped;
+}
+
+bool video_output_set_input_queue(video_t *video,
+		void (*callback)(void *param, struct video_data *frame),
+		void *param, size_t max_frames,
+		enum video_input_overflow overflow)
+{
+	struct video_input *input;
+
+	if (!video)
+		return false;
+
+	if (max_frames < 1)
+		max_frames = 1;
+	else if (max_frames > MAX_CACHE_SIZE)
+		max_frames = MAX_CACHE_SIZE;
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	input = video_get_input(video, callback, param);
+	if (input) {
+		pthread_mutex_lock(&input->queue_mutex);
+		input->max_queued = max_frames;
+		input->overflow   = overflow;
+		pthread_mutex_unlock(&input->queue_mutex);
+
+		update_input_buffers(video);
+	}
+
+	pthread_mutex_unlock(&video->input_mutex);
+	return input != NULL;
+}
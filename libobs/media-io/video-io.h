@@ -202,6 +202,30 @@ EXPORT double video_output_get_frame_rate(const video_t *video);
 EXPORT uint32_t video_output_get_skipped_frames(const video_t *video);
 EXPORT uint32_t video_output_get_total_frames(const video_t *video);
 
+/* Each input receives frames on its own thread through a short queue.  If an
+ * input cannot keep up, frames are dropped for that input only. */
+EXPORT size_t video_output_get_input_queued_frames(video_t *video,
+		void (*callback)(void *param, struct video_data *frame),
+		void *param);
+EXPORT uint32_t video_output_get_input_dropped_frames(video_t *video,
+		void (*callback)(void *param, struct video_data *frame),
+		void *param);
+
+enum video_input_overflow {
+	VIDEO_INPUT_DROP_NEWEST,
+	VIDEO_INPUT_DROP_OLDEST,
+	VIDEO_INPUT_BLOCK,
+};
+
+/* Sets how many frames an input can queue and what happens to new frames
+ * when its queue is full.  Blocking holds up the video thread, and with it
+ * the next frames of every other input, for up to 100ms before the frame is
+ * dropped.  Frames already queued to other inputs are not held up. */
+EXPORT bool video_output_set_input_queue(video_t *video,
+		void (*callback)(void *param, struct video_data *frame),
+		void *param, size_t max_frames,
+		enum video_input_overflow overflow);
+
 
 #ifdef __cplusplus
 }
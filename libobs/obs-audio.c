@@ -17,6 +17,7 @@
 
 #include <inttypes.h>
 #include "obs-internal.h"
+#include "media-io/audio-mix.h"
 
 struct ts_info {
 	uint64_t start;
@@ -24,7 +25,12 @@ struct ts_info {
 };
 
 #define DEBUG_AUDIO 0
-#define MAX_BUFFERING_TICKS 45
+
+/* adaptive buffering: headroom is measured over a window before lowering the
+ * target, then buffering is dropped one tick per interval toward it */
+#define HEADROOM_WINDOW_MS          10000
+#define HEADROOM_SHRINK_INTERVAL_MS 1000
+#define HEADROOM_MARGIN_NS          5000000ULL
 
 static void push_audio_tree(obs_source_t *parent, obs_source_t *source, void *p)
 {
@@ -35,7 +41,80 @@ static void push_audio_tree(obs_source_t *parent, obs_source_t *source, void *p)
 		da_push_back(audio->render_order, &source);
 	}
 
-	UNUSED_PARAMETER(parent);
+	if (parent) {
+		struct audio_tree_edge edge = {parent, source};
+		da_push_back(audio->render_edges, &edge);
+	}
+}
+
+/* sources only depend on the sources they mix (their children in the active
+ * tree), so a source is rendered one level after the deepest of its
+ * children, and all sources of the same level can render in parallel */
+static size_t calc_render_levels(struct obs_core_audio *audio)
+{
+	size_t max_level = 0;
+	size_t passes = 0;
+	bool changed = true;
+
+	for (size_t i = 0; i < audio->render_order.num; i++)
+		audio->render_order.array[i]->audio_render_level = 0;
+
+	/* the tree can't be deeper than the number of sources */
+	while (changed && passes++ <= audio->render_order.num) {
+		changed = false;
+
+		for (size_t i = 0; i < audio->render_edges.num; i++) {
+			struct audio_tree_edge *edge =
+				audio->render_edges.array + i;
+			size_t level = edge->child->audio_render_level + 1;
+
+			if (edge->parent->audio_render_level < level) {
+				edge->parent->audio_render_level = level;
+				if (level > max_level)
+					max_level = level;
+				changed = true;
+			}
+		}
+	}
+
+	return max_level;
+}
+
+struct audio_render_params {
+	uint32_t mixers;
+	size_t   channels;
+	size_t   sample_rate;
+	size_t   size;
+};
+
+static void render_audio_source(void *param, obs_source_t *source)
+{
+	struct audio_render_params *params = param;
+
+	obs_source_audio_render(source, params->mixers, params->channels,
+			params->sample_rate, params->size);
+}
+
+static void render_audio_sources(struct obs_core_audio *audio,
+		struct audio_render_params *params)
+{
+	struct source_pool *pool = &audio->render_pool;
+	size_t max_level = calc_render_levels(audio);
+
+	for (size_t level = 0; level <= max_level; level++) {
+		da_resize(pool->sources, 0);
+
+		for (size_t i = 0; i < audio->render_order.num; i++) {
+			obs_source_t *source = audio->render_order.array[i];
+			if (source->audio_render_level == level)
+				da_push_back(pool->sources, &source);
+		}
+
+		source_pool_start(pool, render_audio_source, params);
+		source_pool_join(pool);
+	}
+
+	da_resize(pool->sources, 0);
 }
 
 static inline size_t convert_time_to_frames(size_t sample_rate, uint64_t t)
@@ -44,10 +123,10 @@ static inline size_t convert_time_to_frames(size_t sample_rate, uint64_t t)
 }
 
 static inline void mix_audio(struct audio_output_data *mixes,
-		obs_source_t *source, size_t channels, size_t sample_rate,
-		struct ts_info *ts)
+		obs_source_t *source, uint32_t mixers, size_t channels,
+		size_t sample_rate, struct ts_info *ts)
 {
-	size_t total_floats = AUDIO_OUTPUT_FRAMES;
+	size_t total_floats = obs->audio.output_frames;
 	size_t start_point = 0;
 
 	if (source->audio_ts < ts->start || ts->end <= source->audio_ts)
@@ -56,24 +135,22 @@ static inline void mix_audio(struct audio_output_data *mixes,
 	if (source->audio_ts != ts->start) {
 		start_point = convert_time_to_frames(sample_rate,
 				source->audio_ts - ts->start);
-		if (start_point == AUDIO_OUTPUT_FRAMES)
+		if (start_point == obs->audio.output_frames)
 			return;
 
 		total_floats -= start_point;
 	}
 
 	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
-		for (size_t ch = 0; ch < channels; ch++) {
-			register float *mix = mixes[mix_idx].data[ch];
-			register float *aud =
-				source->audio_output_buf[mix_idx][ch];
-			register float *end;
+		/* skip mixes that nothing is connected to */
+		if ((mixers & (1 << mix_idx)) == 0)
+			continue;
 
-			mix += start_point;
-			end = aud + total_floats;
+		for (size_t ch = 0; ch < channels; ch++) {
+			float *mix = mixes[mix_idx].data[ch];
+			float *aud = source->audio_output_buf[mix_idx][ch];
 
-			while (aud < end)
-				*(mix++) += *(aud++);
+			audio_mix_float(mix + start_point, aud, total_floats);
 		}
 	}
 }
@@ -135,13 +212,12 @@ static bool discard_if_stopped(obs_source_t *source, size_t channels)
 	}
 }
 
-#define MAX_AUDIO_SIZE (AUDIO_OUTPUT_FRAMES * sizeof(float))
-
 static inline void discard_audio(struct obs_core_audio *audio,
 		obs_source_t *source, size_t channels, size_t sample_rate,
 		struct ts_info *ts)
 {
-	size_t total_floats = AUDIO_OUTPUT_FRAMES;
+	size_t total_floats = audio->output_frames;
+	size_t max_audio_size = audio->output_frames * sizeof(float);
 	size_t size;
 
 #if DEBUG_AUDIO == 1
@@ -165,7 +241,7 @@ static inline void discard_audio(struct obs_core_audio *audio,
 
 	if (source->audio_ts < (ts->start - 1)) {
 		if (source->audio_pending &&
-		    source->audio_input_buf[0].size < MAX_AUDIO_SIZE &&
+		    source->audio_input_buf[0].size < max_audio_size &&
 		    discard_if_stopped(source, channels))
 			return;
 
@@ -177,7 +253,7 @@ static inline void discard_audio(struct obs_core_audio *audio,
 					source->audio_ts, ts->start);
 		}
 #endif
-		if (audio->total_buffering_ticks == MAX_BUFFERING_TICKS)
+		if (audio->total_buffering_ticks == audio->max_buffering_ticks)
 			ignore_audio(source, channels, sample_rate);
 		return;
 	}
@@ -186,7 +262,7 @@ static inline void discard_audio(struct obs_core_audio *audio,
 	    source->audio_ts != (ts->start - 1)) {
 		size_t start_point = convert_time_to_frames(sample_rate,
 				source->audio_ts - ts->start);
-		if (start_point == AUDIO_OUTPUT_FRAMES) {
+		if (start_point == audio->output_frames) {
 #if DEBUG_AUDIO == 1
 			if (is_audio_source)
 				blog(LOG_DEBUG, "can't discard, start point is "
@@ -226,17 +302,184 @@ static inline void discard_audio(struct obs_core_audio *audio,
 	source->audio_ts = ts->end;
 }
 
+static void signal_buffering_changed(struct obs_core_audio *audio,
+		size_t sample_rate)
+{
+	struct calldata params;
+	uint8_t stack[128];
+	long long frames = (long long)audio->output_frames;
+	long long rate = (long long)sample_rate;
+
+	os_atomic_set_long(&audio->public_buffering_ticks,
+			audio->total_buffering_ticks);
+	os_atomic_set_long(&audio->public_target_ticks,
+			audio->target_buffering_ticks);
+
+	calldata_init_fixed(&params, stack, sizeof(stack));
+	calldata_set_int(&params, "buffering_ms",
+			audio->total_buffering_ticks * frames * 1000 / rate);
+	calldata_set_int(&params, "target_ms",
+			audio->target_buffering_ticks * frames * 1000 / rate);
+
+	signal_handler_signal(obs->signals, "audio_buffering_changed",
+			&params);
+}
+
+static inline void reset_headroom(struct obs_core_audio *audio)
+{
+	audio->headroom_valid = false;
+	audio->min_headroom = 0;
+	audio->headroom_frames = 0;
+}
+
+/* how far past the end of the window being mixed a source has audio queued */
+static uint64_t source_headroom(obs_source_t *source, size_t sample_rate,
+		const struct ts_info *ts)
+{
+	size_t frames = source->audio_input_buf[0].size / sizeof(float);
+	uint64_t buffered_end;
+
+	if (source->audio_pending)
+		return 0;
+
+	buffered_end = source->audio_ts + audio_frames_to_ns(sample_rate,
+			frames);
+	return buffered_end > ts->end ? buffered_end - ts->end : 0;
+}
+
+/* returns UINT64_MAX if no source currently has any audio */
+static uint64_t calc_headroom(struct obs_core_data *data,
+		size_t sample_rate, const struct ts_info *ts)
+{
+	uint64_t min_headroom = UINT64_MAX;
+	struct obs_source *source;
+
+	pthread_mutex_lock(&data->audio_sources_mutex);
+
+	source = data->first_audio_source;
+	while (source) {
+		if (!source->info.audio_render) {
+			pthread_mutex_lock(&source->audio_buf_mutex);
+
+			if (source->audio_ts) {
+				uint64_t headroom = source_headroom(source,
+						sample_rate, ts);
+				if (headroom < min_headroom)
+					min_headroom = headroom;
+			}
+
+			pthread_mutex_unlock(&source->audio_buf_mutex);
+		}
+
+		source = (struct obs_source*)source->next_audio_source;
+	}
+
+	pthread_mutex_unlock(&data->audio_sources_mutex);
+	return min_headroom;
+}
+
+/* returns true if a tick of buffering should be dropped after this tick */
+static bool update_adaptive_buffering(struct obs_core_audio *audio,
+		size_t sample_rate, uint64_t headroom)
+{
+	uint64_t tick_ns = audio_frames_to_ns(sample_rate,
+			audio->output_frames);
+	uint64_t required = tick_ns + HEADROOM_MARGIN_NS;
+	bool shrinking;
+	bool drop = false;
+	size_t period;
+
+	if (!os_atomic_load_bool(&audio->adaptive_buffering) ||
+	    !audio->total_buffering_ticks) {
+		if (audio->target_buffering_ticks !=
+		    audio->total_buffering_ticks) {
+			audio->target_buffering_ticks =
+				audio->total_buffering_ticks;
+			signal_buffering_changed(audio, sample_rate);
+		}
+
+		reset_headroom(audio);
+		return false;
+	}
+
+	if (headroom != UINT64_MAX) {
+		if (!audio->headroom_valid || headroom < audio->min_headroom)
+			audio->min_headroom = headroom;
+		audio->headroom_valid = true;
+	}
+
+	shrinking = audio->target_buffering_ticks <
+		audio->total_buffering_ticks;
+	period = sample_rate * (shrinking ?
+			HEADROOM_SHRINK_INTERVAL_MS : HEADROOM_WINDOW_MS) / 1000;
+
+	audio->headroom_frames += audio->output_frames;
+	if (audio->headroom_frames < period)
+		return false;
+
+	if (audio->headroom_valid && audio->min_headroom >= required) {
+		if (shrinking) {
+			drop = headroom >= required;
+
+		} else {
+			uint64_t spare = (audio->min_headroom -
+					HEADROOM_MARGIN_NS) / tick_ns;
+			int ticks = (int)spare;
+
+			if (spare > (uint64_t)audio->total_buffering_ticks)
+				ticks = audio->total_buffering_ticks;
+
+			audio->target_buffering_ticks =
+				audio->total_buffering_ticks - ticks;
+			signal_buffering_changed(audio, sample_rate);
+		}
+
+	} else if (shrinking) {
+		audio->target_buffering_ticks = audio->total_buffering_ticks;
+		signal_buffering_changed(audio, sample_rate);
+	}
+
+	reset_headroom(audio);
+	return drop;
+}
+
+/* ramps the head or tail of the mixes so that dropping a tick of buffering
+ * doesn't cause an audible discontinuity */
+static void fade_mixes(struct audio_output_data *mixes, uint32_t mixers,
+		size_t channels, size_t frames, bool fade_in)
+{
+	size_t ramp = frames / 4;
+	size_t start = fade_in ? 0 : frames - ramp;
+
+	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+		if ((mixers & (1 << mix_idx)) == 0)
+			continue;
+
+		for (size_t ch = 0; ch < channels; ch++) {
+			float *data = mixes[mix_idx].data[ch] + start;
+
+			for (size_t i = 0; i < ramp; i++) {
+				float vol = fade_in ?
+					(float)i / (float)ramp :
+					(float)(ramp - i) / (float)ramp;
+				data[i] *= vol;
+			}
+		}
+	}
+}
+
 static void add_audio_buffering(struct obs_core_audio *audio,
 		size_t sample_rate, struct ts_info *ts, uint64_t min_ts)
 {
 	struct ts_info new_ts;
 	uint64_t offset;
 	uint64_t frames;
+	size_t output_frames = audio->output_frames;
 	size_t total_ms;
 	size_t ms;
 	int ticks;
 
-	if (audio->total_buffering_ticks == MAX_BUFFERING_TICKS)
+	if (audio->total_buffering_ticks == audio->max_buffering_ticks)
 		return;
 
 	if (!audio->buffering_wait_ticks)
@@ -244,18 +487,19 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 
 	offset = ts->start - min_ts;
 	frames = ns_to_audio_frames(sample_rate, offset);
-	ticks = (int)((frames + AUDIO_OUTPUT_FRAMES - 1) / AUDIO_OUTPUT_FRAMES);
+	ticks = (int)((frames + output_frames - 1) / output_frames);
 
 	audio->total_buffering_ticks += ticks;
 
-	if (audio->total_buffering_ticks >= MAX_BUFFERING_TICKS) {
-		ticks -= audio->total_buffering_ticks - MAX_BUFFERING_TICKS;
-		audio->total_buffering_ticks = MAX_BUFFERING_TICKS;
+	if (audio->total_buffering_ticks >= audio->max_buffering_ticks) {
+		ticks -= audio->total_buffering_ticks -
+			audio->max_buffering_ticks;
+		audio->total_buffering_ticks = audio->max_buffering_ticks;
 		blog(LOG_WARNING, "Max audio buffering reached!");
 	}
 
-	ms = ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
-	total_ms = audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES * 1000 /
+	ms = ticks * output_frames * 1000 / sample_rate;
+	total_ms = audio->total_buffering_ticks * output_frames * 1000 /
 		sample_rate;
 
 	blog(LOG_INFO, "adding %d milliseconds of audio buffering, total "
@@ -269,7 +513,7 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 #endif
 
 	new_ts.start = audio->buffered_ts - audio_frames_to_ns(sample_rate,
-			audio->buffering_wait_ticks * AUDIO_OUTPUT_FRAMES);
+			audio->buffering_wait_ticks * output_frames);
 
 	while (ticks--) {
 		int cur_ticks = ++audio->buffering_wait_ticks;
@@ -277,7 +521,7 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 		new_ts.end = new_ts.start;
 		new_ts.start = audio->buffered_ts - audio_frames_to_ns(
 				sample_rate,
-				cur_ticks * AUDIO_OUTPUT_FRAMES);
+				cur_ticks * output_frames);
 
 #if DEBUG_AUDIO == 1
 		blog(LOG_DEBUG, "add buffered ts: %"PRIu64"-%"PRIu64,
@@ -289,12 +533,16 @@ static void add_audio_buffering(struct obs_core_audio *audio,
 	}
 
 	*ts = new_ts;
+
+	audio->target_buffering_ticks = audio->total_buffering_ticks;
+	reset_headroom(audio);
+	signal_buffering_changed(audio, sample_rate);
 }
 
 static bool audio_buffer_insuffient(struct obs_source *source,
 		size_t sample_rate, uint64_t min_ts)
 {
-	size_t total_floats = AUDIO_OUTPUT_FRAMES;
+	size_t total_floats = obs->audio.output_frames;
 	size_t size;
 
 	if (source->info.audio_render || source->audio_pending ||
@@ -306,7 +554,7 @@ static bool audio_buffer_insuffient(struct obs_source *source,
 	    source->audio_ts != (min_ts - 1)) {
 		size_t start_point = convert_time_to_frames(sample_rate,
 				source->audio_ts - min_ts);
-		if (start_point >= AUDIO_OUTPUT_FRAMES)
+		if (start_point >= total_floats)
 			return false;
 
 		total_floats -= start_point;
@@ -358,6 +606,79 @@ static inline void calc_min_ts(struct obs_core_data *data,
 		find_min_ts(data, min_ts);
 }
 
+static void discard_audio_sources(struct obs_core_audio *audio,
+		struct obs_core_data *data, size_t channels,
+		size_t sample_rate, struct ts_info *ts)
+{
+	struct obs_source *source;
+
+	pthread_mutex_lock(&data->audio_sources_mutex);
+
+	source = data->first_audio_source;
+	while (source) {
+		pthread_mutex_lock(&source->audio_buf_mutex);
+		discard_audio(audio, source, channels, sample_rate, ts);
+		pthread_mutex_unlock(&source->audio_buf_mutex);
+
+		source = (struct obs_source*)source->next_audio_source;
+	}
+
+	pthread_mutex_unlock(&data->audio_sources_mutex);
+}
+
+/* audio encoders timestamp their audio by counting samples from where they
+ * started, so they wouldn't see the jump in the timeline that dropping a tick
+ * causes.  buffering is only lowered while no audio is being encoded. */
+static bool audio_encoders_active(struct obs_core_data *data)
+{
+	struct obs_encoder *encoder;
+	bool active = false;
+
+	pthread_mutex_lock(&data->encoders_mutex);
+
+	encoder = data->first_encoder;
+	while (encoder) {
+		if (encoder->info.type == OBS_ENCODER_AUDIO &&
+		    os_atomic_load_bool(&encoder->active)) {
+			active = true;
+			break;
+		}
+
+		encoder = (struct obs_encoder*)encoder->context.next;
+	}
+
+	pthread_mutex_unlock(&data->encoders_mutex);
+	return active;
+}
+
+/* skips the next buffered window entirely: the sources' data for it is
+ * discarded without being mixed, which lowers the buffering by one tick */
+static void drop_audio_tick(struct obs_core_audio *audio,
+		struct obs_core_data *data, size_t channels,
+		size_t sample_rate)
+{
+	struct ts_info ts;
+	size_t total_ms;
+
+	if (audio->buffered_timestamps.size < sizeof(ts))
+		return;
+
+	circlebuf_peek_front(&audio->buffered_timestamps, &ts, sizeof(ts));
+	discard_audio_sources(audio, data, channels, sample_rate, &ts);
+	circlebuf_pop_front(&audio->buffered_timestamps, NULL, sizeof(ts));
+
+	audio->total_buffering_ticks--;
+
+	total_ms = audio->total_buffering_ticks * audio->output_frames *
+		1000 / sample_rate;
+	blog(LOG_INFO, "removing %d milliseconds of audio buffering, total "
+			"audio buffering is now %d milliseconds",
+			(int)(audio->output_frames * 1000 / sample_rate),
+			(int)total_ms);
+
+	signal_buffering_changed(audio, sample_rate);
+}
+
 static inline void release_audio_sources(struct obs_core_audio *audio)
 {
 	for (size_t i = 0; i < audio->render_order.num; i++)
@@ -376,15 +697,17 @@ bool audio_callback(void *param,
 	struct ts_info ts = {start_ts_in, end_ts_in};
 	size_t audio_size;
 	uint64_t min_ts;
+	bool drop_tick = false;
 
 	da_resize(audio->render_order, 0);
 	da_resize(audio->root_nodes, 0);
+	da_resize(audio->render_edges, 0);
 
 	circlebuf_push_back(&audio->buffered_timestamps, &ts, sizeof(ts));
 	circlebuf_peek_front(&audio->buffered_timestamps, &ts, sizeof(ts));
 	min_ts = ts.start;
 
-	audio_size = AUDIO_OUTPUT_FRAMES * sizeof(float);
+	audio_size = audio->output_frames * sizeof(float);
 
 #if DEBUG_AUDIO == 1
 	blog(LOG_DEBUG, "ts %llu-%llu", ts.start, ts.end);
@@ -408,6 +731,7 @@ bool audio_callback(void *param,
 
 	source = data->first_audio_source;
 	while (source) {
+		obs_source_receive_audio(source);
 		push_audio_tree(NULL, source, audio);
 		source = (struct obs_source*)source->next_audio_source;
 	}
@@ -416,11 +740,11 @@ bool audio_callback(void *param,
 
 	/* ------------------------------------------------ */
 	/* render audio data */
-	for (size_t i = 0; i < audio->render_order.num; i++) {
-		obs_source_t *source = audio->render_order.array[i];
-		obs_source_audio_render(source, mixers, channels, sample_rate,
-				audio_size);
-	}
+	struct audio_render_params params = {
+		mixers, channels, sample_rate, audio_size
+	};
+
+	render_audio_sources(audio, &params);
 
 	/* ------------------------------------------------ */
 	/* get minimum audio timestamp */
@@ -433,6 +757,14 @@ bool audio_callback(void *param,
 	if (min_ts < ts.start)
 		add_audio_buffering(audio, sample_rate, &ts, min_ts);
 
+	/* ------------------------------------------------ */
+	/* check whether buffering can be lowered */
+	if (!audio->buffering_wait_ticks) {
+		uint64_t headroom = calc_headroom(data, sample_rate, &ts);
+		drop_tick = update_adaptive_buffering(audio, sample_rate,
+				headroom) && !audio_encoders_active(data);
+	}
+
 	/* ------------------------------------------------ */
 	/* mix audio */
 	if (!audio->buffering_wait_ticks) {
@@ -445,27 +777,28 @@ bool audio_callback(void *param,
 			pthread_mutex_lock(&source->audio_buf_mutex);
 
 			if (source->audio_output_buf[0][0] && source->audio_ts)
-				mix_audio(mixes, source, channels, sample_rate,
-						&ts);
+				mix_audio(mixes, source, mixers, channels,
+						sample_rate, &ts);
 
 			pthread_mutex_unlock(&source->audio_buf_mutex);
 		}
-	}
-
-	/* ------------------------------------------------ */
-	/* discard audio */
-	pthread_mutex_lock(&data->audio_sources_mutex);
 
-	source = data->first_audio_source;
-	while (source) {
-		pthread_mutex_lock(&source->audio_buf_mutex);
-		discard_audio(audio, source, channels, sample_rate, &ts);
-		pthread_mutex_unlock(&source->audio_buf_mutex);
+		if (audio->fade_in_next) {
+			fade_mixes(mixes, mixers, channels,
+					audio->output_frames, true);
+			audio->fade_in_next = false;
+		}
 
-		source = (struct obs_source*)source->next_audio_source;
+		if (drop_tick) {
+			fade_mixes(mixes, mixers, channels,
+					audio->output_frames, false);
+			audio->fade_in_next = true;
+		}
 	}
 
-	pthread_mutex_unlock(&data->audio_sources_mutex);
+	/* ------------------------------------------------ */
+	/* discard audio */
+	discard_audio_sources(audio, data, channels, sample_rate, &ts);
 
 	/* ------------------------------------------------ */
 	/* release audio sources */
@@ -473,6 +806,9 @@ bool audio_callback(void *param,
 
 	circlebuf_pop_front(&audio->buffered_timestamps, NULL, sizeof(ts));
 
+	if (drop_tick)
+		drop_audio_tick(audio, data, channels, sample_rate);
+
 	*out_ts = ts.start;
 
 	if (audio->buffering_wait_ticks) {
@@ -15,7 +15,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
-#include "obs.h"
+#include "obs-internal.h"
 #include "obs-avc.h"
 #include "util/array-serializer.h"
 
@@ -132,17 +132,22 @@ void obs_parse_avc_packet(struct encoder_packet *avc_packet,
 {
 	struct array_output_data output;
 	struct serializer s;
-	long ref = 1;
+	union {
+		struct packet_header header;
+		uint8_t              bytes[PACKET_HEADER_SIZE];
+	} header = {0};
 
 	array_output_serializer_init(&s, &output);
 	*avc_packet = *src;
 
-	serialize(&s, &ref, sizeof(ref));
+	/* not from the packet pool, freed with bfree once released */
+	header.header.refs = 1;
+	serialize(&s, &header, PACKET_HEADER_SIZE);
 	serialize_avc_data(&s, src->data, src->size, &avc_packet->keyframe,
 			&avc_packet->priority);
 
-	avc_packet->data          = output.bytes.array + sizeof(ref);
-	avc_packet->size          = output.bytes.num - sizeof(ref);
+	avc_packet->data          = output.bytes.array + PACKET_HEADER_SIZE;
+	avc_packet->size          = output.bytes.num - PACKET_HEADER_SIZE;
 	avc_packet->drop_priority = get_drop_priority(avc_packet->priority);
 }
 
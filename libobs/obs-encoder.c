@@ -49,6 +49,7 @@ static bool init_encoder(struct obs_encoder *encoder, const char *name,
 	pthread_mutex_init_value(&encoder->init_mutex);
 	pthread_mutex_init_value(&encoder->callbacks_mutex);
 	pthread_mutex_init_value(&encoder->outputs_mutex);
+	pthread_mutex_init_value(&encoder->stats_mutex);
 
 	if (pthread_mutexattr_init(&attr) != 0)
 		return false;
@@ -63,6 +64,8 @@ static bool init_encoder(struct obs_encoder *encoder, const char *name,
 		return false;
 	if (pthread_mutex_init(&encoder->outputs_mutex, NULL) != 0)
 		return false;
+	if (pthread_mutex_init(&encoder->stats_mutex, NULL) != 0)
+		return false;
 
 	if (encoder->info.get_defaults)
 		encoder->info.get_defaults(encoder->context.settings);
@@ -190,8 +193,21 @@ static void add_connection(struct obs_encoder *encoder)
 		get_video_info(encoder, &info);
 
 		start_raw_video(encoder->media, &info, receive_video, encoder);
+
+		if (encoder->queue_frames)
+			video_output_set_input_queue(encoder->media,
+					receive_video, encoder,
+					encoder->queue_frames,
+					encoder->queue_overflow);
 	}
 
+	pthread_mutex_lock(&encoder->stats_mutex);
+	encoder->last_encode_ns = 0;
+	encoder->avg_encode_ns  = 0;
+	encoder->max_encode_ns  = 0;
+	encoder->avg_latency_ns = 0;
+	pthread_mutex_unlock(&encoder->stats_mutex);
+
 	set_encoder_active(encoder, true);
 }
 
@@ -237,6 +253,7 @@ static void obs_encoder_actually_destroy(obs_encoder_t *encoder)
 		pthread_mutex_destroy(&encoder->init_mutex);
 		pthread_mutex_destroy(&encoder->callbacks_mutex);
 		pthread_mutex_destroy(&encoder->outputs_mutex);
+		pthread_mutex_destroy(&encoder->stats_mutex);
 		obs_context_data_free(&encoder->context);
 		if (encoder->owns_info_id)
 			bfree((void*)encoder->info.id);
@@ -727,6 +744,7 @@ static void send_first_video_packet(struct obs_encoder *encoder,
 		struct encoder_callback *cb, struct encoder_packet *packet)
 {
 	struct encoder_packet first_packet;
+	struct encoder_packet sei_packet;
 	DARRAY(uint8_t)       data;
 	uint8_t               *sei;
 	size_t                size;
@@ -746,14 +764,17 @@ static void send_first_video_packet(struct obs_encoder *encoder,
 	da_push_back_array(data, sei, size);
 	da_push_back_array(data, packet->data, packet->size);
 
-	first_packet      = *packet;
-	first_packet.data = data.array;
-	first_packet.size = data.num;
+	sei_packet      = *packet;
+	sei_packet.data = data.array;
+	sei_packet.size = data.num;
+
+	obs_encoder_packet_create_instance(&first_packet, &sei_packet);
+	da_free(data);
 
 	cb->new_packet(cb->param, &first_packet);
 	cb->sent_first_packet = true;
 
-	da_free(data);
+	obs_encoder_packet_release(&first_packet);
 }
 
 static inline void send_packet(struct obs_encoder *encoder,
@@ -776,6 +797,15 @@ static void full_stop(struct obs_encoder *encoder)
 	}
 }
 
+/* running average over roughly the last 16 values */
+static inline void update_average(uint64_t *avg, uint64_t val)
+{
+	if (*avg)
+		*avg = *avg - *avg / 16 + val / 16;
+	else
+		*avg = val;
+}
+
 static const char *do_encode_name = "do_encode";
 static inline void do_encode(struct obs_encoder *encoder,
 		struct encoder_frame *frame)
@@ -787,17 +817,29 @@ static inline void do_encode(struct obs_encoder *encoder,
 					"encode(%s)", encoder->context.name);
 
 	struct encoder_packet pkt = {0};
+	struct encoder_packet shared_pkt;
 	bool received = false;
 	bool success;
+	uint64_t encode_start;
+	uint64_t encode_ns;
 
 	pkt.timebase_num = encoder->timebase_num;
 	pkt.timebase_den = encoder->timebase_den;
 	pkt.encoder = encoder;
 
 	profile_start(encoder->profile_encoder_encode_name);
+	encode_start = os_gettime_ns();
 	success = encoder->info.encode(encoder->context.data, frame, &pkt,
 			&received);
+	encode_ns = os_gettime_ns() - encode_start;
 	profile_end(encoder->profile_encoder_encode_name);
+
+	pthread_mutex_lock(&encoder->stats_mutex);
+	update_average(&encoder->avg_encode_ns, encode_ns);
+	encoder->last_encode_ns = encode_ns;
+	if (encode_ns > encoder->max_encode_ns)
+		encoder->max_encode_ns = encode_ns;
+	pthread_mutex_unlock(&encoder->stats_mutex);
 	if (!success) {
 		full_stop(encoder);
 		blog(LOG_ERROR, "Error encoding with encoder '%s'",
@@ -817,21 +859,48 @@ static inline void do_encode(struct obs_encoder *encoder,
 			packet_dts_usec(&pkt) - encoder->offset_usec;
 		pkt.sys_dts_usec = pkt.dts_usec;
 
+		/* the packet data belongs to the encoder, so it's copied once
+		 * here and then referenced by every output that keeps it */
+		obs_encoder_packet_create_instance(&shared_pkt, &pkt);
+
 		pthread_mutex_lock(&encoder->callbacks_mutex);
 
 		for (size_t i = encoder->callbacks.num; i > 0; i--) {
 			struct encoder_callback *cb;
 			cb = encoder->callbacks.array+(i-1);
-			send_packet(encoder, cb, &pkt);
+			send_packet(encoder, cb, &shared_pkt);
 		}
 
 		pthread_mutex_unlock(&encoder->callbacks_mutex);
+
+		obs_encoder_packet_release(&shared_pkt);
 	}
 
 error:
 	profile_end(do_encode_name);
 }
 
+/* frames can be dropped before they reach the encoder, so the pts is taken
+ * from the frame's timestamp rather than counted.  a dropped frame then
+ * leaves a gap instead of shifting all following video against the audio */
+static inline int64_t get_frame_pts(struct obs_encoder *encoder,
+		uint64_t timestamp)
+{
+	uint64_t frame_time = video_output_get_frame_time(encoder->media);
+	int64_t pts = encoder->cur_pts;
+
+	if (frame_time && timestamp > encoder->start_ts) {
+		uint64_t frames = (timestamp - encoder->start_ts +
+				frame_time / 2) / frame_time;
+		int64_t frame_pts = (int64_t)frames * encoder->timebase_num;
+
+		if (frame_pts > pts)
+			pts = frame_pts;
+	}
+
+	return pts;
+}
+
 static const char *receive_video_name = "receive_video";
 static void receive_video(void *param, struct video_data *frame)
 {
@@ -859,11 +928,16 @@ static void receive_video(void *param, struct video_data *frame)
 		encoder->start_ts = frame->timestamp;
 
 	enc_frame.frames = 1;
-	enc_frame.pts    = encoder->cur_pts;
+	enc_frame.pts    = get_frame_pts(encoder, frame->timestamp);
 
 	do_encode(encoder, &enc_frame);
 
-	encoder->cur_pts += encoder->timebase_num;
+	pthread_mutex_lock(&encoder->stats_mutex);
+	update_average(&encoder->avg_latency_ns,
+			os_gettime_ns() - frame->timestamp);
+	pthread_mutex_unlock(&encoder->stats_mutex);
+
+	encoder->cur_pts = enc_frame.pts + encoder->timebase_num;
 
 wait_for_audio:
 	profile_end(receive_video_name);
@@ -1042,12 +1116,10 @@ void obs_encoder_remove_output(struct obs_encoder *encoder,
 void obs_encoder_packet_create_instance(struct encoder_packet *dst,
 		const struct encoder_packet *src)
 {
-	long *p_refs;
+	struct packet_pool *pool = obs ? &obs->data.packet_pool : NULL;
 
 	*dst = *src;
-	p_refs = bmalloc(src->size + sizeof(long));
-	dst->data = (void*)(p_refs + 1);
-	*p_refs = 1;
+	dst->data = packet_pool_alloc(pool, src->size);
 	memcpy(dst->data, src->data, src->size);
 }
 
@@ -1069,8 +1141,8 @@ void obs_encoder_packet_ref(struct encoder_packet *dst,
 		return;
 
 	if (src->data) {
-		long *p_refs = ((long*)src->data) - 1;
-		os_atomic_inc_long(p_refs);
+		struct packet_header *header = packet_get_header(src->data);
+		os_atomic_inc_long(&header->refs);
 	}
 
 	*dst = *src;
@@ -1082,14 +1154,47 @@ void obs_encoder_packet_release(struct encoder_packet *pkt)
 		return;
 
 	if (pkt->data) {
-		long *p_refs = ((long*)pkt->data) - 1;
-		if (os_atomic_dec_long(p_refs) == 0)
-			bfree(p_refs);
+		struct packet_header *header = packet_get_header(pkt->data);
+		if (os_atomic_dec_long(&header->refs) == 0)
+			packet_pool_release(pkt->data);
 	}
 
 	memset(pkt, 0, sizeof(struct encoder_packet));
 }
 
+bool obs_encoder_packet_write(FILE *file, const struct encoder_packet *packet)
+{
+	struct encoder_packet record = *packet;
+
+	/* the data pointer isn't valid, the data follows the packet */
+	record.data = NULL;
+
+	if (fwrite(&record, sizeof(record), 1, file) != 1)
+		return false;
+
+	return !packet->size ||
+		fwrite(packet->data, packet->size, 1, file) == 1;
+}
+
+bool obs_encoder_packet_read(FILE *file, struct encoder_packet *packet)
+{
+	struct packet_pool *pool = obs ? &obs->data.packet_pool : NULL;
+	struct encoder_packet record;
+
+	if (fread(&record, sizeof(record), 1, file) != 1)
+		return false;
+
+	record.data = packet_pool_alloc(pool, record.size);
+
+	if (record.size && fread(record.data, record.size, 1, file) != 1) {
+		packet_pool_release(record.data);
+		return false;
+	}
+
+	*packet = record;
+	return true;
+}
+
 void obs_encoder_set_preferred_video_format(obs_encoder_t *encoder,
 		enum video_format format)
 {
@@ -1108,6 +1213,59 @@ enum video_format obs_encoder_get_preferred_video_format(
 	return encoder->preferred_format;
 }
 
+void obs_encoder_set_frame_queue(obs_encoder_t *encoder,
+		size_t max_frames, enum video_input_overflow overflow)
+{
+	if (!obs_encoder_valid(encoder, "obs_encoder_set_frame_queue"))
+		return;
+	if (encoder->info.type != OBS_ENCODER_VIDEO) {
+		blog(LOG_WARNING, "obs_encoder_set_frame_queue: "
+				"encoder '%s' is not a video encoder",
+				obs_encoder_get_name(encoder));
+		return;
+	}
+
+	pthread_mutex_lock(&encoder->init_mutex);
+
+	encoder->queue_frames   = max_frames;
+	encoder->queue_overflow = overflow;
+
+	if (encoder_active(encoder))
+		video_output_set_input_queue(encoder->media, receive_video,
+				encoder, max_frames, overflow);
+
+	pthread_mutex_unlock(&encoder->init_mutex);
+}
+
+void obs_encoder_get_stats(obs_encoder_t *encoder,
+		struct obs_encoder_stats *stats)
+{
+	if (!obs_ptr_valid(stats, "obs_encoder_get_stats"))
+		return;
+
+	memset(stats, 0, sizeof(*stats));
+
+	if (!obs_encoder_valid(encoder, "obs_encoder_get_stats"))
+		return;
+
+	if (encoder->info.type == OBS_ENCODER_VIDEO &&
+	    encoder_active(encoder)) {
+		stats->queued_frames = (uint32_t)
+			video_output_get_input_queued_frames(encoder->media,
+					receive_video, (void*)encoder);
+		stats->dropped_frames =
+			video_output_get_input_dropped_frames(encoder->media,
+					receive_video, (void*)encoder);
+	}
+
+	pthread_mutex_lock(&encoder->stats_mutex);
+	stats->last_encode_ns = encoder->last_encode_ns;
+	stats->avg_encode_ns  = encoder->avg_encode_ns;
+	stats->max_encode_ns  = encoder->max_encode_ns;
+	stats->avg_latency_ns = encoder->avg_latency_ns;
+	pthread_mutex_unlock(&encoder->stats_mutex);
+}
+
 void obs_encoder_addref(obs_encoder_t *encoder)
 {
 	if (!encoder)
@@ -0,0 +1,266 @@
+/******************************************************************************
+    Copyright (C) 2018 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <inttypes.h>
+#include "obs-internal.h"
+
+/* global pool of async frame buffers.  buffers are rounded up to a size
+ * class (four per power of two) so that frames of slightly different sizes
+ * and formats can reuse each other's buffers, and buffers released by one
+ * source can be used by any other. */
+
+#define DEFAULT_POOL_BUDGET    (256ULL * 1024ULL * 1024ULL)
+#define MIN_SIZE_CLASS         4096
+#define MAX_IDLE_TIME_NS       10000000000ULL
+
+/* the size class of a buffer is stored in front of it, padded so that the
+ * data keeps the allocator's alignment */
+#define BUFFER_HEADER_SIZE     64
+
+static inline size_t get_size_class(size_t size)
+{
+	size_t high = MIN_SIZE_CLASS;
+	size_t step;
+
+	if (size <= high)
+		return high;
+
+	while (high < size)
+		high <<= 1;
+
+	step = high / 8;
+	return (size + step - 1) / step * step;
+}
+
+static inline uint8_t *buffer_data(uint8_t *mem)
+{
+	return mem + BUFFER_HEADER_SIZE;
+}
+
+static inline uint8_t *buffer_mem(uint8_t *data)
+{
+	return data - BUFFER_HEADER_SIZE;
+}
+
+static inline size_t buffer_size(uint8_t *data)
+{
+	size_t size;
+	memcpy(&size, buffer_mem(data), sizeof(size));
+	return size;
+}
+
+static inline void free_buffer(struct frame_pool *pool, uint8_t *data)
+{
+	pool->resident_bytes -= buffer_size(data);
+	bfree(buffer_mem(data));
+}
+
+bool frame_pool_init(struct frame_pool *pool)
+{
+	memset(pool, 0, sizeof(*pool));
+	pthread_mutex_init_value(&pool->mutex);
+
+	if (pthread_mutex_init(&pool->mutex, NULL) != 0)
+		return false;
+
+	pool->budget = DEFAULT_POOL_BUDGET;
+	return true;
+}
+
+void frame_pool_free(struct frame_pool *pool)
+{
+	for (size_t i = 0; i < pool->classes.num; i++) {
+		struct frame_pool_class *bucket = pool->classes.array + i;
+
+		for (size_t j = 0; j < bucket->buffers.num; j++)
+			free_buffer(pool, bucket->buffers.array[j].data);
+		da_free(bucket->buffers);
+	}
+
+	if (pool->resident_bytes)
+		blog(LOG_DEBUG, "frame_pool_free: %"PRIu64" bytes of frame "
+				"buffers still in use", pool->resident_bytes);
+
+	da_free(pool->classes);
+	pthread_mutex_destroy(&pool->mutex);
+	memset(pool, 0, sizeof(*pool));
+}
+
+static struct frame_pool_class *get_class(struct frame_pool *pool,
+		size_t size, bool create)
+{
+	struct frame_pool_class *bucket;
+
+	for (size_t i = 0; i < pool->classes.num; i++) {
+		bucket = pool->classes.array + i;
+		if (bucket->size == size)
+			return bucket;
+	}
+
+	if (!create)
+		return NULL;
+
+	bucket = da_push_back_new(pool->classes);
+	bucket->size = size;
+	return bucket;
+}
+
+/* frees the idle buffer that has been idle the longest, if any */
+static bool free_oldest_buffer(struct frame_pool *pool)
+{
+	struct frame_pool_class *oldest = NULL;
+
+	for (size_t i = 0; i < pool->classes.num; i++) {
+		struct frame_pool_class *bucket = pool->classes.array + i;
+
+		if (!bucket->buffers.num)
+			continue;
+		if (!oldest || bucket->buffers.array[0].release_time <
+		               oldest->buffers.array[0].release_time)
+			oldest = bucket;
+	}
+
+	if (!oldest)
+		return false;
+
+	pool->idle_bytes -= oldest->size;
+	free_buffer(pool, oldest->buffers.array[0].data);
+	da_erase(oldest->buffers, 0);
+	return true;
+}
+
+static void free_expired_buffers(struct frame_pool *pool, uint64_t time)
+{
+	for (size_t i = 0; i < pool->classes.num; i++) {
+		struct frame_pool_class *bucket = pool->classes.array + i;
+
+		while (bucket->buffers.num &&
+		       time - bucket->buffers.array[0].release_time >
+		       MAX_IDLE_TIME_NS) {
+			pool->idle_bytes -= bucket->size;
+			free_buffer(pool, bucket->buffers.array[0].data);
+			da_erase(bucket->buffers, 0);
+		}
+	}
+}
+
+uint8_t *frame_pool_alloc(struct frame_pool *pool, size_t size)
+{
+	struct frame_pool_class *bucket;
+	uint8_t *data = NULL;
+	size_t class_size = get_size_class(size);
+	uint64_t time = os_gettime_ns();
+
+	pthread_mutex_lock(&pool->mutex);
+
+	bucket = get_class(pool, class_size, false);
+	if (bucket && bucket->buffers.num) {
+		data = bucket->buffers.array[bucket->buffers.num - 1].data;
+		da_pop_back(bucket->buffers);
+		pool->idle_bytes -= class_size;
+		pool->hits++;
+	} else {
+		pool->misses++;
+		pool->resident_bytes += class_size;
+	}
+
+	free_expired_buffers(pool, time);
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	if (!data) {
+		uint8_t *mem = bmalloc(BUFFER_HEADER_SIZE + class_size);
+		memcpy(mem, &class_size, sizeof(class_size));
+		data = buffer_data(mem);
+	}
+
+	return data;
+}
+
+void frame_pool_release(struct frame_pool *pool, uint8_t *data)
+{
+	struct frame_pool_buffer buffer;
+	size_t size;
+
+	if (!data)
+		return;
+
+	size = buffer_size(data);
+	buffer.data = data;
+	buffer.release_time = os_gettime_ns();
+
+	pthread_mutex_lock(&pool->mutex);
+
+	free_expired_buffers(pool, buffer.release_time);
+
+	while (pool->idle_bytes + size > pool->budget) {
+		if (!free_oldest_buffer(pool))
+			break;
+	}
+
+	if (pool->idle_bytes + size <= pool->budget) {
+		struct frame_pool_class *bucket = get_class(pool, size, true);
+		da_push_back(bucket->buffers, &buffer);
+		pool->idle_bytes += size;
+	} else {
+		free_buffer(pool, data);
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+
+void obs_get_frame_pool_stats(struct obs_frame_pool_stats *stats)
+{
+	struct frame_pool *pool;
+
+	if (!stats)
+		return;
+
+	memset(stats, 0, sizeof(*stats));
+	if (!obs)
+		return;
+
+	pool = &obs->data.frame_pool;
+
+	pthread_mutex_lock(&pool->mutex);
+	stats->hits           = pool->hits;
+	stats->misses         = pool->misses;
+	stats->resident_bytes = pool->resident_bytes;
+	stats->idle_bytes     = pool->idle_bytes;
+	stats->budget         = pool->budget;
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void obs_set_frame_pool_budget(uint64_t bytes)
+{
+	struct frame_pool *pool;
+
+	if (!obs)
+		return;
+
+	pool = &obs->data.frame_pool;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->budget = bytes;
+	while (pool->idle_bytes > pool->budget) {
+		if (!free_oldest_buffer(pool))
+			break;
+	}
+	pthread_mutex_unlock(&pool->mutex);
+}
@@ -20,6 +20,7 @@
 #include "util/c99defs.h"
 #include "util/darray.h"
 #include "util/circlebuf.h"
+#include "util/spsc-ring.h"
 #include "util/dstr.h"
 #include "util/threading.h"
 #include "util/platform.h"
@@ -225,6 +226,132 @@ struct obs_vframe_info {
 	int count;
 };
 
+/* rolling window of frame timing samples, in nanoseconds */
+#define FRAME_TIMING_WINDOW 600
+
+struct frame_timing_samples {
+	uint64_t                        samples[FRAME_TIMING_WINDOW];
+	size_t                          pos;
+	size_t                          num;
+};
+
+/* runs a function for each source in a batch on a set of worker threads,
+ * see obs-source-pool.c */
+struct source_pool {
+	DARRAY(pthread_t)               threads;
+	const char                      *thread_name;
+
+	/* batch, only modified by the owner while no batch is running */
+	DARRAY(struct obs_source*)      sources;
+	void                            (*func)(void *param,
+	                                        struct obs_source *source);
+	void                            *param;
+	size_t                          next;
+	size_t                          completed;
+	bool                            running;
+	bool                            stop;
+
+	pthread_mutex_t                 mutex;
+	os_sem_t                        *start_sem;
+	os_event_t                      *done_event;
+};
+
+extern bool source_pool_init(struct source_pool *pool,
+		const char *thread_name, int max_threads);
+extern void source_pool_free(struct source_pool *pool);
+extern void source_pool_start(struct source_pool *pool,
+		void (*func)(void *param, struct obs_source *source),
+		void *param);
+extern void source_pool_join(struct source_pool *pool);
+
+/* ------------------------------------------------------------------------- */
+/* async frame buffer pool */
+
+struct frame_pool_buffer {
+	uint8_t                         *data;
+	uint64_t                        release_time;
+};
+
+/* idle buffers of one size class, most recently released last */
+struct frame_pool_class {
+	size_t                          size;
+	DARRAY(struct frame_pool_buffer) buffers;
+};
+
+struct frame_pool {
+	pthread_mutex_t                 mutex;
+	DARRAY(struct frame_pool_class) classes;
+
+	uint64_t                        budget;
+	uint64_t                        idle_bytes;
+	uint64_t                        resident_bytes;
+	uint64_t                        hits;
+	uint64_t                        misses;
+};
+
+extern bool frame_pool_init(struct frame_pool *pool);
+extern void frame_pool_free(struct frame_pool *pool);
+extern uint8_t *frame_pool_alloc(struct frame_pool *pool, size_t size);
+extern void frame_pool_release(struct frame_pool *pool, uint8_t *data);
+
+/* ------------------------------------------------------------------------- */
+/* encoder packet buffer pool */
+
+#define PACKET_POOL_CLASSES    13
+#define PACKET_POOL_MAX_SLABS  256
+
+struct packet_pool;
+struct packet_pool_class;
+
+/* stored in front of the data of every refcounted encoder packet.  buffers
+ * that weren't allocated from the pool have no pool class and are freed with
+ * bfree when released. */
+struct packet_header {
+	struct packet_pool_class        *pool_class;
+	long                            slot;
+	volatile long                   next_free;
+	volatile long                   refs;
+};
+
+#define PACKET_HEADER_SIZE 32
+
+static inline struct packet_header *packet_get_header(uint8_t *data)
+{
+	return (struct packet_header*)(data - PACKET_HEADER_SIZE);
+}
+
+/* buffers are allocated in slabs that are kept until shutdown, up to a total
+ * budget.  free buffers are kept in a lock-free stack, its head holds the
+ * index of the top buffer plus one along with a tag to detect concurrent pops
+ * and pushes */
+struct packet_pool_class {
+	size_t                          size;
+	size_t                          stride;
+	long                            slab_buffers;
+	long                            max_slabs;
+	struct packet_pool              *pool;
+
+	uint8_t                         *slabs[PACKET_POOL_MAX_SLABS];
+	volatile long                   num_slabs;
+	volatile long                   free_head;
+};
+
+struct packet_pool {
+	pthread_mutex_t                 grow_mutex;
+	struct packet_pool_class        classes[PACKET_POOL_CLASSES];
+
+	volatile long                   hits;
+	volatile long                   misses;
+	volatile long                   unpooled;
+	volatile long                   in_use;
+	uint64_t                        resident_bytes;
+};
+
+extern bool packet_pool_init(struct packet_pool *pool);
+extern void packet_pool_free(struct packet_pool *pool);
+extern uint8_t *packet_pool_alloc(struct packet_pool *pool, size_t size);
+extern void packet_pool_release(uint8_t *data);
+
 struct obs_core_video {
 	graphics_t                      *graphics;
 	gs_stagesurf_t                  *copy_surfaces[NUM_TEXTURES];
@@ -259,6 +386,16 @@ struct obs_core_video {
 	uint32_t                        lagged_frames;
 	bool                            thread_initialized;
 
+	pthread_mutex_t                 frame_timing_mutex;
+	struct frame_timing_samples     frame_timing[OBS_FRAME_TIMING_TYPES];
+
+	pthread_mutex_t                 render_cache_mutex;
+	struct obs_render_cache_stats   render_cache_stats;
+
+	/* runs the video_tick callbacks of OBS_SOURCE_PARALLEL_TICK sources */
+	struct source_pool              tick_pool;
+	float                           tick_seconds;
+
 	bool                            gpu_conversion;
 	const char                      *conversion_tech;
 	uint32_t                        conversion_height;
@@ -289,16 +426,44 @@ struct obs_core_video {
 
 struct audio_monitor;
 
+struct audio_tree_edge {
+	struct obs_source               *parent;
+	struct obs_source               *child;
+};
+
 struct obs_core_audio {
 	audio_t                         *audio;
 
 	DARRAY(struct obs_source*)      render_order;
 	DARRAY(struct obs_source*)      root_nodes;
+	DARRAY(struct audio_tree_edge)  render_edges;
+
+	/* renders sources of the same render level in parallel */
+	struct source_pool              render_pool;
 
 	uint64_t                        buffered_ts;
 	struct circlebuf                buffered_timestamps;
 	int                             buffering_wait_ticks;
 	int                             total_buffering_ticks;
+	int                             max_buffering_ticks;
+
+	/* adaptive buffering: the smallest amount of data the sources had
+	 * queued past the window being mixed, over the current measuring
+	 * period.  buffering is only lowered toward target_buffering_ticks
+	 * while that headroom stays above a full tick. */
+	volatile bool                   adaptive_buffering;
+	bool                            headroom_valid;
+	uint64_t                        min_headroom;
+	size_t                          headroom_frames;
+	int                             target_buffering_ticks;
+	bool                            fade_in_next;
+
+	/* buffering info readable from other threads */
+	volatile long                   public_buffering_ticks;
+	volatile long                   public_target_ticks;
+
+	/* frames per audio tick */
+	uint32_t                        output_frames;
 
 	float                           user_volume;
 
@@ -333,6 +498,10 @@ struct obs_core_data {
 
 	obs_data_t                      *private_data;
 
+	/* buffers of cached async source frames */
+	struct frame_pool               frame_pool;
+	struct packet_pool              packet_pool;
+
 	volatile bool                   valid;
 };
 
@@ -405,8 +574,14 @@ extern struct obs_core *obs;
 
 extern void *obs_graphics_thread(void *param);
 
+extern bool obs_init_tick_pool(void);
+extern void obs_free_tick_pool(void);
+
 extern gs_effect_t *obs_load_effect(gs_effect_t **effect, const char *file);
 
+/* maximum amount of audio buffering, about a second at 48khz */
+#define MAX_BUFFERING_FRAMES (45 * AUDIO_OUTPUT_FRAMES)
+
 extern bool audio_callback(void *param,
 		uint64_t start_ts_in, uint64_t end_ts_in, uint64_t *out_ts,
 		uint32_t mixers, struct audio_output_data *mixes);
@@ -553,6 +728,9 @@ struct obs_source {
 	/* signals to call the source update in the video thread */
 	bool                            defer_update;
 
+	/* incremented whenever the output of a static video source changes */
+	volatile long                   video_version;
+
 	/* ensures show/hide are only called once */
 	volatile long                   show_refs;
 
@@ -585,6 +763,7 @@ struct obs_source {
 	bool                            audio_failed;
 	bool                            audio_pending;
 	bool                            pending_stop;
+	size_t                          audio_render_level;
 	bool                            user_muted;
 	bool                            muted;
 	struct obs_source               *next_audio_source;
@@ -592,6 +771,13 @@ struct obs_source {
 	uint64_t                        audio_ts;
 	struct circlebuf                audio_input_buf[MAX_AUDIO_CHANNELS];
 	size_t                          last_audio_input_buf_size;
+
+	/* audio output by the source is queued here without locking and is
+	 * moved to audio_input_buf by the audio thread every tick */
+	struct spsc_ring                audio_ring;
+	bool                            audio_ring_overflowed;
+	volatile long                   audio_overflows;
+	volatile long                   audio_underflows;
 	DARRAY(struct audio_action)     audio_actions;
 	float                           *audio_output_buf[MAX_AUDIO_MIXES][MAX_AUDIO_CHANNELS];
 	struct resample_info            sample_info;
@@ -765,9 +951,12 @@ static inline enum gs_color_format convert_video_format(
 extern void obs_source_activate(obs_source_t *source, enum view_type type);
 extern void obs_source_deactivate(obs_source_t *source, enum view_type type);
 extern void obs_source_video_tick(obs_source_t *source, float seconds);
+extern void obs_source_video_tick_internal(obs_source_t *source, float seconds,
+		bool call_tick);
 extern float obs_source_get_target_volume(obs_source_t *source,
 		obs_source_t *target);
 
+extern void obs_source_receive_audio(obs_source_t *source);
 extern void obs_source_audio_render(obs_source_t *source, uint32_t mixers,
 		size_t channels, size_t sample_rate, size_t size);
 
@@ -805,8 +994,80 @@ struct delay_data {
 	struct encoder_packet packet;
 };
 
+/* delay data past the memory limit is appended to a series of files, and
+ * read back in order once the data in memory runs low.  the files are only
+ * touched by the spool thread, so the encoder thread never waits on disk
+ * I/O; everything else is protected by delay_mutex. */
+struct delay_spool {
+	pthread_t                       thread;
+	bool                            thread_active;
+	os_event_t                      *event;
+	volatile bool                   stop;
+
+	struct dstr                     base_path;
+	FILE                            *write_file;
+	FILE                            *read_file;
+	uint32_t                        write_segment;
+	uint32_t                        read_segment;
+	uint64_t                        write_size;
+
+	/* data waiting to be written, and how much data is spooled in total:
+	 * waiting, on disk or being read back */
+	struct circlebuf                write_queue; /* struct delay_data */
+	size_t                          queued;
+	size_t                          records;
+	bool                            failed;
+
+	/* packet data waiting to be written, and an event signaled as it's
+	 * written for threads waiting on a full write queue */
+	uint64_t                        queued_bytes;
+	os_event_t                      *written_event;
+
+	uint64_t                        spooled_bytes;
+	uint64_t                        bytes_written;
+	uint64_t                        bytes_read;
+	uint32_t                        segments;
+	uint32_t                        errors;
+};
+
 typedef void (*encoded_callback_t)(void *data, struct encoder_packet *packet);
 
+/* ------------------------------------------------------------------------- */
+/* packet interleaving */
+
+/* track 0 is video, the rest are the audio tracks */
+#define INTERLEAVE_TRACKS (1 + MAX_AUDIO_MIXES)
+
+/* keeps encoder packets ordered by dts_usec.  each track has its own queue,
+ * which packets almost always arrive at in order, and a heap of the tracks
+ * ordered by their first packet gives the next packet.  packets of the same
+ * time are ordered video first, then by audio track. */
+struct interleaver {
+	struct circlebuf                tracks[INTERLEAVE_TRACKS];
+	size_t                          heap[INTERLEAVE_TRACKS];
+	size_t                          heap_size;
+	size_t                          num_packets;
+};
+
+extern void interleaver_free(struct interleaver *il);
+extern void interleaver_push(struct interleaver *il,
+		const struct encoder_packet *packet);
+extern struct encoder_packet *interleaver_peek(struct interleaver *il);
+extern void interleaver_pop(struct interleaver *il,
+		struct encoder_packet *packet);
+extern struct encoder_packet *interleaver_first(struct interleaver *il,
+		enum obs_encoder_type type, size_t audio_idx);
+extern struct encoder_packet *interleaver_last(struct interleaver *il,
+		enum obs_encoder_type type, size_t audio_idx);
+extern void interleaver_discard_before(struct interleaver *il,
+		const struct encoder_packet *packet);
+extern void interleaver_discard_until(struct interleaver *il,
+		int64_t dts_usec);
+extern void interleaver_for_each(struct interleaver *il,
+		void (*callback)(void *param, struct encoder_packet *packet),
+		void *param);
+extern void interleaver_reorder(struct interleaver *il);
+
 struct obs_weak_output {
 	struct obs_weak_ref ref;
 	struct obs_output *output;
@@ -838,7 +1099,7 @@ struct obs_output {
 	pthread_t                       end_data_capture_thread;
 	os_event_t                      *stopping_event;
 	pthread_mutex_t                 interleaved_mutex;
-	DARRAY(struct encoder_packet)   interleaved_packets;
+	struct interleaver              interleaved_packets;
 	int                             stop_code;
 
 	int                             reconnect_retry_sec;
@@ -890,6 +1151,14 @@ struct obs_output {
 	volatile bool                   delay_active;
 	volatile bool                   delay_capturing;
 
+	/* packet data of delay_data, limited to delay_max_memory if a spool
+	 * directory is set */
+	uint64_t                        delay_memory;
+	uint64_t                        delay_peak_memory;
+	uint64_t                        delay_max_memory;
+	char                            *delay_spool_dir;
+	struct delay_spool              delay_spool;
+
 	char                            *last_error_message;
 };
 
@@ -989,6 +1258,18 @@ struct obs_encoder {
 	pthread_mutex_t                 callbacks_mutex;
 	DARRAY(struct encoder_callback) callbacks;
 
+	/* size and overflow policy of the video input queue, 0 frames uses
+	 * the video-io default */
+	size_t                          queue_frames;
+	enum video_input_overflow       queue_overflow;
+
+	/* written on the encoding thread, read by obs_encoder_get_stats */
+	pthread_mutex_t                 stats_mutex;
+	uint64_t                        last_encode_ns;
+	uint64_t                        avg_encode_ns;
+	uint64_t                        max_encode_ns;
+	uint64_t                        avg_latency_ns;
+
 	const char                      *profile_encoder_encode_name;
 };
 
@@ -28,6 +28,486 @@ static inline bool delay_capturing(const struct obs_output *output)
 	return os_atomic_load_bool(&output->delay_capturing);
 }
 
+/* ------------------------------------------------------------------------- */
+/* disk spool */
+
+#define SPOOL_SEGMENT_SIZE (64ULL * 1024ULL * 1024ULL)
+
+/* packets are written after the record with obs_encoder_packet_write */
+struct spool_record {
+	uint32_t              msg;
+	uint32_t              reserved;
+	uint64_t              ts;
+};
+
+static inline size_t delay_data_size(const struct delay_data *dd)
+{
+	return dd->msg == DELAY_MSG_PACKET ? dd->packet.size : 0;
+}
+
+static inline uint64_t spool_record_size(const struct delay_data *dd)
+{
+	uint64_t size = sizeof(struct spool_record);
+	if (dd->msg == DELAY_MSG_PACKET)
+		size += sizeof(struct encoder_packet) + dd->packet.size;
+	return size;
+}
+
+static inline void get_segment_path(struct delay_spool *spool,
+		uint32_t segment, struct dstr *path)
+{
+	dstr_printf(path, "%s-%"PRIu32".spool", spool->base_path.array,
+			segment);
+}
+
+/* a quarter of the memory limit is set aside for data waiting to be written
+ * to the spool, the rest is for delayed data held in memory */
+static inline uint64_t queue_limit(const struct obs_output *output)
+{
+	return output->delay_max_memory / 4;
+}
+
+static inline uint64_t memory_limit(const struct obs_output *output)
+{
+	return output->delay_max_memory - queue_limit(output);
+}
+
+static inline void update_peak_memory(struct obs_output *output)
+{
+	uint64_t memory = output->delay_memory +
+		output->delay_spool.queued_bytes;
+
+	if (memory > output->delay_peak_memory)
+		output->delay_peak_memory = memory;
+}
+
+static inline void push_memory(struct obs_output *output,
+		struct delay_data *dd)
+{
+	circlebuf_push_back(&output->delay_data, dd, sizeof(*dd));
+
+	output->delay_memory += delay_data_size(dd);
+	update_peak_memory(output);
+}
+
+/* the functions below that access the spool files are only called from the
+ * spool thread, or after it has been stopped */
+
+static bool open_write_segment(struct obs_output *output)
+{
+	struct delay_spool *spool = &output->delay_spool;
+	struct dstr path = {0};
+
+	get_segment_path(spool, spool->write_segment, &path);
+	spool->write_file = os_fopen(path.array, "wb");
+	spool->write_size = 0;
+
+	if (spool->write_file) {
+		pthread_mutex_lock(&output->delay_mutex);
+		spool->segments++;
+		pthread_mutex_unlock(&output->delay_mutex);
+	} else {
+		blog(LOG_WARNING, "Output '%s': Failed to create delay spool "
+				"file '%s'", output->context.name, path.array);
+	}
+
+	dstr_free(&path);
+	return spool->write_file != NULL;
+}
+
+static bool spool_write(struct obs_output *output, struct delay_data *dd)
+{
+	struct delay_spool *spool = &output->delay_spool;
+	struct spool_record record = {0};
+	bool success;
+
+	if (!spool->write_file && !open_write_segment(output))
+		return false;
+
+	record.msg = (uint32_t)dd->msg;
+	record.ts  = dd->ts;
+
+	success = fwrite(&record, sizeof(record), 1, spool->write_file) == 1;
+	if (success && dd->msg == DELAY_MSG_PACKET)
+		success = obs_encoder_packet_write(spool->write_file,
+				&dd->packet);
+
+	if (!success) {
+		blog(LOG_WARNING, "Output '%s': Failed to write to delay "
+				"spool", output->context.name);
+		return false;
+	}
+
+	spool->write_size += spool_record_size(dd);
+
+	/* rotate segments so that read segments can be deleted */
+	if (spool->write_size >= SPOOL_SEGMENT_SIZE) {
+		fclose(spool->write_file);
+		spool->write_file = NULL;
+		spool->write_segment++;
+	}
+
+	return true;
+}
+
+static bool spool_read(struct obs_output *output, struct delay_data *dd)
+{
+	struct delay_spool *spool = &output->delay_spool;
+	struct spool_record record;
+	struct dstr path = {0};
+
+	if (spool->read_segment == spool->write_segment && spool->write_file)
+		fflush(spool->write_file);
+
+	for (;;) {
+		if (!spool->read_file) {
+			get_segment_path(spool, spool->read_segment, &path);
+			spool->read_file = os_fopen(path.array, "rb");
+			if (!spool->read_file)
+				goto fail;
+		}
+
+		clearerr(spool->read_file);
+		if (fread(&record, sizeof(record), 1, spool->read_file) == 1)
+			break;
+
+		/* end of a finished segment, delete it and go to the next */
+		if (spool->read_segment == spool->write_segment)
+			goto fail;
+
+		fclose(spool->read_file);
+		spool->read_file = NULL;
+
+		get_segment_path(spool, spool->read_segment++, &path);
+		os_unlink(path.array);
+	}
+
+	dd->msg = (enum delay_msg)record.msg;
+	dd->ts  = record.ts;
+
+	if (dd->msg == DELAY_MSG_PACKET &&
+	    !obs_encoder_packet_read(spool->read_file, &dd->packet))
+		goto fail;
+
+	dstr_free(&path);
+	return true;
+
+fail:
+	dstr_free(&path);
+	return false;
+}
+
+/* closes and deletes all spool files */
+static void spool_remove_files(struct obs_output *output)
+{
+	struct delay_spool *spool = &output->delay_spool;
+	struct dstr path = {0};
+
+	if (spool->write_file)
+		fclose(spool->write_file);
+	if (spool->read_file)
+		fclose(spool->read_file);
+	spool->write_file = NULL;
+	spool->read_file  = NULL;
+
+	if (!dstr_is_empty(&spool->base_path)) {
+		for (uint32_t i = spool->read_segment;
+		     i <= spool->write_segment; i++) {
+			get_segment_path(spool, i, &path);
+			if (os_file_exists(path.array))
+				os_unlink(path.array);
+		}
+	}
+
+	dstr_free(&path);
+
+	spool->write_segment = 0;
+	spool->read_segment  = 0;
+	spool->write_size    = 0;
+}
+
+/* reads the oldest spooled data back in to memory.  if that fails, the rest
+ * of the data on disk is dropped. */
+static bool load_spooled_data(struct obs_output *output)
+{
+	struct delay_spool *spool = &output->delay_spool;
+	struct delay_data dd = {0};
+	size_t size;
+
+	if (!spool_read(output, &dd)) {
+		pthread_mutex_lock(&output->delay_mutex);
+		blog(LOG_WARNING, "Output '%s': Failed to read from delay "
+				"spool, dropping %"PRIu64" bytes of delayed "
+				"data", output->context.name,
+				spool->spooled_bytes);
+		spool->errors++;
+		spool->queued       -= spool->records;
+		spool->records       = 0;
+		spool->spooled_bytes = 0;
+		pthread_mutex_unlock(&output->delay_mutex);
+
+		spool_remove_files(output);
+		return false;
+	}
+
+	size = delay_data_size(&dd);
+
+	pthread_mutex_lock(&output->delay_mutex);
+	spool->queued--;
+	spool->records--;
+	spool->spooled_bytes -= size;
+	spool->bytes_read    += spool_record_size(&dd);
+	push_memory(output, &dd);
+	pthread_mutex_unlock(&output->delay_mutex);
+	return true;
+}
+
+/* if the spool can't be written to, everything in it is loaded back in to
+ * memory so that the data stays in order, even though that can exceed the
+ * memory limit.  spooling stays off until the delay is restarted. */
+static void unspool_all(struct obs_output *output,
+		struct delay_data *unwritten)
+{
+	struct delay_spool *spool = &output->delay_spool;
+	struct delay_data dd;
+
+	while (spool->records && load_spooled_data(output));
+
+	pthread_mutex_lock(&output->delay_mutex);
+
+	spool->errors++;
+	spool->failed = true;
+
+	push_memory(output, unwritten);
+	spool->queued--;
+
+	while (spool->write_queue.size) {
+		circlebuf_pop_front(&spool->write_queue, &dd, sizeof(dd));
+		push_memory(output, &dd);
+		spool->queued--;
+	}
+
+	spool->queued_bytes = 0;
+	os_event_signal(spool->written_event);
+
+	pthread_mutex_unlock(&output->delay_mutex);
+
+	spool_remove_files(output);
+}
+
+static void write_queued_data(struct obs_output *output)
+{
+	struct delay_spool *spool = &output->delay_spool;
+	struct delay_data dd;
+	size_t size;
+
+	for (;;) {
+		pthread_mutex_lock(&output->delay_mutex);
+		if (!spool->write_queue.size) {
+			pthread_mutex_unlock(&output->delay_mutex);
+			break;
+		}
+		circlebuf_pop_front(&spool->write_queue, &dd, sizeof(dd));
+		pthread_mutex_unlock(&output->delay_mutex);
+
+		if (!spool_write(output, &dd)) {
+			unspool_all(output, &dd);
+			break;
+		}
+
+		size = delay_data_size(&dd);
+
+		pthread_mutex_lock(&output->delay_mutex);
+		spool->records++;
+		spool->spooled_bytes += size;
+		spool->queued_bytes  -= size;
+		spool->bytes_written += spool_record_size(&dd);
+		os_event_signal(spool->written_event);
+		pthread_mutex_unlock(&output->delay_mutex);
+
+		if (dd.msg == DELAY_MSG_PACKET)
+			obs_encoder_packet_release(&dd.packet);
+	}
+}
+
+static inline bool needs_refill(struct obs_output *output)
+{
+	bool refill;
+
+	pthread_mutex_lock(&output->delay_mutex);
+	refill = output->delay_spool.records &&
+		(output->delay_memory < memory_limit(output) ||
+		 !output->delay_data.size);
+	pthread_mutex_unlock(&output->delay_mutex);
+
+	return refill;
+}
+
+/* writes queued data to disk, and loads spooled data back in to memory so
+ * it's ready before it's needed */
+static void *delay_spool_thread(void *data)
+{
+	struct obs_output *output = data;
+	struct delay_spool *spool = &output->delay_spool;
+
+	os_set_thread_name("libobs: delay spool thread");
+
+	while (os_event_wait(spool->event) == 0) {
+		if (os_atomic_load_bool(&spool->stop))
+			break;
+
+		write_queued_data(output);
+
+		while (needs_refill(output) && load_spooled_data(output));
+	}
+
+	return NULL;
+}
+
+/* must be called with delay_mutex locked */
+static void start_spool_thread(struct obs_output *output)
+{
+	struct delay_spool *spool = &output->delay_spool;
+
+	if (spool->thread_active || !output->delay_spool_dir ||
+	    !output->delay_max_memory)
+		return;
+
+	os_mkdirs(output->delay_spool_dir);
+	dstr_printf(&spool->base_path, "%s/obs-delay-%p-%"PRIu64,
+			output->delay_spool_dir, output, os_gettime_ns());
+
+	spool->stop   = false;
+	spool->failed = false;
+
+	if (os_event_init(&spool->event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+
+	if (pthread_create(&spool->thread, NULL, delay_spool_thread,
+				output) != 0) {
+		os_event_destroy(spool->event);
+		spool->event = NULL;
+		goto fail;
+	}
+
+	spool->thread_active = true;
+	return;
+
+fail:
+	blog(LOG_WARNING, "Output '%s': Failed to create delay spool thread, "
+			"keeping delayed data in memory",
+			output->context.name);
+	dstr_free(&spool->base_path);
+}
+
+static void stop_spool_thread(struct obs_output *output)
+{
+	struct delay_spool *spool = &output->delay_spool;
+
+	if (!spool->thread_active)
+		return;
+
+	os_atomic_set_bool(&spool->stop, true);
+	os_event_signal(spool->event);
+	pthread_join(spool->thread, NULL);
+
+	pthread_mutex_lock(&output->delay_mutex);
+	os_event_destroy(spool->event);
+	spool->event = NULL;
+	spool->thread_active = false;
+	os_event_signal(spool->written_event);
+	pthread_mutex_unlock(&output->delay_mutex);
+}
+
+/* must be called with delay_mutex locked, after the spool thread stopped */
+static void spool_clear(struct obs_output *output)
+{
+	struct delay_spool *spool = &output->delay_spool;
+	struct delay_data dd;
+
+	while (spool->write_queue.size) {
+		circlebuf_pop_front(&spool->write_queue, &dd, sizeof(dd));
+		if (dd.msg == DELAY_MSG_PACKET)
+			obs_encoder_packet_release(&dd.packet);
+	}
+
+	circlebuf_free(&spool->write_queue);
+	spool_remove_files(output);
+	dstr_free(&spool->base_path);
+
+	spool->queued        = 0;
+	spool->queued_bytes  = 0;
+	spool->records       = 0;
+	spool->spooled_bytes = 0;
+	spool->failed        = false;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* must be called with delay_mutex locked */
+static inline bool should_spool(struct obs_output *output,
+		struct delay_data *dd)
+{
+	struct delay_spool *spool = &output->delay_spool;
+
+	if (!spool->thread_active || spool->failed)
+		return false;
+
+	/* once data is spooled, everything after it has to be spooled as
+	 * well to keep it in order */
+	if (spool->queued)
+		return true;
+
+	return output->delay_max_memory &&
+		output->delay_memory + delay_data_size(dd) >
+		memory_limit(output);
+}
+
+/* must be called with delay_mutex locked.  if the disk can't keep up with
+ * the data, this waits for the spool thread to write some of it rather than
+ * letting the write queue grow past its share of the memory limit. */
+static void wait_for_queue_space(struct obs_output *output, size_t size)
+{
+	struct delay_spool *spool = &output->delay_spool;
+	bool waited = false;
+
+	while (spool->thread_active && !spool->failed &&
+	       spool->queued_bytes &&
+	       spool->queued_bytes + size > queue_limit(output)) {
+		pthread_mutex_unlock(&output->delay_mutex);
+		os_event_wait(spool->written_event);
+		pthread_mutex_lock(&output->delay_mutex);
+		waited = true;
+	}
+
+	/* pass the signal on to any other thread that's waiting */
+	if (waited)
+		os_event_signal(spool->written_event);
+}
+
+/* must be called with delay_mutex locked.  only waits on disk I/O when the
+ * write queue is full, data to spool is handed to the spool thread. */
+static void push_delay_data(struct obs_output *output, struct delay_data *dd)
+{
+	struct delay_spool *spool = &output->delay_spool;
+	size_t size = delay_data_size(dd);
+
+	if (should_spool(output, dd))
+		wait_for_queue_space(output, size);
+
+	/* the spool may have failed or emptied while waiting */
+	if (should_spool(output, dd)) {
+		circlebuf_push_back(&spool->write_queue, dd, sizeof(*dd));
+		spool->queued++;
+		spool->queued_bytes += size;
+		update_peak_memory(output);
+		os_event_signal(spool->event);
+		return;
+	}
+
+	push_memory(output, dd);
+}
+
 static inline void push_packet(struct obs_output *output,
 		struct encoder_packet *packet, uint64_t t)
 {
@@ -35,10 +515,10 @@ static inline void push_packet(struct obs_output *output,
 
 	dd.msg = DELAY_MSG_PACKET;
 	dd.ts  = t;
-	obs_encoder_packet_create_instance(&dd.packet, packet);
+	obs_encoder_packet_ref(&dd.packet, packet);
 
 	pthread_mutex_lock(&output->delay_mutex);
-	circlebuf_push_back(&output->delay_data, &dd, sizeof(dd));
+	push_delay_data(output, &dd);
 	pthread_mutex_unlock(&output->delay_mutex);
 }
 
@@ -65,6 +545,10 @@ void obs_output_cleanup_delay(obs_output_t *output)
 {
 	struct delay_data dd;
 
+	stop_spool_thread(output);
+
+	pthread_mutex_lock(&output->delay_mutex);
+
 	while (output->delay_data.size) {
 		circlebuf_pop_front(&output->delay_data, &dd, sizeof(dd));
 		if (dd.msg == DELAY_MSG_PACKET) {
@@ -72,6 +556,11 @@ void obs_output_cleanup_delay(obs_output_t *output)
 		}
 	}
 
+	output->delay_memory = 0;
+	spool_clear(output);
+
+	pthread_mutex_unlock(&output->delay_mutex);
+
 	output->active_delay_ns = 0;
 	os_atomic_set_long(&output->delay_restart_refs, 0);
 }
@@ -99,10 +588,17 @@ static inline bool pop_packet(struct obs_output *output, uint64_t t)
 		} else if (elapsed_time > output->active_delay_ns) {
 			circlebuf_pop_front(&output->delay_data, NULL,
 					sizeof(dd));
+			output->delay_memory -= delay_data_size(&dd);
 			popped = true;
 		}
 	}
 
+	/* the spool thread reads spooled data back in as memory frees up */
+	if (output->delay_spool.thread_active &&
+	    output->delay_spool.records &&
+	    output->delay_memory < memory_limit(output))
+		os_event_signal(output->delay_spool.event);
+
 	pthread_mutex_unlock(&output->delay_mutex);
 
 	/* ------------------------------------------------ */
@@ -148,7 +644,8 @@ bool obs_output_delay_start(obs_output_t *output)
 	}
 
 	pthread_mutex_lock(&output->delay_mutex);
-	circlebuf_push_back(&output->delay_data, &dd, sizeof(dd));
+	start_spool_thread(output);
+	push_delay_data(output, &dd);
 	pthread_mutex_unlock(&output->delay_mutex);
 
 	os_atomic_inc_long(&output->delay_restart_refs);
@@ -174,7 +671,7 @@ void obs_output_delay_stop(obs_output_t *output)
 	};
 
 	pthread_mutex_lock(&output->delay_mutex);
-	circlebuf_push_back(&output->delay_data, &dd, sizeof(dd));
+	push_delay_data(output, &dd);
 	pthread_mutex_unlock(&output->delay_mutex);
 
 	do_output_signal(output, "stopping");
@@ -208,3 +705,46 @@ uint32_t obs_output_get_active_delay(const obs_output_t *output)
 	return obs_output_valid(output, "obs_output_set_delay") ?
 		(uint32_t)(output->active_delay_ns / 1000000000ULL) : 0;
 }
+
+void obs_output_set_delay_spool(obs_output_t *output, const char *directory,
+		uint64_t max_memory)
+{
+	if (!obs_output_valid(output, "obs_output_set_delay_spool"))
+		return;
+
+	pthread_mutex_lock(&output->delay_mutex);
+
+	bfree(output->delay_spool_dir);
+	output->delay_spool_dir = (directory && *directory) ?
+		bstrdup(directory) : NULL;
+	output->delay_max_memory = max_memory;
+
+	pthread_mutex_unlock(&output->delay_mutex);
+}
+
+void obs_output_get_delay_stats(obs_output_t *output,
+		struct obs_output_delay_stats *stats)
+{
+	struct delay_spool *spool;
+
+	if (!obs_ptr_valid(stats, "obs_output_get_delay_stats"))
+		return;
+
+	memset(stats, 0, sizeof(*stats));
+
+	if (!obs_output_valid(output, "obs_output_get_delay_stats"))
+		return;
+
+	spool = &output->delay_spool;
+
+	pthread_mutex_lock(&output->delay_mutex);
+	stats->memory_bytes      = output->delay_memory +
+		spool->queued_bytes;
+	stats->peak_memory_bytes = output->delay_peak_memory;
+	stats->spooled_bytes     = spool->spooled_bytes;
+	stats->bytes_written     = spool->bytes_written;
+	stats->bytes_read        = spool->bytes_read;
+	stats->segments          = spool->segments;
+	stats->errors            = spool->errors;
+	pthread_mutex_unlock(&output->delay_mutex);
+}
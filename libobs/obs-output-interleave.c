@@ -0,0 +1,267 @@
+/******************************************************************************
+    Copyright (C) 2018 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "obs-internal.h"
+
+#define PACKET_SIZE sizeof(struct encoder_packet)
+
+static inline size_t get_track(const struct encoder_packet *packet)
+{
+	return packet->type == OBS_ENCODER_VIDEO ? 0 : 1 + packet->track_idx;
+}
+
+static inline size_t track_size(const struct interleaver *il, size_t track)
+{
+	return il->tracks[track].size / PACKET_SIZE;
+}
+
+static inline struct encoder_packet *track_packet(struct interleaver *il,
+		size_t track, size_t idx)
+{
+	return circlebuf_data(&il->tracks[track], idx * PACKET_SIZE);
+}
+
+static inline bool packet_before(int64_t dts_usec_a, size_t track_a,
+		int64_t dts_usec_b, size_t track_b)
+{
+	if (dts_usec_a != dts_usec_b)
+		return dts_usec_a < dts_usec_b;
+	return track_a < track_b;
+}
+
+static inline bool track_before(struct interleaver *il, size_t a, size_t b)
+{
+	return packet_before(track_packet(il, a, 0)->dts_usec, a,
+			track_packet(il, b, 0)->dts_usec, b);
+}
+
+/* ------------------------------------------------------------------------- */
+/* heap of the tracks that have packets, ordered by their first packet */
+
+static inline void heap_swap(struct interleaver *il, size_t a, size_t b)
+{
+	size_t track = il->heap[a];
+	il->heap[a] = il->heap[b];
+	il->heap[b] = track;
+}
+
+static void heap_sift_up(struct interleaver *il, size_t idx)
+{
+	while (idx) {
+		size_t parent = (idx - 1) / 2;
+
+		if (!track_before(il, il->heap[idx], il->heap[parent]))
+			break;
+
+		heap_swap(il, idx, parent);
+		idx = parent;
+	}
+}
+
+static void heap_sift_down(struct interleaver *il, size_t idx)
+{
+	for (;;) {
+		size_t left  = idx * 2 + 1;
+		size_t right = left + 1;
+		size_t first = idx;
+
+		if (left < il->heap_size &&
+		    track_before(il, il->heap[left], il->heap[first]))
+			first = left;
+		if (right < il->heap_size &&
+		    track_before(il, il->heap[right], il->heap[first]))
+			first = right;
+
+		if (first == idx)
+			break;
+
+		heap_swap(il, idx, first);
+		idx = first;
+	}
+}
+
+void interleaver_reorder(struct interleaver *il)
+{
+	il->heap_size = 0;
+
+	for (size_t i = 0; i < INTERLEAVE_TRACKS; i++) {
+		if (il->tracks[i].size)
+			il->heap[il->heap_size++] = i;
+	}
+
+	for (size_t i = il->heap_size / 2; i > 0; i--)
+		heap_sift_down(il, i - 1);
+}
+
+/* ------------------------------------------------------------------------- */
+
+void interleaver_free(struct interleaver *il)
+{
+	for (size_t i = 0; i < INTERLEAVE_TRACKS; i++) {
+		struct circlebuf *cb = &il->tracks[i];
+
+		while (cb->size) {
+			struct encoder_packet packet;
+			circlebuf_pop_front(cb, &packet, PACKET_SIZE);
+			obs_encoder_packet_release(&packet);
+		}
+
+		circlebuf_free(cb);
+	}
+
+	il->heap_size   = 0;
+	il->num_packets = 0;
+}
+
+/* packets of a track nearly always arrive in order, so this only searches
+ * the track if the packet is older than the last one */
+static bool insert_sorted(struct circlebuf *cb,
+		const struct encoder_packet *packet)
+{
+	DARRAY(struct encoder_packet) later;
+	struct encoder_packet last;
+	bool first;
+
+	da_init(later);
+
+	while (cb->size) {
+		circlebuf_peek_back(cb, &last, PACKET_SIZE);
+		if (last.dts_usec <= packet->dts_usec)
+			break;
+
+		circlebuf_pop_back(cb, NULL, PACKET_SIZE);
+		da_push_back(later, &last);
+	}
+
+	first = !cb->size;
+	circlebuf_push_back(cb, packet, PACKET_SIZE);
+
+	for (size_t i = later.num; i > 0; i--)
+		circlebuf_push_back(cb, &later.array[i - 1], PACKET_SIZE);
+
+	da_free(later);
+	return first;
+}
+
+void interleaver_push(struct interleaver *il,
+		const struct encoder_packet *packet)
+{
+	size_t track = get_track(packet);
+	struct circlebuf *cb = &il->tracks[track];
+	struct encoder_packet last;
+
+	il->num_packets++;
+
+	if (!cb->size) {
+		circlebuf_push_back(cb, packet, PACKET_SIZE);
+		il->heap[il->heap_size] = track;
+		heap_sift_up(il, il->heap_size++);
+		return;
+	}
+
+	circlebuf_peek_back(cb, &last, PACKET_SIZE);
+	if (last.dts_usec <= packet->dts_usec) {
+		circlebuf_push_back(cb, packet, PACKET_SIZE);
+
+	} else if (insert_sorted(cb, packet)) {
+		/* the first packet of the track changed */
+		interleaver_reorder(il);
+	}
+}
+
+struct encoder_packet *interleaver_peek(struct interleaver *il)
+{
+	return il->heap_size ? track_packet(il, il->heap[0], 0) : NULL;
+}
+
+void interleaver_pop(struct interleaver *il, struct encoder_packet *packet)
+{
+	size_t track;
+
+	if (!il->heap_size)
+		return;
+
+	track = il->heap[0];
+	circlebuf_pop_front(&il->tracks[track], packet, PACKET_SIZE);
+	il->num_packets--;
+
+	if (!il->tracks[track].size)
+		il->heap[0] = il->heap[--il->heap_size];
+
+	heap_sift_down(il, 0);
+}
+
+struct encoder_packet *interleaver_first(struct interleaver *il,
+		enum obs_encoder_type type, size_t audio_idx)
+{
+	size_t track = type == OBS_ENCODER_VIDEO ? 0 : 1 + audio_idx;
+	return track_size(il, track) ? track_packet(il, track, 0) : NULL;
+}
+
+struct encoder_packet *interleaver_last(struct interleaver *il,
+		enum obs_encoder_type type, size_t audio_idx)
+{
+	size_t track = type == OBS_ENCODER_VIDEO ? 0 : 1 + audio_idx;
+	size_t size = track_size(il, track);
+	return size ? track_packet(il, track, size - 1) : NULL;
+}
+
+void interleaver_discard_before(struct interleaver *il,
+		const struct encoder_packet *packet)
+{
+	int64_t dts_usec = packet->dts_usec;
+	size_t track = get_track(packet);
+	struct encoder_packet *next;
+
+	while ((next = interleaver_peek(il)) != NULL) {
+		struct encoder_packet discarded;
+
+		if (!packet_before(next->dts_usec, get_track(next),
+					dts_usec, track))
+			break;
+
+		interleaver_pop(il, &discarded);
+		obs_encoder_packet_release(&discarded);
+	}
+}
+
+void interleaver_discard_until(struct interleaver *il, int64_t dts_usec)
+{
+	struct encoder_packet *next;
+
+	while ((next = interleaver_peek(il)) != NULL) {
+		struct encoder_packet discarded;
+
+		if (next->dts_usec >= dts_usec)
+			break;
+
+		interleaver_pop(il, &discarded);
+		obs_encoder_packet_release(&discarded);
+	}
+}
+
+void interleaver_for_each(struct interleaver *il,
+		void (*callback)(void *param, struct encoder_packet *packet),
+		void *param)
+{
+	for (size_t i = 0; i < INTERLEAVE_TRACKS; i++) {
+		size_t size = track_size(il, i);
+
+		for (size_t j = 0; j < size; j++)
+			callback(param, track_packet(il, i, j));
+	}
+}
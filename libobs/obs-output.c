@@ -114,6 +114,9 @@ obs_output_t *obs_output_create(const char *id, const char *name,
 		goto fail;
 	if (os_event_init(&output->stopping_event, OS_EVENT_TYPE_MANUAL) != 0)
 		goto fail;
+	if (os_event_init(&output->delay_spool.written_event,
+				OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
 	if (!init_output_handlers(output, name, settings, hotkey_data))
 		goto fail;
 
@@ -164,9 +167,7 @@ fail:
 
 static inline void free_packets(struct obs_output *output)
 {
-	for (size_t i = 0; i < output->interleaved_packets.num; i++)
-		obs_encoder_packet_release(output->interleaved_packets.array+i);
-	da_free(output->interleaved_packets);
+	interleaver_free(&output->interleaved_packets);
 }
 
 void obs_output_destroy(obs_output_t *output)
@@ -190,6 +191,10 @@ void obs_output_destroy(obs_output_t *output)
 
 		free_packets(output);
 
+		/* stops the delay spool thread if the delay never stopped */
+		if (output->delay_spool.thread_active)
+			obs_output_cleanup_delay(output);
+
 		if (output->video_encoder) {
 			obs_encoder_remove_output(output->video_encoder,
 					output);
@@ -204,12 +209,14 @@ void obs_output_destroy(obs_output_t *output)
 		}
 
 		os_event_destroy(output->stopping_event);
+		os_event_destroy(output->delay_spool.written_event);
 		pthread_mutex_destroy(&output->caption_mutex);
 		pthread_mutex_destroy(&output->interleaved_mutex);
 		pthread_mutex_destroy(&output->delay_mutex);
 		os_event_destroy(output->reconnect_stop_event);
 		obs_context_data_free(&output->context);
 		circlebuf_free(&output->delay_data);
+		bfree(output->delay_spool_dir);
 		if (output->owns_info_id)
 			bfree((void*)output->info.id);
 		if (output->last_error_message)
@@ -982,7 +989,10 @@ static bool add_caption(struct obs_output *output, struct encoder_packet *out)
 	sei_t sei;
 	uint8_t *data;
 	size_t size;
-	long ref = 1;
+	union {
+		struct packet_header header;
+		uint8_t              bytes[PACKET_HEADER_SIZE];
+	} header = {0};
 
 	DARRAY(uint8_t) out_data;
 
@@ -991,8 +1001,11 @@ static bool add_caption(struct obs_output *output, struct encoder_packet *out)
 
 	sei_init(&sei, 0.0);
 
+	/* not from the packet pool, freed with bfree once released */
+	header.header.refs = 1;
+
 	da_init(out_data);
-	da_push_back_array(out_data, &ref, sizeof(ref));
+	da_push_back_array(out_data, &header, PACKET_HEADER_SIZE);
 	da_push_back_array(out_data, out->data, out->size);
 
 	caption_frame_init(&cf);
@@ -1010,8 +1023,8 @@ static bool add_caption(struct obs_output *output, struct encoder_packet *out)
 	obs_encoder_packet_release(out);
 
 	*out = backup;
-	out->data = (uint8_t*)out_data.array + sizeof(ref);
-	out->size = out_data.num - sizeof(ref);
+	out->data = (uint8_t*)out_data.array + PACKET_HEADER_SIZE;
+	out->size = out_data.num - PACKET_HEADER_SIZE;
 
 	sei_free(&sei);
 
@@ -1024,15 +1037,17 @@ static bool add_caption(struct obs_output *output, struct encoder_packet *out)
 
 static inline void send_interleaved(struct obs_output *output)
 {
-	struct encoder_packet out = output->interleaved_packets.array[0];
+	struct encoder_packet *next =
+		interleaver_peek(&output->interleaved_packets);
+	struct encoder_packet out;
 
 	/* do not send an interleaved packet if there's no packet of the
 	 * opposing type of a higher timestamp in the interleave buffer.
 	 * this ensures that the timestamps are monotonic */
-	if (!has_higher_opposing_ts(output, &out))
+	if (!next || !has_higher_opposing_ts(output, next))
 		return;
 
-	da_erase(output->interleaved_packets, 0);
+	interleaver_pop(&output->interleaved_packets, &out);
 
 	if (out.type == OBS_ENCODER_VIDEO) {
 		output->total_frames++;
@@ -1079,184 +1094,185 @@ static inline void set_higher_ts(struct obs_output *output,
 
 static inline struct encoder_packet *find_first_packet_type(
 		struct obs_output *output, enum obs_encoder_type type,
-		size_t audio_idx);
-static int find_first_packet_type_idx(struct obs_output *output,
-		enum obs_encoder_type type, size_t audio_idx);
+		size_t audio_idx)
+{
+	return interleaver_first(&output->interleaved_packets, type,
+			audio_idx);
+}
+
+static inline struct encoder_packet *find_last_packet_type(
+		struct obs_output *output, enum obs_encoder_type type,
+		size_t audio_idx)
+{
+	return interleaver_last(&output->interleaved_packets, type, audio_idx);
+}
+
+/* finds the audio packet of a track closest to a timestamp, preferring the
+ * earlier packet if two are equally close */
+static struct encoder_packet *find_closest_audio(struct obs_output *output,
+		size_t audio_idx, int64_t dts_usec)
+{
+	struct circlebuf *track =
+		&output->interleaved_packets.tracks[1 + audio_idx];
+	size_t count = track->size / sizeof(struct encoder_packet);
+	struct encoder_packet *before = NULL;
+	struct encoder_packet *after = NULL;
+	size_t low = 0;
+	size_t high = count;
+
+	/* first packet at or after the timestamp */
+	while (low < high) {
+		size_t mid = (low + high) / 2;
+		struct encoder_packet *packet = circlebuf_data(track,
+				mid * sizeof(struct encoder_packet));
+
+		if (packet->dts_usec < dts_usec)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if (low > 0)
+		before = circlebuf_data(track,
+				(low - 1) * sizeof(struct encoder_packet));
+	if (low < count)
+		after = circlebuf_data(track,
+				low * sizeof(struct encoder_packet));
+
+	if (!before)
+		return after;
+	if (!after)
+		return before;
+
+	return (after->dts_usec - dts_usec < dts_usec - before->dts_usec) ?
+		after : before;
+}
 
 /* gets the point where audio and video are closest together */
-static size_t get_interleaved_start_idx(struct obs_output *output)
+static struct encoder_packet *get_interleaved_start(struct obs_output *output)
 {
 	int64_t closest_diff = 0x7FFFFFFFFFFFFFFFLL;
 	struct encoder_packet *first_video = find_first_packet_type(output,
 			OBS_ENCODER_VIDEO, 0);
-	size_t video_idx = DARRAY_INVALID;
-	size_t idx = 0;
+	struct encoder_packet *start = NULL;
 
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		struct encoder_packet *audio;
 		int64_t diff;
 
-		if (packet->type != OBS_ENCODER_AUDIO) {
-			if (packet == first_video)
-				video_idx = i;
+		audio = find_closest_audio(output, i, first_video->dts_usec);
+		if (!audio)
 			continue;
-		}
 
-		diff = llabs(packet->dts_usec - first_video->dts_usec);
-		if (diff < closest_diff) {
+		diff = llabs(audio->dts_usec - first_video->dts_usec);
+		if (diff < closest_diff ||
+		    (diff == closest_diff &&
+		     audio->dts_usec < start->dts_usec)) {
 			closest_diff = diff;
-			idx = i;
+			start = audio;
 		}
 	}
 
-	return video_idx < idx ? video_idx : idx;
+	if (!start || first_video->dts_usec <= start->dts_usec)
+		return first_video;
+	return start;
 }
 
-static int prune_premature_packets(struct obs_output *output)
+/* returns the packet up to which packets should be pruned, or NULL */
+static struct encoder_packet *prune_premature_packets(
+		struct obs_output *output, bool *failed)
 {
 	size_t audio_mixes = num_audio_mixes(output);
 	struct encoder_packet *video;
-	int video_idx;
-	int max_idx;
+	struct encoder_packet *last;
 	int64_t duration_usec;
 	int64_t max_diff = 0;
 	int64_t diff = 0;
 
-	video_idx = find_first_packet_type_idx(output, OBS_ENCODER_VIDEO, 0);
-	if (video_idx == -1) {
+	*failed = false;
+
+	video = find_first_packet_type(output, OBS_ENCODER_VIDEO, 0);
+	if (!video) {
 		output->received_video = false;
-		return -1;
+		*failed = true;
+		return NULL;
 	}
 
-	max_idx = video_idx;
-	video = &output->interleaved_packets.array[video_idx];
+	last = video;
 	duration_usec = video->timebase_num * 1000000LL / video->timebase_den;
 
 	for (size_t i = 0; i < audio_mixes; i++) {
 		struct encoder_packet *audio;
-		int audio_idx;
 
-		audio_idx = find_first_packet_type_idx(output,
-				OBS_ENCODER_AUDIO, i);
-		if (audio_idx == -1) {
+		audio = find_first_packet_type(output, OBS_ENCODER_AUDIO, i);
+		if (!audio) {
 			output->received_audio = false;
-			return -1;
+			*failed = true;
+			return NULL;
 		}
 
-		audio = &output->interleaved_packets.array[audio_idx];
-		if (audio_idx > max_idx)
-			max_idx = audio_idx;
+		/* later tracks come after earlier ones of the same time */
+		if (audio->dts_usec >= last->dts_usec)
+			last = audio;
 
 		diff = audio->dts_usec - video->dts_usec;
 		if (diff > max_diff)
 			max_diff = diff;
 	}
 
-	return diff > duration_usec ? max_idx + 1 : 0;
+	return diff > duration_usec ? last : NULL;
 }
 
-static void discard_to_idx(struct obs_output *output, size_t idx)
+static void discard_through(struct obs_output *output,
+		struct encoder_packet *packet)
 {
-	for (size_t i = 0; i < idx; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		obs_encoder_packet_release(packet);
-	}
+	struct encoder_packet discarded;
 
-	da_erase_range(output->interleaved_packets, 0, idx);
+	interleaver_discard_before(&output->interleaved_packets, packet);
+	interleaver_pop(&output->interleaved_packets, &discarded);
+	obs_encoder_packet_release(&discarded);
 }
 
 #define DEBUG_STARTING_PACKETS 0
 
+#if DEBUG_STARTING_PACKETS == 1
+static void log_starting_packet(void *param, struct encoder_packet *packet)
+{
+	blog(LOG_DEBUG, "packet: %s %d, ts: %lld",
+			packet->type == OBS_ENCODER_AUDIO ?
+			"audio" : "video", (int)packet->track_idx,
+			packet->dts_usec);
+
+	UNUSED_PARAMETER(param);
+}
+#endif
+
 static bool prune_interleaved_packets(struct obs_output *output)
 {
-	size_t start_idx = 0;
-	int prune_start = prune_premature_packets(output);
+	struct encoder_packet *prune_end;
+	bool failed;
+
+	prune_end = prune_premature_packets(output, &failed);
 
 #if DEBUG_STARTING_PACKETS == 1
-	blog(LOG_DEBUG, "--------- Pruning! %d ---------", prune_start);
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		blog(LOG_DEBUG, "packet: %s %d, ts: %lld, pruned = %s",
-				packet->type == OBS_ENCODER_AUDIO ?
-				"audio" : "video", (int)packet->track_idx,
-				packet->dts_usec,
-				(int)i < prune_start ? "true" : "false");
-	}
+	blog(LOG_DEBUG, "--------- Pruning! %lld ---------",
+			prune_end ? prune_end->dts_usec : 0);
+	interleaver_for_each(&output->interleaved_packets,
+			log_starting_packet, NULL);
 #endif
 
 	/* prunes the first video packet if it's too far away from audio */
-	if (prune_start == -1)
+	if (failed)
 		return false;
-	else if (prune_start != 0)
-		start_idx = (size_t)prune_start;
+	else if (prune_end)
+		discard_through(output, prune_end);
 	else
-		start_idx = get_interleaved_start_idx(output);
-
-	if (start_idx)
-		discard_to_idx(output, start_idx);
+		interleaver_discard_before(&output->interleaved_packets,
+				get_interleaved_start(output));
 
 	return true;
 }
 
-static int find_first_packet_type_idx(struct obs_output *output,
-		enum obs_encoder_type type, size_t audio_idx)
-{
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-
-		if (packet->type == type) {
-			if (type == OBS_ENCODER_AUDIO &&
-			    packet->track_idx != audio_idx) {
-				continue;
-			}
-
-			return (int)i;
-		}
-	}
-
-	return -1;
-}
-
-static int find_last_packet_type_idx(struct obs_output *output,
-		enum obs_encoder_type type, size_t audio_idx)
-{
-	for (size_t i = output->interleaved_packets.num; i > 0; i--) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i - 1];
-
-		if (packet->type == type) {
-			if (type == OBS_ENCODER_AUDIO &&
-			    packet->track_idx != audio_idx) {
-				continue;
-			}
-
-			return (int)(i - 1);
-		}
-	}
-
-	return -1;
-}
-
-static inline struct encoder_packet *find_first_packet_type(
-		struct obs_output *output, enum obs_encoder_type type,
-		size_t audio_idx)
-{
-	int idx = find_first_packet_type_idx(output, type, audio_idx);
-	return (idx != -1) ? &output->interleaved_packets.array[idx] : NULL;
-}
-
-static inline struct encoder_packet *find_last_packet_type(
-		struct obs_output *output, enum obs_encoder_type type,
-		size_t audio_idx)
-{
-	int idx = find_last_packet_type_idx(output, type, audio_idx);
-	return (idx != -1) ? &output->interleaved_packets.array[idx] : NULL;
-}
-
 static bool get_audio_and_video_packets(struct obs_output *output,
 		struct encoder_packet **video,
 		struct encoder_packet **audio, size_t audio_mixes)
@@ -1280,13 +1296,18 @@ static bool get_audio_and_video_packets(struct obs_output *output,
 	return true;
 }
 
+static void apply_offset(void *param, struct encoder_packet *packet)
+{
+	apply_interleaved_packet_offset(param, packet);
+}
+
 static bool initialize_interleaved_packets(struct obs_output *output)
 {
 	struct encoder_packet *video;
 	struct encoder_packet *audio[MAX_AUDIO_MIXES];
 	struct encoder_packet *last_audio[MAX_AUDIO_MIXES];
+	struct encoder_packet *start;
 	size_t audio_mixes = num_audio_mixes(output);
-	size_t start_idx;
 
 	if (!get_audio_and_video_packets(output, &video, audio, audio_mixes))
 		return false;
@@ -1304,9 +1325,9 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 	}
 
 	/* clear out excess starting audio if it hasn't been already */
-	start_idx = get_interleaved_start_idx(output);
-	if (start_idx) {
-		discard_to_idx(output, start_idx);
+	start = get_interleaved_start(output);
+	if (start != interleaver_peek(&output->interleaved_packets)) {
+		interleaver_discard_before(&output->interleaved_packets, start);
 		if (!get_audio_and_video_packets(output, &video, audio,
 					audio_mixes))
 			return false;
@@ -1332,11 +1353,8 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 	output->highest_video_ts -= video->dts_usec;
 
 	/* apply new offsets to all existing packet DTS/PTS values */
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		apply_interleaved_packet_offset(output, packet);
-	}
+	interleaver_for_each(&output->interleaved_packets, apply_offset,
+			output);
 
 	return true;
 }
@@ -1344,51 +1362,18 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 static inline void insert_interleaved_packet(struct obs_output *output,
 		struct encoder_packet *out)
 {
-	size_t idx;
-	for (idx = 0; idx < output->interleaved_packets.num; idx++) {
-		struct encoder_packet *cur_packet;
-		cur_packet = output->interleaved_packets.array + idx;
-
-		if (out->dts_usec == cur_packet->dts_usec &&
-		    out->type == OBS_ENCODER_VIDEO) {
-			break;
-		} else if (out->dts_usec < cur_packet->dts_usec) {
-			break;
-		}
-	}
-
-	da_insert(output->interleaved_packets, idx, out);
+	interleaver_push(&output->interleaved_packets, out);
 }
 
 static void resort_interleaved_packets(struct obs_output *output)
 {
-	DARRAY(struct encoder_packet) old_array;
-
-	old_array.da = output->interleaved_packets.da;
-	memset(&output->interleaved_packets, 0,
-			sizeof(output->interleaved_packets));
-
-	for (size_t i = 0; i < old_array.num; i++)
-		insert_interleaved_packet(output, &old_array.array[i]);
-
-	da_free(old_array);
+	interleaver_reorder(&output->interleaved_packets);
 }
 
 static void discard_unused_audio_packets(struct obs_output *output,
 		int64_t dts_usec)
 {
-	size_t idx = 0;
-
-	for (; idx < output->interleaved_packets.num; idx++) {
-		struct encoder_packet *p =
-			&output->interleaved_packets.array[idx];
-
-		if (p->dts_usec >= dts_usec)
-			break;
-	}
-
-	if (idx)
-		discard_to_idx(output, idx);
+	interleaver_discard_until(&output->interleaved_packets, dts_usec);
 }
 
 static void interleave_packets(void *data, struct encoder_packet *packet)
@@ -1422,7 +1407,7 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 	if (output->active_delay_ns)
 		out = *packet;
 	else
-		obs_encoder_packet_create_instance(&out, packet);
+		obs_encoder_packet_ref(&out, packet);
 
 	if (was_started)
 		apply_interleaved_packet_offset(output, &out);
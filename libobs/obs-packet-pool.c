@@ -0,0 +1,274 @@
+/******************************************************************************
+    Copyright (C) 2018 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "obs-internal.h"
+
+/* global pool of encoder packet buffers.  packets are copied once when they
+ * come out of the encoder and then shared by reference between all outputs,
+ * so buffers are allocated and freed from several threads at a high rate.
+ * free buffers are kept per power of two size class on lock-free stacks, and
+ * the pool only takes a lock when a class has to grow. */
+
+#define MIN_CLASS_SIZE  1024
+#define SLAB_SIZE       (256 * 1024)
+
+/* slabs are kept until shutdown, so the memory of all classes together is
+ * capped.  once the cap is reached, packets are allocated outside of the pool
+ * and freed as soon as they're released. */
+#define POOL_BUDGET     (128ULL * 1024ULL * 1024ULL)
+
+/* the free list head fits in a 32-bit long: the low 12 bits hold the slot of
+ * the top buffer plus one, which limits a class to 4095 buffers, and the
+ * other 19 bits a tag that changes on every push and pop.  a pop can only be
+ * fooled if the head changes exactly a multiple of 2^19 times between its
+ * load and its swap (a few instructions) and ends up on the same slot. */
+#define SLOT_BITS       12
+#define SLOT_MASK       ((1L << SLOT_BITS) - 1)
+#define TAG_MASK        0x7FFFFL
+
+/* the header must fit in PACKET_HEADER_SIZE, and packet data must stay
+ * aligned for SSE/AVX access */
+typedef char packet_header_fits[
+	sizeof(struct packet_header) <= PACKET_HEADER_SIZE ? 1 : -1];
+typedef char packet_header_aligned[PACKET_HEADER_SIZE % 32 == 0 ? 1 : -1];
+
+static inline long next_head(long head, long slot)
+{
+	long tag = ((head >> SLOT_BITS) + 1) & TAG_MASK;
+	return (tag << SLOT_BITS) | slot;
+}
+
+static inline struct packet_header *get_slot_header(
+		struct packet_pool_class *pc, long slot)
+{
+	uint8_t *slab = pc->slabs[slot / pc->slab_buffers];
+	size_t offset = (size_t)(slot % pc->slab_buffers) * pc->stride;
+	return (struct packet_header*)(slab + offset);
+}
+
+/* slabs are never freed while the pool exists, so a header can safely be
+ * read even if another thread pops it first; the tag makes the swap fail in
+ * that case */
+static struct packet_header *pop_free(struct packet_pool_class *pc)
+{
+	struct packet_header *header;
+	long head, next;
+
+	do {
+		head = os_atomic_load_long(&pc->free_head);
+		if (!(head & SLOT_MASK))
+			return NULL;
+
+		header = get_slot_header(pc, (head & SLOT_MASK) - 1);
+		next = os_atomic_load_long(&header->next_free);
+	} while (!os_atomic_compare_swap_long(&pc->free_head, head,
+				next_head(head, next)));
+
+	return header;
+}
+
+static void push_free(struct packet_pool_class *pc,
+		struct packet_header *header)
+{
+	long head;
+
+	do {
+		head = os_atomic_load_long(&pc->free_head);
+		os_atomic_set_long(&header->next_free, head & SLOT_MASK);
+	} while (!os_atomic_compare_swap_long(&pc->free_head, head,
+				next_head(head, header->slot + 1)));
+}
+
+bool packet_pool_init(struct packet_pool *pool)
+{
+	size_t size = MIN_CLASS_SIZE;
+
+	memset(pool, 0, sizeof(*pool));
+	pthread_mutex_init_value(&pool->grow_mutex);
+
+	if (pthread_mutex_init(&pool->grow_mutex, NULL) != 0)
+		return false;
+
+	for (size_t i = 0; i < PACKET_POOL_CLASSES; i++) {
+		struct packet_pool_class *pc = &pool->classes[i];
+		long max_slabs;
+
+		pc->pool         = pool;
+		pc->size         = size;
+		pc->stride       = PACKET_HEADER_SIZE + size;
+		pc->slab_buffers = (long)(SLAB_SIZE / pc->stride);
+		if (!pc->slab_buffers)
+			pc->slab_buffers = 1;
+
+		max_slabs = (SLOT_MASK - 1) / pc->slab_buffers;
+		pc->max_slabs = max_slabs < PACKET_POOL_MAX_SLABS ?
+			max_slabs : PACKET_POOL_MAX_SLABS;
+
+		size <<= 1;
+	}
+
+	return true;
+}
+
+void packet_pool_free(struct packet_pool *pool)
+{
+	for (size_t i = 0; i < PACKET_POOL_CLASSES; i++) {
+		struct packet_pool_class *pc = &pool->classes[i];
+
+		for (long j = 0; j < pc->num_slabs; j++)
+			bfree(pc->slabs[j]);
+	}
+
+	if (pool->in_use)
+		blog(LOG_DEBUG, "packet_pool_free: %ld packet buffers still "
+				"in use", pool->in_use);
+
+	pthread_mutex_destroy(&pool->grow_mutex);
+	memset(pool, 0, sizeof(*pool));
+}
+
+static inline struct packet_pool_class *get_class(struct packet_pool *pool,
+		size_t size)
+{
+	for (size_t i = 0; i < PACKET_POOL_CLASSES; i++) {
+		if (size <= pool->classes[i].size)
+			return &pool->classes[i];
+	}
+
+	return NULL;
+}
+
+static struct packet_header *grow_class(struct packet_pool *pool,
+		struct packet_pool_class *pc)
+{
+	struct packet_header *header;
+	long num_slabs;
+	long first_slot;
+	uint8_t *slab;
+
+	pthread_mutex_lock(&pool->grow_mutex);
+
+	/* another thread may have grown the class in the meantime */
+	header = pop_free(pc);
+	if (header)
+		goto unlock;
+
+	num_slabs = pc->num_slabs;
+	if (num_slabs >= pc->max_slabs)
+		goto unlock;
+	if (pool->resident_bytes + pc->stride * pc->slab_buffers > POOL_BUDGET)
+		goto unlock;
+
+	slab = bmalloc(pc->stride * pc->slab_buffers);
+	first_slot = num_slabs * pc->slab_buffers;
+
+	/* the slab has to be visible before any of its buffers can be popped
+	 * by other threads, pushing them is a full barrier */
+	pc->slabs[num_slabs] = slab;
+	os_atomic_inc_long(&pc->num_slabs);
+	pool->resident_bytes += pc->stride * pc->slab_buffers;
+
+	for (long i = pc->slab_buffers; i > 0; i--) {
+		struct packet_header *cur = (struct packet_header*)
+			(slab + (size_t)(i - 1) * pc->stride);
+
+		cur->pool_class = pc;
+		cur->slot       = first_slot + i - 1;
+		cur->next_free  = 0;
+		cur->refs       = 0;
+
+		if (i > 1)
+			push_free(pc, cur);
+		else
+			header = cur;
+	}
+
+unlock:
+	pthread_mutex_unlock(&pool->grow_mutex);
+	return header;
+}
+
+uint8_t *packet_pool_alloc(struct packet_pool *pool, size_t size)
+{
+	struct packet_pool_class *pc = pool ? get_class(pool, size) : NULL;
+	struct packet_header *header = NULL;
+
+	if (pc) {
+		header = pop_free(pc);
+		if (header) {
+			os_atomic_inc_long(&pool->hits);
+		} else {
+			header = grow_class(pool, pc);
+			if (header)
+				os_atomic_inc_long(&pool->misses);
+		}
+	}
+
+	if (header) {
+		os_atomic_inc_long(&pool->in_use);
+	} else {
+		/* too large for the pool, or the pool is full */
+		header = bmalloc(PACKET_HEADER_SIZE + size);
+		header->pool_class = NULL;
+		header->slot       = 0;
+		header->next_free  = 0;
+
+		if (pool)
+			os_atomic_inc_long(&pool->unpooled);
+	}
+
+	header->refs = 1;
+	return (uint8_t*)header + PACKET_HEADER_SIZE;
+}
+
+void packet_pool_release(uint8_t *data)
+{
+	struct packet_header *header = packet_get_header(data);
+	struct packet_pool_class *pc = header->pool_class;
+
+	if (pc) {
+		push_free(pc, header);
+		os_atomic_dec_long(&pc->pool->in_use);
+	} else {
+		bfree(header);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+void obs_get_packet_pool_stats(struct obs_packet_pool_stats *stats)
+{
+	struct packet_pool *pool;
+
+	if (!stats)
+		return;
+
+	memset(stats, 0, sizeof(*stats));
+	if (!obs)
+		return;
+
+	pool = &obs->data.packet_pool;
+
+	stats->hits     = (uint64_t)os_atomic_load_long(&pool->hits);
+	stats->misses   = (uint64_t)os_atomic_load_long(&pool->misses);
+	stats->unpooled = (uint64_t)os_atomic_load_long(&pool->unpooled);
+	stats->in_use   = (uint64_t)os_atomic_load_long(&pool->in_use);
+
+	pthread_mutex_lock(&pool->grow_mutex);
+	stats->resident_bytes = pool->resident_bytes;
+	pthread_mutex_unlock(&pool->grow_mutex);
+}
@@ -428,6 +428,7 @@ static void update_item_transform(struct obs_scene_item *item, bool update_tex)
 		obs_leave_graphics();
 	}
 
+	item->cache_valid = false;
 	os_atomic_set_bool(&item->update_transform, false);
 }
 
@@ -505,8 +506,187 @@ static void render_item_texture(struct obs_scene_item *item)
 		obs_source_draw(tex, 0, 0, 0, 0, 0);
 }
 
+/* ------------------------------------------------------------------------- */
+/* render cache                                                              */
+
+static inline void hash_combine(uint64_t *key, uint64_t val)
+{
+	*key = (*key ^ val) * 1099511628211ULL;
+}
+
+static inline void hash_data(uint64_t *key, const void *data, size_t size)
+{
+	const uint8_t *bytes = data;
+
+	for (size_t i = 0; i < size; i++)
+		hash_combine(key, bytes[i]);
+}
+
+static bool source_content_key(obs_source_t *source, uint64_t *key);
+
+/* assumes video lock */
+static bool scene_content_key(obs_scene_t *scene, uint64_t *key)
+{
+	struct obs_scene_item *item = scene->first_item;
+
+	hash_combine(key, scene->cx);
+	hash_combine(key, scene->cy);
+
+	while (item) {
+		/* pending transform updates and removals are only applied
+		 * when the scene actually renders */
+		if (obs_source_removed(item->source) ||
+		    os_atomic_load_bool(&item->update_transform) ||
+		    os_atomic_load_bool(&item->update_group_resize) ||
+		    source_size_changed(item))
+			return false;
+
+		hash_combine(key, (uint64_t)(uintptr_t)item);
+		hash_combine(key, item->user_visible);
+
+		if (item->user_visible) {
+			if (!source_content_key(item->source, key))
+				return false;
+
+			hash_data(key, &item->crop, sizeof(item->crop));
+			hash_data(key, &item->draw_transform,
+					sizeof(item->draw_transform));
+			hash_combine(key, item->scale_filter);
+		}
+
+		item = item->next;
+	}
+
+	return true;
+}
+
+/* computes a key that changes whenever the rendered output of the source may
+ * have changed, returns false if the source cannot be cached at all */
+static bool source_content_key(obs_source_t *source, uint64_t *key)
+{
+	uint32_t flags = source->info.output_flags;
+	bool is_static = true;
+
+	if (!source->context.data || source->defer_update)
+		return false;
+
+	if (source->info.type == OBS_SOURCE_TYPE_SCENE) {
+		obs_scene_t *scene = source->context.data;
+
+		video_lock(scene);
+		is_static = scene_content_key(scene, key);
+		video_unlock(scene);
+
+		if (!is_static)
+			return false;
+
+	} else if ((flags & OBS_SOURCE_STATIC_VIDEO) == 0 ||
+	           (flags & OBS_SOURCE_ASYNC) != 0) {
+		return false;
+	}
+
+	hash_combine(key, (uint64_t)(uintptr_t)source);
+	hash_combine(key, (uint64_t)os_atomic_load_long(&source->video_version));
+	hash_combine(key, obs_source_get_width(source));
+	hash_combine(key, obs_source_get_height(source));
+
+	pthread_mutex_lock(&source->filter_mutex);
+
+	for (size_t i = 0; i < source->filters.num; i++) {
+		obs_source_t *filter = source->filters.array[i];
+
+		hash_combine(key, filter->enabled);
+		if (!filter->enabled)
+			continue;
+
+		if (!source_content_key(filter, key)) {
+			is_static = false;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	return is_static;
+}
+
+static inline void update_render_cache_stats(bool hit, uint64_t saved_ns)
+{
+	struct obs_render_cache_stats *stats = &obs->video.render_cache_stats;
+
+	pthread_mutex_lock(&obs->video.render_cache_mutex);
+	if (hit) {
+		stats->hits++;
+		stats->saved_ns += saved_ns;
+	} else {
+		stats->misses++;
+	}
+	pthread_mutex_unlock(&obs->video.render_cache_mutex);
+}
+
+/* returns false if the item's content can't be cached */
+static bool item_cache_key(struct obs_scene_item *item, uint64_t *key)
+{
+	*key = 14695981039346656037ULL;
+	hash_data(key, &item->crop, sizeof(item->crop));
+
+	if (!source_content_key(item->source, key)) {
+		item->cache_valid = false;
+		return false;
+	}
+
+	return true;
+}
+
+/* returns true if the texture of the item can be reused as it is */
+static bool item_cache_hit(struct obs_scene_item *item, uint64_t key)
+{
+	if (item->cache_valid && item->cache_key == key &&
+	    gs_texrender_get_texture(item->item_render)) {
+		update_render_cache_stats(true, item->cache_render_ns);
+		return true;
+	}
+
+	return false;
+}
+
+/* items that are otherwise drawn directly are only worth drawing through a
+ * cached texture if rendering them does more than draw a single texture,
+ * which is the case for groups and for sources with filters */
+static inline bool item_cache_worthwhile(const struct obs_scene_item *item)
+{
+	return item->is_group || item->source->filters.num > 0;
+}
+
+/* creates or destroys the texture of an item that only needs one while its
+ * content can be cached.  assumes graphics context. */
+static void update_item_cache_texture(struct obs_scene_item *item,
+		bool cacheable)
+{
+	if (!item->item_render && cacheable) {
+		item->item_render = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+		item->cache_valid = false;
+
+	} else if (item->item_render && !cacheable &&
+	           !item_texture_enabled(item)) {
+		gs_texrender_destroy(item->item_render);
+		item->item_render = NULL;
+		item->cache_valid = false;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
 static inline void render_item(struct obs_scene_item *item)
 {
+	bool cacheable = false;
+	uint64_t key = 0;
+
+	if (item->item_render || item_cache_worthwhile(item)) {
+		cacheable = item_cache_key(item, &key);
+		update_item_cache_texture(item, cacheable);
+	}
+
 	if (item->item_render) {
 		uint32_t width  = obs_source_get_width(item->source);
 		uint32_t height = obs_source_get_height(item->source);
@@ -517,7 +697,11 @@ static inline void render_item(struct obs_scene_item *item)
 		uint32_t cx = calc_cx(item, width);
 		uint32_t cy = calc_cy(item, height);
 
-		if (cx && cy && gs_texrender_begin(item->item_render, cx, cy)) {
+		if (cacheable && item_cache_hit(item, key)) {
+			/* texture is still up to date */
+
+		} else if (cx && cy &&
+		           gs_texrender_begin(item->item_render, cx, cy)) {
 			float cx_scale = (float)width  / (float)cx;
 			float cy_scale = (float)height / (float)cy;
 			struct vec4 clear_color;
@@ -533,11 +717,21 @@ static inline void render_item(struct obs_scene_item *item)
 					-(float)item->crop.top,
 					0.0f);
 
+			uint64_t start_time = os_gettime_ns();
+
 			gs_blend_state_push();
 			gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
 			obs_source_video_render(item->source);
 			gs_blend_state_pop();
 			gs_texrender_end(item->item_render);
+
+			if (cacheable) {
+				item->cache_valid = true;
+				item->cache_key = key;
+				item->cache_render_ns =
+					os_gettime_ns() - start_time;
+				update_render_cache_stats(false, 0);
+			}
 		}
 	}
 
@@ -935,7 +1129,7 @@ static void apply_scene_item_audio_actions(struct obs_scene_item *item,
 		new_frame_num = (timestamp - ts) * (uint64_t)sample_rate /
 			1000000000ULL;
 
-		if (ts && new_frame_num >= AUDIO_OUTPUT_FRAMES)
+		if (ts && new_frame_num >= obs->audio.output_frames)
 			break;
 
 		da_erase(item->audio_actions, i--);
@@ -953,7 +1147,7 @@ static void apply_scene_item_audio_actions(struct obs_scene_item *item,
 	}
 
 	if (buf) {
-		for (; frame_num < AUDIO_OUTPUT_FRAMES; frame_num++)
+		for (; frame_num < obs->audio.output_frames; frame_num++)
 			buf[frame_num] = cur_visible ? 1.0f : 0.0f;
 	}
 
@@ -982,7 +1176,7 @@ static bool apply_scene_item_volume(struct obs_scene_item *item,
 	pthread_mutex_unlock(&item->actions_mutex);
 
 	if (actions_pending) {
-		uint64_t duration = (uint64_t)AUDIO_OUTPUT_FRAMES *
+		uint64_t duration = (uint64_t)obs->audio.output_frames *
 			1000000000ULL / (uint64_t)sample_rate;
 
 		if (!ts || action.timestamp < (ts + duration)) {
@@ -1084,7 +1278,12 @@ static bool scene_audio_render(void *data, uint64_t *ts_out,
 
 		pos = (size_t)ns_to_audio_frames(sample_rate,
 				source_ts - timestamp);
-		count = AUDIO_OUTPUT_FRAMES - pos;
+		if (pos >= obs->audio.output_frames) {
+			item = item->next;
+			continue;
+		}
+
+		count = obs->audio.output_frames - pos;
 
 		if (!apply_buf && !item->visible) {
 			item = item->next;
@@ -51,6 +51,12 @@ struct obs_scene_item {
 	gs_texrender_t        *item_render;
 	struct obs_sceneitem_crop crop;
 
+	/* content key of what was last rendered to item_render, used to skip
+	 * rendering static content again */
+	bool                  cache_valid;
+	uint64_t              cache_key;
+	uint64_t              cache_render_ns;
+
 	struct vec2           pos;
 	struct vec2           scale;
 	float                 rot;
@@ -0,0 +1,170 @@
+/******************************************************************************
+    Copyright (C) 2018 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "obs-internal.h"
+
+/* a small pool of worker threads that runs a function on each source of a
+ * batch, used for parallel source ticking and audio rendering */
+
+static bool run_pool_source(struct source_pool *pool)
+{
+	void (*func)(void *param, struct obs_source *source);
+	struct obs_source *source;
+	void *param;
+
+	/* workers can wake up late, so only look at the batch while it's
+	 * actually running */
+	pthread_mutex_lock(&pool->mutex);
+	if (!pool->running || pool->next == pool->sources.num) {
+		pthread_mutex_unlock(&pool->mutex);
+		return false;
+	}
+	source = pool->sources.array[pool->next++];
+	func   = pool->func;
+	param  = pool->param;
+	pthread_mutex_unlock(&pool->mutex);
+
+	func(param, source);
+
+	pthread_mutex_lock(&pool->mutex);
+	if (++pool->completed == pool->sources.num)
+		os_event_signal(pool->done_event);
+	pthread_mutex_unlock(&pool->mutex);
+	return true;
+}
+
+static void *source_pool_thread(void *param)
+{
+	struct source_pool *pool = param;
+
+	os_set_thread_name(pool->thread_name);
+
+	while (os_sem_wait(pool->start_sem) == 0) {
+		if (pool->stop)
+			break;
+
+		while (run_pool_source(pool));
+	}
+
+	return NULL;
+}
+
+bool source_pool_init(struct source_pool *pool, const char *thread_name,
+		int max_threads)
+{
+	int num_threads = os_get_logical_cores() - 1;
+
+	if (num_threads > max_threads)
+		num_threads = max_threads;
+
+	memset(pool, 0, sizeof(*pool));
+	pool->thread_name = thread_name;
+
+	/* on single core machines, everything runs on the calling thread */
+	if (num_threads <= 0)
+		return true;
+
+	if (pthread_mutex_init(&pool->mutex, NULL) != 0)
+		return false;
+	if (os_sem_init(&pool->start_sem, 0) != 0)
+		return false;
+	if (os_event_init(&pool->done_event, OS_EVENT_TYPE_MANUAL) != 0)
+		return false;
+
+	for (int i = 0; i < num_threads; i++) {
+		pthread_t thread;
+
+		if (pthread_create(&thread, NULL, source_pool_thread,
+					pool) != 0) {
+			blog(LOG_WARNING, "Failed to create '%s' %d",
+					thread_name, i);
+			break;
+		}
+
+		da_push_back(pool->threads, &thread);
+	}
+
+	return true;
+}
+
+void source_pool_free(struct source_pool *pool)
+{
+	if (!pool->start_sem) {
+		da_free(pool->sources);
+		return;
+	}
+
+	pool->stop = true;
+	for (size_t i = 0; i < pool->threads.num; i++)
+		os_sem_post(pool->start_sem);
+	for (size_t i = 0; i < pool->threads.num; i++)
+		pthread_join(pool->threads.array[i], NULL);
+
+	da_free(pool->threads);
+	da_free(pool->sources);
+	os_event_destroy(pool->done_event);
+	os_sem_destroy(pool->start_sem);
+	pthread_mutex_destroy(&pool->mutex);
+	memset(pool, 0, sizeof(*pool));
+}
+
+void source_pool_start(struct source_pool *pool,
+		void (*func)(void *param, obs_source_t *source), void *param)
+{
+	size_t num_wake;
+
+	pool->func  = func;
+	pool->param = param;
+
+	if (!pool->sources.num || !pool->threads.num)
+		return;
+
+	os_event_reset(pool->done_event);
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->next      = 0;
+	pool->completed = 0;
+	pool->running   = true;
+	pthread_mutex_unlock(&pool->mutex);
+
+	/* the joining thread works on the batch as well */
+	num_wake = pool->sources.num - 1;
+	if (num_wake > pool->threads.num)
+		num_wake = pool->threads.num;
+
+	for (size_t i = 0; i < num_wake; i++)
+		os_sem_post(pool->start_sem);
+}
+
+void source_pool_join(struct source_pool *pool)
+{
+	if (!pool->sources.num)
+		return;
+
+	if (!pool->threads.num) {
+		for (size_t i = 0; i < pool->sources.num; i++)
+			pool->func(pool->param, pool->sources.array[i]);
+		return;
+	}
+
+	while (run_pool_source(pool));
+	os_event_wait(pool->done_event);
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->running = false;
+	pthread_mutex_unlock(&pool->mutex);
+}
@@ -843,7 +843,7 @@ static void process_audio(obs_source_t *transition, obs_source_t *child,
 	obs_source_get_audio_mix(child, &child_audio);
 	pos = (size_t)ns_to_audio_frames(sample_rate, ts - min_ts);
 
-	if (pos > AUDIO_OUTPUT_FRAMES)
+	if (pos > obs->audio.output_frames)
 		return;
 
 	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
@@ -858,12 +858,26 @@ static void process_audio(obs_source_t *transition, obs_source_t *child,
 			float *in = input->data[ch];
 
 			mix_child(transition, out + pos, in,
-					AUDIO_OUTPUT_FRAMES - pos,
+					obs->audio.output_frames - pos,
 					sample_rate, ts, mix);
 		}
 	}
 }
 
+static void copy_audio(obs_source_t *child,
+		struct obs_source_audio_mix *audio, uint32_t mixers)
+{
+	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
+		if ((mixers & (1 << mix_idx)) == 0)
+			continue;
+
+		memcpy(audio->output[mix_idx].data[0],
+				child->audio_output_buf[mix_idx][0],
+				AUDIO_OUTPUT_FRAMES * MAX_AUDIO_CHANNELS *
+				sizeof(float));
+	}
+}
+
 static inline uint64_t calc_min_ts(obs_source_t *sources[2])
 {
 	uint64_t min_ts = 0;
@@ -941,9 +955,7 @@ bool obs_transition_audio_render(obs_source_t *transition,
 						min_ts, mixers, channels,
 						sample_rate, mix_b);
 		} else if (state.s[0]) {
-			memcpy(audio->output[0].data[0],
-					state.s[0]->audio_output_buf[0][0],
-					TOTAL_AUDIO_SIZE);
+			copy_audio(state.s[0], audio, mixers);
 		}
 
 		obs_source_release(state.s[0]);
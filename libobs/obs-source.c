@@ -98,19 +98,26 @@ const char *obs_source_get_display_name(const char *id)
 	return (info != NULL) ? info->get_name(info->type_data) : NULL;
 }
 
-static void allocate_audio_output_buffer(struct obs_source *source)
+static void allocate_audio_output_buffer(struct obs_source *source,
+		size_t mix)
 {
-	size_t size = sizeof(float) *
-		AUDIO_OUTPUT_FRAMES * MAX_AUDIO_CHANNELS * MAX_AUDIO_MIXES;
+	size_t size = sizeof(float) * AUDIO_OUTPUT_FRAMES * MAX_AUDIO_CHANNELS;
 	float *ptr = bzalloc(size);
 
-	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
-		size_t mix_pos = mix * AUDIO_OUTPUT_FRAMES * MAX_AUDIO_CHANNELS;
+	for (size_t i = 0; i < MAX_AUDIO_CHANNELS; i++)
+		source->audio_output_buf[mix][i] = ptr + AUDIO_OUTPUT_FRAMES * i;
+}
 
-		for (size_t i = 0; i < MAX_AUDIO_CHANNELS; i++) {
-			source->audio_output_buf[mix][i] =
-				ptr + mix_pos + AUDIO_OUTPUT_FRAMES * i;
-		}
+/* the first mix is always allocated, as it's also used to pull audio data
+ * from the source.  the other mixes are only allocated once something is
+ * actually connected to them, which happens on the audio thread. */
+static inline void allocate_audio_mixes(struct obs_source *source,
+		uint32_t mixers)
+{
+	for (size_t mix = 1; mix < MAX_AUDIO_MIXES; mix++) {
+		if ((mixers & (1 << mix)) != 0 &&
+		    !source->audio_output_buf[mix][0])
+			allocate_audio_output_buffer(source, mix);
 	}
 }
 
@@ -132,6 +139,22 @@ static inline bool is_composite_source(const struct obs_source *source)
 
 extern char *find_libobs_data_file(const char *file);
 
+/* the queue between a source's audio thread and the audio thread holds about
+ * a second of audio at the current channel count and sample rate, plus room
+ * for the packet headers */
+#define AUDIO_RING_MS           1000
+#define AUDIO_RING_HEADER_SPACE (4 * 1024)
+
+static size_t get_audio_ring_size(void)
+{
+	audio_t *audio = obs->audio.audio;
+	size_t channels = audio ? audio_output_get_channels(audio) : 2;
+	size_t rate = audio ? audio_output_get_sample_rate(audio) : 48000;
+
+	return rate * channels * sizeof(float) * AUDIO_RING_MS / 1000 +
+		AUDIO_RING_HEADER_SPACE;
+}
+
 /* internal initialization */
 bool obs_source_init(struct obs_source *source)
 {
@@ -164,7 +187,11 @@ bool obs_source_init(struct obs_source *source)
 		return false;
 
 	if (is_audio_source(source) || is_composite_source(source))
-		allocate_audio_output_buffer(source);
+		allocate_audio_output_buffer(source, 0);
+
+	if (source->info.type == OBS_SOURCE_TYPE_INPUT &&
+	    is_audio_source(source) && !source->info.audio_render)
+		spsc_ring_init(&source->audio_ring, get_audio_ring_size());
 
 	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION) {
 		if (!obs_transition_init(source))
@@ -512,10 +539,77 @@ void obs_source_frame_init(struct obs_source_frame *frame,
 	}
 }
 
+/* frames of the async cache either use buffers from the global frame pool,
+ * or buffers owned by the source itself, which are given back to it with the
+ * release callback once libobs is done with them */
+struct cached_frame {
+	struct obs_source_frame frame;
+	void (*release)(void *param);
+	void *param;
+};
+
+static inline bool cached_frame_external(struct obs_source_frame *frame)
+{
+	return ((struct cached_frame*)frame)->release != NULL;
+}
+
+static struct obs_source_frame *cached_frame_create(enum video_format format,
+		uint32_t width, uint32_t height)
+{
+	struct cached_frame *cached = bzalloc(sizeof(*cached));
+	struct obs_source_frame *frame = &cached->frame;
+	struct video_frame vid_frame;
+	size_t size = video_frame_get_size(format, width, height);
+	uint8_t *data = NULL;
+
+	if (size)
+		data = frame_pool_alloc(&obs->data.frame_pool, size);
+
+	video_frame_init_buffer(&vid_frame, format, width, height, data);
+	frame->format = format;
+	frame->width  = width;
+	frame->height = height;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		frame->data[i]     = vid_frame.data[i];
+		frame->linesize[i] = vid_frame.linesize[i];
+	}
+
+	return frame;
+}
+
+static struct obs_source_frame *cached_frame_create_external(
+		const struct obs_source_frame *src,
+		void (*release)(void *param), void *param)
+{
+	struct cached_frame *cached = bzalloc(sizeof(*cached));
+
+	cached->frame      = *src;
+	cached->frame.refs = 1;
+	cached->frame.prev_frame = false;
+	cached->release    = release;
+	cached->param      = param;
+	return &cached->frame;
+}
+
+static inline void cached_frame_destroy(struct obs_source_frame *frame)
+{
+	struct cached_frame *cached = (struct cached_frame*)frame;
+
+	if (!cached)
+		return;
+
+	if (cached->release)
+		cached->release(cached->param);
+	else
+		frame_pool_release(&obs->data.frame_pool, frame->data[0]);
+	bfree(cached);
+}
+
 static inline void obs_source_frame_decref(struct obs_source_frame *frame)
 {
 	if (os_atomic_dec_long(&frame->refs) == 0)
-		obs_source_frame_destroy(frame);
+		cached_frame_destroy(frame);
 }
 
 static bool obs_source_filter_remove_refless(obs_source_t *source,
@@ -585,8 +679,10 @@ void obs_source_destroy(struct obs_source *source)
 		bfree(source->audio_data.data[i]);
 	for (i = 0; i < MAX_AUDIO_CHANNELS; i++)
 		circlebuf_free(&source->audio_input_buf[i]);
+	spsc_ring_free(&source->audio_ring);
 	audio_resampler_destroy(source->resampler);
-	bfree(source->audio_output_buf[0][0]);
+	for (i = 0; i < MAX_AUDIO_MIXES; i++)
+		bfree(source->audio_output_buf[i][0]);
 
 	obs_source_frame_destroy(source->async_preload_frame);
 
@@ -802,6 +898,7 @@ static void obs_source_deferred_update(obs_source_t *source)
 				source->context.settings);
 
 	source->defer_update = false;
+	os_atomic_inc_long(&source->video_version);
 }
 
 void obs_source_update(obs_source_t *source, obs_data_t *settings)
@@ -820,6 +917,14 @@ void obs_source_update(obs_source_t *source, obs_data_t *settings)
 	}
 }
 
+void obs_source_invalidate_video(obs_source_t *source)
+{
+	if (!obs_source_valid(source, "obs_source_invalidate_video"))
+		return;
+
+	os_atomic_inc_long(&source->video_version);
+}
+
 void obs_source_update_properties(obs_source_t *source)
 {
 	if (!obs_source_valid(source, "obs_source_update_properties"))
@@ -995,6 +1100,12 @@ void obs_source_deactivate(obs_source_t *source, enum view_type type)
 
 static inline struct obs_source_frame *get_closest_frame(obs_source_t *source,
 		uint64_t sys_time);
+/* the software device cannot run the format conversion shaders */
+static inline bool gpu_conversion_supported(void)
+{
+	return gs_get_device_type() != GS_DEVICE_SOFTWARE;
+}
+
 bool set_async_texture_size(struct obs_source *source,
 		const struct obs_source_frame *frame);
 
@@ -1027,11 +1138,19 @@ static void async_tick(obs_source_t *source)
 
 void obs_source_video_tick(obs_source_t *source, float seconds)
 {
-	bool now_showing, now_active;
-
 	if (!obs_source_valid(source, "obs_source_video_tick"))
 		return;
 
+	obs_source_video_tick_internal(source, seconds, true);
+}
+
+/* when call_tick is false, the caller is responsible for calling the
+ * video_tick callback of the source itself (see tick_sources) */
+void obs_source_video_tick_internal(obs_source_t *source, float seconds,
+		bool call_tick)
+{
+	bool now_showing, now_active;
+
 	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
 		obs_transition_tick(source);
 
@@ -1069,7 +1188,7 @@ void obs_source_video_tick(obs_source_t *source, float seconds)
 		source->active = now_active;
 	}
 
-	if (source->context.data && source->info.video_tick)
+	if (call_tick && source->context.data && source->info.video_tick)
 		source->info.video_tick(source->context.data, seconds);
 
 	source->async_rendered = false;
@@ -1106,7 +1225,7 @@ static inline void reset_audio_timing(obs_source_t *source, uint64_t timestamp,
 	source->timing_adjust = os_time - timestamp;
 }
 
-static void reset_audio_data(obs_source_t *source, uint64_t os_time)
+static void clear_audio_input_buf(obs_source_t *source, uint64_t os_time)
 {
 	for (size_t i = 0; i < MAX_AUDIO_CHANNELS; i++) {
 		if (source->audio_input_buf[i].size)
@@ -1116,6 +1235,15 @@ static void reset_audio_data(obs_source_t *source, uint64_t os_time)
 
 	source->last_audio_input_buf_size = 0;
 	source->audio_ts = os_time;
+}
+
+/* must be called with both audio_mutex and audio_buf_mutex locked */
+static void reset_audio_data(obs_source_t *source, uint64_t os_time)
+{
+	if (source->audio_ring.data)
+		spsc_ring_clear(&source->audio_ring);
+
+	clear_audio_input_buf(source, os_time);
 	source->next_audio_sys_ts_min = os_time;
 }
 
@@ -1126,9 +1254,7 @@ static void handle_ts_jump(obs_source_t *source, uint64_t expected,
 	                "expected value %"PRIu64", input value %"PRIu64,
 	                source->context.name, diff, expected, ts);
 
-	pthread_mutex_lock(&source->audio_buf_mutex);
 	reset_audio_timing(source, ts, os_time);
-	pthread_mutex_unlock(&source->audio_buf_mutex);
 }
 
 static void source_signal_audio_data(obs_source_t *source,
@@ -1155,27 +1281,56 @@ static inline size_t get_buf_placement(audio_t *audio, uint64_t offset)
 	return (size_t)(offset * (uint64_t)sample_rate / 1000000000ULL);
 }
 
+struct audio_ring_packet {
+	uint64_t timestamp;
+	uint32_t frames;
+	uint32_t channels;
+	bool     push_back;
+};
+
+/* gets the data of one channel of a packet, either from the ring or, when the
+ * packet bypasses the ring, straight from the source's audio data */
+static inline void get_packet_data(obs_source_t *source,
+		const struct audio_ring_packet *packet,
+		const struct audio_data *in, size_t offset, size_t channel,
+		const uint8_t **data1, size_t *size1,
+		const uint8_t **data2, size_t *size2)
+{
+	size_t size = packet->frames * sizeof(float);
+
+	if (in) {
+		*data1 = in->data[channel];
+		*size1 = size;
+		*data2 = NULL;
+		*size2 = 0;
+	} else {
+		spsc_ring_peek_ptrs(&source->audio_ring, offset + channel * size,
+				size, data1, size1, data2, size2);
+	}
+}
+
 static void source_output_audio_place(obs_source_t *source,
-		const struct audio_data *in)
+		const struct audio_ring_packet *packet,
+		const struct audio_data *in, size_t offset)
 {
 	audio_t *audio = obs->audio.audio;
 	size_t buf_placement;
-	size_t channels = audio_output_get_channels(audio);
-	size_t size = in->frames * sizeof(float);
+	size_t channels = packet->channels;
+	size_t size = packet->frames * sizeof(float);
 
-	if (!source->audio_ts || in->timestamp < source->audio_ts)
-		reset_audio_data(source, in->timestamp);
+	if (!source->audio_ts || packet->timestamp < source->audio_ts)
+		clear_audio_input_buf(source, packet->timestamp);
 
 	buf_placement = get_buf_placement(audio,
-			in->timestamp - source->audio_ts) * sizeof(float);
+			packet->timestamp - source->audio_ts) * sizeof(float);
 
 #if DEBUG_AUDIO == 1
 	blog(LOG_DEBUG, "frames: %lu, size: %lu, placement: %lu, base_ts: %llu, ts: %llu",
-			(unsigned long)in->frames,
+			(unsigned long)packet->frames,
 			(unsigned long)source->audio_input_buf[0].size,
 			(unsigned long)buf_placement,
 			source->audio_ts,
-			in->timestamp);
+			packet->timestamp);
 #endif
 
 	/* do not allow the circular buffers to become too big */
@@ -1183,36 +1338,173 @@ static void source_output_audio_place(obs_source_t *source,
 		return;
 
 	for (size_t i = 0; i < channels; i++) {
-		circlebuf_place(&source->audio_input_buf[i], buf_placement,
-				in->data[i], size);
-		circlebuf_pop_back(&source->audio_input_buf[i], NULL,
-				source->audio_input_buf[i].size -
-				(buf_placement + size));
+		struct circlebuf *buf = &source->audio_input_buf[i];
+		const uint8_t *data1, *data2;
+		size_t size1, size2;
+
+		get_packet_data(source, packet, in, offset, i,
+				&data1, &size1, &data2, &size2);
+
+		circlebuf_place(buf, buf_placement, data1, size1);
+		if (size2)
+			circlebuf_place(buf, buf_placement + size1,
+					data2, size2);
+
+		circlebuf_pop_back(buf, NULL,
+				buf->size - (buf_placement + size));
 	}
 
 	source->last_audio_input_buf_size = 0;
 }
 
 static inline void source_output_audio_push_back(obs_source_t *source,
-		const struct audio_data *in)
+		const struct audio_ring_packet *packet,
+		const struct audio_data *in, size_t offset)
 {
-	audio_t *audio = obs->audio.audio;
-	size_t channels = audio_output_get_channels(audio);
-	size_t size = in->frames * sizeof(float);
+	size_t channels = packet->channels;
+	size_t size = packet->frames * sizeof(float);
 
 	/* do not allow the circular buffers to become too big */
 	if ((source->audio_input_buf[0].size + size) > MAX_BUF_SIZE)
 		return;
 
-	for (size_t i = 0; i < channels; i++)
-		circlebuf_push_back(&source->audio_input_buf[i],
-				in->data[i], size);
+	for (size_t i = 0; i < channels; i++) {
+		const uint8_t *data1, *data2;
+		size_t size1, size2;
+
+		get_packet_data(source, packet, in, offset, i,
+				&data1, &size1, &data2, &size2);
+
+		circlebuf_push_back(&source->audio_input_buf[i], data1, size1);
+		if (size2)
+			circlebuf_push_back(&source->audio_input_buf[i],
+					data2, size2);
+	}
 
 	/* reset audio input buffer size to ensure that audio doesn't get
 	 * perpetually cut */
 	source->last_audio_input_buf_size = 0;
 }
 
+/* must be called with audio_buf_mutex locked */
+static void output_audio_packet(obs_source_t *source,
+		const struct audio_ring_packet *packet,
+		const struct audio_data *in, size_t offset)
+{
+	size_t channels = audio_output_get_channels(obs->audio.audio);
+
+	/* audio output before an audio reset is discarded */
+	if (packet->channels != channels)
+		return;
+
+	if (packet->push_back && source->audio_ts)
+		source_output_audio_push_back(source, packet, in, offset);
+	else
+		source_output_audio_place(source, packet, in, offset);
+}
+
+/* must be called with audio_buf_mutex locked */
+static void drain_audio_ring(obs_source_t *source)
+{
+	struct spsc_ring *ring = &source->audio_ring;
+	struct audio_ring_packet packet;
+
+	while (spsc_ring_size(ring) >= sizeof(packet)) {
+		size_t offset = sizeof(packet);
+
+		spsc_ring_peek(ring, 0, &packet, sizeof(packet));
+		output_audio_packet(source, &packet, NULL, offset);
+		spsc_ring_pop(ring, offset +
+				packet.channels * packet.frames * sizeof(float));
+	}
+}
+
+/* moves audio queued by the source's thread to its input buffers, called
+ * from the audio thread every tick */
+void obs_source_receive_audio(obs_source_t *source)
+{
+	pthread_mutex_lock(&source->audio_buf_mutex);
+
+	if (source->audio_ring.data)
+		drain_audio_ring(source);
+
+	pthread_mutex_unlock(&source->audio_buf_mutex);
+}
+
+/* used when a packet doesn't fit in the queue: waits for the audio thread,
+ * then outputs everything queued so far followed by the packet itself so
+ * that nothing gets dropped.  the queue is also grown here when an audio reset
+ * raised the channel count or sample rate, or when a single packet is bigger
+ * than the whole queue. */
+static void output_audio_direct(obs_source_t *source,
+		const struct audio_ring_packet *packet,
+		const struct audio_data *in)
+{
+	struct spsc_ring *ring = &source->audio_ring;
+	size_t packet_size = sizeof(*packet) +
+		packet->channels * packet->frames * sizeof(float);
+	size_t ring_size = get_audio_ring_size();
+
+	if (ring_size <= packet_size)
+		ring_size = packet_size + AUDIO_RING_HEADER_SPACE;
+
+	pthread_mutex_lock(&source->audio_buf_mutex);
+
+	drain_audio_ring(source);
+	output_audio_packet(source, packet, in, 0);
+
+	if (ring->capacity < ring_size) {
+		spsc_ring_free(ring);
+		spsc_ring_init(ring, ring_size);
+	}
+
+	pthread_mutex_unlock(&source->audio_buf_mutex);
+}
+
+/* queues audio for the audio thread.  only blocks on the audio thread when the
+ * queue is full, which is much better than dropping the audio */
+static void queue_audio_data(obs_source_t *source,
+		const struct audio_data *in, bool push_back)
+{
+	struct spsc_ring *ring = &source->audio_ring;
+	size_t channels = audio_output_get_channels(obs->audio.audio);
+	size_t size = in->frames * sizeof(float);
+	size_t offset = sizeof(struct audio_ring_packet);
+	struct audio_ring_packet packet;
+
+	if (!ring->data)
+		return;
+
+	packet.timestamp = in->timestamp;
+	packet.frames    = in->frames;
+	packet.channels  = (uint32_t)channels;
+	packet.push_back = push_back;
+
+	if (spsc_ring_free_space(ring) < offset + channels * size) {
+		if (!source->audio_ring_overflowed)
+			blog(LOG_WARNING, "Source '%s' audio queue is full, "
+					"waiting for the audio thread",
+					source->context.name);
+
+		os_atomic_inc_long(&source->audio_overflows);
+		source->audio_ring_overflowed = true;
+
+		output_audio_direct(source, &packet, in);
+		return;
+	}
+
+	source->audio_ring_overflowed = false;
+
+	spsc_ring_write(ring, 0, &packet, sizeof(packet));
+
+	for (size_t i = 0; i < channels; i++) {
+		spsc_ring_write(ring, offset, in->data[i], size);
+		offset += size;
+	}
+
+	spsc_ring_commit(ring, offset);
+}
+
 static inline bool source_muted(obs_source_t *source, uint64_t os_time)
 {
 	if (source->push_to_mute_enabled && source->user_push_to_mute_pressed)
@@ -1272,8 +1564,6 @@ static void source_output_audio_data(obs_source_t *source,
 
 	in.timestamp += source->timing_adjust;
 
-	pthread_mutex_lock(&source->audio_buf_mutex);
-
 	if (source->next_audio_sys_ts_min == in.timestamp) {
 		push_back = true;
 
@@ -1309,14 +1599,8 @@ static void source_output_audio_data(obs_source_t *source,
 		source->last_sync_offset = sync_offset;
 	}
 
-	if (source->monitoring_type != OBS_MONITORING_TYPE_MONITOR_ONLY) {
-		if (push_back && source->audio_ts)
-			source_output_audio_push_back(source, &in);
-		else
-			source_output_audio_place(source, &in);
-	}
-
-	pthread_mutex_unlock(&source->audio_buf_mutex);
+	if (source->monitoring_type != OBS_MONITORING_TYPE_MONITOR_ONLY)
+		queue_audio_data(source, &in, push_back);
 
 	source_signal_audio_data(source, data, source_muted(source, os_time));
 }
@@ -1373,8 +1657,9 @@ static inline bool set_planar420_sizes(struct obs_source *source,
 	source->async_convert_width   = frame->width;
 	source->async_convert_height  = size / frame->width;
 	source->async_texture_format  = GS_R8;
-	source->async_plane_offset[0] = (int)(frame->data[1] - frame->data[0]);
-	source->async_plane_offset[1] = (int)(frame->data[2] - frame->data[0]);
+	source->async_plane_offset[0] = (int)(frame->width * frame->height);
+	source->async_plane_offset[1] = source->async_plane_offset[0] +
+		(int)((frame->width / 2) * (frame->height / 2));
 	return true;
 }
 
@@ -1387,7 +1672,7 @@ static inline bool set_nv12_sizes(struct obs_source *source,
 	source->async_convert_width   = frame->width;
 	source->async_convert_height  = size / frame->width;
 	source->async_texture_format  = GS_R8;
-	source->async_plane_offset[0] = (int)(frame->data[1] - frame->data[0]);
+	source->async_plane_offset[0] = (int)(frame->width * frame->height);
 	return true;
 }
 
@@ -1439,7 +1724,8 @@ bool set_async_texture_size(struct obs_source *source,
 	source->async_texrender = NULL;
 	source->async_prev_texrender = NULL;
 
-	if (cur != CONVERT_NONE && init_gpu_conversion(source, frame)) {
+	if (cur != CONVERT_NONE && gpu_conversion_supported() &&
+	    init_gpu_conversion(source, frame)) {
 		source->async_gpu_conversion = true;
 
 		source->async_texrender =
@@ -1469,6 +1755,62 @@ bool set_async_texture_size(struct obs_source *source,
 	return !!source->async_texture;
 }
 
+/* the conversion shaders read the planes one after another from the texture
+ * as if it were a single buffer with rows the width of the texture, so each
+ * plane row is copied to its position in that layout.  the planes can be
+ * anywhere in memory and padded to any line size. */
+static void upload_plane(uint8_t *dst, uint32_t dst_linesize,
+		uint32_t tex_width, size_t *pos, const uint8_t *src,
+		uint32_t src_linesize, uint32_t width, uint32_t height)
+{
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t *row = src + (size_t)y * src_linesize;
+		uint32_t left = width;
+
+		while (left) {
+			size_t x = *pos % tex_width;
+			size_t tex_y = *pos / tex_width;
+			uint32_t count = (uint32_t)(tex_width - x);
+
+			if (count > left)
+				count = left;
+
+			memcpy(dst + tex_y * dst_linesize + x, row, count);
+			row += count;
+			left -= count;
+			*pos += count;
+		}
+	}
+}
+
+static void upload_planar_frame(gs_texture_t *tex,
+		const struct obs_source_frame *frame)
+{
+	uint32_t width  = frame->width;
+	uint32_t height = frame->height;
+	uint32_t linesize;
+	uint8_t *ptr;
+	size_t pos = 0;
+
+	if (!gs_texture_map(tex, &ptr, &linesize))
+		return;
+
+	upload_plane(ptr, linesize, width, &pos, frame->data[0],
+			frame->linesize[0], width, height);
+
+	if (frame->format == VIDEO_FORMAT_I420) {
+		upload_plane(ptr, linesize, width, &pos, frame->data[1],
+				frame->linesize[1], width / 2, height / 2);
+		upload_plane(ptr, linesize, width, &pos, frame->data[2],
+				frame->linesize[2], width / 2, height / 2);
+	} else {
+		upload_plane(ptr, linesize, width, &pos, frame->data[1],
+				frame->linesize[1], width, height / 2);
+	}
+
+	gs_texture_unmap(tex);
+}
+
 static void upload_raw_frame(gs_texture_t *tex,
 		const struct obs_source_frame *frame)
 {
@@ -1480,13 +1822,8 @@ static void upload_raw_frame(gs_texture_t *tex,
 			break;
 
 		case CONVERT_420:
-			gs_texture_set_image(tex, frame->data[0],
-					frame->width, false);
-			break;
-
 		case CONVERT_NV12:
-			gs_texture_set_image(tex, frame->data[0],
-					frame->width, false);
+			upload_planar_frame(tex, frame);
 			break;
 
 		case CONVERT_NONE:
@@ -2334,7 +2671,7 @@ static void clean_cache(obs_source_t *source)
 		struct async_frame *af = &source->async_cache.array[i - 1];
 		if (!af->used) {
 			if (++af->unused_count == MAX_UNUSED_FRAME_DURATION) {
-				obs_source_frame_destroy(af->frame);
+				cached_frame_destroy(af->frame);
 				da_erase(source->async_cache, i - 1);
 			}
 		}
@@ -2383,7 +2720,7 @@ static inline struct obs_source_frame *cache_video(struct obs_source *source,
 		if (format == VIDEO_FORMAT_Y800)
 			format = VIDEO_FORMAT_BGRX;
 
-		new_frame = obs_source_frame_create(format,
+		new_frame = cached_frame_create(format,
 				frame->width, frame->height);
 		new_af.frame = new_frame;
 		new_af.used = true;
@@ -2400,7 +2737,7 @@ static inline struct obs_source_frame *cache_video(struct obs_source *source,
 	copy_frame_data(new_frame, frame);
 
 	if (os_atomic_dec_long(&new_frame->refs) == 0) {
-		obs_source_frame_destroy(new_frame);
+		cached_frame_destroy(new_frame);
 		new_frame = NULL;
 	}
 
@@ -2414,6 +2751,11 @@ void obs_source_output_video(obs_source_t *source,
 		return;
 
 	if (!frame) {
+		/* gives any held external buffers back to the source */
+		pthread_mutex_lock(&source->async_mutex);
+		free_async_cache(source);
+		pthread_mutex_unlock(&source->async_mutex);
+
 		source->async_active = false;
 		return;
 	}
@@ -2431,6 +2773,61 @@ void obs_source_output_video(obs_source_t *source,
 	}
 }
 
+void obs_source_output_video_external(obs_source_t *source,
+		const struct obs_source_frame *frame,
+		void (*release)(void *param), void *param)
+{
+	struct obs_source_frame *output;
+	struct async_frame new_af;
+
+	if (!obs_source_valid(source, "obs_source_output_video_external") ||
+	    !frame) {
+		if (release)
+			release(param);
+		return;
+	}
+
+	/* Y800 is converted on the CPU while copying, so it can't be used
+	 * directly */
+	if (!release || frame->format == VIDEO_FORMAT_Y800) {
+		obs_source_output_video(source, frame);
+		if (release)
+			release(param);
+		return;
+	}
+
+	pthread_mutex_lock(&source->async_mutex);
+
+	if (source->async_frames.num >= MAX_ASYNC_FRAMES) {
+		free_async_cache(source);
+		source->last_frame_ts = 0;
+		pthread_mutex_unlock(&source->async_mutex);
+		release(param);
+		return;
+	}
+
+	if (async_texture_changed(source, frame)) {
+		free_async_cache(source);
+		source->async_cache_width  = frame->width;
+		source->async_cache_height = frame->height;
+		source->async_cache_format = frame->format;
+	}
+
+	clean_cache(source);
+
+	/* the cache holds the only reference until the frame is removed */
+	output = cached_frame_create_external(frame, release, param);
+	new_af.frame = output;
+	new_af.used = true;
+	new_af.unused_count = 0;
+	da_push_back(source->async_cache, &new_af);
+	da_push_back(source->async_frames, &output);
+
+	pthread_mutex_unlock(&source->async_mutex);
+
+	source->async_active = true;
+}
+
 static inline bool preload_frame_changed(obs_source_t *source,
 		const struct obs_source_frame *in)
 {
@@ -2480,11 +2877,13 @@ void obs_source_show_preloaded_video(obs_source_t *source)
 
 	source->async_active = true;
 
+	pthread_mutex_lock(&source->audio_mutex);
 	pthread_mutex_lock(&source->audio_buf_mutex);
 	sys_ts = os_gettime_ns();
 	reset_audio_timing(source, source->last_frame_ts, sys_ts);
 	reset_audio_data(source, sys_ts);
 	pthread_mutex_unlock(&source->audio_buf_mutex);
+	pthread_mutex_unlock(&source->audio_mutex);
 }
 
 static inline struct obs_audio_data *filter_async_audio(obs_source_t *source,
@@ -2667,7 +3066,14 @@ void remove_async_frame(obs_source_t *source, struct obs_source_frame *frame)
 		struct async_frame *f = &source->async_cache.array[i];
 
 		if (f->frame == frame) {
-			f->used = false;
+			/* external buffers can't be reused, so they're given
+			 * back as soon as nothing else references them */
+			if (cached_frame_external(frame)) {
+				da_erase(source->async_cache, i);
+				obs_source_frame_decref(frame);
+			} else {
+				f->used = false;
+			}
 			break;
 		}
 	}
@@ -2817,12 +3223,12 @@ void obs_source_release_frame(obs_source_t *source,
 		return;
 
 	if (!source) {
-		obs_source_frame_destroy(frame);
+		cached_frame_destroy(frame);
 	} else {
 		pthread_mutex_lock(&source->async_mutex);
 
 		if (os_atomic_dec_long(&frame->refs) == 0)
-			obs_source_frame_destroy(frame);
+			cached_frame_destroy(frame);
 		else
 			remove_async_frame(source, frame);
 
@@ -3786,11 +4192,13 @@ static float get_source_volume(obs_source_t *source, uint64_t os_time)
 static inline void multiply_output_audio(obs_source_t *source, size_t mix,
 		size_t channels, float vol)
 {
-	register float *out = source->audio_output_buf[mix][0];
-	register float *end = out + AUDIO_OUTPUT_FRAMES * channels;
+	for (size_t ch = 0; ch < channels; ch++) {
+		register float *out = source->audio_output_buf[mix][ch];
+		register float *end = out + obs->audio.output_frames;
 
-	while (out < end)
-		*(out++) *= vol;
+		while (out < end)
+			*(out++) *= vol;
+	}
 }
 
 static inline void multiply_vol_data(obs_source_t *source, size_t mix,
@@ -3798,7 +4206,7 @@ static inline void multiply_vol_data(obs_source_t *source, size_t mix,
 {
 	for (size_t ch = 0; ch < channels; ch++) {
 		register float *out = source->audio_output_buf[mix][ch];
-		register float *end = out + AUDIO_OUTPUT_FRAMES;
+		register float *end = out + obs->audio.output_frames;
 		register float *vol = vol_data;
 
 		while (out < end)
@@ -3821,8 +4229,8 @@ static inline void apply_audio_action(obs_source_t *source,
 	}
 }
 
-static void apply_audio_actions(obs_source_t *source, size_t channels,
-		size_t sample_rate)
+static void apply_audio_actions(obs_source_t *source, uint32_t mixers,
+		size_t channels, size_t sample_rate)
 {
 	float *vol_data = malloc(sizeof(float) * AUDIO_OUTPUT_FRAMES);
 	float cur_vol = get_source_volume(source, source->audio_ts);
@@ -3841,7 +4249,7 @@ static void apply_audio_actions(obs_source_t *source, size_t channels,
 		new_frame_num = conv_time_to_frames(sample_rate,
 				timestamp - source->audio_ts);
 
-		if (new_frame_num >= AUDIO_OUTPUT_FRAMES)
+		if (new_frame_num >= obs->audio.output_frames)
 			break;
 
 		da_erase(source->audio_actions, i--);
@@ -3856,13 +4264,13 @@ static void apply_audio_actions(obs_source_t *source, size_t channels,
 		cur_vol = get_source_volume(source, timestamp);
 	}
 
-	for (; frame_num < AUDIO_OUTPUT_FRAMES; frame_num++)
+	for (; frame_num < obs->audio.output_frames; frame_num++)
 		vol_data[frame_num] = cur_vol;
 
 	pthread_mutex_unlock(&source->audio_actions_mutex);
 
 	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
-		if ((source->audio_mixers & (1 << mix)) != 0)
+		if ((source->audio_mixers & mixers & (1 << mix)) != 0)
 			multiply_vol_data(source, mix, channels, vol_data);
 	}
 
@@ -3886,10 +4294,11 @@ static void apply_audio_volume(obs_source_t *source, uint32_t mixers,
 
 	if (actions_pending) {
 		uint64_t duration = conv_frames_to_time(sample_rate,
-				AUDIO_OUTPUT_FRAMES);
+				obs->audio.output_frames);
 
 		if (action.timestamp < (source->audio_ts + duration)) {
-			apply_audio_actions(source, channels, sample_rate);
+			apply_audio_actions(source, mixers, channels,
+					sample_rate);
 			return;
 		}
 	}
@@ -3899,9 +4308,13 @@ static void apply_audio_volume(obs_source_t *source, uint32_t mixers,
 		return;
 
 	if (vol == 0.0f || mixers == 0) {
-		memset(source->audio_output_buf[0][0], 0,
-				AUDIO_OUTPUT_FRAMES * sizeof(float) *
-				MAX_AUDIO_CHANNELS * MAX_AUDIO_MIXES);
+		for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
+			if (source->audio_output_buf[mix][0])
+				memset(source->audio_output_buf[mix][0], 0,
+						AUDIO_OUTPUT_FRAMES *
+						sizeof(float) *
+						MAX_AUDIO_CHANNELS);
+		}
 		return;
 	}
 
@@ -3957,6 +4370,13 @@ static void custom_audio_render(obs_source_t *source, uint32_t mixers,
 	apply_audio_volume(source, mixers, channels, sample_rate);
 }
 
+static inline void clear_audio_output_buf(obs_source_t *source, size_t mix,
+		size_t channels, size_t size)
+{
+	for (size_t ch = 0; ch < channels; ch++)
+		memset(source->audio_output_buf[mix][ch], 0, size);
+}
+
 static inline void process_audio_source_tick(obs_source_t *source,
 		uint32_t mixers, size_t channels, size_t sample_rate,
 		size_t size)
@@ -3964,6 +4384,8 @@ static inline void process_audio_source_tick(obs_source_t *source,
 	pthread_mutex_lock(&source->audio_buf_mutex);
 
 	if (source->audio_input_buf[0].size < size) {
+		if (source->audio_ts)
+			os_atomic_inc_long(&source->audio_underflows);
 		source->audio_pending = true;
 		pthread_mutex_unlock(&source->audio_buf_mutex);
 		return;
@@ -3979,10 +4401,12 @@ static inline void process_audio_source_tick(obs_source_t *source,
 	for (size_t mix = 1; mix < MAX_AUDIO_MIXES; mix++) {
 		uint32_t mix_and_val = (1 << mix);
 
-		if ((source->audio_mixers & mix_and_val) == 0 ||
-		    (mixers & mix_and_val) == 0) {
-			memset(source->audio_output_buf[mix][0],
-					0, size * channels);
+		/* nothing reads mixes that have no outputs */
+		if ((mixers & mix_and_val) == 0)
+			continue;
+
+		if ((source->audio_mixers & mix_and_val) == 0) {
+			clear_audio_output_buf(source, mix, channels, size);
 			continue;
 		}
 
@@ -3992,8 +4416,7 @@ static inline void process_audio_source_tick(obs_source_t *source,
 	}
 
 	if ((source->audio_mixers & 1) == 0 || (mixers & 1) == 0)
-		memset(source->audio_output_buf[0][0], 0,
-				size * channels);
+		clear_audio_output_buf(source, 0, channels, size);
 
 	apply_audio_volume(source, mixers, channels, sample_rate);
 	source->audio_pending = false;
@@ -4007,6 +4430,8 @@ void obs_source_audio_render(obs_source_t *source, uint32_t mixers,
 		return;
 	}
 
+	allocate_audio_mixes(source, mixers);
+
 	if (source->info.audio_render) {
 		custom_audio_render(source, mixers, channels, sample_rate);
 		return;
@@ -4051,6 +4476,20 @@ void obs_source_get_audio_mix(const obs_source_t *source,
 	}
 }
 
+void obs_source_get_audio_stats(const obs_source_t *source,
+		struct obs_source_audio_stats *stats)
+{
+	if (!obs_source_valid(source, "obs_source_get_audio_stats"))
+		return;
+	if (!obs_ptr_valid(stats, "obs_source_get_audio_stats"))
+		return;
+
+	stats->overflows = (uint64_t)os_atomic_load_long(
+			&source->audio_overflows);
+	stats->underflows = (uint64_t)os_atomic_load_long(
+			&source->audio_underflows);
+}
+
 void obs_source_add_audio_capture_callback(obs_source_t *source,
 		obs_source_audio_capture_t callback, void *param)
 {
@@ -4140,10 +4579,12 @@ void obs_source_set_async_decoupled(obs_source_t *source, bool decouple)
 
 	source->async_decoupled = decouple;
 	if (decouple) {
+		pthread_mutex_lock(&source->audio_mutex);
 		pthread_mutex_lock(&source->audio_buf_mutex);
 		source->timing_set = false;
 		reset_audio_data(source, 0);
 		pthread_mutex_unlock(&source->audio_buf_mutex);
+		pthread_mutex_unlock(&source->audio_mutex);
 	}
 }
 
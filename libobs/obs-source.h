@@ -135,6 +135,28 @@ enum obs_source_type {
  */
 #define OBS_SOURCE_CAP_DISABLED (1<<10)
 
+/**
+ * Source video_tick can run in parallel with other sources
+ *
+ * When used, specifies that the source's video_tick callback does not use
+ * the graphics subsystem and does not depend on other sources being ticked
+ * first.  The callback may then be called from a worker thread at the same
+ * time as the video_tick callbacks of other sources.  All video_tick calls
+ * will have completed before any source is rendered for that frame.
+ */
+#define OBS_SOURCE_PARALLEL_TICK (1<<11)
+
+/**
+ * Source video only changes when it is updated
+ *
+ * When used, specifies that the source renders the same image every frame
+ * until its settings are updated or it calls obs_source_invalidate_video.
+ * Scenes may then reuse a previously rendered texture of the source (along
+ * with its filters, if those are static as well) instead of rendering it
+ * again each frame.
+ */
+#define OBS_SOURCE_STATIC_VIDEO (1<<12)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
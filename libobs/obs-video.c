@@ -24,8 +24,58 @@
 #include "media-io/format-conversion.h"
 #include "media-io/video-frame.h"
 
+/* ------------------------------------------------------------------------- */
+/* parallel source ticking                                                   */
+
+#define MAX_TICK_THREADS 8
+
+bool obs_init_tick_pool(void)
+{
+	return source_pool_init(&obs->video.tick_pool,
+			"obs: source tick thread", MAX_TICK_THREADS);
+}
+
+void obs_free_tick_pool(void)
+{
+	struct source_pool *pool = &obs->video.tick_pool;
+
+	for (size_t i = 0; i < pool->sources.num; i++)
+		obs_source_release(pool->sources.array[i]);
+	da_resize(pool->sources, 0);
+
+	source_pool_free(pool);
+}
+
+static inline bool parallel_tick(struct obs_source *source)
+{
+	return obs->video.tick_pool.threads.num &&
+		(source->info.output_flags & OBS_SOURCE_PARALLEL_TICK) != 0 &&
+		source->context.data && source->info.video_tick;
+}
+
+static void parallel_video_tick(void *param, struct obs_source *source)
+{
+	float *seconds = param;
+	source->info.video_tick(source->context.data, *seconds);
+}
+
+/* called on the graphics thread after tick_sources, ensures that every
+ * parallel video_tick of the current frame has finished before the tick
+ * phase is timed and the frame is rendered */
+static void join_parallel_ticks(struct source_pool *pool)
+{
+	source_pool_join(pool);
+
+	for (size_t i = 0; i < pool->sources.num; i++)
+		obs_source_release(pool->sources.array[i]);
+	da_resize(pool->sources, 0);
+}
+
+/* ------------------------------------------------------------------------- */
+
 static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 {
+	struct source_pool   *pool = &obs->video.tick_pool;
 	struct obs_core_data *data = &obs->data;
 	struct obs_source    *source;
 	uint64_t             delta_time;
@@ -58,10 +108,22 @@ static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 
 	source = data->first_source;
 	while (source) {
-		obs_source_video_tick(source, seconds);
+		bool parallel = parallel_tick(source);
+
+		obs_source_video_tick_internal(source, seconds, !parallel);
+
+		if (parallel) {
+			obs_source_t *ref = obs_source_get_ref(source);
+			if (ref)
+				da_push_back(pool->sources, &ref);
+		}
+
 		source = (struct obs_source*)source->context.next;
 	}
 
+	obs->video.tick_seconds = seconds;
+	source_pool_start(pool, parallel_video_tick, &obs->video.tick_seconds);
+
 	pthread_mutex_unlock(&data->sources_mutex);
 
 	return cur_time;
@@ -525,7 +587,37 @@ static inline void output_video_data(struct obs_core_video *video,
 	}
 }
 
-static inline void video_sleep(struct obs_core_video *video, bool active,
+static void record_frame_timing(struct obs_core_video *video,
+		enum obs_frame_timing_type type, uint64_t ns)
+{
+	struct frame_timing_samples *timing = &video->frame_timing[type];
+
+	pthread_mutex_lock(&video->frame_timing_mutex);
+
+	timing->samples[timing->pos] = ns;
+	if (++timing->pos == FRAME_TIMING_WINDOW)
+		timing->pos = 0;
+	if (timing->num < FRAME_TIMING_WINDOW)
+		timing->num++;
+
+	pthread_mutex_unlock(&video->frame_timing_mutex);
+}
+
+static void signal_deadline_missed(uint64_t frame_time_ns,
+		uint64_t interval_ns, int missed_frames)
+{
+	struct calldata params;
+	uint8_t stack[128];
+
+	calldata_init_fixed(&params, stack, sizeof(stack));
+	calldata_set_int(&params, "frame_time_ns", (long long)frame_time_ns);
+	calldata_set_int(&params, "interval_ns", (long long)interval_ns);
+	calldata_set_int(&params, "missed_frames", missed_frames);
+
+	signal_handler_signal(obs->signals, "frame_deadline_missed", &params);
+}
+
+static inline int video_sleep(struct obs_core_video *video, bool active,
 		uint64_t *p_time, uint64_t interval_ns)
 {
 	struct obs_vframe_info vframe_info;
@@ -534,6 +626,8 @@ static inline void video_sleep(struct obs_core_video *video, bool active,
 	int count;
 
 	if (os_sleepto_ns(t)) {
+		record_frame_timing(video, OBS_FRAME_TIMING_SLEEP_OVERSHOOT,
+				os_gettime_ns() - t);
 		*p_time = t;
 		count = 1;
 	} else {
@@ -549,6 +643,8 @@ static inline void video_sleep(struct obs_core_video *video, bool active,
 	if (active)
 		circlebuf_push_back(&video->vframe_info_buffer, &vframe_info,
 				sizeof(vframe_info));
+
+	return count;
 }
 
 static const char *output_frame_gs_context_name = "gs_context(video->graphics)";
@@ -563,6 +659,7 @@ static inline void output_frame(bool raw_active)
 	int prev_texture = cur_texture == 0 ? NUM_TEXTURES-1 : cur_texture-1;
 	struct video_data frame;
 	bool frame_ready;
+	uint64_t start_time;
 
 	memset(&frame, 0, sizeof(struct video_data));
 
@@ -570,12 +667,18 @@ static inline void output_frame(bool raw_active)
 	gs_enter_context(video->graphics);
 
 	profile_start(output_frame_render_video_name);
+	start_time = os_gettime_ns();
 	render_video(video, raw_active, cur_texture, prev_texture);
+	record_frame_timing(video, OBS_FRAME_TIMING_RENDER,
+			os_gettime_ns() - start_time);
 	profile_end(output_frame_render_video_name);
 
 	if (raw_active) {
 		profile_start(output_frame_download_frame_name);
+		start_time = os_gettime_ns();
 		frame_ready = download_frame(video, prev_texture, &frame);
+		record_frame_timing(video, OBS_FRAME_TIMING_READBACK,
+				os_gettime_ns() - start_time);
 		profile_end(output_frame_download_frame_name);
 	}
 
@@ -640,7 +743,9 @@ void *obs_graphics_thread(void *param)
 	while (!video_output_stopped(obs->video.video)) {
 		uint64_t frame_start = os_gettime_ns();
 		uint64_t frame_time_ns;
+		uint64_t step_start;
 		bool raw_active = obs->video.raw_active > 0;
+		int count;
 
 		if (!raw_was_active && raw_active)
 			clear_frame_data();
@@ -650,12 +755,20 @@ void *obs_graphics_thread(void *param)
 
 		profile_start(tick_sources_name);
 		last_time = tick_sources(obs->video.video_time, last_time);
+		join_parallel_ticks(&obs->video.tick_pool);
 		profile_end(tick_sources_name);
 
+		step_start = os_gettime_ns();
+		record_frame_timing(&obs->video, OBS_FRAME_TIMING_TICK,
+				step_start - frame_start);
+
 		profile_start(output_frame_name);
 		output_frame(raw_active);
 		profile_end(output_frame_name);
 
+		record_frame_timing(&obs->video, OBS_FRAME_TIMING_OUTPUT_FRAME,
+				os_gettime_ns() - step_start);
+
 		profile_start(render_displays_name);
 		render_displays();
 		profile_end(render_displays_name);
@@ -666,8 +779,11 @@ void *obs_graphics_thread(void *param)
 
 		profile_reenable_thread();
 
-		video_sleep(&obs->video, raw_active, &obs->video.video_time,
-				interval);
+		count = video_sleep(&obs->video, raw_active,
+				&obs->video.video_time, interval);
+		if (count > 1)
+			signal_deadline_missed(frame_time_ns, interval,
+					count - 1);
 
 		frame_time_total_ns += frame_time_ns;
 		fps_total_ns += (obs->video.video_time - last_time);
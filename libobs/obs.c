@@ -377,6 +377,14 @@ static int obs_init_video(struct obs_video_info *ovi)
 
 	gs_enter_context(video->graphics);
 
+	if (ovi->gpu_conversion &&
+	    gs_get_device_type() == GS_DEVICE_SOFTWARE) {
+		blog(LOG_INFO, "GPU conversion is not available with the "
+		               "software renderer, converting on the CPU");
+		video->gpu_conversion = false;
+		ovi->gpu_conversion = false;
+	}
+
 	if (ovi->gpu_conversion && !obs_init_gpu_conversion(ovi))
 		return OBS_VIDEO_FAIL;
 	if (!obs_init_textures(ovi))
@@ -384,6 +392,9 @@ static int obs_init_video(struct obs_video_info *ovi)
 
 	gs_leave_context();
 
+	if (!obs_init_tick_pool())
+		return OBS_VIDEO_FAIL;
+
 	errorcode = pthread_create(&video->video_thread, NULL,
 			obs_graphics_thread, obs);
 	if (errorcode != 0)
@@ -407,6 +418,8 @@ static void stop_video(void)
 		}
 	}
 
+	obs_free_tick_pool();
+
 }
 
 static void obs_free_video(void)
@@ -484,6 +497,8 @@ static void obs_free_graphics(void)
 	}
 }
 
+#define MAX_AUDIO_RENDER_THREADS 4
+
 static bool obs_init_audio(struct audio_output_info *ai)
 {
 	struct obs_core_audio *audio = &obs->audio;
@@ -502,9 +517,17 @@ static bool obs_init_audio(struct audio_output_info *ai)
 
 	audio->user_volume    = 1.0f;
 
+	audio->output_frames = ai->frames;
+	audio->max_buffering_ticks = (int)(MAX_BUFFERING_FRAMES / ai->frames);
+
 	audio->monitoring_device_name = bstrdup("Default");
 	audio->monitoring_device_id = bstrdup("default");
 
+	if (!source_pool_init(&audio->render_pool,
+				"obs: audio render thread",
+				MAX_AUDIO_RENDER_THREADS))
+		return false;
+
 	errorcode = audio_output_open(&audio->audio, ai);
 	if (errorcode == AUDIO_OUTPUT_SUCCESS)
 		return true;
@@ -519,19 +542,27 @@ static bool obs_init_audio(struct audio_output_info *ai)
 static void obs_free_audio(void)
 {
 	struct obs_core_audio *audio = &obs->audio;
+	bool adaptive_buffering;
+
 	if (audio->audio)
 		audio_output_close(audio->audio);
 
+	source_pool_free(&audio->render_pool);
+
 	circlebuf_free(&audio->buffered_timestamps);
 	da_free(audio->render_order);
 	da_free(audio->root_nodes);
+	da_free(audio->render_edges);
 
 	da_free(audio->monitors);
 	bfree(audio->monitoring_device_name);
 	bfree(audio->monitoring_device_id);
 	pthread_mutex_destroy(&audio->monitoring_mutex);
 
+	/* the adaptive buffering setting is kept across audio resets */
+	adaptive_buffering = os_atomic_load_bool(&audio->adaptive_buffering);
 	memset(audio, 0, sizeof(struct obs_core_audio));
+	audio->adaptive_buffering = adaptive_buffering;
 }
 
 static bool obs_init_data(void)
@@ -564,6 +595,10 @@ static bool obs_init_data(void)
 		goto fail;
 	if (!obs_view_init(&data->main_view))
 		goto fail;
+	if (!frame_pool_init(&data->frame_pool))
+		goto fail;
+	if (!packet_pool_init(&data->packet_pool))
+		goto fail;
 
 	data->private_data = obs_data_create();
 	data->valid = true;
@@ -622,6 +657,8 @@ static void obs_free_data(void)
 	da_free(data->draw_callbacks);
 	da_free(data->tick_callbacks);
 	obs_data_release(data->private_data);
+	frame_pool_free(&data->frame_pool);
+	packet_pool_free(&data->packet_pool);
 }
 
 static const char *obs_signals[] = {
@@ -645,6 +682,10 @@ static const char *obs_signals[] = {
 	"void channel_change(int channel, in out ptr source, ptr prev_source)",
 	"void master_volume(in out float volume)",
 
+	"void frame_deadline_missed(int frame_time_ns, int interval_ns, "
+		"int missed_frames)",
+	"void audio_buffering_changed(int buffering_ms, int target_ms)",
+
 	"void hotkey_layout_change()",
 	"void hotkey_register(ptr hotkey)",
 	"void hotkey_unregister(ptr hotkey)",
@@ -751,8 +792,16 @@ static bool obs_init(const char *locale, const char *module_config_path,
 		profiler_name_store_t *store)
 {
 	obs = bzalloc(sizeof(struct obs_core));
+	obs->audio.adaptive_buffering = true;
 
 	pthread_mutex_init_value(&obs->audio.monitoring_mutex);
+	pthread_mutex_init_value(&obs->video.frame_timing_mutex);
+	pthread_mutex_init_value(&obs->video.render_cache_mutex);
+
+	if (pthread_mutex_init(&obs->video.frame_timing_mutex, NULL) != 0)
+		return false;
+	if (pthread_mutex_init(&obs->video.render_cache_mutex, NULL) != 0)
+		return false;
 
 	obs->name_store_owned = !store;
 	obs->name_store = store ? store : profiler_name_store_create();
@@ -892,6 +941,8 @@ void obs_shutdown(void)
 	obs_free_video();
 	obs_free_hotkeys();
 	obs_free_graphics();
+	pthread_mutex_destroy(&obs->video.frame_timing_mutex);
+	pthread_mutex_destroy(&obs->video.render_cache_mutex);
 	proc_handler_destroy(obs->procs);
 	signal_handler_destroy(obs->signals);
 	obs->procs = NULL;
@@ -1044,9 +1095,9 @@ int obs_reset_video(struct obs_video_info *ovi)
 	return obs_init_video(ovi);
 }
 
-bool obs_reset_audio(const struct obs_audio_info *oai)
+bool obs_reset_audio2(const struct obs_audio_info2 *oai)
 {
-	struct audio_output_info ai;
+	struct audio_output_info ai = {0};
 
 	if (!obs) return false;
 
@@ -1063,17 +1114,32 @@ bool obs_reset_audio(const struct obs_audio_info *oai)
 	ai.format = AUDIO_FORMAT_FLOAT_PLANAR;
 	ai.speakers = oai->speakers;
 	ai.input_callback = audio_callback;
+	ai.frames = oai->frames ? oai->frames : AUDIO_OUTPUT_FRAMES;
 
 	blog(LOG_INFO, "---------------------------------");
 	blog(LOG_INFO, "audio settings reset:\n"
 	               "\tsamples per sec: %d\n"
-	               "\tspeakers:        %d",
+	               "\tspeakers:        %d\n"
+	               "\tframes per tick: %d",
 	               (int)ai.samples_per_sec,
-	               (int)ai.speakers);
+	               (int)ai.speakers,
+	               (int)ai.frames);
 
 	return obs_init_audio(&ai);
 }
 
+bool obs_reset_audio(const struct obs_audio_info *oai)
+{
+	struct obs_audio_info2 oai2 = {0};
+
+	if (!oai)
+		return obs_reset_audio2(NULL);
+
+	oai2.samples_per_sec = oai->samples_per_sec;
+	oai2.speakers = oai->speakers;
+	return obs_reset_audio2(&oai2);
+}
+
 bool obs_get_video_info(struct obs_video_info *ovi)
 {
 	struct obs_core_video *video = &obs->video;
@@ -1100,6 +1166,22 @@ bool obs_get_audio_info(struct obs_audio_info *oai)
 	return true;
 }
 
+bool obs_get_audio_info2(struct obs_audio_info2 *oai)
+{
+	struct obs_core_audio *audio = &obs->audio;
+	const struct audio_output_info *info;
+
+	if (!obs || !oai || !audio->audio)
+		return false;
+
+	info = audio_output_get_info(audio->audio);
+
+	oai->samples_per_sec = info->samples_per_sec;
+	oai->speakers = info->speakers;
+	oai->frames = info->frames;
+	return true;
+}
+
 bool obs_enum_source_types(size_t idx, const char **id)
 {
 	if (!obs) return false;
@@ -2123,6 +2205,121 @@ uint32_t obs_get_lagged_frames(void)
 	return obs ? obs->video.lagged_frames : 0;
 }
 
+static inline size_t frame_timing_bucket(uint64_t ns)
+{
+	size_t bucket = 0;
+
+	while (bucket < OBS_FRAME_TIMING_BUCKETS - 1 &&
+	       ns >= (OBS_FRAME_TIMING_BUCKET_BASE_NS << bucket))
+		bucket++;
+
+	return bucket;
+}
+
+bool obs_get_frame_timing(enum obs_frame_timing_type type,
+		struct obs_frame_timing *timing)
+{
+	struct frame_timing_samples *samples;
+	uint64_t total = 0;
+
+	if (!obs || !timing || (int)type < 0 ||
+	    type >= OBS_FRAME_TIMING_TYPES)
+		return false;
+
+	memset(timing, 0, sizeof(*timing));
+	samples = &obs->video.frame_timing[type];
+
+	pthread_mutex_lock(&obs->video.frame_timing_mutex);
+
+	for (size_t i = 0; i < samples->num; i++) {
+		uint64_t ns = samples->samples[i];
+
+		if (!i || ns < timing->min_ns)
+			timing->min_ns = ns;
+		if (ns > timing->max_ns)
+			timing->max_ns = ns;
+
+		timing->buckets[frame_timing_bucket(ns)]++;
+		total += ns;
+	}
+
+	timing->count = (uint32_t)samples->num;
+
+	pthread_mutex_unlock(&obs->video.frame_timing_mutex);
+
+	if (timing->count)
+		timing->avg_ns = total / timing->count;
+	return true;
+}
+
+void obs_get_render_cache_stats(struct obs_render_cache_stats *stats)
+{
+	if (!stats)
+		return;
+
+	memset(stats, 0, sizeof(*stats));
+	if (!obs)
+		return;
+
+	pthread_mutex_lock(&obs->video.render_cache_mutex);
+	*stats = obs->video.render_cache_stats;
+	pthread_mutex_unlock(&obs->video.render_cache_mutex);
+}
+
+void obs_reset_render_cache_stats(void)
+{
+	if (!obs)
+		return;
+
+	pthread_mutex_lock(&obs->video.render_cache_mutex);
+	memset(&obs->video.render_cache_stats, 0,
+			sizeof(obs->video.render_cache_stats));
+	pthread_mutex_unlock(&obs->video.render_cache_mutex);
+}
+
+static inline uint32_t buffering_ticks_to_ms(const volatile long *ticks,
+		uint64_t frames, uint64_t rate)
+{
+	uint64_t total = (uint64_t)os_atomic_load_long(ticks) * frames;
+	return (uint32_t)(total * 1000 / rate);
+}
+
+bool obs_get_audio_buffering(uint32_t *buffering_ms, uint32_t *target_ms)
+{
+	struct obs_core_audio *audio;
+	uint64_t frames;
+	uint64_t rate;
+
+	if (!obs || !obs->audio.audio)
+		return false;
+
+	audio = &obs->audio;
+	frames = audio->output_frames;
+	rate = audio_output_get_sample_rate(audio->audio);
+
+	if (buffering_ms)
+		*buffering_ms = buffering_ticks_to_ms(
+				&audio->public_buffering_ticks, frames, rate);
+	if (target_ms)
+		*target_ms = buffering_ticks_to_ms(
+				&audio->public_target_ticks, frames, rate);
+	return true;
+}
+
+void obs_set_adaptive_audio_buffering(bool enable)
+{
+	if (!obs)
+		return;
+
+	os_atomic_set_bool(&obs->audio.adaptive_buffering, enable);
+}
+
+bool obs_adaptive_audio_buffering_enabled(void)
+{
+	return obs ? os_atomic_load_bool(&obs->audio.adaptive_buffering) :
+		false;
+}
+
 void start_raw_video(video_t *v, const struct video_scale_info *conversion,
 		void (*callback)(void *param, struct video_data *frame),
 		void *param)
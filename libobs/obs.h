@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <stdio.h>
+
 #include "util/c99defs.h"
 #include "util/bmem.h"
 #include "util/profiler.h"
@@ -151,7 +153,8 @@ struct obs_transform_info {
 struct obs_video_info {
 #ifndef SWIG
 	/**
-	 * Graphics module to use (usually "libobs-opengl" or "libobs-d3d11")
+	 * Graphics module to use (usually "libobs-opengl" or "libobs-d3d11",
+	 * or "libobs-software" for headless CPU rendering)
 	 */
 	const char          *graphics_module;
 #endif
@@ -186,6 +189,22 @@ struct obs_audio_info {
 	enum speaker_layout speakers;
 };
 
+/**
+ * Extended audio initialization structure
+ */
+struct obs_audio_info2 {
+	uint32_t            samples_per_sec;
+	enum speaker_layout speakers;
+
+	/**
+	 * Frames per audio tick, from MIN_AUDIO_OUTPUT_FRAMES up to
+	 * AUDIO_OUTPUT_FRAMES (the default if 0).  Smaller values lower the
+	 * latency of monitoring and outputs at the cost of more frequent
+	 * audio processing, e.g. 256 frames is about 5ms at 48khz.
+	 */
+	uint32_t            frames;
+};
+
 /**
  * Sent to source filters via the filter_audio callback to allow filtering of
  * audio data
@@ -340,12 +359,23 @@ EXPORT int obs_reset_video(struct obs_video_info *ovi);
  */
 EXPORT bool obs_reset_audio(const struct obs_audio_info *oai);
 
+/**
+ * Sets base audio output format/channels/samples/etc, as well as the number
+ * of frames processed per audio tick
+ *
+ * @note Cannot reset base audio if an output is currently active.
+ */
+EXPORT bool obs_reset_audio2(const struct obs_audio_info2 *oai);
+
 /** Gets the current video settings, returns false if no video */
 EXPORT bool obs_get_video_info(struct obs_video_info *ovi);
 
 /** Gets the current audio settings, returns false if no audio */
 EXPORT bool obs_get_audio_info(struct obs_audio_info *oai);
 
+/** Gets the current extended audio settings, returns false if no audio */
+EXPORT bool obs_get_audio_info2(struct obs_audio_info2 *oai);
+
 /**
  * Opens a plugin module directly from a specific path.
  *
@@ -682,6 +712,127 @@ EXPORT uint64_t obs_get_average_frame_time_ns(void);
 EXPORT uint32_t obs_get_total_frames(void);
 EXPORT uint32_t obs_get_lagged_frames(void);
 
+enum obs_frame_timing_type {
+	OBS_FRAME_TIMING_TICK,            /**< Source tick time */
+	OBS_FRAME_TIMING_RENDER,          /**< Main view render time */
+	OBS_FRAME_TIMING_READBACK,        /**< GPU readback (staging) wait */
+	OBS_FRAME_TIMING_OUTPUT_FRAME,    /**< Total output_frame time */
+	OBS_FRAME_TIMING_SLEEP_OVERSHOOT, /**< How late the thread woke up */
+};
+
+#define OBS_FRAME_TIMING_TYPES   5
+#define OBS_FRAME_TIMING_BUCKETS 16
+
+/** Upper bound of the first histogram bucket, in nanoseconds */
+#define OBS_FRAME_TIMING_BUCKET_BASE_NS 64000ULL
+
+/**
+ * Histogram of the most recent frame timing samples of one type.
+ *
+ *   Bucket 0 holds samples below OBS_FRAME_TIMING_BUCKET_BASE_NS, and each
+ * following bucket doubles the range of the previous one (bucket n holds
+ * samples from BASE << (n - 1) up to BASE << n).  The last bucket also holds
+ * everything above its range.
+ */
+struct obs_frame_timing {
+	uint32_t buckets[OBS_FRAME_TIMING_BUCKETS];
+	uint32_t count;
+	uint64_t min_ns;
+	uint64_t max_ns;
+	uint64_t avg_ns;
+};
+
+/**
+ * Gets a histogram of the graphics thread timings for roughly the last ten
+ * seconds of frames.
+ *
+ *   The core signal "frame_deadline_missed" is also emitted from the graphics
+ * thread whenever a frame took too long and one or more frames were lagged.
+ */
+EXPORT bool obs_get_frame_timing(enum obs_frame_timing_type type,
+		struct obs_frame_timing *timing);
+
+/** Statistics of the scene item render cache */
+struct obs_render_cache_stats {
+	uint64_t hits;      /**< Items drawn from their cached texture */
+	uint64_t misses;    /**< Cacheable items that had to be rendered */
+	uint64_t saved_ns;  /**< Estimated render time saved by cache hits */
+};
+
+/**
+ * Gets the statistics of the scene item render cache.
+ *
+ *   Scene items that render to a texture (nested scenes, cropped or scale
+ * filtered items) reuse that texture when their content, made up only of
+ * OBS_SOURCE_STATIC_VIDEO sources and filters, has not changed.  The saved
+ * time is estimated from how long the item took to render the last time it
+ * was rendered.
+ */
+EXPORT void obs_get_render_cache_stats(struct obs_render_cache_stats *stats);
+EXPORT void obs_reset_render_cache_stats(void);
+
+/**
+ * Gets the current global audio buffering and the buffering it is being
+ * lowered to, in milliseconds.  Returns false if there is no audio.
+ *
+ *   Buffering is raised whenever a source's audio arrives late.  With
+ * adaptive buffering enabled, the amount of audio every source has queued
+ * ahead of the mix is measured over a window of roughly ten seconds, and if
+ * they all stayed at least a tick ahead, buffering is lowered toward the
+ * target one tick per second.  The core signal "audio_buffering_changed" is
+ * emitted from the audio thread whenever either value changes.
+ */
+EXPORT bool obs_get_audio_buffering(uint32_t *buffering_ms,
+		uint32_t *target_ms);
+
+/**
+ * Enables/disables lowering audio buffering again (enabled by default).
+ * Buffering is only lowered while no audio encoders are active.  The setting
+ * is kept across audio resets.
+ */
+EXPORT void obs_set_adaptive_audio_buffering(bool enable);
+EXPORT bool obs_adaptive_audio_buffering_enabled(void);
+
+/** Statistics of the global async video frame buffer pool */
+struct obs_frame_pool_stats {
+	uint64_t hits;            /**< Frame buffers reused from the pool */
+	uint64_t misses;          /**< Frame buffers that had to be allocated */
+	uint64_t resident_bytes;  /**< Memory of all pooled buffers */
+	uint64_t idle_bytes;      /**< Memory of buffers waiting to be reused */
+	uint64_t budget;          /**< Maximum memory of idle buffers */
+};
+
+/**
+ * Gets the statistics of the frame buffer pool.
+ *
+ *   Frames output by async sources are copied into buffers taken from a
+ * pool shared by all sources, so a source changing resolution or format
+ * can reuse the buffers released by itself or other sources.  Idle buffers
+ * are freed after about ten seconds or when they exceed the budget.
+ */
+EXPORT void obs_get_frame_pool_stats(struct obs_frame_pool_stats *stats);
+
+/** Sets the maximum memory of idle buffers kept by the frame pool */
+EXPORT void obs_set_frame_pool_budget(uint64_t bytes);
+
+/** Statistics of the global encoder packet buffer pool */
+struct obs_packet_pool_stats {
+	uint64_t hits;            /**< Packet buffers reused from the pool */
+	uint64_t misses;          /**< Packet buffers added to the pool */
+	uint64_t unpooled;        /**< Packets too large for the pool, or
+	                               allocated while the pool was full */
+	uint64_t in_use;          /**< Pooled packet buffers currently in use */
+	uint64_t resident_bytes;  /**< Memory allocated by the pool */
+};
+
+/**
+ * Gets the statistics of the encoder packet pool.
+ *
+ *   Encoded packets are copied once in to a buffer from a pool shared by all
+ * encoders, and then referenced by every output that uses them.
+ */
+EXPORT void obs_get_packet_pool_stats(struct obs_packet_pool_stats *stats);
+
 EXPORT void obs_apply_private_data(obs_data_t *settings);
 EXPORT void obs_set_private_data(obs_data_t *settings);
 EXPORT obs_data_t *obs_get_private_data(void);
@@ -828,6 +979,13 @@ EXPORT obs_properties_t *obs_source_properties(const obs_source_t *source);
 /** Updates settings for this source */
 EXPORT void obs_source_update(obs_source_t *source, obs_data_t *settings);
 
+/**
+ * Notifies that the video of a source with the OBS_SOURCE_STATIC_VIDEO flag
+ * changed without its settings being updated, so any cached texture of it
+ * must be rendered again.
+ */
+EXPORT void obs_source_invalidate_video(obs_source_t *source);
+
 /** Renders a video source. */
 EXPORT void obs_source_video_render(obs_source_t *source);
 
@@ -1074,6 +1232,18 @@ EXPORT void obs_source_draw(gs_texture_t *image, int x, int y,
 EXPORT void obs_source_output_video(obs_source_t *source,
 		const struct obs_source_frame *frame);
 
+/**
+ * Outputs asynchronous video data without copying it.  The frame's planes
+ * must stay valid until libobs calls the release callback, which happens once
+ * the frame has been uploaded or dropped.  The callback can be called from
+ * any thread while libobs locks are held, so it must not call back into the
+ * source.  Planes can be separate and padded.  Falls back to copying for
+ * formats that require conversion on the CPU.
+ */
+EXPORT void obs_source_output_video_external(obs_source_t *source,
+		const struct obs_source_frame *frame,
+		void (*release)(void *param), void *param);
+
 /** Preloads asynchronous video data to allow instantaneous playback */
 EXPORT void obs_source_preload_video(obs_source_t *source,
 		const struct obs_source_frame *frame);
@@ -1184,9 +1354,26 @@ EXPORT uint32_t obs_source_get_base_height(obs_source_t *source);
 
 EXPORT bool obs_source_audio_pending(const obs_source_t *source);
 EXPORT uint64_t obs_source_get_audio_timestamp(const obs_source_t *source);
+
+/**
+ * Gets the audio of a source for the current audio tick.  Only the mixes
+ * that were passed to audio_render are valid, the others may be NULL.
+ */
 EXPORT void obs_source_get_audio_mix(const obs_source_t *source,
 		struct obs_source_audio_mix *audio);
 
+/** Counters of a source's audio queue */
+struct obs_source_audio_stats {
+	/** Audio output calls that had to wait because the queue to the audio
+	 * thread was full */
+	uint64_t overflows;
+	/** Audio ticks the source had audio for, but not enough of it */
+	uint64_t underflows;
+};
+
+EXPORT void obs_source_get_audio_stats(const obs_source_t *source,
+		struct obs_source_audio_stats *stats);
+
 EXPORT void obs_source_set_async_unbuffered(obs_source_t *source,
 		bool unbuffered);
 EXPORT bool obs_source_async_unbuffered(const obs_source_t *source);
@@ -1532,6 +1719,33 @@ EXPORT uint32_t obs_output_get_delay(const obs_output_t *output);
 /** If delay is active, gets the currently active delay value, in seconds. */
 EXPORT uint32_t obs_output_get_active_delay(const obs_output_t *output);
 
+/**
+ * Sets a directory to spool delayed data to, so that no more than max_memory
+ * bytes of packet data are held in memory.  A quarter of max_memory is for
+ * data waiting to be written, and if the disk can't keep up, new data waits
+ * for it.  Spooled data is read back in order as it's needed.  Set directory
+ * to NULL to keep all delayed data in memory.
+ */
+EXPORT void obs_output_set_delay_spool(obs_output_t *output,
+		const char *directory, uint64_t max_memory);
+
+/**
+ * Memory and disk usage of an output's delay buffer.  Data waiting to be
+ * written to the spool counts as memory.
+ */
+struct obs_output_delay_stats {
+	uint64_t memory_bytes;       /**< Delayed packet data in memory */
+	uint64_t peak_memory_bytes;  /**< Most packet data held in memory */
+	uint64_t spooled_bytes;      /**< Delayed packet data on disk */
+	uint64_t bytes_written;      /**< Total bytes written to the spool */
+	uint64_t bytes_read;         /**< Total bytes read from the spool */
+	uint32_t segments;           /**< Spool files created */
+	uint32_t errors;             /**< Spool read or write errors */
+};
+
+EXPORT void obs_output_get_delay_stats(obs_output_t *output,
+		struct obs_output_delay_stats *stats);
+
 /** Forces the output to stop.  Usually only used with delay. */
 EXPORT void obs_output_force_stop(obs_output_t *output);
 
@@ -1866,6 +2080,35 @@ EXPORT audio_t *obs_encoder_audio(const obs_encoder_t *encoder);
 /** Returns true if encoder is active, false otherwise */
 EXPORT bool obs_encoder_active(const obs_encoder_t *encoder);
 
+/**
+ * Sets the number of raw frames that can be queued for a video encoder, and
+ * what happens to new frames when the encoder falls behind and its queue is
+ * full.  Video encoders always encode on their own thread, this only affects
+ * how much they can fall behind.
+ */
+EXPORT void obs_encoder_set_frame_queue(obs_encoder_t *encoder,
+		size_t max_frames, enum video_input_overflow overflow);
+
+/** Encoder queue and timing statistics */
+struct obs_encoder_stats {
+	/** Raw frames currently waiting to be encoded */
+	uint32_t queued_frames;
+	/** Raw frames dropped because the queue was full */
+	uint32_t dropped_frames;
+
+	/** Time spent in the encode callback */
+	uint64_t last_encode_ns;
+	uint64_t avg_encode_ns;
+	uint64_t max_encode_ns;
+
+	/** Time from when a raw video frame was rendered until it was
+	 * encoded, including time spent in the queue */
+	uint64_t avg_latency_ns;
+};
+
+EXPORT void obs_encoder_get_stats(obs_encoder_t *encoder,
+		struct obs_encoder_stats *stats);
+
 EXPORT void *obs_encoder_get_type_data(obs_encoder_t *encoder);
 
 EXPORT const char *obs_encoder_get_id(const obs_encoder_t *encoder);
@@ -1886,6 +2129,20 @@ EXPORT void obs_encoder_packet_ref(struct encoder_packet *dst,
 		struct encoder_packet *src);
 EXPORT void obs_encoder_packet_release(struct encoder_packet *packet);
 
+/**
+ * Writes an encoder packet to a file: the packet structure followed by its
+ * data.  Packets written this way can only be read back by the same process,
+ * as the encoder pointer is stored as is.
+ */
+EXPORT bool obs_encoder_packet_write(FILE *file,
+		const struct encoder_packet *packet);
+
+/**
+ * Reads a packet written with obs_encoder_packet_write in to a new packet
+ * buffer, which must be released with obs_encoder_packet_release.
+ */
+EXPORT bool obs_encoder_packet_read(FILE *file, struct encoder_packet *packet);
+
 
 /* ------------------------------------------------------------------------- */
 /* Stream Services */
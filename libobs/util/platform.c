@@ -26,6 +26,12 @@
 #include "utf8.h"
 #include "dstr.h"
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
 FILE *os_wfopen(const wchar_t *path, const char *mode)
 {
 	FILE *file = NULL;
@@ -774,3 +780,62 @@ char *os_generate_formatted_filename(const char *extension, bool space,
 
 	return sf.array;
 }
+
+#define CPUID_1_ECX_OSXSAVE (1 << 27)
+#define CPUID_1_ECX_AVX     (1 << 28)
+#define CPUID_7_EBX_AVX2    (1 << 5)
+#define XCR0_SSE_AVX        0x6
+
+static bool check_cpu_avx2(void)
+{
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+	int info[4];
+	const int avx = CPUID_1_ECX_OSXSAVE | CPUID_1_ECX_AVX;
+
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	__cpuid(info, 1);
+	if ((info[2] & avx) != avx)
+		return false;
+	if ((_xgetbv(0) & XCR0_SSE_AVX) != XCR0_SSE_AVX)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & CPUID_7_EBX_AVX2) != 0;
+
+#elif defined(__i386__) || defined(__x86_64__)
+	const unsigned int avx = CPUID_1_ECX_OSXSAVE | CPUID_1_ECX_AVX;
+	unsigned int eax, ebx, ecx, edx;
+	unsigned int xcr0_lo, xcr0_hi;
+
+	if (__get_cpuid_max(0, NULL) < 7)
+		return false;
+
+	__cpuid(1, eax, ebx, ecx, edx);
+	if ((ecx & avx) != avx)
+		return false;
+
+	/* make sure the OS saves the YMM registers */
+	__asm__ volatile ("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+	if ((xcr0_lo & XCR0_SSE_AVX) != XCR0_SSE_AVX)
+		return false;
+
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return (ebx & CPUID_7_EBX_AVX2) != 0;
+
+#else
+	return false;
+#endif
+}
+
+bool os_cpu_has_avx2(void)
+{
+	static int has_avx2 = -1;
+
+	if (has_avx2 == -1)
+		has_avx2 = check_cpu_avx2() ? 1 : 0;
+
+	return has_avx2 == 1;
+}
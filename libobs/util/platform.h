@@ -181,6 +181,15 @@ EXPORT void os_breakpoint(void);
 EXPORT int os_get_physical_cores(void);
 EXPORT int os_get_logical_cores(void);
 
+/* the AVX2 code paths are only built for x86 targets */
+#if defined(__i386__) || defined(__x86_64__) || \
+    defined(_M_IX86) || defined(_M_X64)
+#define OS_HAS_AVX2_PATHS
+#endif
+
+/* returns true if both the CPU and the OS support AVX2 instructions */
+EXPORT bool os_cpu_has_avx2(void);
+
 EXPORT uint64_t os_get_sys_free_size(void);
 
 struct os_proc_memory_usage {
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2018 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include "c99defs.h"
+#include <string.h>
+
+#include "bmem.h"
+#include "threading.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fixed size lock-free ring buffer with a single producer and a single
+ * consumer.
+ *
+ *   The producer writes data past the write position with spsc_ring_write
+ * and then makes it visible all at once with spsc_ring_commit.  The consumer
+ * reads with spsc_ring_peek/spsc_ring_peek_ptrs and frees the space with
+ * spsc_ring_pop.  Neither side ever blocks or allocates, so the producer has
+ * to handle the ring being full.
+ */
+
+struct spsc_ring {
+	uint8_t       *data;
+	size_t        capacity;
+
+	volatile long read_pos;
+	volatile long write_pos;
+};
+
+static inline void spsc_ring_init(struct spsc_ring *ring, size_t capacity)
+{
+	memset(ring, 0, sizeof(struct spsc_ring));
+	ring->data     = (uint8_t*)bmalloc(capacity);
+	ring->capacity = capacity;
+}
+
+static inline void spsc_ring_free(struct spsc_ring *ring)
+{
+	bfree(ring->data);
+	memset(ring, 0, sizeof(struct spsc_ring));
+}
+
+/* only the owning side writes each position, so the swap always succeeds;
+ * it's used as a full barrier to make the data visible before the position */
+static inline void spsc_ring_set_pos(volatile long *pos, size_t val)
+{
+	long old_val = os_atomic_load_long(pos);
+	os_atomic_compare_swap_long(pos, old_val, (long)val);
+}
+
+static inline size_t spsc_ring_wrap(const struct spsc_ring *ring, size_t pos)
+{
+	return pos >= ring->capacity ? pos - ring->capacity : pos;
+}
+
+/* ------------------------------------------------------------------------- */
+/* producer */
+
+static inline size_t spsc_ring_free_space(const struct spsc_ring *ring)
+{
+	size_t read_pos  = (size_t)os_atomic_load_long(&ring->read_pos);
+	size_t write_pos = (size_t)ring->write_pos;
+
+	if (!ring->capacity)
+		return 0;
+
+	return (read_pos + ring->capacity - write_pos - 1) % ring->capacity;
+}
+
+static inline void spsc_ring_write(struct spsc_ring *ring, size_t offset,
+		const void *data, size_t size)
+{
+	size_t pos = spsc_ring_wrap(ring, (size_t)ring->write_pos + offset);
+	size_t back_size = ring->capacity - pos;
+
+	if (size <= back_size) {
+		memcpy(ring->data + pos, data, size);
+	} else {
+		memcpy(ring->data + pos, data, back_size);
+		memcpy(ring->data, (const uint8_t*)data + back_size,
+				size - back_size);
+	}
+}
+
+static inline void spsc_ring_commit(struct spsc_ring *ring, size_t size)
+{
+	size_t pos = spsc_ring_wrap(ring, (size_t)ring->write_pos + size);
+	spsc_ring_set_pos(&ring->write_pos, pos);
+}
+
+/* ------------------------------------------------------------------------- */
+/* consumer */
+
+static inline size_t spsc_ring_size(const struct spsc_ring *ring)
+{
+	size_t write_pos = (size_t)os_atomic_load_long(&ring->write_pos);
+	size_t read_pos  = (size_t)ring->read_pos;
+
+	if (!ring->capacity)
+		return 0;
+
+	return (write_pos + ring->capacity - read_pos) % ring->capacity;
+}
+
+/* gets the data at an offset from the read position without copying it; if
+ * the data wraps around the end of the ring, the rest is in data2 */
+static inline void spsc_ring_peek_ptrs(const struct spsc_ring *ring,
+		size_t offset, size_t size,
+		const uint8_t **data1, size_t *size1,
+		const uint8_t **data2, size_t *size2)
+{
+	size_t pos = spsc_ring_wrap(ring, (size_t)ring->read_pos + offset);
+	size_t back_size = ring->capacity - pos;
+
+	*data1 = ring->data + pos;
+
+	if (size <= back_size) {
+		*size1 = size;
+		*data2 = NULL;
+		*size2 = 0;
+	} else {
+		*size1 = back_size;
+		*data2 = ring->data;
+		*size2 = size - back_size;
+	}
+}
+
+static inline void spsc_ring_peek(const struct spsc_ring *ring, size_t offset,
+		void *data, size_t size)
+{
+	const uint8_t *data1, *data2;
+	size_t size1, size2;
+
+	spsc_ring_peek_ptrs(ring, offset, size, &data1, &size1,
+			&data2, &size2);
+
+	memcpy(data, data1, size1);
+	if (size2)
+		memcpy((uint8_t*)data + size1, data2, size2);
+}
+
+static inline void spsc_ring_pop(struct spsc_ring *ring, size_t size)
+{
+	size_t pos = spsc_ring_wrap(ring, (size_t)ring->read_pos + size);
+	spsc_ring_set_pos(&ring->read_pos, pos);
+}
+
+static inline void spsc_ring_clear(struct spsc_ring *ring)
+{
+	size_t write_pos = (size_t)os_atomic_load_long(&ring->write_pos);
+	spsc_ring_set_pos(&ring->read_pos, write_pos);
+}
+
+#ifdef __cplusplus
+}
+#endif
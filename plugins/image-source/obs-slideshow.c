@@ -707,6 +707,7 @@ static inline bool ss_audio_render_(obs_source_t *transition, uint64_t *ts_out,
 		uint32_t mixers, size_t channels, size_t sample_rate)
 {
 	struct obs_source_audio_mix child_audio;
+	size_t frames = audio_output_get_frames(obs_get_audio());
 	uint64_t source_ts;
 
 	if (obs_source_audio_pending(transition))
@@ -725,8 +726,7 @@ static inline bool ss_audio_render_(obs_source_t *transition, uint64_t *ts_out,
 			float *out = audio_output->output[mix].data[ch];
 			float *in = child_audio.output[mix].data[ch];
 
-			memcpy(out, in, AUDIO_OUTPUT_FRAMES *
-					MAX_AUDIO_CHANNELS * sizeof(float));
+			memcpy(out, in, frames * sizeof(float));
 		}
 	}
 
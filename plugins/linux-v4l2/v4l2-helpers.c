@@ -61,13 +61,30 @@ int_fast32_t v4l2_stop_capture(int_fast32_t dev)
 	return 0;
 }
 
+int_fast32_t v4l2_queue_buffer(int_fast32_t dev, uint32_t index)
+{
+	struct v4l2_buffer enq;
+
+	memset(&enq, 0, sizeof(enq));
+	enq.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	enq.memory = V4L2_MEMORY_MMAP;
+	enq.index  = index;
+
+	if (v4l2_ioctl(dev, VIDIOC_QBUF, &enq) < 0) {
+		blog(LOG_ERROR, "unable to queue buffer");
+		return -1;
+	}
+
+	return 0;
+}
+
 int_fast32_t v4l2_create_mmap(int_fast32_t dev, struct v4l2_buffer_data *buf)
 {
 	struct v4l2_requestbuffers req;
 	struct v4l2_buffer map;
 
 	memset(&req, 0, sizeof(req));
-	req.count  = 4;
+	req.count  = 8;
 	req.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 	req.memory = V4L2_MEMORY_MMAP;
 
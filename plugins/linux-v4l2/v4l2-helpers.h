@@ -198,10 +198,20 @@ int_fast32_t v4l2_start_capture(int_fast32_t dev, struct v4l2_buffer_data *buf);
  */
 int_fast32_t v4l2_stop_capture(int_fast32_t dev);
 
+/**
+ * Give a buffer back to the device after its data has been used.
+ *
+ * @param dev handle for the v4l2 device
+ * @param index index of the buffer
+ *
+ * @return negative on failure
+ */
+int_fast32_t v4l2_queue_buffer(int_fast32_t dev, uint32_t index);
+
 /**
  * Create memory mapping for buffers
  *
- * This tries to map at least 2, preferably 4, buffers to application memory.
+ * This tries to map at least 2, preferably 8, buffers to application memory.
  *
  * @param dev handle for the v4l2 device
  * @param buf buffer data
@@ -63,6 +63,36 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define blog(level, msg, ...) blog(level, "v4l2-input: " msg, ##__VA_ARGS__)
 
+/* frames are copied instead of held once fewer buffers are left with the
+ * device, so capture never runs out of buffers */
+#define V4L2_MIN_QUEUED 2
+
+struct v4l2_mapping;
+
+struct v4l2_frame_ref {
+	struct v4l2_mapping *mapping;
+	uint32_t index;
+};
+
+/**
+ * Mapped buffers shared with libobs
+ *
+ * Frames are output without being copied, and each buffer is only given back
+ * to the device once libobs has released it.  The buffers stay mapped until
+ * the capture has stopped and the last frame has been released.
+ */
+struct v4l2_mapping {
+	volatile long refs;
+	pthread_mutex_t mutex;
+
+	/* device handle while capturing, -1 once the capture stopped */
+	int_fast32_t dev;
+	uint_fast32_t queued;
+
+	struct v4l2_buffer_data buffers;
+	struct v4l2_frame_ref *frames;
+};
+
 /**
  * Data structure for the v4l2 source
  */
@@ -85,7 +115,7 @@ struct v4l2_data {
 	int width;
 	int height;
 	int linesize;
-	struct v4l2_buffer_data buffers;
+	struct v4l2_mapping *mapping;
 };
 
 /* forward declarations */
@@ -142,6 +172,87 @@ static void v4l2_prep_obs_frame(struct v4l2_data *data,
 	}
 }
 
+static struct v4l2_mapping *v4l2_mapping_create(int_fast32_t dev)
+{
+	struct v4l2_mapping *m = bzalloc(sizeof(struct v4l2_mapping));
+
+	m->refs = 1;
+	m->dev = -1;
+
+	if (pthread_mutex_init(&m->mutex, NULL) != 0) {
+		bfree(m);
+		return NULL;
+	}
+
+	if (v4l2_create_mmap(dev, &m->buffers) == 0) {
+		m->frames = bzalloc(m->buffers.count *
+				sizeof(struct v4l2_frame_ref));
+
+		for (uint_fast32_t i = 0; i < m->buffers.count; ++i) {
+			m->frames[i].mapping = m;
+			m->frames[i].index = (uint32_t)i;
+		}
+	}
+
+	return m;
+}
+
+static void v4l2_mapping_release(struct v4l2_mapping *m)
+{
+	if (!m || os_atomic_dec_long(&m->refs) != 0)
+		return;
+
+	v4l2_destroy_mmap(&m->buffers);
+	pthread_mutex_destroy(&m->mutex);
+	bfree(m->frames);
+	bfree(m);
+}
+
+/* called by libobs once it's done with a frame */
+static void v4l2_release_frame(void *param)
+{
+	struct v4l2_frame_ref *ref = param;
+	struct v4l2_mapping *m = ref->mapping;
+
+	pthread_mutex_lock(&m->mutex);
+	if (m->dev != -1 && v4l2_queue_buffer(m->dev, ref->index) == 0)
+		m->queued++;
+	pthread_mutex_unlock(&m->mutex);
+
+	v4l2_mapping_release(m);
+}
+
+/* outputs the frame without copying it unless the device is running low on
+ * buffers, returns false if the buffer couldn't be given back */
+static bool v4l2_output_frame(struct v4l2_data *data,
+		struct obs_source_frame *out, uint32_t index)
+{
+	struct v4l2_mapping *m = data->mapping;
+	bool hold;
+	int_fast32_t ret;
+
+	pthread_mutex_lock(&m->mutex);
+	hold = --m->queued >= V4L2_MIN_QUEUED;
+	pthread_mutex_unlock(&m->mutex);
+
+	if (hold) {
+		os_atomic_inc_long(&m->refs);
+		obs_source_output_video_external(data->source, out,
+				v4l2_release_frame, &m->frames[index]);
+		return true;
+	}
+
+	obs_source_output_video(data->source, out);
+
+	pthread_mutex_lock(&m->mutex);
+	ret = v4l2_queue_buffer(m->dev, index);
+	if (ret == 0)
+		m->queued++;
+	pthread_mutex_unlock(&m->mutex);
+
+	return ret == 0;
+}
+
 /*
  * Worker thread to get video data
  */
@@ -158,9 +269,14 @@ static void *v4l2_thread(void *vptr)
 	struct obs_source_frame out;
 	size_t plane_offsets[MAX_AV_PLANES];
 
-	if (v4l2_start_capture(data->dev, &data->buffers) < 0)
+	if (v4l2_start_capture(data->dev, &data->mapping->buffers) < 0)
 		goto exit;
 
+	pthread_mutex_lock(&data->mapping->mutex);
+	data->mapping->dev = data->dev;
+	data->mapping->queued = data->mapping->buffers.count;
+	pthread_mutex_unlock(&data->mapping->mutex);
+
 	frames   = 0;
 	first_ts = 0;
 	v4l2_prep_obs_frame(data, &out, plane_offsets);
@@ -197,12 +313,12 @@ static void *v4l2_thread(void *vptr)
 			first_ts = out.timestamp;
 		out.timestamp -= first_ts;
 
-		start = (uint8_t *) data->buffers.info[buf.index].start;
+		start = (uint8_t *)
+			data->mapping->buffers.info[buf.index].start;
 		for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
 			out.data[i] = start + plane_offsets[i];
-		obs_source_output_video(data->source, &out);
 
-		if (v4l2_ioctl(data->dev, VIDIOC_QBUF, &buf) < 0) {
+		if (!v4l2_output_frame(data, &out, buf.index)) {
 			blog(LOG_DEBUG, "failed to enqueue buffer");
 			break;
 		}
@@ -213,6 +329,11 @@ static void *v4l2_thread(void *vptr)
 	blog(LOG_INFO, "Stopped capture after %"PRIu64" frames", frames);
 
 exit:
+	/* buffers released by libobs after this stay with the mapping */
+	pthread_mutex_lock(&data->mapping->mutex);
+	data->mapping->dev = -1;
+	pthread_mutex_unlock(&data->mapping->mutex);
+
 	v4l2_stop_capture(data->dev);
 	return NULL;
 }
@@ -784,7 +905,8 @@ static void v4l2_terminate(struct v4l2_data *data)
 		data->thread = 0;
 	}
 
-	v4l2_destroy_mmap(&data->buffers);
+	v4l2_mapping_release(data->mapping);
+	data->mapping = NULL;
 
 	if (data->dev != -1) {
 		v4l2_close(data->dev);
@@ -892,7 +1014,8 @@ static void v4l2_init(struct v4l2_data *data)
 	blog(LOG_INFO, "Framerate: %.2f fps", (float) fps_denom / fps_num);
 
 	/* map buffers */
-	if (v4l2_create_mmap(data->dev, &data->buffers) < 0) {
+	data->mapping = v4l2_mapping_create(data->dev);
+	if (!data->mapping || !data->mapping->frames) {
 		blog(LOG_ERROR, "Failed to map buffers");
 		goto fail;
 	}
@@ -0,0 +1,555 @@
+/*
+ * Copyright (c) 2018 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+/*
+ * Shared memory packet ring between obs-ffmpeg-mux and ffmpeg-mux.
+ *
+ *   obs-ffmpeg-mux writes each packet (an ffm_packet_info followed by the
+ * packet data) directly in to the ring, and ffmpeg-mux muxes it straight
+ * from the ring before releasing the space.  The pipe is still used for the
+ * command line, the codec headers and the exit code.
+ *
+ *   Records are never split at the end of the ring; a padding record fills
+ * the rest of the ring instead, so the packet data is always contiguous.
+ * Each side only sleeps when the ring is empty or full.  On linux it sleeps
+ * on a futex in the shared memory, on windows on a named event, and
+ * elsewhere it polls.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "ffmpeg-mux.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <limits.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+#endif
+
+#define FFM_SHM_DEFAULT_SIZE (64 * 1024 * 1024)
+#define FFM_SHM_HEADER_SIZE  64
+#define FFM_SHM_WAIT_MS      100
+
+#pragma pack(push, 8)
+
+struct ffm_shm_header {
+	volatile uint64_t    write_pos;
+	volatile uint64_t    read_pos;
+
+	/* incremented each time data is written or space is freed; the
+	 * waiting side sleeps on these */
+	volatile uint32_t    data_seq;
+	volatile uint32_t    space_seq;
+	volatile uint32_t    data_waiters;
+	volatile uint32_t    space_waiters;
+
+	volatile uint32_t    closed;
+	uint32_t             capacity;
+};
+
+struct ffm_shm_record {
+	uint32_t             size;
+	uint32_t             padding;
+	struct ffm_packet_info info;
+};
+
+#pragma pack(pop)
+
+struct ffm_shm {
+	struct ffm_shm_header *header;
+	uint8_t               *data;
+	size_t                map_size;
+	uint32_t              cur_size;
+	bool                  owner;
+	char                  name[64];
+
+#ifdef _WIN32
+	HANDLE                mapping;
+	HANDLE                data_event;
+	HANDLE                space_event;
+#endif
+};
+
+/* ------------------------------------------------------------------------- */
+/* atomics (ffmpeg-mux doesn't link libobs) */
+
+#ifdef _MSC_VER
+static inline uint64_t ffm_load64(volatile uint64_t *p)
+{
+	return (uint64_t)InterlockedCompareExchange64((volatile LONG64*)p,
+			0, 0);
+}
+
+static inline void ffm_store64(volatile uint64_t *p, uint64_t val)
+{
+	InterlockedExchange64((volatile LONG64*)p, (LONG64)val);
+}
+
+static inline uint32_t ffm_load32(volatile uint32_t *p)
+{
+	return (uint32_t)InterlockedCompareExchange((volatile LONG*)p, 0, 0);
+}
+
+static inline void ffm_inc32(volatile uint32_t *p)
+{
+	InterlockedIncrement((volatile LONG*)p);
+}
+
+static inline void ffm_dec32(volatile uint32_t *p)
+{
+	InterlockedDecrement((volatile LONG*)p);
+}
+
+static inline void ffm_store32(volatile uint32_t *p, uint32_t val)
+{
+	InterlockedExchange((volatile LONG*)p, (LONG)val);
+}
+#else
+static inline uint64_t ffm_load64(volatile uint64_t *p)
+{
+	return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+static inline void ffm_store64(volatile uint64_t *p, uint64_t val)
+{
+	__atomic_store_n(p, val, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t ffm_load32(volatile uint32_t *p)
+{
+	return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+static inline void ffm_inc32(volatile uint32_t *p)
+{
+	__atomic_fetch_add(p, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline void ffm_dec32(volatile uint32_t *p)
+{
+	__atomic_fetch_sub(p, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline void ffm_store32(volatile uint32_t *p, uint32_t val)
+{
+	__atomic_store_n(p, val, __ATOMIC_SEQ_CST);
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* waiting */
+
+static inline uint64_t ffm_shm_time_ms(void)
+{
+#ifdef _WIN32
+	return (uint64_t)GetTickCount64();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+#endif
+}
+
+#ifdef _WIN32
+static inline void ffm_shm_sleep(struct ffm_shm *shm, bool data,
+		volatile uint32_t *seq, uint32_t val)
+{
+	if (ffm_load32(seq) == val)
+		WaitForSingleObject(data ? shm->data_event : shm->space_event,
+				FFM_SHM_WAIT_MS);
+}
+
+static inline void ffm_shm_wake(struct ffm_shm *shm, bool data,
+		volatile uint32_t *seq)
+{
+	(void)seq;
+	SetEvent(data ? shm->data_event : shm->space_event);
+}
+
+#elif defined(__linux__)
+static inline void ffm_shm_sleep(struct ffm_shm *shm, bool data,
+		volatile uint32_t *seq, uint32_t val)
+{
+	struct timespec timeout = {0, FFM_SHM_WAIT_MS * 1000000L};
+
+	syscall(SYS_futex, seq, FUTEX_WAIT, val, &timeout, NULL, 0);
+	(void)shm;
+	(void)data;
+}
+
+static inline void ffm_shm_wake(struct ffm_shm *shm, bool data,
+		volatile uint32_t *seq)
+{
+	syscall(SYS_futex, seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+	(void)shm;
+	(void)data;
+}
+
+#else
+static inline void ffm_shm_sleep(struct ffm_shm *shm, bool data,
+		volatile uint32_t *seq, uint32_t val)
+{
+	if (ffm_load32(seq) == val)
+		usleep(1000);
+	(void)shm;
+	(void)data;
+}
+
+static inline void ffm_shm_wake(struct ffm_shm *shm, bool data,
+		volatile uint32_t *seq)
+{
+	(void)shm;
+	(void)data;
+	(void)seq;
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* creation */
+
+#ifdef _WIN32
+static inline bool ffm_shm_open_events(struct ffm_shm *shm, bool create)
+{
+	char name[80];
+
+	snprintf(name, sizeof(name), "%s-data", shm->name);
+	shm->data_event = create ?
+		CreateEventA(NULL, false, false, name) :
+		OpenEventA(EVENT_ALL_ACCESS, false, name);
+
+	snprintf(name, sizeof(name), "%s-space", shm->name);
+	shm->space_event = create ?
+		CreateEventA(NULL, false, false, name) :
+		OpenEventA(EVENT_ALL_ACCESS, false, name);
+
+	return shm->data_event && shm->space_event;
+}
+#endif
+
+static inline void ffm_shm_close(struct ffm_shm *shm)
+{
+#ifdef _WIN32
+	if (shm->header)
+		UnmapViewOfFile(shm->header);
+	if (shm->mapping)
+		CloseHandle(shm->mapping);
+	if (shm->data_event)
+		CloseHandle(shm->data_event);
+	if (shm->space_event)
+		CloseHandle(shm->space_event);
+#else
+	if (shm->header)
+		munmap(shm->header, shm->map_size);
+	if (shm->owner && *shm->name)
+		shm_unlink(shm->name);
+#endif
+
+	memset(shm, 0, sizeof(*shm));
+}
+
+static inline bool ffm_shm_map(struct ffm_shm *shm, bool create,
+		uint32_t capacity)
+{
+#ifdef _WIN32
+	if (create) {
+		shm->map_size = FFM_SHM_HEADER_SIZE + (size_t)capacity;
+		shm->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL,
+				PAGE_READWRITE, 0, (DWORD)shm->map_size,
+				shm->name);
+	} else {
+		shm->mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, false,
+				shm->name);
+	}
+
+	if (!shm->mapping || !ffm_shm_open_events(shm, create))
+		return false;
+
+	shm->header = MapViewOfFile(shm->mapping, FILE_MAP_ALL_ACCESS,
+			0, 0, 0);
+#else
+	int fd = shm_open(shm->name, create ? (O_RDWR | O_CREAT | O_EXCL) :
+			O_RDWR, 0600);
+	void *mem;
+
+	if (fd == -1)
+		return false;
+
+	if (create) {
+		shm->map_size = FFM_SHM_HEADER_SIZE + (size_t)capacity;
+		if (ftruncate(fd, (off_t)shm->map_size) != 0) {
+			close(fd);
+			return false;
+		}
+	} else {
+		struct stat st;
+		if (fstat(fd, &st) != 0) {
+			close(fd);
+			return false;
+		}
+		shm->map_size = (size_t)st.st_size;
+	}
+
+	mem = mmap(NULL, shm->map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			fd, 0);
+	close(fd);
+
+	shm->header = mem == MAP_FAILED ? NULL : mem;
+#endif
+
+	if (!shm->header)
+		return false;
+
+	shm->data = (uint8_t*)shm->header + FFM_SHM_HEADER_SIZE;
+	return true;
+}
+
+static inline void ffm_shm_get_name(char *name, size_t size, const char *id)
+{
+#ifdef _WIN32
+	snprintf(name, size, "obs-ffmpeg-mux-%s", id);
+#else
+	snprintf(name, size, "/obs-ffmpeg-mux-%s", id);
+#endif
+}
+
+/* creates the ring, from obs-ffmpeg-mux */
+static inline bool ffm_shm_create(struct ffm_shm *shm, const char *id,
+		uint32_t capacity)
+{
+	memset(shm, 0, sizeof(*shm));
+	ffm_shm_get_name(shm->name, sizeof(shm->name), id);
+	shm->owner = true;
+
+	if (!ffm_shm_map(shm, true, capacity)) {
+		ffm_shm_close(shm);
+		return false;
+	}
+
+	memset(shm->header, 0, sizeof(*shm->header));
+	shm->header->capacity = capacity & ~(uint32_t)7;
+	return true;
+}
+
+/* opens the ring, from ffmpeg-mux */
+static inline bool ffm_shm_open(struct ffm_shm *shm, const char *id)
+{
+	memset(shm, 0, sizeof(*shm));
+	ffm_shm_get_name(shm->name, sizeof(shm->name), id);
+
+	if (!ffm_shm_map(shm, false, 0)) {
+		ffm_shm_close(shm);
+		return false;
+	}
+
+#ifndef _WIN32
+	/* nothing else needs to open it, so it's removed right away to make
+	 * sure it's cleaned up even if either process exits unexpectedly */
+	shm_unlink(shm->name);
+#endif
+	return shm->map_size >= FFM_SHM_HEADER_SIZE + shm->header->capacity;
+}
+
+/* ------------------------------------------------------------------------- */
+/* producer */
+
+static inline uint32_t ffm_shm_record_size(uint32_t data_size)
+{
+	return (uint32_t)(sizeof(struct ffm_shm_record) + data_size + 7) &
+		~(uint32_t)7;
+}
+
+static inline bool ffm_shm_wait_space(struct ffm_shm *shm, uint64_t pos,
+		uint64_t needed, uint32_t timeout_ms)
+{
+	struct ffm_shm_header *header = shm->header;
+	uint64_t start = ffm_shm_time_ms();
+
+	for (;;) {
+		uint32_t seq = ffm_load32(&header->space_seq);
+		uint64_t used;
+
+		ffm_inc32(&header->space_waiters);
+		used = pos - ffm_load64(&header->read_pos);
+		if (header->capacity - used >= needed) {
+			ffm_dec32(&header->space_waiters);
+			return true;
+		}
+
+		if (ffm_shm_time_ms() - start >= timeout_ms) {
+			ffm_dec32(&header->space_waiters);
+			return false;
+		}
+
+		ffm_shm_sleep(shm, false, &header->space_seq, seq);
+		ffm_dec32(&header->space_waiters);
+	}
+}
+
+static inline void ffm_shm_commit(struct ffm_shm *shm, uint64_t pos)
+{
+	struct ffm_shm_header *header = shm->header;
+
+	ffm_store64(&header->write_pos, pos);
+	ffm_inc32(&header->data_seq);
+
+	if (ffm_load32(&header->data_waiters))
+		ffm_shm_wake(shm, true, &header->data_seq);
+}
+
+/* writes a packet in to the ring, waiting up to timeout_ms for space */
+static inline bool ffm_shm_write(struct ffm_shm *shm,
+		const struct ffm_packet_info *info, const uint8_t *data,
+		uint32_t timeout_ms)
+{
+	struct ffm_shm_header *header = shm->header;
+	uint32_t size = ffm_shm_record_size(info->size);
+	uint64_t pos = header->write_pos;
+	uint32_t offset = (uint32_t)(pos % header->capacity);
+	uint32_t tail = header->capacity - offset;
+	uint64_t needed = tail < size ? (uint64_t)tail + size : size;
+	struct ffm_shm_record *record;
+
+	if (size > header->capacity / 2)
+		return false;
+	if (!ffm_shm_wait_space(shm, pos, needed, timeout_ms))
+		return false;
+
+	if (tail < size) {
+		record = (struct ffm_shm_record*)(shm->data + offset);
+		record->size = tail;
+		record->padding = 1;
+		pos += tail;
+		offset = 0;
+	}
+
+	record = (struct ffm_shm_record*)(shm->data + offset);
+	record->size = size;
+	record->padding = 0;
+	record->info = *info;
+	memcpy(record + 1, data, info->size);
+
+	ffm_shm_commit(shm, pos + size);
+	return true;
+}
+
+/* marks the end of the data, from obs-ffmpeg-mux */
+static inline void ffm_shm_set_closed(struct ffm_shm *shm)
+{
+	struct ffm_shm_header *header = shm->header;
+
+	ffm_store32(&header->closed, 1);
+	ffm_inc32(&header->data_seq);
+	ffm_shm_wake(shm, true, &header->data_seq);
+}
+
+/* ------------------------------------------------------------------------- */
+/* consumer */
+
+static inline void ffm_shm_release(struct ffm_shm *shm, uint32_t size)
+{
+	struct ffm_shm_header *header = shm->header;
+
+	ffm_store64(&header->read_pos, header->read_pos + size);
+	ffm_inc32(&header->space_seq);
+
+	if (ffm_load32(&header->space_waiters))
+		ffm_shm_wake(shm, false, &header->space_seq);
+}
+
+/* packets don't go through stdin when using shared memory, but the parent
+ * keeps its end of the pipe open until it's done with the muxer.  the pipe
+ * breaks when the parent exits for any reason, including a crash. */
+static inline bool ffm_shm_parent_gone(void)
+{
+#ifdef _WIN32
+	HANDLE input = GetStdHandle(STD_INPUT_HANDLE);
+
+	if (!PeekNamedPipe(input, NULL, 0, NULL, NULL, NULL))
+		return GetLastError() == ERROR_BROKEN_PIPE ||
+		       GetLastError() == ERROR_INVALID_HANDLE;
+	return false;
+#else
+	struct pollfd fd = {STDIN_FILENO, POLLIN, 0};
+
+	if (poll(&fd, 1, 0) <= 0)
+		return false;
+	return (fd.revents & (POLLHUP | POLLERR | POLLNVAL)) != 0;
+#endif
+}
+
+/* gets the next packet without copying it, waiting for one if necessary.
+ * returns false once the ring has been closed and all packets are read. */
+static inline bool ffm_shm_peek(struct ffm_shm *shm,
+		struct ffm_packet_info **info, uint8_t **data)
+{
+	struct ffm_shm_header *header = shm->header;
+
+	for (;;) {
+		uint64_t pos = header->read_pos;
+		uint32_t seq = ffm_load32(&header->data_seq);
+		struct ffm_shm_record *record;
+
+		ffm_inc32(&header->data_waiters);
+
+		if (pos == ffm_load64(&header->write_pos)) {
+			if (ffm_load32(&header->closed) ||
+			    ffm_shm_parent_gone()) {
+				ffm_dec32(&header->data_waiters);
+				return false;
+			}
+
+			ffm_shm_sleep(shm, true, &header->data_seq, seq);
+			ffm_dec32(&header->data_waiters);
+			continue;
+		}
+
+		ffm_dec32(&header->data_waiters);
+
+		record = (struct ffm_shm_record*)
+			(shm->data + pos % header->capacity);
+
+		if (record->padding) {
+			ffm_shm_release(shm, record->size);
+			continue;
+		}
+
+		shm->cur_size = record->size;
+		*info = &record->info;
+		*data = (uint8_t*)(record + 1);
+		return true;
+	}
+}
+
+/* frees the space of the packet returned by ffm_shm_peek */
+static inline void ffm_shm_pop(struct ffm_shm *shm)
+{
+	ffm_shm_release(shm, shm->cur_size);
+}
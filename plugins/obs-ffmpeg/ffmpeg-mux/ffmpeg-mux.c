@@ -20,12 +20,16 @@
 #include <windows.h>
 #define inline __inline
 
+#else
+#include <time.h>
+#include <unistd.h>
 #endif
 
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include "ffmpeg-mux.h"
+#include "ffmpeg-mux-shm.h"
 
 #include <libavformat/avformat.h>
 
@@ -81,6 +85,8 @@ struct main_params {
 	int fps_den;
 	char *acodec;
 	char *muxer_settings;
+	char *shm_id;
+	int fsync_ms;
 };
 
 struct audio_params {
@@ -106,6 +112,10 @@ struct ffmpeg_mux {
 	int                    num_audio_streams;
 	bool                   initialized;
 	char error[4096];
+
+	/* the file is written directly when it needs to be synced to disk */
+	FILE                   *file;
+	uint64_t               last_sync;
 };
 
 static void header_free(struct header *header)
@@ -113,10 +123,141 @@ static void header_free(struct header *header)
 	free(header->data);
 }
 
+/* ------------------------------------------------------------------------- */
+
+static uint64_t get_time_ms(void)
+{
+#ifdef _WIN32
+	return (uint64_t)GetTickCount64();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+#endif
+}
+
+static FILE *open_file(const char *path)
+{
+#ifdef _WIN32
+	wchar_t *wpath;
+	FILE *file;
+	int size;
+
+	size = MultiByteToWideChar(CP_UTF8, 0, path, -1, NULL, 0);
+	wpath = malloc(size * sizeof(wchar_t));
+	MultiByteToWideChar(CP_UTF8, 0, path, -1, wpath, size);
+
+	file = _wfopen(wpath, L"wb");
+	free(wpath);
+	return file;
+#else
+	return fopen(path, "wb");
+#endif
+}
+
+static int write_file(void *opaque, uint8_t *buf, int buf_size)
+{
+	struct ffmpeg_mux *ffm = opaque;
+	size_t size = fwrite(buf, 1, (size_t)buf_size, ffm->file);
+	return size == (size_t)buf_size ? buf_size : AVERROR(EIO);
+}
+
+#ifdef _WIN32
+#define fseek_64 _fseeki64
+#define ftell_64 _ftelli64
+#else
+#define fseek_64 fseeko
+#define ftell_64 ftello
+#endif
+
+static int64_t seek_file(void *opaque, int64_t offset, int whence)
+{
+	struct ffmpeg_mux *ffm = opaque;
+	int64_t pos;
+
+	if (whence == AVSEEK_SIZE) {
+		int64_t cur = ftell_64(ffm->file);
+		fseek_64(ffm->file, 0, SEEK_END);
+		pos = ftell_64(ffm->file);
+		fseek_64(ffm->file, cur, SEEK_SET);
+		return pos;
+	}
+
+	if (fseek_64(ffm->file, offset, whence & ~AVSEEK_FORCE) != 0)
+		return AVERROR(EIO);
+
+	return ftell_64(ffm->file);
+}
+
+static void sync_file(struct ffmpeg_mux *ffm)
+{
+	avio_flush(ffm->output->pb);
+	fflush(ffm->file);
+
+#ifdef _WIN32
+	_commit(_fileno(ffm->file));
+#else
+	fsync(fileno(ffm->file));
+#endif
+
+	ffm->last_sync = get_time_ms();
+}
+
+static void ffmpeg_mux_sync(struct ffmpeg_mux *ffm)
+{
+	if (ffm->file && get_time_ms() - ffm->last_sync >=
+			(uint64_t)ffm->params.fsync_ms)
+		sync_file(ffm);
+}
+
+#define IO_BUFFER_SIZE (64 * 1024)
+
+static bool open_sync_file(struct ffmpeg_mux *ffm)
+{
+	uint8_t *buffer;
+
+	ffm->file = open_file(ffm->params.file);
+	if (!ffm->file)
+		return false;
+
+	buffer = av_malloc(IO_BUFFER_SIZE);
+	ffm->output->pb = avio_alloc_context(buffer, IO_BUFFER_SIZE, 1, ffm,
+			NULL, write_file, seek_file);
+	if (!ffm->output->pb) {
+		av_free(buffer);
+		fclose(ffm->file);
+		ffm->file = NULL;
+		return false;
+	}
+
+	ffm->output->flags |= AVFMT_FLAG_CUSTOM_IO;
+	ffm->last_sync = get_time_ms();
+	return true;
+}
+
+static void close_sync_file(struct ffmpeg_mux *ffm)
+{
+	AVIOContext *pb = ffm->output->pb;
+
+	if (pb) {
+		sync_file(ffm);
+		av_freep(&pb->buffer);
+		av_freep(&pb);
+		ffm->output->pb = NULL;
+	}
+
+	fclose(ffm->file);
+	ffm->file = NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
 static void free_avformat(struct ffmpeg_mux *ffm)
 {
 	if (ffm->output) {
-		if ((ffm->output->oformat->flags & AVFMT_NOFILE) == 0)
+		if (ffm->file)
+			close_sync_file(ffm);
+		else if ((ffm->output->oformat->flags & AVFMT_NOFILE) == 0)
 			avio_close(ffm->output->pb);
 
 		avformat_free_context(ffm->output);
@@ -258,6 +399,27 @@ static bool init_params(int *argc, char ***argv, struct main_params *params,
 
 	get_opt_str(argc, argv, &params->muxer_settings, "muxer settings");
 
+	while (*argc) {
+		char *opt;
+		get_opt_str(argc, argv, &opt, "option");
+
+		/* packets are sent through shared memory instead of stdin */
+		if (strcmp(opt, "-shm") == 0) {
+			if (!get_opt_str(argc, argv, &params->shm_id,
+						"shared memory id"))
+				return false;
+
+		/* the file is synced to disk at this interval */
+		} else if (strcmp(opt, "-fsync") == 0) {
+			if (!get_opt_int(argc, argv, &params->fsync_ms,
+						"fsync interval"))
+				return false;
+
+		} else {
+			printf("Unknown option '%s'\n", opt);
+		}
+	}
+
 	return true;
 }
 
@@ -465,7 +627,13 @@ static inline int open_output_file(struct ffmpeg_mux *ffm)
 	AVOutputFormat *format = ffm->output->oformat;
 	int ret;
 
-	if ((format->flags & AVFMT_NOFILE) == 0) {
+	if ((format->flags & AVFMT_NOFILE) == 0 && ffm->params.fsync_ms > 0) {
+		if (!open_sync_file(ffm)) {
+			printf("Couldn't open '%s'", ffm->params.file);
+			return FFM_ERROR;
+		}
+
+	} else if ((format->flags & AVFMT_NOFILE) == 0) {
 		ret = avio_open(&ffm->output->pb, ffm->params.file,
 				AVIO_FLAG_WRITE);
 		if (ret < 0) {
@@ -652,6 +820,7 @@ int main(int argc, char *argv[])
 	struct ffm_packet_info info = {0};
 	struct ffmpeg_mux ffm = {0};
 	struct resize_buf rb = {0};
+	struct ffm_shm shm = {0};
 	bool fail = false;
 	int ret;
 
@@ -683,11 +852,30 @@ int main(int argc, char *argv[])
 		return ret;
 	}
 
+	if (ffm.params.shm_id) {
+		if (ffm_shm_open(&shm, ffm.params.shm_id)) {
+			struct ffm_packet_info *shm_info;
+			uint8_t *data;
+
+			while (ffm_shm_peek(&shm, &shm_info, &data)) {
+				ffmpeg_mux_packet(&ffm, data, shm_info);
+				ffm_shm_pop(&shm);
+				ffmpeg_mux_sync(&ffm);
+			}
+		} else {
+			printf("Couldn't open shared memory '%s'\n",
+					ffm.params.shm_id);
+		}
+
+		ffm_shm_close(&shm);
+	}
+
 	while (!fail && safe_read(&info, sizeof(info)) == sizeof(info)) {
 		resize_buf_resize(&rb, info.size);
 
 		if (safe_read(rb.buf, info.size) == info.size) {
 			ffmpeg_mux_packet(&ffm, rb.buf, &info);
+			ffmpeg_mux_sync(&ffm);
 		} else {
 			fail = true;
 		}
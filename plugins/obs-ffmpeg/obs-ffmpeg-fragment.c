@@ -0,0 +1,486 @@
+/******************************************************************************
+    Copyright (C) 2018 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/dstr.h>
+
+#include <libavformat/avformat.h>
+
+#include "obs-ffmpeg-fragment.h"
+
+#define IO_BUFFER_SIZE (64 * 1024)
+
+#define do_log(level, format, ...) \
+	blog(level, "[fragment muxer: '%s'] " format, \
+			obs_output_get_name(fm->output), ##__VA_ARGS__)
+
+#define warn(format, ...)  do_log(LOG_WARNING, format, ##__VA_ARGS__)
+
+struct fragment_muxer {
+	obs_output_t      *output;
+	AVFormatContext   *context;
+	AVIOContext       *io;
+	AVStream          *video_stream;
+	AVStream          *audio_streams[MAX_AUDIO_MIXES];
+
+	fragment_write_cb write;
+	void              *param;
+};
+
+static int write_data(void *opaque, uint8_t *buf, int buf_size)
+{
+	struct fragment_muxer *fm = opaque;
+	fm->write(fm->param, buf, (size_t)buf_size);
+	return buf_size;
+}
+
+/* encoders name their codec in either case ("h264", "AAC") */
+static const AVCodecDescriptor *get_codec_desc(const char *name)
+{
+	const AVCodecDescriptor *desc = NULL;
+
+	while ((desc = avcodec_descriptor_next(desc)) != NULL) {
+		if (astrcmpi(desc->name, name) == 0)
+			return desc;
+	}
+
+	return NULL;
+}
+
+static AVStream *new_stream(struct fragment_muxer *fm, const char *name,
+		obs_encoder_t *encoder)
+{
+	const AVCodecDescriptor *desc = get_codec_desc(name);
+	AVStream *stream;
+	uint8_t *header;
+	size_t size;
+
+	if (!desc) {
+		warn("Couldn't find codec '%s'", name);
+		return NULL;
+	}
+
+	stream = avformat_new_stream(fm->context, NULL);
+	if (!stream) {
+		warn("Couldn't create stream for codec '%s'", name);
+		return NULL;
+	}
+
+	stream->id = fm->context->nb_streams - 1;
+	stream->codecpar->codec_type = desc->type;
+	stream->codecpar->codec_id = desc->id;
+
+	if (obs_encoder_get_extra_data(encoder, &header, &size) && size) {
+		stream->codecpar->extradata = av_mallocz(size +
+				AV_INPUT_BUFFER_PADDING_SIZE);
+		stream->codecpar->extradata_size = (int)size;
+		memcpy(stream->codecpar->extradata, header, size);
+	}
+
+	return stream;
+}
+
+static bool create_video_stream(struct fragment_muxer *fm,
+		obs_encoder_t *vencoder)
+{
+	video_t *video = obs_get_video();
+	const struct video_output_info *info = video_output_get_info(video);
+	AVStream *stream;
+
+	stream = new_stream(fm, obs_encoder_get_codec(vencoder), vencoder);
+	if (!stream)
+		return false;
+
+	stream->codecpar->width = (int)obs_output_get_width(fm->output);
+	stream->codecpar->height = (int)obs_output_get_height(fm->output);
+	stream->time_base = (AVRational){(int)info->fps_den,
+		(int)info->fps_num};
+	stream->avg_frame_rate = av_inv_q(stream->time_base);
+
+	fm->video_stream = stream;
+	return true;
+}
+
+static bool create_audio_stream(struct fragment_muxer *fm,
+		obs_encoder_t *aencoder, size_t idx)
+{
+	audio_t *audio = obs_get_audio();
+	int channels = (int)audio_output_get_channels(audio);
+	AVStream *stream;
+
+	stream = new_stream(fm, obs_encoder_get_codec(aencoder), aencoder);
+	if (!stream)
+		return false;
+
+	av_dict_set(&stream->metadata, "title",
+			obs_encoder_get_name(aencoder), 0);
+
+	stream->codecpar->sample_rate =
+		(int)obs_encoder_get_sample_rate(aencoder);
+	stream->codecpar->channels = channels;
+	stream->codecpar->channel_layout =
+		av_get_default_channel_layout(channels);
+	stream->time_base = (AVRational){1, stream->codecpar->sample_rate};
+
+	fm->audio_streams[idx] = stream;
+	return true;
+}
+
+static bool init_streams(struct fragment_muxer *fm)
+{
+	obs_encoder_t *vencoder = obs_output_get_video_encoder(fm->output);
+
+	if (vencoder && !create_video_stream(fm, vencoder))
+		return false;
+
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		obs_encoder_t *aencoder =
+			obs_output_get_audio_encoder(fm->output, i);
+		if (!aencoder)
+			break;
+		if (!create_audio_stream(fm, aencoder, i))
+			return false;
+	}
+
+	return fm->context->nb_streams > 0;
+}
+
+static bool init_context(struct fragment_muxer *fm)
+{
+	AVDictionary *dict = NULL;
+	uint8_t *buffer;
+	int ret;
+
+	ret = avformat_alloc_output_context2(&fm->context, NULL, "mp4", NULL);
+	if (ret < 0) {
+		warn("Couldn't initialize output context: %s",
+				av_err2str(ret));
+		return false;
+	}
+
+	if (!init_streams(fm))
+		return false;
+
+	buffer = av_malloc(IO_BUFFER_SIZE);
+	fm->io = avio_alloc_context(buffer, IO_BUFFER_SIZE, 1, fm, NULL,
+			write_data, NULL);
+	if (!fm->io) {
+		av_free(buffer);
+		warn("Couldn't create IO context");
+		return false;
+	}
+
+	fm->context->pb = fm->io;
+	fm->context->flags |= AVFMT_FLAG_CUSTOM_IO;
+	fm->context->avoid_negative_ts = AVFMT_AVOID_NEG_TS_MAKE_ZERO;
+
+	/* fragments are only cut when fragment_muxer_flush is called, and the
+	 * moov is written up front so that no fragment depends on data that
+	 * comes after it */
+	av_dict_set(&dict, "movflags",
+			"frag_custom+empty_moov+default_base_moof", 0);
+
+	ret = avformat_write_header(fm->context, &dict);
+	av_dict_free(&dict);
+
+	if (ret < 0) {
+		warn("Couldn't write header: %s", av_err2str(ret));
+		return false;
+	}
+
+	avio_flush(fm->io);
+	return true;
+}
+
+struct fragment_muxer *fragment_muxer_create(obs_output_t *output,
+		fragment_write_cb write, void *param)
+{
+	struct fragment_muxer *fm = bzalloc(sizeof(*fm));
+	fm->output = output;
+	fm->write = write;
+	fm->param = param;
+
+	if (!init_context(fm)) {
+		fragment_muxer_destroy(fm);
+		return NULL;
+	}
+
+	return fm;
+}
+
+void fragment_muxer_destroy(struct fragment_muxer *fm)
+{
+	if (!fm)
+		return;
+
+	if (fm->context)
+		avformat_free_context(fm->context);
+	if (fm->io) {
+		av_freep(&fm->io->buffer);
+		av_freep(&fm->io);
+	}
+
+	bfree(fm);
+}
+
+static inline AVStream *get_stream(struct fragment_muxer *fm,
+		struct encoder_packet *packet)
+{
+	if (packet->type == OBS_ENCODER_VIDEO)
+		return fm->video_stream;
+
+	return packet->track_idx < MAX_AUDIO_MIXES ?
+		fm->audio_streams[packet->track_idx] : NULL;
+}
+
+bool fragment_muxer_write(struct fragment_muxer *fm,
+		struct encoder_packet *packet)
+{
+	AVStream *stream = get_stream(fm, packet);
+	AVRational time_base;
+	AVPacket pkt;
+
+	if (!stream)
+		return true;
+
+	time_base = (AVRational){(int)packet->timebase_num,
+		(int)packet->timebase_den};
+
+	av_init_packet(&pkt);
+	pkt.data = packet->data;
+	pkt.size = (int)packet->size;
+	pkt.stream_index = stream->index;
+	pkt.pts = av_rescale_q(packet->pts, time_base, stream->time_base);
+	pkt.dts = av_rescale_q(packet->dts, time_base, stream->time_base);
+
+	if (packet->keyframe)
+		pkt.flags = AV_PKT_FLAG_KEY;
+
+	return av_write_frame(fm->context, &pkt) >= 0;
+}
+
+bool fragment_muxer_flush(struct fragment_muxer *fm)
+{
+	bool success = av_write_frame(fm->context, NULL) >= 0;
+	avio_flush(fm->io);
+	return success;
+}
+
+/* ------------------------------------------------------------------------ */
+
+static inline uint32_t rb32(const uint8_t *data)
+{
+	return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) |
+	       ((uint32_t)data[2] << 8) | (uint32_t)data[3];
+}
+
+static inline uint64_t rb64(const uint8_t *data)
+{
+	return ((uint64_t)rb32(data) << 32) | (uint64_t)rb32(data + 4);
+}
+
+static inline void wb32(uint8_t *data, uint32_t val)
+{
+	data[0] = (uint8_t)(val >> 24);
+	data[1] = (uint8_t)(val >> 16);
+	data[2] = (uint8_t)(val >> 8);
+	data[3] = (uint8_t)val;
+}
+
+static inline void wb64(uint8_t *data, uint64_t val)
+{
+	wb32(data, (uint32_t)(val >> 32));
+	wb32(data + 4, (uint32_t)val);
+}
+
+/* finds the next child box of the given type, box sizes are always 32 bit
+ * for the boxes looked at here */
+static uint8_t *find_box(uint8_t *data, size_t size, size_t *pos,
+		const char *type, size_t *box_size)
+{
+	while (size - *pos >= 8) {
+		uint8_t *box = data + *pos;
+		size_t cur_size = rb32(box);
+
+		if (cur_size < 8 || cur_size > size - *pos)
+			return NULL;
+
+		*pos += cur_size;
+
+		if (memcmp(box + 4, type, 4) == 0) {
+			*box_size = cur_size;
+			return box;
+		}
+	}
+
+	return NULL;
+}
+
+static uint32_t get_timescale(struct fragment_rebase *rb, uint32_t track_id)
+{
+	for (size_t i = 0; i < rb->num_tracks; i++) {
+		if (rb->track_ids[i] == track_id)
+			return rb->timescales[i];
+	}
+	return 0;
+}
+
+static void add_track(struct fragment_rebase *rb, uint8_t *trak,
+		size_t size)
+{
+	uint8_t *tkhd, *mdia, *mdhd;
+	size_t tkhd_size, mdia_size, mdhd_size;
+	size_t pos = 8;
+	uint32_t track_id, timescale;
+
+	tkhd = find_box(trak, size, &pos, "tkhd", &tkhd_size);
+	pos = 8;
+	mdia = find_box(trak, size, &pos, "mdia", &mdia_size);
+	if (!tkhd || !mdia || rb->num_tracks == FRAGMENT_MAX_TRACKS)
+		return;
+
+	pos = 8;
+	mdhd = find_box(mdia, mdia_size, &pos, "mdhd", &mdhd_size);
+	if (!mdhd)
+		return;
+
+	/* version 1 boxes have 64 bit creation/modification times */
+	if (tkhd[8] == 1 && tkhd_size >= 32)
+		track_id = rb32(tkhd + 28);
+	else if (tkhd[8] == 0 && tkhd_size >= 24)
+		track_id = rb32(tkhd + 20);
+	else
+		return;
+
+	if (mdhd[8] == 1 && mdhd_size >= 32)
+		timescale = rb32(mdhd + 28);
+	else if (mdhd[8] == 0 && mdhd_size >= 24)
+		timescale = rb32(mdhd + 20);
+	else
+		return;
+
+	if (!timescale)
+		return;
+
+	rb->track_ids[rb->num_tracks] = track_id;
+	rb->timescales[rb->num_tracks] = timescale;
+	rb->num_tracks++;
+}
+
+void fragment_rebase_init(struct fragment_rebase *rb, const uint8_t *header,
+		size_t size)
+{
+	uint8_t *data = (uint8_t*)header;
+	uint8_t *moov, *trak;
+	size_t moov_size, trak_size;
+	size_t pos = 0;
+
+	memset(rb, 0, sizeof(*rb));
+
+	moov = find_box(data, size, &pos, "moov", &moov_size);
+	if (!moov)
+		return;
+
+	pos = 8;
+	while ((trak = find_box(moov, moov_size, &pos, "trak",
+					&trak_size)) != NULL)
+		add_track(rb, trak, trak_size);
+}
+
+/* returns the tfdt of a traf along with its timescale, or NULL */
+static uint8_t *get_tfdt(struct fragment_rebase *rb, uint8_t *traf,
+		size_t size, uint32_t *timescale)
+{
+	uint8_t *tfhd, *tfdt;
+	size_t tfhd_size, tfdt_size;
+	size_t pos = 8;
+
+	tfhd = find_box(traf, size, &pos, "tfhd", &tfhd_size);
+	pos = 8;
+	tfdt = find_box(traf, size, &pos, "tfdt", &tfdt_size);
+	if (!tfhd || !tfdt || tfhd_size < 16)
+		return NULL;
+	if (tfdt_size < (tfdt[8] == 1 ? 20U : 16U))
+		return NULL;
+
+	*timescale = get_timescale(rb, rb32(tfhd + 12));
+	return *timescale ? tfdt : NULL;
+}
+
+static inline uint64_t get_tfdt_time(const uint8_t *tfdt)
+{
+	return tfdt[8] == 1 ? rb64(tfdt + 12) : (uint64_t)rb32(tfdt + 12);
+}
+
+/* the earliest track of the first fragment becomes zero */
+static void find_base(struct fragment_rebase *rb, uint8_t *moof, size_t size)
+{
+	uint8_t *traf;
+	size_t traf_size;
+	size_t pos = 8;
+
+	while ((traf = find_box(moof, size, &pos, "traf",
+					&traf_size)) != NULL) {
+		uint32_t timescale;
+		uint8_t *tfdt = get_tfdt(rb, traf, traf_size, &timescale);
+		uint64_t time;
+
+		if (!tfdt)
+			continue;
+
+		time = get_tfdt_time(tfdt);
+		if (!rb->have_base || time * rb->base_timescale <
+				rb->base * timescale) {
+			rb->base = time;
+			rb->base_timescale = timescale;
+			rb->have_base = true;
+		}
+	}
+}
+
+void fragment_rebase_moof(struct fragment_rebase *rb, uint8_t *moof,
+		size_t size)
+{
+	uint8_t *traf;
+	size_t traf_size;
+	size_t pos = 8;
+
+	if (!rb->have_base)
+		find_base(rb, moof, size);
+	if (!rb->have_base)
+		return;
+
+	while ((traf = find_box(moof, size, &pos, "traf",
+					&traf_size)) != NULL) {
+		uint32_t timescale;
+		uint8_t *tfdt = get_tfdt(rb, traf, traf_size, &timescale);
+		uint64_t time, offset;
+
+		if (!tfdt)
+			continue;
+
+		time = get_tfdt_time(tfdt);
+		offset = rb->base * timescale / rb->base_timescale;
+		time = time > offset ? time - offset : 0;
+
+		if (tfdt[8] == 1)
+			wb64(tfdt + 12, time);
+		else
+			wb32(tfdt + 12, (uint32_t)time);
+	}
+}
@@ -0,0 +1,64 @@
+/******************************************************************************
+    Copyright (C) 2018 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <obs-module.h>
+
+/*
+ * In-process fragmented MP4 muxer.  Muxed data is passed to the write
+ * callback instead of a file: the init segment (ftyp/moov) is written while
+ * the muxer is being created, and each fragment (moof/mdat) is written when
+ * fragment_muxer_flush is called.  Because every fragment is self-contained,
+ * the init segment followed by any run of fragments is a playable file.
+ */
+
+typedef void (*fragment_write_cb)(void *param, const uint8_t *data,
+		size_t size);
+
+struct fragment_muxer;
+
+extern struct fragment_muxer *fragment_muxer_create(obs_output_t *output,
+		fragment_write_cb write, void *param);
+extern void fragment_muxer_destroy(struct fragment_muxer *fm);
+
+extern bool fragment_muxer_write(struct fragment_muxer *fm,
+		struct encoder_packet *packet);
+extern bool fragment_muxer_flush(struct fragment_muxer *fm);
+
+#define FRAGMENT_MAX_TRACKS (MAX_AUDIO_MIXES + 1)
+
+/*
+ * Fragments keep the decode times (tfdt) they were muxed with, so a run of
+ * fragments taken from the middle of the stream would start late.  The first
+ * fragment passed to fragment_rebase_moof is moved to zero and every fragment
+ * after it is moved by the same amount of time.
+ */
+struct fragment_rebase {
+	uint32_t track_ids[FRAGMENT_MAX_TRACKS];
+	uint32_t timescales[FRAGMENT_MAX_TRACKS];
+	size_t   num_tracks;
+
+	bool     have_base;
+	uint64_t base;
+	uint32_t base_timescale;
+};
+
+extern void fragment_rebase_init(struct fragment_rebase *rb,
+		const uint8_t *header, size_t size);
+extern void fragment_rebase_moof(struct fragment_rebase *rb, uint8_t *moof,
+		size_t size);
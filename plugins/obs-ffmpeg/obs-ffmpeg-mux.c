@@ -15,6 +15,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#include <inttypes.h>
 #include <obs-module.h>
 #include <obs-hotkey.h>
 #include <obs-avc.h>
@@ -25,6 +26,8 @@
 #include <util/circlebuf.h>
 #include <util/threading.h>
 #include "ffmpeg-mux/ffmpeg-mux.h"
+#include "ffmpeg-mux/ffmpeg-mux-shm.h"
+#include "obs-ffmpeg-fragment.h"
 
 #include <libavformat/avformat.h>
 
@@ -35,6 +38,71 @@
 #define warn(format, ...)  do_log(LOG_WARNING, format, ##__VA_ARGS__)
 #define info(format, ...)  do_log(LOG_INFO,    format, ##__VA_ARGS__)
 
+struct replay_offsets {
+	bool              found_video;
+	int64_t           video_offset;
+	int64_t           video_dts_offset;
+	bool              found_audio[MAX_AUDIO_MIXES];
+	int64_t           audio_offsets[MAX_AUDIO_MIXES];
+	int64_t           audio_dts_offsets[MAX_AUDIO_MIXES];
+};
+
+/* a replay buffer segment holds the packets from one video keyframe up to
+ * the next, either as packets spooled to a file or as premuxed MP4
+ * fragments in a file or in memory.  segments are referenced by the buffer
+ * and by a save in progress, and the file is deleted when the last
+ * reference is released. */
+struct replay_segment {
+	volatile long     refs;
+	struct dstr       path;
+	DARRAY(uint8_t)   data;
+	uint64_t          file_size;
+	int64_t           packet_bytes;
+	int64_t           start_time;
+	struct replay_offsets offsets;
+};
+
+/* spool files are written on a separate thread so the encoder thread never
+ * waits on disk I/O.  each job holds a reference to its segment. */
+enum spool_job_type {
+	SPOOL_JOB_PACKET,
+	SPOOL_JOB_DATA,
+	SPOOL_JOB_FLUSH,
+	SPOOL_JOB_RELEASE,
+};
+
+struct spool_job {
+	enum spool_job_type   type;
+	struct replay_segment *segment;
+	struct encoder_packet packet;
+	uint8_t               *data;
+	size_t                size;
+};
+
+/* a finished file of a split recording */
+struct segment_info {
+	struct dstr path;
+	uint32_t    index;
+	int64_t     duration;
+	uint64_t    size;
+};
+
+/* the muxer of the previous file, finished on the split thread */
+struct split_job {
+	os_process_pipe_t   *pipe;
+	struct ffm_shm      shm;
+	bool                use_shm;
+	struct segment_info segment;
+};
+
+struct mux_segment {
+	struct replay_segment *segment;
+	uint64_t              size;
+
+	/* copy of in-memory data that's still being written to */
+	uint8_t               *copy;
+};
+
 struct ffmpeg_muxer {
 	obs_output_t      *output;
 	os_process_pipe_t *pipe;
@@ -46,6 +114,32 @@ struct ffmpeg_muxer {
 	volatile bool     stopping;
 	volatile bool     capturing;
 
+	/* shared memory packet transport */
+	struct ffm_shm    shm;
+	struct dstr       shm_id;
+	bool              use_shm;
+
+	/* split file */
+	int64_t           split_time;
+	int64_t           split_size;
+	uint32_t          split_index;
+	struct dstr       split_path;
+	struct dstr       segment_path;
+	bool              found_segment_start;
+	int64_t           segment_start;
+	int64_t           segment_offset;
+	uint64_t          segment_bytes;
+	int64_t           last_dts_usec;
+
+	/* the next file's muxer is started and the previous one is finished
+	 * on the split thread, packets are held until the new one is ready */
+	pthread_t         split_thread;
+	bool              split_thread_active;
+	bool              split_pending;
+	os_event_t        *split_event;
+	struct split_job  split_job;
+	struct circlebuf  split_packets;
+
 	/* replay buffer */
 	struct circlebuf  packets;
 	int64_t           cur_size;
@@ -56,6 +150,36 @@ struct ffmpeg_muxer {
 	int               keyframes;
 	obs_hotkey_id     hotkey;
 
+	/* replay buffer disk spool */
+	bool                           spooling;
+	struct dstr                    spool_path;
+	uint32_t                       spool_index;
+	DARRAY(struct replay_segment*) segments;
+	DARRAY(struct mux_segment)     mux_segments;
+	struct replay_offsets          mux_offsets;
+
+	/* spool writer thread, the file and its segment are only used by
+	 * the thread */
+	pthread_t                      spool_thread;
+	bool                           spool_thread_active;
+	pthread_mutex_t                spool_mutex;
+	os_event_t                     *spool_event;
+	os_event_t                     *spool_flushed;
+	struct circlebuf               spool_jobs;
+	volatile bool                  spool_stop;
+	volatile bool                  spool_write_failed;
+	FILE                           *spool_file;
+	struct replay_segment          *spool_file_segment;
+	bool                           mux_wait_flush;
+
+	/* replay buffer premuxed fragments */
+	bool                           premux;
+	struct fragment_muxer          *fragments;
+	DARRAY(uint8_t)                fragment_header;
+	DARRAY(uint8_t)                mux_header;
+	bool                           mux_premuxed;
+	uint64_t                       save_start;
+
 	DARRAY(struct encoder_packet) mux_packets;
 	pthread_t                     mux_thread;
 	bool                          mux_thread_joinable;
@@ -68,6 +192,60 @@ static const char *ffmpeg_mux_getname(void *type)
 	return obs_module_text("FFmpegMuxer");
 }
 
+static inline void release_segment(struct replay_segment *segment)
+{
+	if (os_atomic_dec_long(&segment->refs) == 0) {
+		if (!dstr_is_empty(&segment->path))
+			os_unlink(segment->path.array);
+		dstr_free(&segment->path);
+		da_free(segment->data);
+		bfree(segment);
+	}
+}
+
+static void push_spool_job(struct ffmpeg_muxer *stream,
+		struct spool_job *job)
+{
+	pthread_mutex_lock(&stream->spool_mutex);
+	circlebuf_push_back(&stream->spool_jobs, job, sizeof(*job));
+	pthread_mutex_unlock(&stream->spool_mutex);
+
+	os_event_signal(stream->spool_event);
+}
+
+/* spool files are deleted on the spool thread when it's running, after any
+ * writes that are still queued for them */
+static void spool_release_segment(struct ffmpeg_muxer *stream,
+		struct replay_segment *segment)
+{
+	if (stream->spool_thread_active && !dstr_is_empty(&segment->path)) {
+		struct spool_job job = {0};
+		job.type    = SPOOL_JOB_RELEASE;
+		job.segment = segment;
+		push_spool_job(stream, &job);
+	} else {
+		release_segment(segment);
+	}
+}
+
+static void spool_clear(struct ffmpeg_muxer *stream)
+{
+	for (size_t i = 0; i < stream->segments.num; i++)
+		spool_release_segment(stream, stream->segments.array[i]);
+
+	fragment_muxer_destroy(stream->fragments);
+	stream->fragments = NULL;
+	da_free(stream->fragment_header);
+
+	da_free(stream->segments);
+	dstr_free(&stream->spool_path);
+	stream->spooling = false;
+	stream->premux = false;
+}
+
+static bool start_spool_thread(struct ffmpeg_muxer *stream);
+static void stop_spool_thread(struct ffmpeg_muxer *stream);
+
 static inline void replay_buffer_clear(struct ffmpeg_muxer *stream)
 {
 	while (stream->packets.size > 0) {
@@ -77,6 +255,8 @@ static inline void replay_buffer_clear(struct ffmpeg_muxer *stream)
 	}
 
 	circlebuf_free(&stream->packets);
+	spool_clear(stream);
+	stop_spool_thread(stream);
 	stream->cur_size = 0;
 	stream->cur_time = 0;
 	stream->max_size = 0;
@@ -85,16 +265,36 @@ static inline void replay_buffer_clear(struct ffmpeg_muxer *stream)
 	stream->keyframes = 0;
 }
 
+static void wait_split_thread(struct ffmpeg_muxer *stream);
+static void free_split_packets(struct ffmpeg_muxer *stream);
+
 static void ffmpeg_mux_destroy(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
 
+	wait_split_thread(stream);
+	free_split_packets(stream);
+	os_event_destroy(stream->split_event);
+
 	replay_buffer_clear(stream);
 	if (stream->mux_thread_joinable)
 		pthread_join(stream->mux_thread, NULL);
 	da_free(stream->mux_packets);
+	da_free(stream->mux_segments);
+	da_free(stream->mux_header);
+
+	if (stream->spool_event) {
+		os_event_destroy(stream->spool_event);
+		os_event_destroy(stream->spool_flushed);
+		pthread_mutex_destroy(&stream->spool_mutex);
+	}
 
 	os_process_pipe_destroy(stream->pipe);
+	if (stream->use_shm)
+		ffm_shm_close(&stream->shm);
+	dstr_free(&stream->shm_id);
+	dstr_free(&stream->split_path);
+	dstr_free(&stream->segment_path);
 	dstr_free(&stream->path);
 	bfree(stream);
 }
@@ -104,6 +304,15 @@ static void *ffmpeg_mux_create(obs_data_t *settings, obs_output_t *output)
 	struct ffmpeg_muxer *stream = bzalloc(sizeof(*stream));
 	stream->output = output;
 
+	if (os_event_init(&stream->split_event, OS_EVENT_TYPE_MANUAL) != 0) {
+		bfree(stream);
+		return NULL;
+	}
+
+	signal_handler_add(obs_output_get_signal_handler(output),
+			"void segment_saved(ptr output, string path, int index, "
+			"int duration_ms, int size)");
+
 	UNUSED_PARAMETER(settings);
 	return stream;
 }
@@ -203,20 +412,54 @@ static void log_muxer_params(struct ffmpeg_muxer *stream, const char *settings)
 	av_dict_free(&dict);
 }
 
-static void add_muxer_params(struct dstr *cmd, struct ffmpeg_muxer *stream)
+static inline bool is_mp4_path(const char *path)
+{
+	const char *ext = os_get_path_extension(path);
+	return ext && (astrcmpi(ext, ".mp4") == 0 ||
+	               astrcmpi(ext, ".m4v") == 0 ||
+	               astrcmpi(ext, ".mov") == 0);
+}
+
+/* fragmented mp4 writes the moov up front and then self-contained
+ * fragments, so the file stays playable if recording is interrupted */
+static void add_fragment_params(struct dstr *mux, obs_data_t *settings,
+		const char *path)
+{
+	int64_t duration = obs_data_get_int(settings, "fragment_duration");
+
+	if (!obs_data_get_bool(settings, "fragmented") || !is_mp4_path(path))
+		return;
+
+	if (duration > 0)
+		dstr_catf(mux, "movflags=empty_moov+default_base_moof "
+				"frag_duration=%"PRId64" ",
+				duration * 1000);
+	else
+		dstr_cat(mux, "movflags=frag_keyframe+empty_moov+"
+				"default_base_moof ");
+}
+
+static void add_muxer_params(struct dstr *cmd, struct ffmpeg_muxer *stream,
+		const char *path)
 {
 	obs_data_t *settings = obs_output_get_settings(stream->output);
 	struct dstr mux = {0};
 
-	dstr_copy(&mux, obs_data_get_string(settings, "muxer_settings"));
+	add_fragment_params(&mux, settings, path);
+	dstr_cat(&mux, obs_data_get_string(settings, "muxer_settings"));
 
 	log_muxer_params(stream, mux.array);
 
 	dstr_replace(&mux, "\"", "\\\"");
-	obs_data_release(settings);
 
 	dstr_catf(cmd, "\"%s\" ", mux.array ? mux.array : "");
 
+	if (obs_data_get_int(settings, "fsync_interval") > 0)
+		dstr_catf(cmd, "-fsync %d ",
+				(int)obs_data_get_int(settings,
+					"fsync_interval"));
+
+	obs_data_release(settings);
 	dstr_free(&mux);
 }
 
@@ -258,7 +501,31 @@ static void build_command_line(struct ffmpeg_muxer *stream, struct dstr *cmd,
 		}
 	}
 
-	add_muxer_params(cmd, stream);
+	add_muxer_params(cmd, stream, path);
+
+	if (stream->use_shm)
+		dstr_catf(cmd, "-shm \"%s\" ", stream->shm_id.array);
+}
+
+#define SHM_WRITE_TIMEOUT_MS 10000
+
+static void create_shm(struct ffmpeg_muxer *stream)
+{
+	dstr_printf(&stream->shm_id, "%p-%"PRIu64, stream, os_gettime_ns());
+
+	stream->use_shm = ffm_shm_create(&stream->shm, stream->shm_id.array,
+			FFM_SHM_DEFAULT_SIZE);
+	if (!stream->use_shm)
+		warn("Failed to create shared memory, sending packets "
+		     "through the pipe instead");
+}
+
+static void close_shm(struct ffmpeg_muxer *stream)
+{
+	if (stream->use_shm) {
+		ffm_shm_close(&stream->shm);
+		stream->use_shm = false;
+	}
 }
 
 static inline void start_pipe(struct ffmpeg_muxer *stream, const char *path)
@@ -301,10 +568,22 @@ static bool ffmpeg_mux_start(void *data)
 	fclose(test_file);
 	os_unlink(path);
 
+	if (obs_data_get_bool(settings, "shared_memory"))
+		create_shm(stream);
+
+	stream->split_time =
+		obs_data_get_int(settings, "split_time_sec") * 1000000LL;
+	stream->split_size =
+		obs_data_get_int(settings, "split_size_mb") * (1024LL * 1024LL);
+	stream->split_index = 0;
+	dstr_copy(&stream->split_path, path);
+	dstr_copy(&stream->segment_path, path);
+
 	start_pipe(stream, path);
 	obs_data_release(settings);
 
 	if (!stream->pipe) {
+		close_shm(stream);
 		obs_output_set_last_error(stream->output,
 			obs_module_text("HelperProcessFailed"));
 		warn("Failed to create process pipe");
@@ -315,19 +594,71 @@ static bool ffmpeg_mux_start(void *data)
 	os_atomic_set_bool(&stream->active, true);
 	os_atomic_set_bool(&stream->capturing, true);
 	stream->total_bytes = 0;
+	stream->found_segment_start = false;
+	stream->segment_offset = 0;
+	stream->segment_bytes = 0;
 	obs_output_begin_data_capture(stream->output, 0);
 
 	info("Writing file '%s'...", stream->path.array);
 	return true;
 }
 
+static inline bool splitting(struct ffmpeg_muxer *stream)
+{
+	return stream->split_time > 0 || stream->split_size > 0;
+}
+
+static void get_segment_info(struct ffmpeg_muxer *stream,
+		struct segment_info *info)
+{
+	dstr_copy_dstr(&info->path, &stream->segment_path);
+	info->index = stream->split_index;
+	info->duration = stream->last_dts_usec - stream->segment_start;
+	info->size = stream->total_bytes - stream->segment_bytes;
+}
+
+static void signal_segment_saved(struct ffmpeg_muxer *stream,
+		const struct segment_info *info)
+{
+	struct calldata params;
+
+	calldata_init(&params);
+	calldata_set_ptr(&params, "output", stream->output);
+	calldata_set_string(&params, "path", info->path.array);
+	calldata_set_int(&params, "index", (long long)info->index);
+	calldata_set_int(&params, "duration_ms", info->duration / 1000);
+	calldata_set_int(&params, "size", (long long)info->size);
+
+	signal_handler_signal(obs_output_get_signal_handler(stream->output),
+			"segment_saved", &params);
+
+	calldata_free(&params);
+}
+
 static int deactivate(struct ffmpeg_muxer *stream)
 {
 	int ret = -1;
 
 	if (active(stream)) {
+		/* the previous file has to be finished before this one */
+		wait_split_thread(stream);
+		free_split_packets(stream);
+		stream->split_pending = false;
+
+		if (stream->use_shm)
+			ffm_shm_set_closed(&stream->shm);
+
 		ret = os_process_pipe_destroy(stream->pipe);
 		stream->pipe = NULL;
+		close_shm(stream);
+
+		if (ret == 0 && splitting(stream) &&
+		    stream->found_segment_start) {
+			struct segment_info info = {0};
+			get_segment_info(stream, &info);
+			signal_segment_saved(stream, &info);
+			dstr_free(&info.path);
+		}
 
 		os_atomic_set_bool(&stream->active, false);
 		os_atomic_set_bool(&stream->sent_headers, false);
@@ -371,17 +702,36 @@ static bool write_packet(struct ffmpeg_muxer *stream,
 		struct encoder_packet *packet)
 {
 	bool is_video = packet->type == OBS_ENCODER_VIDEO;
+	int64_t offset = 0;
 	size_t ret;
 
+	/* every segment after the first starts from zero */
+	if (stream->segment_offset && packet->timebase_num)
+		offset = stream->segment_offset * packet->timebase_den /
+			(packet->timebase_num * 1000000LL);
+
 	struct ffm_packet_info info = {
-		.pts = packet->pts,
-		.dts = packet->dts,
+		.pts = packet->pts - offset,
+		.dts = packet->dts - offset,
 		.size = (uint32_t)packet->size,
 		.index = (int)packet->track_idx,
 		.type = is_video ? FFM_PACKET_VIDEO : FFM_PACKET_AUDIO,
 		.keyframe = packet->keyframe
 	};
 
+	/* codec headers are always sent through the pipe */
+	if (stream->use_shm && stream->sent_headers) {
+		if (!ffm_shm_write(&stream->shm, &info, packet->data,
+					SHM_WRITE_TIMEOUT_MS)) {
+			warn("Failed to write packet to shared memory");
+			signal_failure(stream);
+			return false;
+		}
+
+		stream->total_bytes += packet->size;
+		return true;
+	}
+
 	ret = os_process_pipe_write(stream->pipe, (const uint8_t*)&info,
 			sizeof(info));
 	if (ret != sizeof(info)) {
@@ -448,6 +798,182 @@ static bool send_headers(struct ffmpeg_muxer *stream)
 	return true;
 }
 
+static void get_segment_path(struct dstr *dst, const char *path,
+		uint32_t index)
+{
+	const char *ext = os_get_path_extension(path);
+
+	if (ext) {
+		dstr_ncopy(dst, path, ext - path);
+		dstr_catf(dst, "_%03"PRIu32"%s", index + 1, ext);
+	} else {
+		dstr_printf(dst, "%s_%03"PRIu32, path, index + 1);
+	}
+}
+
+static inline bool should_split(struct ffmpeg_muxer *stream,
+		struct encoder_packet *packet)
+{
+	if (packet->type != OBS_ENCODER_VIDEO || !packet->keyframe)
+		return false;
+	if (!stream->found_segment_start)
+		return false;
+
+	if (stream->split_time > 0 &&
+	    packet->dts_usec - stream->segment_start >= stream->split_time)
+		return true;
+	if (stream->split_size > 0 &&
+	    stream->total_bytes - stream->segment_bytes >=
+	    (uint64_t)stream->split_size)
+		return true;
+
+	return false;
+}
+
+static void *split_thread(void *data)
+{
+	struct ffmpeg_muxer *stream = data;
+	struct split_job *job = &stream->split_job;
+	int ret;
+
+	os_set_thread_name("ffmpeg-mux: split_thread");
+
+	/* the next file is started first so packets can continue while the
+	 * previous file is being finished */
+	if (job->use_shm)
+		create_shm(stream);
+
+	start_pipe(stream, stream->segment_path.array);
+	if (!stream->pipe)
+		close_shm(stream);
+
+	os_event_signal(stream->split_event);
+
+	if (job->use_shm)
+		ffm_shm_set_closed(&job->shm);
+
+	ret = os_process_pipe_destroy(job->pipe);
+	if (job->use_shm)
+		ffm_shm_close(&job->shm);
+
+	/* a file the muxer failed to finish isn't reported as saved */
+	if (ret != 0)
+		warn("Muxer exited with code %d while finishing '%s'", ret,
+				job->segment.path.array);
+	else
+		signal_segment_saved(stream, &job->segment);
+
+	return NULL;
+}
+
+static void wait_split_thread(struct ffmpeg_muxer *stream)
+{
+	if (stream->split_thread_active) {
+		pthread_join(stream->split_thread, NULL);
+		stream->split_thread_active = false;
+	}
+
+	dstr_free(&stream->split_job.segment.path);
+}
+
+static void free_split_packets(struct ffmpeg_muxer *stream)
+{
+	while (stream->split_packets.size) {
+		struct encoder_packet packet;
+		circlebuf_pop_front(&stream->split_packets, &packet,
+				sizeof(packet));
+		obs_encoder_packet_release(&packet);
+	}
+
+	circlebuf_free(&stream->split_packets);
+}
+
+static inline void hold_split_packet(struct ffmpeg_muxer *stream,
+		struct encoder_packet *packet)
+{
+	struct encoder_packet ref;
+	obs_encoder_packet_ref(&ref, packet);
+	circlebuf_push_back(&stream->split_packets, &ref, sizeof(ref));
+}
+
+/* hands the current file's muxer to the split thread, which starts a new
+ * muxer process for the next file beginning at this keyframe.  the encoders
+ * are left running, so no frames are lost between files. */
+static void start_split(struct ffmpeg_muxer *stream,
+		struct encoder_packet *packet)
+{
+	struct split_job *job = &stream->split_job;
+
+	wait_split_thread(stream);
+
+	get_segment_info(stream, &job->segment);
+	job->pipe = stream->pipe;
+	job->shm = stream->shm;
+	job->use_shm = stream->use_shm;
+
+	stream->pipe = NULL;
+	stream->use_shm = false;
+	memset(&stream->shm, 0, sizeof(stream->shm));
+
+	stream->found_segment_start = false;
+	stream->split_index++;
+	get_segment_path(&stream->segment_path, stream->split_path.array,
+			stream->split_index);
+
+	stream->sent_headers = false;
+	stream->segment_offset = packet->dts_usec;
+	stream->segment_bytes = stream->total_bytes;
+	stream->split_pending = true;
+
+	os_event_reset(stream->split_event);
+
+	stream->split_thread_active = pthread_create(&stream->split_thread,
+			NULL, split_thread, stream) == 0;
+	if (!stream->split_thread_active) {
+		warn("Failed to create split thread, splitting on the "
+		     "encoder thread instead");
+		split_thread(stream);
+	}
+}
+
+static inline bool split_ready(struct ffmpeg_muxer *stream)
+{
+	return os_event_try(stream->split_event) == 0;
+}
+
+/* writes the held packets once the next file's muxer is running */
+static bool finish_split(struct ffmpeg_muxer *stream)
+{
+	bool success = true;
+
+	os_event_wait(stream->split_event);
+	stream->split_pending = false;
+
+	if (!stream->pipe) {
+		warn("Failed to create process pipe for '%s'",
+				stream->segment_path.array);
+		free_split_packets(stream);
+		signal_failure(stream);
+		return false;
+	}
+
+	info("Writing file '%s'...", stream->segment_path.array);
+
+	success = send_headers(stream);
+	stream->sent_headers = success;
+
+	while (success && stream->split_packets.size) {
+		struct encoder_packet packet;
+		circlebuf_pop_front(&stream->split_packets, &packet,
+				sizeof(packet));
+		success = write_packet(stream, &packet);
+		obs_encoder_packet_release(&packet);
+	}
+
+	free_split_packets(stream);
+	return success;
+}
+
 static void ffmpeg_mux_data(void *data, struct encoder_packet *packet)
 {
 	struct ffmpeg_muxer *stream = data;
@@ -455,7 +981,12 @@ static void ffmpeg_mux_data(void *data, struct encoder_packet *packet)
 	if (!active(stream))
 		return;
 
-	if (!stream->sent_headers) {
+	if (stream->split_pending &&
+	    (stopping(stream) || split_ready(stream)) &&
+	    !finish_split(stream))
+		return;
+
+	if (!stream->split_pending && !stream->sent_headers) {
 		if (!send_headers(stream))
 			return;
 
@@ -469,7 +1000,22 @@ static void ffmpeg_mux_data(void *data, struct encoder_packet *packet)
 		}
 	}
 
-	write_packet(stream, packet);
+	if (splitting(stream)) {
+		if (!stream->split_pending && should_split(stream, packet))
+			start_split(stream, packet);
+
+		if (!stream->found_segment_start) {
+			stream->segment_start = packet->dts_usec;
+			stream->found_segment_start = true;
+		}
+
+		stream->last_dts_usec = packet->dts_usec;
+	}
+
+	if (stream->split_pending)
+		hold_split_packet(stream, packet);
+	else
+		write_packet(stream, packet);
 }
 
 static obs_properties_t *ffmpeg_mux_properties(void *unused)
@@ -544,6 +1090,14 @@ static void *replay_buffer_create(obs_data_t *settings, obs_output_t *output)
 	struct ffmpeg_muxer *stream = bzalloc(sizeof(*stream));
 	stream->output = output;
 
+	pthread_mutex_init_value(&stream->spool_mutex);
+	if (pthread_mutex_init(&stream->spool_mutex, NULL) != 0)
+		goto fail;
+	if (os_event_init(&stream->spool_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+	if (os_event_init(&stream->spool_flushed, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+
 	stream->hotkey = obs_hotkey_register_output(output,
 			"ReplayBuffer.Save",
 			obs_module_text("ReplayBuffer.Save"),
@@ -555,6 +1109,11 @@ static void *replay_buffer_create(obs_data_t *settings, obs_output_t *output)
 			get_last_replay, stream);
 
 	return stream;
+
+fail:
+	os_event_destroy(stream->spool_event);
+	bfree(stream);
+	return NULL;
 }
 
 static void replay_buffer_destroy(void *data)
@@ -575,8 +1134,27 @@ static bool replay_buffer_start(void *data)
 		return false;
 
 	obs_data_t *s = obs_output_get_settings(stream->output);
+	const char *spool_dir = obs_data_get_string(s, "spool_dir");
+	const char *ext = obs_data_get_string(s, "extension");
 	stream->max_time = obs_data_get_int(s, "max_time_sec") * 1000000LL;
 	stream->max_size = obs_data_get_int(s, "max_size_mb") * (1024 * 1024);
+
+	if (obs_data_get_bool(s, "premux")) {
+		if (astrcmpi(ext, "mp4") == 0 || astrcmpi(ext, "mov") == 0)
+			stream->premux = true;
+		else
+			warn("Premuxed replays require the mp4 or mov "
+			     "extension, muxing '%s' replays on save", ext);
+	}
+
+	if (spool_dir && *spool_dir) {
+		os_mkdirs(spool_dir);
+		dstr_printf(&stream->spool_path, "%s/obs-replay-%p-%"PRIu64,
+				spool_dir, stream, os_gettime_ns());
+		dstr_replace(&stream->spool_path, "\\", "/");
+		stream->spooling = start_spool_thread(stream);
+	}
+
 	obs_data_release(s);
 
 	os_atomic_set_bool(&stream->active, true);
@@ -648,6 +1226,617 @@ static inline void replay_buffer_purge(struct ffmpeg_muxer *stream,
 		purge(stream);
 }
 
+/* ------------------------------------------------------------------------ */
+/* disk spool: packets are written to one file per keyframe interval, and
+ * only the segment list is kept in memory, so memory use doesn't depend on
+ * the length of the replay */
+
+static void close_spool_file(struct ffmpeg_muxer *stream)
+{
+	if (stream->spool_file) {
+		fclose(stream->spool_file);
+		stream->spool_file = NULL;
+	}
+	if (stream->spool_file_segment) {
+		release_segment(stream->spool_file_segment);
+		stream->spool_file_segment = NULL;
+	}
+}
+
+static bool select_spool_file(struct ffmpeg_muxer *stream,
+		struct replay_segment *segment)
+{
+	if (stream->spool_file_segment == segment)
+		return stream->spool_file != NULL;
+
+	close_spool_file(stream);
+
+	os_atomic_inc_long(&segment->refs);
+	stream->spool_file_segment = segment;
+	stream->spool_file = os_fopen(segment->path.array, "wb");
+
+	if (!stream->spool_file)
+		warn("Failed to create replay buffer spool file '%s'",
+				segment->path.array);
+	return stream->spool_file != NULL;
+}
+
+static void process_spool_job(struct ffmpeg_muxer *stream,
+		struct spool_job *job)
+{
+	bool success;
+
+	switch (job->type) {
+	case SPOOL_JOB_PACKET:
+	case SPOOL_JOB_DATA:
+		/* once a write fails the replay buffer stops spooling, the
+		 * rest of the queued data is dropped */
+		if (os_atomic_load_bool(&stream->spool_write_failed))
+			break;
+
+		success = select_spool_file(stream, job->segment);
+		if (success && job->type == SPOOL_JOB_PACKET)
+			success = obs_encoder_packet_write(stream->spool_file,
+					&job->packet);
+		else if (success)
+			success = fwrite(job->data, 1, job->size,
+					stream->spool_file) == job->size;
+
+		if (!success) {
+			warn("Failed to write to replay buffer spool file "
+			     "'%s'", job->segment->path.array);
+			os_atomic_set_bool(&stream->spool_write_failed, true);
+		}
+		break;
+
+	case SPOOL_JOB_FLUSH:
+		if (stream->spool_file)
+			fflush(stream->spool_file);
+		os_event_signal(stream->spool_flushed);
+		break;
+
+	case SPOOL_JOB_RELEASE:
+		/* the file has to be closed before it can be deleted */
+		if (stream->spool_file_segment == job->segment)
+			close_spool_file(stream);
+		break;
+	}
+
+	if (job->type == SPOOL_JOB_PACKET)
+		obs_encoder_packet_release(&job->packet);
+	if (job->segment)
+		release_segment(job->segment);
+	bfree(job->data);
+}
+
+static void *spool_thread(void *data)
+{
+	struct ffmpeg_muxer *stream = data;
+
+	os_set_thread_name("replay-buffer: spool_thread");
+
+	for (;;) {
+		struct spool_job job;
+		bool have_job = false;
+
+		pthread_mutex_lock(&stream->spool_mutex);
+		if (stream->spool_jobs.size) {
+			circlebuf_pop_front(&stream->spool_jobs, &job,
+					sizeof(job));
+			have_job = true;
+		}
+		pthread_mutex_unlock(&stream->spool_mutex);
+
+		if (have_job) {
+			process_spool_job(stream, &job);
+			continue;
+		}
+
+		/* only stops once everything queued has been written */
+		if (os_atomic_load_bool(&stream->spool_stop))
+			break;
+
+		os_event_wait(stream->spool_event);
+	}
+
+	close_spool_file(stream);
+	return NULL;
+}
+
+static bool start_spool_thread(struct ffmpeg_muxer *stream)
+{
+	os_atomic_set_bool(&stream->spool_stop, false);
+	os_atomic_set_bool(&stream->spool_write_failed, false);
+
+	stream->spool_thread_active = pthread_create(&stream->spool_thread,
+			NULL, spool_thread, stream) == 0;
+	if (!stream->spool_thread_active)
+		warn("Failed to create replay buffer spool thread, keeping "
+		     "packets in memory");
+
+	return stream->spool_thread_active;
+}
+
+static void stop_spool_thread(struct ffmpeg_muxer *stream)
+{
+	if (!stream->spool_thread_active)
+		return;
+
+	os_atomic_set_bool(&stream->spool_stop, true);
+	os_event_signal(stream->spool_event);
+	pthread_join(stream->spool_thread, NULL);
+
+	circlebuf_free(&stream->spool_jobs);
+	stream->spool_thread_active = false;
+}
+
+static inline bool spool_failed(struct ffmpeg_muxer *stream)
+{
+	return os_atomic_load_bool(&stream->spool_write_failed);
+}
+
+static inline void purge_segment(struct ffmpeg_muxer *stream)
+{
+	struct replay_segment *segment = stream->segments.array[0];
+
+	stream->cur_size -= segment->packet_bytes;
+	stream->keyframes--;
+
+	da_erase(stream->segments, 0);
+	spool_release_segment(stream, segment);
+
+	stream->cur_time = stream->segments.num ?
+		stream->segments.array[0]->start_time : 0;
+}
+
+static inline void spool_purge(struct ffmpeg_muxer *stream,
+		struct encoder_packet *pkt)
+{
+	if (stream->max_size) {
+		while (stream->segments.num > 2 &&
+		       (stream->cur_size + (int64_t)pkt->size) >
+		       stream->max_size)
+			purge_segment(stream);
+	}
+
+	while (stream->segments.num > 2 &&
+	       (pkt->dts_usec - stream->cur_time) > stream->max_time)
+		purge_segment(stream);
+}
+
+/* the file of a spooled segment is created by the spool thread when the
+ * first data is written to it */
+static void start_segment(struct ffmpeg_muxer *stream, int64_t start_time)
+{
+	struct replay_segment *segment;
+
+	segment = bzalloc(sizeof(*segment));
+	segment->refs = 1;
+	segment->start_time = start_time;
+
+	if (stream->spooling)
+		dstr_printf(&segment->path, "%s-%"PRIu32".spool",
+				stream->spool_path.array,
+				stream->spool_index++);
+
+	if (!stream->segments.num)
+		stream->cur_time = start_time;
+
+	da_push_back(stream->segments, &segment);
+	stream->keyframes++;
+}
+
+static void spool_packet(struct ffmpeg_muxer *stream,
+		struct encoder_packet *packet)
+{
+	struct replay_segment *segment;
+	struct replay_offsets *offsets;
+	struct spool_job job = {0};
+	bool keyframe = packet->type == OBS_ENCODER_VIDEO && packet->keyframe;
+
+	if (keyframe || !stream->segments.num)
+		start_segment(stream, packet->dts_usec);
+
+	segment = stream->segments.array[stream->segments.num - 1];
+
+	job.type = SPOOL_JOB_PACKET;
+	job.segment = segment;
+	os_atomic_inc_long(&segment->refs);
+	obs_encoder_packet_ref(&job.packet, packet);
+	push_spool_job(stream, &job);
+
+	offsets = &segment->offsets;
+
+	if (packet->type == OBS_ENCODER_VIDEO) {
+		if (!offsets->found_video) {
+			offsets->video_offset = packet->dts_usec;
+			offsets->video_dts_offset = packet->dts;
+			offsets->found_video = true;
+		}
+	} else if (!offsets->found_audio[packet->track_idx]) {
+		offsets->found_audio[packet->track_idx] = true;
+		offsets->audio_offsets[packet->track_idx] = packet->dts_usec;
+		offsets->audio_dts_offsets[packet->track_idx] = packet->dts;
+	}
+
+	segment->file_size += sizeof(*packet) + packet->size;
+	segment->packet_bytes += (int64_t)packet->size;
+	stream->cur_size += (int64_t)packet->size;
+}
+
+static bool replay_buffer_spool(struct ffmpeg_muxer *stream,
+		struct encoder_packet *packet)
+{
+	if (!spool_failed(stream)) {
+		spool_purge(stream, packet);
+		spool_packet(stream, packet);
+		return true;
+	}
+
+	/* the packets in memory can still be saved, but the spooled
+	 * packets are lost */
+	warn("Disabling the replay buffer spool, keeping packets in "
+	     "memory instead");
+
+	spool_clear(stream);
+	stream->cur_size = 0;
+	stream->cur_time = 0;
+	stream->keyframes = 0;
+	return false;
+}
+
+/* ------------------------------------------------------------------------ */
+/* premuxed fragments: packets are muxed in to one fragmented MP4 fragment
+ * per keyframe interval as they arrive, so saving only has to write the
+ * init segment and copy the fragments in the replay window */
+
+static void write_fragment_data(void *param, const uint8_t *data, size_t size)
+{
+	struct ffmpeg_muxer *stream = param;
+	struct replay_segment *segment;
+
+	/* the init segment is written while the muxer is being created */
+	if (!stream->fragments) {
+		da_push_back_array(stream->fragment_header, data, size);
+		return;
+	}
+
+	if (!stream->segments.num)
+		return;
+
+	segment = stream->segments.array[stream->segments.num - 1];
+
+	if (!dstr_is_empty(&segment->path)) {
+		struct spool_job job = {0};
+
+		job.type    = SPOOL_JOB_DATA;
+		job.segment = segment;
+		job.data    = bmemdup(data, size);
+		job.size    = size;
+		os_atomic_inc_long(&segment->refs);
+		push_spool_job(stream, &job);
+	} else {
+		da_push_back_array(segment->data, data, size);
+	}
+
+	segment->file_size += size;
+}
+
+static bool fragment_packet(struct ffmpeg_muxer *stream,
+		struct encoder_packet *packet)
+{
+	struct replay_segment *segment;
+	bool keyframe = packet->type == OBS_ENCODER_VIDEO && packet->keyframe;
+
+	if (keyframe || !stream->segments.num) {
+		if (stream->segments.num &&
+		    !fragment_muxer_flush(stream->fragments))
+			return false;
+		start_segment(stream, packet->dts_usec);
+	}
+
+	if (!fragment_muxer_write(stream->fragments, packet))
+		return false;
+
+	segment = stream->segments.array[stream->segments.num - 1];
+	segment->packet_bytes += (int64_t)packet->size;
+	stream->cur_size += (int64_t)packet->size;
+	return !spool_failed(stream);
+}
+
+static bool replay_buffer_fragment(struct ffmpeg_muxer *stream,
+		struct encoder_packet *packet)
+{
+	if (!stream->fragments) {
+		stream->fragments = fragment_muxer_create(stream->output,
+				write_fragment_data, stream);
+		if (!stream->fragments) {
+			warn("Failed to create fragment muxer, muxing "
+			     "replays on save instead");
+			da_free(stream->fragment_header);
+			stream->premux = false;
+			return stream->spooling &&
+				replay_buffer_spool(stream, packet);
+		}
+	}
+
+	spool_purge(stream, packet);
+
+	if (fragment_packet(stream, packet))
+		return true;
+
+	warn("Failed to write replay buffer fragment, keeping packets in "
+	     "memory instead");
+
+	spool_clear(stream);
+	stream->cur_size = 0;
+	stream->cur_time = 0;
+	stream->keyframes = 0;
+	return false;
+}
+
+/* segment data is read from either its spool file or memory */
+struct segment_reader {
+	FILE          *file;
+	const uint8_t *data;
+	uint64_t      pos;
+	uint64_t      size;
+};
+
+static bool segment_read(struct segment_reader *sr, uint8_t *buf,
+		size_t size)
+{
+	if ((uint64_t)size > sr->size - sr->pos)
+		return false;
+
+	if (sr->file) {
+		if (fread(buf, 1, size, sr->file) != size)
+			return false;
+	} else {
+		memcpy(buf, sr->data + sr->pos, size);
+	}
+
+	sr->pos += size;
+	return true;
+}
+
+static bool segment_copy(FILE *out, struct segment_reader *sr,
+		uint64_t size, uint8_t *buffer, size_t buffer_size)
+{
+	while (size) {
+		size_t cur = buffer_size;
+		if ((uint64_t)cur > size)
+			cur = (size_t)size;
+
+		if (!segment_read(sr, buffer, cur) ||
+		    fwrite(buffer, 1, cur, out) != cur)
+			return false;
+		size -= cur;
+	}
+
+	return true;
+}
+
+static inline uint64_t read_box_size(const uint8_t *data, size_t size)
+{
+	uint64_t val = 0;
+	for (size_t i = 0; i < size; i++)
+		val = (val << 8) | data[i];
+	return val;
+}
+
+/* copies the fragments of a segment box by box so the decode times in each
+ * moof can be rebased to the start of the saved replay */
+static bool copy_segment(FILE *out, struct mux_segment *ms,
+		struct fragment_rebase *rb, uint8_t *buffer,
+		size_t buffer_size)
+{
+	struct segment_reader sr = {0};
+	bool success = true;
+
+	sr.size = ms->size;
+
+	if (!dstr_is_empty(&ms->segment->path)) {
+		sr.file = os_fopen(ms->segment->path.array, "rb");
+		success = !!sr.file;
+	} else {
+		sr.data = ms->copy ? ms->copy : ms->segment->data.array;
+	}
+
+	while (success && sr.pos < sr.size) {
+		uint8_t header[16];
+		size_t header_size = 8;
+		uint64_t box_size;
+
+		success = segment_read(&sr, header, 8);
+		if (!success)
+			break;
+
+		box_size = read_box_size(header, 4);
+		if (box_size == 1) {
+			success = segment_read(&sr, header + 8, 8);
+			box_size = read_box_size(header + 8, 8);
+			header_size = 16;
+		} else if (box_size == 0) {
+			box_size = sr.size - sr.pos + header_size;
+		}
+
+		if (!success || box_size < header_size ||
+		    box_size - header_size > sr.size - sr.pos) {
+			success = false;
+			break;
+		}
+
+		if (memcmp(header + 4, "moof", 4) == 0 &&
+		    box_size <= buffer_size) {
+			size_t size = (size_t)box_size;
+
+			memcpy(buffer, header, header_size);
+			success = segment_read(&sr, buffer + header_size,
+					size - header_size);
+			if (success) {
+				fragment_rebase_moof(rb, buffer, size);
+				success = fwrite(buffer, 1, size, out) == size;
+			}
+		} else {
+			success = fwrite(header, 1, header_size, out) ==
+				header_size && segment_copy(out, &sr,
+						box_size - header_size,
+						buffer, buffer_size);
+		}
+	}
+
+	if (sr.file)
+		fclose(sr.file);
+	return success;
+}
+
+#define COPY_BUFFER_SIZE (1024 * 1024)
+
+static inline void wait_spool_flush(struct ffmpeg_muxer *stream)
+{
+	if (stream->mux_wait_flush)
+		os_event_wait(stream->spool_flushed);
+}
+
+static void *replay_buffer_copy_thread(void *data)
+{
+	struct ffmpeg_muxer *stream = data;
+	struct fragment_rebase rb;
+	uint8_t *buffer = bmalloc(COPY_BUFFER_SIZE);
+	bool success;
+	FILE *out;
+
+	wait_spool_flush(stream);
+	fragment_rebase_init(&rb, stream->mux_header.array,
+			stream->mux_header.num);
+
+	out = os_fopen(stream->path.array, "wb");
+	success = !!out;
+
+	if (success)
+		success = fwrite(stream->mux_header.array, 1,
+				stream->mux_header.num, out) ==
+			stream->mux_header.num;
+
+	for (size_t i = 0; success && i < stream->mux_segments.num; i++) {
+		struct mux_segment *ms = &stream->mux_segments.array[i];
+		success = copy_segment(out, ms, &rb, buffer,
+				COPY_BUFFER_SIZE);
+	}
+
+	if (out)
+		fclose(out);
+
+	if (success)
+		info("Wrote replay buffer to '%s' in %"PRIu64" ms",
+				stream->path.array,
+				(os_gettime_ns() - stream->save_start) /
+				1000000);
+	else
+		warn("Failed to write replay buffer to '%s'",
+				stream->path.array);
+
+	for (size_t i = 0; i < stream->mux_segments.num; i++) {
+		release_segment(stream->mux_segments.array[i].segment);
+		bfree(stream->mux_segments.array[i].copy);
+	}
+
+	bfree(buffer);
+	da_free(stream->mux_segments);
+	da_free(stream->mux_header);
+	os_atomic_set_bool(&stream->muxing, false);
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------ */
+
+static void write_spooled_packets(struct ffmpeg_muxer *stream)
+{
+	struct replay_offsets *offsets = &stream->mux_offsets;
+	bool success = true;
+
+	for (size_t i = 0; i < stream->mux_segments.num; i++) {
+		struct mux_segment *ms = &stream->mux_segments.array[i];
+		uint64_t pos = 0;
+		FILE *file = NULL;
+
+		if (success)
+			file = os_fopen(ms->segment->path.array, "rb");
+		if (success && !file) {
+			warn("Failed to open replay buffer spool file '%s'",
+					ms->segment->path.array);
+			success = false;
+		}
+
+		while (success && pos < ms->size) {
+			struct encoder_packet pkt;
+
+			if (!obs_encoder_packet_read(file, &pkt)) {
+				success = false;
+				break;
+			}
+
+			pos += sizeof(pkt) + pkt.size;
+
+			if (pkt.type == OBS_ENCODER_VIDEO) {
+				pkt.dts_usec -= offsets->video_offset;
+				pkt.dts -= offsets->video_dts_offset;
+				pkt.pts -= offsets->video_dts_offset;
+			} else {
+				size_t idx = pkt.track_idx;
+				pkt.dts_usec -= offsets->audio_offsets[idx];
+				pkt.dts -= offsets->audio_dts_offsets[idx];
+				pkt.pts -= offsets->audio_dts_offsets[idx];
+			}
+
+			success = write_packet(stream, &pkt);
+			obs_encoder_packet_release(&pkt);
+		}
+
+		if (file)
+			fclose(file);
+		release_segment(ms->segment);
+	}
+
+	da_free(stream->mux_segments);
+}
+
+/* the offsets of a spooled replay come from the first packet of each track,
+ * which may not all be in the first segment.  this is done when saving
+ * because the last segment is still being written to. */
+static void get_spool_offsets(struct ffmpeg_muxer *stream)
+{
+	struct replay_offsets *offsets = &stream->mux_offsets;
+
+	memset(offsets, 0, sizeof(*offsets));
+
+	for (size_t i = 0; i < stream->mux_segments.num; i++) {
+		struct replay_offsets *seg_offsets =
+			&stream->mux_segments.array[i].segment->offsets;
+
+		if (!offsets->found_video && seg_offsets->found_video) {
+			offsets->video_offset = seg_offsets->video_offset;
+			offsets->video_dts_offset =
+				seg_offsets->video_dts_offset;
+			offsets->found_video = true;
+		}
+
+		for (size_t j = 0; j < MAX_AUDIO_MIXES; j++) {
+			if (!offsets->found_audio[j] &&
+			    seg_offsets->found_audio[j]) {
+				offsets->audio_offsets[j] =
+					seg_offsets->audio_offsets[j];
+				offsets->audio_dts_offsets[j] =
+					seg_offsets->audio_dts_offsets[j];
+				offsets->found_audio[j] = true;
+			}
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------ */
+
 static void insert_packet(struct darray *array, struct encoder_packet *packet,
 		int64_t video_offset, int64_t *audio_offsets,
 		int64_t video_dts_offset, int64_t *audio_dts_offsets)
@@ -683,6 +1872,7 @@ static void *replay_buffer_mux_thread(void *data)
 {
 	struct ffmpeg_muxer *stream = data;
 
+	wait_spool_flush(stream);
 	start_pipe(stream, stream->path.array);
 
 	if (!stream->pipe) {
@@ -699,15 +1889,25 @@ static void *replay_buffer_mux_thread(void *data)
 	for (size_t i = 0; i < stream->mux_packets.num; i++) {
 		struct encoder_packet *pkt = &stream->mux_packets.array[i];
 		write_packet(stream, pkt);
-		obs_encoder_packet_release(pkt);
 	}
 
-	info("Wrote replay buffer to '%s'", stream->path.array);
+	write_spooled_packets(stream);
+
+	info("Wrote replay buffer to '%s' in %"PRIu64" ms",
+			stream->path.array,
+			(os_gettime_ns() - stream->save_start) / 1000000);
 
 error:
 	os_process_pipe_destroy(stream->pipe);
 	stream->pipe = NULL;
+
+	for (size_t i = 0; i < stream->mux_packets.num; i++)
+		obs_encoder_packet_release(&stream->mux_packets.array[i]);
+	for (size_t i = 0; i < stream->mux_segments.num; i++)
+		release_segment(stream->mux_segments.array[i].segment);
+
 	da_free(stream->mux_packets);
+	da_free(stream->mux_segments);
 	os_atomic_set_bool(&stream->muxing, false);
 	return NULL;
 }
@@ -717,8 +1917,48 @@ static void replay_buffer_save(struct ffmpeg_muxer *stream)
 	const size_t size = sizeof(struct encoder_packet);
 	size_t num_packets = stream->packets.size / size;
 
+	stream->save_start = os_gettime_ns();
+	stream->mux_premuxed = stream->premux && stream->fragments;
+
 	da_reserve(stream->mux_packets, num_packets);
 
+	/* ---------------------------- */
+	/* reference segments */
+
+	/* ends the current fragment so the data up to now can be saved; the
+	 * next fragment continues in the same segment */
+	if (stream->mux_premuxed)
+		fragment_muxer_flush(stream->fragments);
+	/* the mux thread waits until everything written so far is on disk */
+	stream->mux_wait_flush = stream->spool_thread_active;
+	if (stream->mux_wait_flush) {
+		struct spool_job job = {0};
+		job.type = SPOOL_JOB_FLUSH;
+
+		os_event_reset(stream->spool_flushed);
+		push_spool_job(stream, &job);
+	}
+
+	for (size_t i = 0; i < stream->segments.num; i++) {
+		struct mux_segment ms = {0};
+		bool last = i == stream->segments.num - 1;
+
+		ms.segment = stream->segments.array[i];
+		ms.size = ms.segment->file_size;
+
+		if (last && ms.segment->data.num)
+			ms.copy = bmemdup(ms.segment->data.array,
+					ms.segment->data.num);
+
+		os_atomic_inc_long(&ms.segment->refs);
+		da_push_back(stream->mux_segments, &ms);
+	}
+
+	if (stream->mux_premuxed)
+		da_copy(stream->mux_header, stream->fragment_header);
+	else
+		get_spool_offsets(stream);
+
 	/* ---------------------------- */
 	/* reorder packets */
 
@@ -776,7 +2016,9 @@ static void replay_buffer_save(struct ffmpeg_muxer *stream)
 
 	os_atomic_set_bool(&stream->muxing, true);
 	stream->mux_thread_joinable = pthread_create(&stream->mux_thread, NULL,
-			replay_buffer_mux_thread, stream) == 0;
+			stream->mux_premuxed ?
+			replay_buffer_copy_thread : replay_buffer_mux_thread,
+			stream) == 0;
 }
 
 static void deactivate_replay_buffer(struct ffmpeg_muxer *stream)
@@ -790,10 +2032,27 @@ static void deactivate_replay_buffer(struct ffmpeg_muxer *stream)
 	replay_buffer_clear(stream);
 }
 
+static void replay_buffer_push(struct ffmpeg_muxer *stream,
+		struct encoder_packet *packet)
+{
+	struct encoder_packet pkt;
+
+	obs_encoder_packet_ref(&pkt, packet);
+	replay_buffer_purge(stream, &pkt);
+
+	if (!stream->packets.size)
+		stream->cur_time = pkt.dts_usec;
+	stream->cur_size += pkt.size;
+
+	circlebuf_push_back(&stream->packets, packet, sizeof(*packet));
+
+	if (packet->type == OBS_ENCODER_VIDEO && packet->keyframe)
+		stream->keyframes++;
+}
+
 static void replay_buffer_data(void *data, struct encoder_packet *packet)
 {
 	struct ffmpeg_muxer *stream = data;
-	struct encoder_packet pkt;
 
 	if (!active(stream))
 		return;
@@ -805,17 +2064,15 @@ static void replay_buffer_data(void *data, struct encoder_packet *packet)
 		}
 	}
 
-	obs_encoder_packet_ref(&pkt, packet);
-	replay_buffer_purge(stream, &pkt);
+	bool stored = false;
 
-	if (!stream->packets.size)
-		stream->cur_time = pkt.dts_usec;
-	stream->cur_size += pkt.size;
-
-	circlebuf_push_back(&stream->packets, packet, sizeof(*packet));
+	if (stream->premux)
+		stored = replay_buffer_fragment(stream, packet);
+	else if (stream->spooling)
+		stored = replay_buffer_spool(stream, packet);
 
-	if (packet->type == OBS_ENCODER_VIDEO && packet->keyframe)
-		stream->keyframes++;
+	if (!stored)
+		replay_buffer_push(stream, packet);
 
 	if (stream->save_ts && packet->sys_dts_usec >= stream->save_ts) {
 		if (os_atomic_load_bool(&stream->muxing))
@@ -838,6 +2095,8 @@ static void replay_buffer_defaults(obs_data_t *s)
 	obs_data_set_default_string(s, "format", "%CCYY-%MM-%DD %hh-%mm-%ss");
 	obs_data_set_default_string(s, "extension", "mp4");
 	obs_data_set_default_bool(s, "allow_spaces", true);
+	obs_data_set_default_string(s, "spool_dir", "");
+	obs_data_set_default_bool(s, "premux", false);
 }
 
 struct obs_output_info replay_buffer = {
@@ -45,6 +45,12 @@ struct flv_output {
 
 	bool            got_first_video;
 	int32_t         start_dts_offset;
+
+	/* split file */
+	int64_t         split_time;
+	int64_t         split_size;
+	uint32_t        split_index;
+	struct dstr     split_path;
 };
 
 static inline bool stopping(struct flv_output *stream)
@@ -70,6 +76,7 @@ static void flv_output_destroy(void *data)
 	struct flv_output *stream = data;
 
 	pthread_mutex_destroy(&stream->mutex);
+	dstr_free(&stream->split_path);
 	dstr_free(&stream->path);
 	bfree(stream);
 }
@@ -80,6 +87,10 @@ static void *flv_output_create(obs_data_t *settings, obs_output_t *output)
 	stream->output = output;
 	pthread_mutex_init(&stream->mutex, NULL);
 
+	signal_handler_add(obs_output_get_signal_handler(output),
+			"void segment_saved(ptr output, string path, int index, "
+			"int duration_ms, int size)");
+
 	UNUSED_PARAMETER(settings);
 	return stream;
 }
@@ -170,6 +181,11 @@ static bool flv_output_start(void *data)
 	settings = obs_output_get_settings(stream->output);
 	path = obs_data_get_string(settings, "path");
 	dstr_copy(&stream->path, path);
+	dstr_copy(&stream->split_path, path);
+	stream->split_time = obs_data_get_int(settings, "split_time_sec") * 1000;
+	stream->split_size =
+		obs_data_get_int(settings, "split_size_mb") * (1024LL * 1024LL);
+	stream->split_index = 0;
 	obs_data_release(settings);
 
 	stream->file = os_fopen(stream->path.array, "wb");
@@ -193,21 +209,110 @@ static void flv_output_stop(void *data, uint64_t ts)
 	os_atomic_set_bool(&stream->stopping, true);
 }
 
+static inline bool splitting(struct flv_output *stream)
+{
+	return stream->split_time > 0 || stream->split_size > 0;
+}
+
+static void signal_segment_saved(struct flv_output *stream,
+		int64_t duration, int64_t size)
+{
+	struct calldata params;
+
+	calldata_init(&params);
+	calldata_set_ptr(&params, "output", stream->output);
+	calldata_set_string(&params, "path", stream->path.array);
+	calldata_set_int(&params, "index", (long long)stream->split_index);
+	calldata_set_int(&params, "duration_ms", duration);
+	calldata_set_int(&params, "size", size);
+
+	signal_handler_signal(obs_output_get_signal_handler(stream->output),
+			"segment_saved", &params);
+
+	calldata_free(&params);
+}
+
+static void close_file(struct flv_output *stream)
+{
+	int64_t duration = stream->last_packet_ts - stream->start_dts_offset;
+	int64_t size = os_ftelli64(stream->file);
+
+	write_file_info(stream->file, duration, size);
+	fclose(stream->file);
+	stream->file = NULL;
+
+	if (splitting(stream) && stream->got_first_video)
+		signal_segment_saved(stream, duration, size);
+}
+
 static void flv_output_actual_stop(struct flv_output *stream)
 {
 	os_atomic_set_bool(&stream->active, false);
 
-	if (stream->file) {
-		write_file_info(stream->file, stream->last_packet_ts,
-				os_ftelli64(stream->file));
-
-		fclose(stream->file);
-	}
+	if (stream->file)
+		close_file(stream);
 	obs_output_end_data_capture(stream->output);
 
 	info("FLV file output complete");
 }
 
+static void get_segment_path(struct dstr *dst, const char *path,
+		uint32_t index)
+{
+	const char *ext = os_get_path_extension(path);
+
+	if (ext) {
+		dstr_ncopy(dst, path, ext - path);
+		dstr_catf(dst, "_%03"PRIu32"%s", index + 1, ext);
+	} else {
+		dstr_printf(dst, "%s_%03"PRIu32, path, index + 1);
+	}
+}
+
+static inline bool should_split(struct flv_output *stream,
+		struct encoder_packet *packet)
+{
+	if (packet->type != OBS_ENCODER_VIDEO || !packet->keyframe)
+		return false;
+	if (!stream->got_first_video)
+		return false;
+
+	if (stream->split_time > 0 &&
+	    get_ms_time(packet, packet->dts) - stream->start_dts_offset >=
+	    stream->split_time)
+		return true;
+	if (stream->split_size > 0 &&
+	    os_ftelli64(stream->file) >= stream->split_size)
+		return true;
+
+	return false;
+}
+
+/* finishes the current file and continues in the next one from this
+ * keyframe, which becomes the new zero timestamp */
+static bool split_file(struct flv_output *stream)
+{
+	close_file(stream);
+
+	stream->split_index++;
+	get_segment_path(&stream->path, stream->split_path.array,
+			stream->split_index);
+
+	stream->file = os_fopen(stream->path.array, "wb");
+	if (!stream->file) {
+		warn("Unable to open FLV file '%s'", stream->path.array);
+		os_atomic_set_bool(&stream->active, false);
+		obs_output_signal_stop(stream->output, OBS_OUTPUT_ERROR);
+		return false;
+	}
+
+	write_headers(stream);
+	stream->got_first_video = false;
+
+	info("Writing FLV file '%s'...", stream->path.array);
+	return true;
+}
+
 static void flv_output_data(void *data, struct encoder_packet *packet)
 {
 	struct flv_output     *stream = data;
@@ -230,6 +335,11 @@ static void flv_output_data(void *data, struct encoder_packet *packet)
 		stream->sent_headers = true;
 	}
 
+	if (splitting(stream) && should_split(stream, packet)) {
+		if (!split_file(stream))
+			goto unlock;
+	}
+
 	if (packet->type == OBS_ENCODER_VIDEO) {
 		if (!stream->got_first_video) {
 			stream->start_dts_offset =
@@ -189,6 +189,7 @@ static bool stinger_audio_render(void *data, uint64_t *ts_out,
 		*ts_out = ts;
 
 	struct obs_source_audio_mix child_audio;
+	size_t frames = audio_output_get_frames(obs_get_audio());
 	obs_source_get_audio_mix(s->media_source, &child_audio);
 
 	for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
@@ -198,7 +199,7 @@ static bool stinger_audio_render(void *data, uint64_t *ts_out,
 		for (size_t ch = 0; ch < channels; ch++) {
 			register float *out = audio->output[mix].data[ch];
 			register float *in = child_audio.output[mix].data[ch];
-			register float *end = in + AUDIO_OUTPUT_FRAMES;
+			register float *end = in + frames;
 
 			while (in < end)
 				*(out++) += *(in++);
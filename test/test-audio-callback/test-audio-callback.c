@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <util/bmem.h>
+#include <util/threading.h>
+#include <util/platform.h>
+#include <util/profiler.h>
+#include <obs.h>
+
+/*
+ * Measures how the cost of the audio callback grows with the number of audio
+ * sources.  For each source count, that many sources are put on output
+ * channels and fed a tone, and the average time of an audio thread tick is
+ * read from the profiler.
+ */
+
+#define SAMPLE_RATE     48000
+#define FEED_FRAMES     480
+#define FEED_INTERVAL   10000000ULL
+#define WARMUP_TIME_MS  1000
+#define MEASURE_TIME_MS 3000
+
+#define AUDIO_THREAD_NAME "audio_thread(Audio)"
+
+static const size_t source_counts[] = {1, 2, 4, 8, 16, 32, 64};
+
+#define NUM_SOURCE_COUNTS (sizeof(source_counts) / sizeof(source_counts[0]))
+
+#ifndef M_PI
+#define M_PI 3.1415926535897932384626433832795
+#endif
+
+struct feeder {
+	obs_source_t *sources[MAX_CHANNELS];
+	size_t       num_sources;
+
+	pthread_t    thread;
+	os_event_t   *stop_event;
+	bool         thread_active;
+};
+
+/* ------------------------------------------------------------------------- */
+
+static const char *bench_source_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Audio Callback Benchmark Source";
+}
+
+static void *bench_source_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	UNUSED_PARAMETER(source);
+	return bzalloc(1);
+}
+
+static void bench_source_destroy(void *data)
+{
+	bfree(data);
+}
+
+static struct obs_source_info bench_source = {
+	.id           = "test_audio_callback_source",
+	.type         = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_AUDIO,
+	.get_name     = bench_source_getname,
+	.create       = bench_source_create,
+	.destroy      = bench_source_destroy,
+};
+
+/* ------------------------------------------------------------------------- */
+
+static void *feeder_thread(void *param)
+{
+	struct feeder *feeder = param;
+	float samples[FEED_FRAMES];
+	uint64_t next_time = os_gettime_ns();
+	double phase = 0.0;
+
+	while (os_event_try(feeder->stop_event) == EAGAIN) {
+		struct obs_source_audio audio = {0};
+
+		for (size_t i = 0; i < FEED_FRAMES; i++) {
+			samples[i] = (float)sin(phase) * 0.25f;
+			phase += 440.0 * 2.0 * M_PI / SAMPLE_RATE;
+		}
+
+		audio.data[0]         = (const uint8_t*)samples;
+		audio.data[1]         = (const uint8_t*)samples;
+		audio.frames          = FEED_FRAMES;
+		audio.speakers        = SPEAKERS_STEREO;
+		audio.format          = AUDIO_FORMAT_FLOAT_PLANAR;
+		audio.samples_per_sec = SAMPLE_RATE;
+		audio.timestamp       = next_time;
+
+		for (size_t i = 0; i < feeder->num_sources; i++)
+			obs_source_output_audio(feeder->sources[i], &audio);
+
+		next_time += FEED_INTERVAL;
+		if (!os_sleepto_ns(next_time))
+			next_time = os_gettime_ns();
+	}
+
+	return NULL;
+}
+
+static bool feeder_start(struct feeder *feeder, size_t num_sources)
+{
+	feeder->num_sources = num_sources;
+
+	for (size_t i = 0; i < num_sources; i++) {
+		char name[32];
+		snprintf(name, sizeof(name), "bench source %d", (int)i);
+
+		feeder->sources[i] = obs_source_create(bench_source.id, name,
+				NULL, NULL);
+		if (!feeder->sources[i])
+			return false;
+
+		obs_set_output_source((uint32_t)i, feeder->sources[i]);
+	}
+
+	if (os_event_init(&feeder->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		return false;
+
+	if (pthread_create(&feeder->thread, NULL, feeder_thread, feeder) != 0)
+		return false;
+
+	feeder->thread_active = true;
+	return true;
+}
+
+static void feeder_stop(struct feeder *feeder)
+{
+	if (feeder->thread_active) {
+		os_event_signal(feeder->stop_event);
+		pthread_join(feeder->thread, NULL);
+	}
+
+	os_event_destroy(feeder->stop_event);
+
+	for (size_t i = 0; i < feeder->num_sources; i++) {
+		obs_set_output_source((uint32_t)i, NULL);
+		obs_source_release(feeder->sources[i]);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+struct tick_times {
+	uint64_t total_usec;
+	uint64_t count;
+};
+
+static bool get_tick_times(void *context, profiler_snapshot_entry_t *entry)
+{
+	struct tick_times *times = context;
+	profiler_time_entries_t *entries;
+
+	const char *name = profiler_snapshot_entry_name(entry);
+	if (strcmp(name, AUDIO_THREAD_NAME) != 0)
+		return true;
+
+	entries = profiler_snapshot_entry_times(entry);
+	for (size_t i = 0; i < entries->num; i++) {
+		times->total_usec += entries->array[i].time_delta *
+			entries->array[i].count;
+		times->count += entries->array[i].count;
+	}
+
+	return false;
+}
+
+static struct tick_times snapshot_tick_times(void)
+{
+	profiler_snapshot_t *snap = profile_snapshot_create();
+	struct tick_times times = {0};
+
+	profiler_snapshot_enumerate_roots(snap, get_tick_times, &times);
+	profile_snapshot_free(snap);
+	return times;
+}
+
+static bool run_benchmark(size_t num_sources)
+{
+	struct feeder feeder = {0};
+	struct tick_times start, end;
+	uint64_t count;
+	bool success;
+
+	success = feeder_start(&feeder, num_sources);
+	if (success) {
+		os_sleep_ms(WARMUP_TIME_MS);
+		start = snapshot_tick_times();
+		os_sleep_ms(MEASURE_TIME_MS);
+		end = snapshot_tick_times();
+
+		count = end.count - start.count;
+		printf("%8d %12.1f %12d\n", (int)num_sources,
+				count ? (double)(end.total_usec -
+					start.total_usec) / (double)count : 0.0,
+				(int)count);
+	} else {
+		printf("failed to set up %d sources\n", (int)num_sources);
+	}
+
+	feeder_stop(&feeder);
+	return success;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void do_log(int log_level, const char *msg, va_list args, void *param)
+{
+	if (log_level <= LOG_WARNING) {
+		vfprintf(stderr, msg, args);
+		fprintf(stderr, "\n");
+	}
+
+	UNUSED_PARAMETER(param);
+}
+
+int main(void)
+{
+	struct obs_audio_info oai = {SAMPLE_RATE, SPEAKERS_STEREO};
+	bool success = true;
+
+	base_set_log_handler(do_log, NULL);
+	profiler_start();
+
+	if (!obs_startup("en-US", NULL, NULL)) {
+		fprintf(stderr, "Couldn't start up OBS\n");
+		return 1;
+	}
+
+	if (!obs_reset_audio(&oai)) {
+		fprintf(stderr, "Couldn't initialize audio\n");
+		obs_shutdown();
+		return 1;
+	}
+
+	obs_register_source(&bench_source);
+
+	printf("%8s %12s %12s\n", "sources", "usec/tick", "ticks");
+
+	for (size_t i = 0; i < NUM_SOURCE_COUNTS; i++) {
+		if (!run_benchmark(source_counts[i])) {
+			success = false;
+			break;
+		}
+	}
+
+	obs_shutdown();
+	profiler_stop();
+	profiler_free();
+
+	return success ? 0 : 1;
+}
@@ -0,0 +1,342 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <media-io/format-conversion.h>
+
+/*
+ * Checks that the AVX2 format conversion functions are bit-exact with the
+ * SSE2/scalar ones, and measures the throughput of both.
+ *
+ * format-conversion.c is built in to this program with os_cpu_has_avx2
+ * renamed to test_use_avx2, so each path can be selected at runtime.
+ */
+
+static bool use_avx2 = false;
+
+bool test_use_avx2(void)
+{
+	return use_avx2;
+}
+
+#define BENCH_WIDTH   1920
+#define BENCH_HEIGHT  1080
+#define BENCH_TIME_NS 500000000ULL
+
+struct frame_size {
+	uint32_t width;
+	uint32_t height;
+};
+
+/* the SSE2 compress functions process 4 pixels at a time */
+static const struct frame_size sizes[] = {
+	{1920, 1080},
+	{1280, 720},
+	{644,  362},
+	{36,   18},
+	{4,    2},
+};
+
+#define NUM_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+struct buffers {
+	uint32_t width;
+	uint32_t height;
+
+	uint8_t  *packed444;
+	uint8_t  *packed422;
+	uint8_t  *planes[3];
+	uint8_t  *out_planes[2][3];
+	uint8_t  *out_packed[2];
+};
+
+static void fill_random(uint8_t *data, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+		data[i] = (uint8_t)rand();
+}
+
+static void buffers_init(struct buffers *b, uint32_t width, uint32_t height)
+{
+	size_t lum_size = (size_t)width * height;
+
+	memset(b, 0, sizeof(*b));
+	b->width  = width;
+	b->height = height;
+
+	/* decompress_422 converts min(in_linesize, out_linesize) / 2 pixel
+	 * pairs per line, which runs past the end of the last line of both
+	 * its input and its output, so those buffers get extra room */
+	b->packed444 = bmalloc(lum_size * 4);
+	b->packed422 = bmalloc(lum_size * 4);
+	fill_random(b->packed444, lum_size * 4);
+	fill_random(b->packed422, lum_size * 4);
+
+	for (size_t i = 0; i < 3; i++) {
+		b->planes[i] = bmalloc(lum_size);
+		fill_random(b->planes[i], lum_size);
+
+		b->out_planes[0][i] = bmalloc(lum_size);
+		b->out_planes[1][i] = bmalloc(lum_size);
+	}
+
+	b->out_packed[0] = bmalloc(lum_size * 8);
+	b->out_packed[1] = bmalloc(lum_size * 8);
+}
+
+static void buffers_free(struct buffers *b)
+{
+	bfree(b->packed444);
+	bfree(b->packed422);
+
+	for (size_t i = 0; i < 3; i++) {
+		bfree(b->planes[i]);
+		bfree(b->out_planes[0][i]);
+		bfree(b->out_planes[1][i]);
+	}
+
+	bfree(b->out_packed[0]);
+	bfree(b->out_packed[1]);
+}
+
+static void clear_outputs(struct buffers *b)
+{
+	size_t lum_size = (size_t)b->width * b->height;
+
+	for (size_t i = 0; i < 2; i++) {
+		for (size_t j = 0; j < 3; j++)
+			memset(b->out_planes[i][j], 0, lum_size);
+		memset(b->out_packed[i], 0, lum_size * 8);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+enum conversion {
+	CONV_UYVX_TO_I420,
+	CONV_UYVX_TO_NV12,
+	CONV_UYVX_TO_I444,
+	CONV_DECOMPRESS_420,
+	CONV_DECOMPRESS_NV12,
+	CONV_DECOMPRESS_422_Y,
+	CONV_DECOMPRESS_422_U,
+	NUM_CONVERSIONS
+};
+
+static const char *conversion_names[NUM_CONVERSIONS] = {
+	"compress_uyvx_to_i420",
+	"compress_uyvx_to_nv12",
+	"convert_uyvx_to_i444",
+	"decompress_420",
+	"decompress_nv12",
+	"decompress_422 (leading luma)",
+	"decompress_422 (leading chroma)",
+};
+
+static void run_conversion(struct buffers *b, enum conversion conv,
+		size_t out_idx, uint32_t start_y, uint32_t end_y)
+{
+	uint32_t width = b->width;
+	uint8_t **out_planes = b->out_planes[out_idx];
+	uint8_t *out_packed = b->out_packed[out_idx];
+	const uint8_t *const *planes = (const uint8_t *const *)b->planes;
+	uint32_t out_linesize[3];
+
+	switch (conv) {
+	case CONV_UYVX_TO_I420:
+		out_linesize[0] = width;
+		out_linesize[1] = width / 2;
+		out_linesize[2] = width / 2;
+		compress_uyvx_to_i420(b->packed444, width * 4, start_y, end_y,
+				out_planes, out_linesize);
+		break;
+
+	case CONV_UYVX_TO_NV12:
+		out_linesize[0] = width;
+		out_linesize[1] = width;
+		compress_uyvx_to_nv12(b->packed444, width * 4, start_y, end_y,
+				out_planes, out_linesize);
+		break;
+
+	case CONV_UYVX_TO_I444:
+		out_linesize[0] = width;
+		out_linesize[1] = width;
+		out_linesize[2] = width;
+		convert_uyvx_to_i444(b->packed444, width * 4, start_y, end_y,
+				out_planes, out_linesize);
+		break;
+
+	case CONV_DECOMPRESS_420:
+		out_linesize[0] = width;
+		out_linesize[1] = width / 2;
+		out_linesize[2] = width / 2;
+		decompress_420(planes, out_linesize, start_y, end_y,
+				out_packed, width * 4);
+		break;
+
+	case CONV_DECOMPRESS_NV12:
+		out_linesize[0] = width;
+		out_linesize[1] = width;
+		decompress_nv12(planes, out_linesize, start_y, end_y,
+				out_packed, width * 4);
+		break;
+
+	case CONV_DECOMPRESS_422_Y:
+	case CONV_DECOMPRESS_422_U:
+		decompress_422(b->packed422, width * 2, start_y, end_y,
+				out_packed, width * 4,
+				conv == CONV_DECOMPRESS_422_Y);
+		break;
+
+	case NUM_CONVERSIONS:
+		break;
+	}
+}
+
+/* bytes read and written by one conversion of the whole frame */
+static size_t conversion_bytes(struct buffers *b, enum conversion conv)
+{
+	size_t lum_size = (size_t)b->width * b->height;
+
+	switch (conv) {
+	case CONV_UYVX_TO_I420:
+	case CONV_UYVX_TO_NV12:
+		return lum_size * 4 + lum_size * 3 / 2;
+	case CONV_UYVX_TO_I444:
+		return lum_size * 4 + lum_size * 3;
+	case CONV_DECOMPRESS_420:
+	case CONV_DECOMPRESS_NV12:
+		return lum_size * 3 / 2 + lum_size * 4;
+	case CONV_DECOMPRESS_422_Y:
+	case CONV_DECOMPRESS_422_U:
+		return lum_size * 2 + lum_size * 4;
+	case NUM_CONVERSIONS:
+		break;
+	}
+
+	return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool outputs_match(struct buffers *b)
+{
+	size_t lum_size = (size_t)b->width * b->height;
+
+	for (size_t i = 0; i < 3; i++) {
+		if (memcmp(b->out_planes[0][i], b->out_planes[1][i],
+					lum_size) != 0)
+			return false;
+	}
+
+	return memcmp(b->out_packed[0], b->out_packed[1], lum_size * 8) == 0;
+}
+
+static bool check_conversion(struct buffers *b, enum conversion conv,
+		uint32_t start_y, uint32_t end_y)
+{
+	clear_outputs(b);
+
+	use_avx2 = false;
+	run_conversion(b, conv, 0, start_y, end_y);
+	use_avx2 = true;
+	run_conversion(b, conv, 1, start_y, end_y);
+
+	if (outputs_match(b))
+		return true;
+
+	printf("FAIL: %s, %ux%u, lines %u-%u\n", conversion_names[conv],
+			b->width, b->height, start_y, end_y);
+	return false;
+}
+
+static bool check_all(void)
+{
+	bool success = true;
+
+	for (size_t i = 0; i < NUM_SIZES; i++) {
+		struct buffers b;
+		uint32_t height = sizes[i].height;
+
+		buffers_init(&b, sizes[i].width, height);
+
+		for (int conv = 0; conv < NUM_CONVERSIONS; conv++) {
+			/* the whole frame, and a slice like the ones the
+			 * conversion threads work on */
+			if (!check_conversion(&b, conv, 0, height))
+				success = false;
+			if (height >= 4 &&
+			    !check_conversion(&b, conv, height / 2 & ~1,
+					    height))
+				success = false;
+		}
+
+		buffers_free(&b);
+	}
+
+	return success;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static double benchmark(struct buffers *b, enum conversion conv, bool avx2)
+{
+	uint64_t start = os_gettime_ns();
+	uint64_t elapsed;
+	size_t count = 0;
+
+	use_avx2 = avx2;
+
+	do {
+		run_conversion(b, conv, 0, 0, b->height);
+		count++;
+		elapsed = os_gettime_ns() - start;
+	} while (elapsed < BENCH_TIME_NS);
+
+	return (double)(conversion_bytes(b, conv) * count) / (double)elapsed;
+}
+
+static void benchmark_all(bool have_avx2)
+{
+	struct buffers b;
+
+	buffers_init(&b, BENCH_WIDTH, BENCH_HEIGHT);
+
+	printf("\nthroughput at %ux%u (GB/s of data read and written):\n",
+			BENCH_WIDTH, BENCH_HEIGHT);
+	printf("%-32s %8s %8s\n", "", "SSE2", "AVX2");
+
+	for (int conv = 0; conv < NUM_CONVERSIONS; conv++) {
+		double sse = benchmark(&b, conv, false);
+
+		if (have_avx2)
+			printf("%-32s %8.2f %8.2f\n", conversion_names[conv],
+					sse, benchmark(&b, conv, true));
+		else
+			printf("%-32s %8.2f %8s\n", conversion_names[conv],
+					sse, "-");
+	}
+
+	buffers_free(&b);
+}
+
+int main(void)
+{
+	bool have_avx2 = os_cpu_has_avx2();
+	bool success = true;
+
+	srand(1234);
+
+	if (have_avx2) {
+		success = check_all();
+		printf("AVX2 output %s the SSE2/scalar output\n",
+				success ? "matches" : "DOES NOT match");
+	} else {
+		printf("AVX2 isn't supported, skipping the bit-exact check\n");
+	}
+
+	benchmark_all(have_avx2);
+
+	return success ? 0 : 1;
+}
@@ -0,0 +1,301 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/bmem.h>
+#include <util/darray.h>
+#include <obs-internal.h>
+
+/*
+ * Randomized test of the output packet interleaver.  Packets of a video track
+ * and several audio tracks are pushed with a random arrival delay, so they
+ * reach the interleaver out of order both across and within tracks, while
+ * packets are popped and discarded in between.  Everything the interleaver
+ * returns is checked against a plain list of the packets it should hold:
+ * packets must come out by dts_usec, and packets of the same time must come
+ * out video first, then by ascending audio track.
+ *
+ * obs-output-interleave.c is built in to this program, since the interleaver
+ * is internal to libobs.
+ */
+
+#define NUM_ROUNDS         500
+#define PACKETS_PER_TRACK  200
+#define MAX_ARRIVAL_DELAY  8000
+
+struct pending_packet {
+	struct encoder_packet packet;
+	int64_t               arrival;
+};
+
+typedef DARRAY(struct encoder_packet) packet_list_t;
+
+static size_t failures = 0;
+
+#define check(cond, round, ...)                                               \
+do {                                                                          \
+	if (!(cond)) {                                                        \
+		printf("FAIL (round %d): ", round);                           \
+		printf(__VA_ARGS__);                                          \
+		printf("\n");                                                 \
+		failures++;                                                   \
+	}                                                                     \
+} while (false)
+
+static inline int64_t random_range(int64_t min, int64_t max)
+{
+	return min + (int64_t)(rand() % (int)(max - min + 1));
+}
+
+/* the order the interleaver must return packets in */
+static inline bool expected_before(const struct encoder_packet *a,
+		const struct encoder_packet *b)
+{
+	bool a_video = a->type == OBS_ENCODER_VIDEO;
+	bool b_video = b->type == OBS_ENCODER_VIDEO;
+
+	if (a->dts_usec != b->dts_usec)
+		return a->dts_usec < b->dts_usec;
+	if (a_video != b_video)
+		return a_video;
+	return a->track_idx < b->track_idx;
+}
+
+static inline bool same_packet(const struct encoder_packet *a,
+		const struct encoder_packet *b)
+{
+	return a->type == b->type && a->track_idx == b->track_idx &&
+		a->dts_usec == b->dts_usec && a->pts == b->pts;
+}
+
+static int compare_arrival(const void *a, const void *b)
+{
+	const struct pending_packet *pa = a;
+	const struct pending_packet *pb = b;
+
+	if (pa->arrival != pb->arrival)
+		return pa->arrival < pb->arrival ? -1 : 1;
+	return pa->packet.pts < pb->packet.pts ? -1 : 1;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* dts values are taken from a coarse grid so that packets of different
+ * tracks often share the same time */
+static void generate_packets(struct pending_packet **packets, size_t *count)
+{
+	size_t num_audio = (size_t)random_range(1, MAX_AUDIO_MIXES);
+	size_t num_tracks = 1 + num_audio;
+	struct pending_packet *array;
+	int64_t id = 0;
+
+	array = bmalloc(sizeof(*array) * num_tracks * PACKETS_PER_TRACK);
+
+	for (size_t track = 0; track < num_tracks; track++) {
+		int64_t step = random_range(1, 4) * 1000;
+		int64_t dts = random_range(0, 4) * 1000 - 5000;
+
+		for (size_t i = 0; i < PACKETS_PER_TRACK; i++) {
+			struct pending_packet *pending = &array[id];
+
+			memset(pending, 0, sizeof(*pending));
+			pending->packet.type = track == 0 ?
+				OBS_ENCODER_VIDEO : OBS_ENCODER_AUDIO;
+			pending->packet.track_idx = track == 0 ? 0 : track - 1;
+			pending->packet.dts_usec = dts;
+			pending->packet.dts = dts;
+			pending->packet.pts = id++;
+
+			/* most packets arrive in order, some are held up
+			 * behind later packets of their own track */
+			pending->arrival = dts;
+			if (rand() % 8 == 0)
+				pending->arrival += random_range(1,
+						MAX_ARRIVAL_DELAY);
+
+			dts += step;
+		}
+	}
+
+	qsort(array, (size_t)id, sizeof(*array), compare_arrival);
+
+	*packets = array;
+	*count = (size_t)id;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static size_t find_expected(packet_list_t *expected)
+{
+	size_t first = 0;
+
+	for (size_t i = 1; i < expected->num; i++) {
+		if (expected_before(&expected->array[i],
+					&expected->array[first]))
+			first = i;
+	}
+
+	return first;
+}
+
+static void check_track_ends(struct interleaver *il, packet_list_t *expected,
+		int round)
+{
+	for (size_t track = 0; track < INTERLEAVE_TRACKS; track++) {
+		enum obs_encoder_type type = track == 0 ?
+			OBS_ENCODER_VIDEO : OBS_ENCODER_AUDIO;
+		size_t audio_idx = track == 0 ? 0 : track - 1;
+		struct encoder_packet *first = NULL;
+		struct encoder_packet *last = NULL;
+		struct encoder_packet *il_first;
+		struct encoder_packet *il_last;
+
+		for (size_t i = 0; i < expected->num; i++) {
+			struct encoder_packet *packet = &expected->array[i];
+
+			if (packet->type != type || packet->track_idx !=
+					audio_idx)
+				continue;
+			if (!first || packet->dts_usec < first->dts_usec)
+				first = packet;
+			if (!last || packet->dts_usec > last->dts_usec)
+				last = packet;
+		}
+
+		il_first = interleaver_first(il, type, audio_idx);
+		il_last = interleaver_last(il, type, audio_idx);
+
+		check(!first == !il_first &&
+				(!first || same_packet(first, il_first)),
+				round, "wrong first packet of track %d",
+				(int)track);
+		check(!last == !il_last &&
+				(!last || same_packet(last, il_last)),
+				round, "wrong last packet of track %d",
+				(int)track);
+	}
+}
+
+static void pop_packet(struct interleaver *il, packet_list_t *expected,
+		int64_t *last_dts, int round)
+{
+	size_t idx = find_expected(expected);
+	struct encoder_packet *peeked = interleaver_peek(il);
+	struct encoder_packet packet;
+
+	check(peeked && same_packet(peeked, &expected->array[idx]), round,
+			"peek doesn't return the next packet");
+
+	interleaver_pop(il, &packet);
+
+	check(same_packet(&packet, &expected->array[idx]), round,
+			"popped dts %lld (type %d, track %d), expected dts "
+			"%lld (type %d, track %d)",
+			(long long)packet.dts_usec, (int)packet.type,
+			(int)packet.track_idx,
+			(long long)expected->array[idx].dts_usec,
+			(int)expected->array[idx].type,
+			(int)expected->array[idx].track_idx);
+	check(packet.dts_usec >= *last_dts, round,
+			"dts went backward from %lld to %lld",
+			(long long)*last_dts, (long long)packet.dts_usec);
+
+	*last_dts = packet.dts_usec;
+	da_erase((*expected), idx);
+}
+
+static void discard_until(struct interleaver *il, packet_list_t *expected,
+		int64_t dts_usec)
+{
+	interleaver_discard_until(il, dts_usec);
+
+	for (size_t i = expected->num; i > 0; i--) {
+		if (expected->array[i - 1].dts_usec < dts_usec)
+			da_erase((*expected), i - 1);
+	}
+}
+
+static void discard_before(struct interleaver *il, packet_list_t *expected,
+		const struct encoder_packet *packet)
+{
+	struct encoder_packet copy = *packet;
+
+	interleaver_discard_before(il, &copy);
+
+	for (size_t i = expected->num; i > 0; i--) {
+		if (expected_before(&expected->array[i - 1], &copy))
+			da_erase((*expected), i - 1);
+	}
+}
+
+static void run_round(int round)
+{
+	struct interleaver il = {0};
+	struct pending_packet *packets;
+	packet_list_t expected;
+	int64_t last_dts = INT64_MIN;
+	size_t count;
+
+	da_init(expected);
+	generate_packets(&packets, &count);
+
+	for (size_t i = 0; i < count; i++) {
+		struct encoder_packet *packet = &packets[i].packet;
+		int action = rand() % 64;
+
+		interleaver_push(&il, packet);
+		da_push_back(expected, packet);
+
+		/* packets older than ones already popped can still arrive,
+		 * so the dts order is only checked between pushes */
+		last_dts = INT64_MIN;
+
+		if (action < 16) {
+			while (expected.num > 16)
+				pop_packet(&il, &expected, &last_dts, round);
+
+		} else if (action == 16) {
+			size_t idx = (size_t)rand() % expected.num;
+			discard_until(&il, &expected,
+					expected.array[idx].dts_usec);
+
+		} else if (action == 17) {
+			size_t idx = (size_t)rand() % expected.num;
+			struct encoder_packet ref = expected.array[idx];
+			discard_before(&il, &expected, &ref);
+		}
+
+		check(il.num_packets == expected.num, round,
+				"holds %d packets, expected %d",
+				(int)il.num_packets, (int)expected.num);
+		check_track_ends(&il, &expected, round);
+	}
+
+	last_dts = INT64_MIN;
+	while (expected.num)
+		pop_packet(&il, &expected, &last_dts, round);
+
+	check(interleaver_peek(&il) == NULL && il.num_packets == 0, round,
+			"packets left after popping everything");
+
+	interleaver_free(&il);
+	da_free(expected);
+	bfree(packets);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int seed = argc > 1 ? (unsigned int)atoi(argv[1]) : 1;
+
+	srand(seed);
+
+	for (int i = 0; i < NUM_ROUNDS && failures < 20; i++)
+		run_round(i);
+
+	if (failures) {
+		printf("%d failures (seed %u)\n", (int)failures, seed);
+		return 1;
+	}
+
+	printf("%d rounds passed (seed %u)\n", NUM_ROUNDS, seed);
+	return 0;
+}